@@ -0,0 +1,292 @@
+/*
+ * qbc_link.c — .qbc 字节码链接器
+ *
+ * 大线路常由测好的小片段拼成（Bell 制备、oracle、扩散算子……），以前是把源码粘在一起重新编译。
+ * qbc_link 直接在字节码层面拼接：逐条改写片段里的比特与经典寄存器操作数，去掉各片段的
+ * OP_INIT_N，在开头写一条合并后的 INIT_N（总比特数）。片段只扫描一遍、不经编译器，
+ * 同一片段重复出现时只读一次，链接耗时与片段字节数成正比。
+ *
+ * 片段写法：
+ *   file.qbc          原样（比特不动；-t 时自动接在前面各片段之后）
+ *   file.qbc@3        比特与寄存器整体平移 3
+ *   file.qbc:4,0,1    比特 i 映射到第 i 个数（必须互不相同），寄存器按同一张表映射
+ * 寄存器随比特一起改写，是因为本仓库线路惯用 MEASURE q q；表外的寄存器按表长之后顺延。
+ * 片段里的 STOP / EXIT 截断该片段（与 qvm_decode 一致），只有最后一个片段的保留。
+ * -P 给出 .qpk 归档时，片段名先在归档里按名字查找（零拷贝），查不到再当文件读。
+ *
+ * 用法: qbc_link -o <out.qbc> [-t] [-P circuits.qpk] <片段>...
+ */
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "qsm_jsonl.h"
+#include "qvm_exec.h"
+#include "qvm_pack.h"
+
+#define MAX_MAP 256                 // 操作数是 u8
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ==================== 片段 ====================
+
+typedef struct {
+    char *name;
+    const uint8_t *data;
+    size_t size;
+    QsmMap map;                 // 从文件读时的映射；来自归档时为空
+    int width;                  // INIT_N 声明与操作数里较大者
+    int nregs;                  // 最大寄存器号 + 1
+} Source;
+
+typedef struct {
+    Source *src;
+    int offset;                 // map 为空时的平移量
+    int map[MAX_MAP];
+    int nmap;                   // 0 = 平移
+    const char *arg;
+} Frag;
+
+static int operand_count(uint8_t op) {
+    switch (op) {
+    case QVM_OP_INIT_N: case QVM_OP_CNOT: case QVM_OP_SWAP: case QVM_OP_MEASURE: return 2;
+    case QVM_OP_H: case QVM_OP_X: case QVM_OP_Y: case QVM_OP_Z: case QVM_OP_T: case QVM_OP_S: case QVM_OP_RESET:
+    case QVM_OP_PRINT: return 1;
+    case QVM_OP_BARRIER: case QVM_OP_STOP: case QVM_OP_EXIT: return 0;
+    default: return -1;
+    }
+}
+
+// 扫一遍片段，求比特宽度与寄存器数；字节码非法返回出错位置，正常返回 -1
+static long scan_source(Source *s) {
+    int maxq = -1, maxr = -1, declared = 0;
+    for (size_t i = 0; i < s->size;) {
+        uint8_t op = s->data[i];
+        int nops = operand_count(op);
+        if (nops < 0 || i + 1 + (size_t)nops > s->size) return (long)i;
+        const uint8_t *a = s->data + i + 1;
+        i += 1 + (size_t)nops;
+        switch (op) {
+        case QVM_OP_INIT_N: declared = a[0] | a[1] << 8; break;
+        case QVM_OP_CNOT: case QVM_OP_SWAP: if (a[1] > maxq) maxq = a[1]; /* fall through */
+        case QVM_OP_H: case QVM_OP_X: case QVM_OP_Y: case QVM_OP_Z: case QVM_OP_T: case QVM_OP_S: case QVM_OP_RESET:
+            if (a[0] > maxq) maxq = a[0];
+            break;
+        case QVM_OP_BARRIER: break;
+        case QVM_OP_MEASURE:
+            if (a[0] > maxq) maxq = a[0];
+            if (a[1] > maxr) maxr = a[1];
+            break;
+        case QVM_OP_PRINT: if (a[0] > maxr) maxr = a[0]; break;
+        default: i = s->size; break;       // STOP / EXIT：其后不会执行
+        }
+    }
+    s->width = declared > maxq + 1 ? declared : maxq + 1;
+    s->nregs = maxr + 1;
+    return -1;
+}
+
+static Source **g_sources;
+static int g_nsources;
+
+// 同一片段只读一次
+static Source *load_source(const char *name, const QvmPack *pk) {
+    for (int i = 0; i < g_nsources; i++)
+        if (strcmp(g_sources[i]->name, name) == 0) return g_sources[i];
+    Source s;
+    memset(&s, 0, sizeof(s));
+    const QvmPackEntry *e = pk ? qvm_pack_find(pk, name, strlen(name)) : NULL;
+    if (e) {
+        s.data = qvm_pack_data(pk, e);
+        s.size = e->size;
+    } else if (qsm_map_file(name, &s.map) == 0) {
+        s.data = (const uint8_t *)s.map.data;
+        s.size = s.map.size;
+    } else {
+        fprintf(stderr, "[LINK] 找不到片段 %s%s\n", name, pk ? "（归档与文件系统里都没有）" : "");
+        return NULL;
+    }
+    long bad = scan_source(&s);
+    if (bad >= 0) {
+        fprintf(stderr, "[LINK] %s: 偏移 %ld 处字节码非法（操作码 %u）\n", name, bad, s.data[bad]);
+        qsm_unmap_file(&s.map);
+        return NULL;
+    }
+    s.name = strdup(name);
+    if (g_nsources % 64 == 0) g_sources = realloc(g_sources, (size_t)(g_nsources + 64) * sizeof(Source *));
+    g_sources[g_nsources] = malloc(sizeof(Source));
+    *g_sources[g_nsources] = s;
+    return g_sources[g_nsources++];
+}
+
+// 解析 "名字[@平移 | :映射表]"；名字本身可以含 ':' 或 '@'，只认最后一个
+static int parse_frag(const char *arg, Frag *f, char **name) {
+    memset(f, 0, sizeof(*f));
+    f->arg = arg;
+    f->offset = -1;
+    const char *at = strrchr(arg, '@'), *colon = strrchr(arg, ':');
+    const char *sep = at > colon ? at : colon;
+    char *end;
+    if (sep && sep == at && sep[1] >= '0' && sep[1] <= '9') {
+        long v = strtol(sep + 1, &end, 10);
+        if (*end || v >= MAX_MAP) return -1;
+        f->offset = (int)v;
+    } else if (sep && sep == colon && sep[1] >= '0' && sep[1] <= '9') {
+        uint8_t used[MAX_MAP] = { 0 };
+        for (const char *p = sep + 1;; p = end + 1) {
+            long v = strtol(p, &end, 10);
+            if (end == p || v < 0 || v >= MAX_MAP || used[v] || f->nmap == MAX_MAP) return -1;
+            used[v] = 1;
+            f->map[f->nmap++] = (int)v;
+            if (*end == '\0') break;
+            if (*end != ',') return -1;
+        }
+    } else {
+        sep = NULL;
+    }
+    *name = sep ? strndup(arg, (size_t)(sep - arg)) : strdup(arg);
+    return 0;
+}
+
+// 比特 / 寄存器改写；超出 u8 返回 -1
+static int remap(const Frag *f, int v) {
+    int r;
+    if (!f->nmap) r = v + f->offset;
+    else if (v < f->nmap) r = f->map[v];
+    else {
+        int hi = 0;
+        for (int i = 0; i < f->nmap; i++) if (f->map[i] + 1 > hi) hi = f->map[i] + 1;
+        r = hi + (v - f->nmap);
+    }
+    return r < MAX_MAP ? r : -1;
+}
+
+// 把片段改写后追加到 out，返回写出的指令条数；操作数越界返回 -1
+static long emit_frag(const Frag *f, int last, uint8_t *out, size_t *pos, int *width) {
+    const Source *s = f->src;
+    long n_ops = 0;
+    for (size_t i = 0; i < s->size;) {
+        uint8_t op = s->data[i];
+        int nops = operand_count(op);
+        const uint8_t *a = s->data + i + 1;
+        i += 1 + (size_t)nops;
+        if (op == QVM_OP_INIT_N) continue;
+        if (op == QVM_OP_STOP || op == QVM_OP_EXIT) {
+            if (last) {
+                out[(*pos)++] = op;
+                n_ops++;
+            }
+            break;
+        }
+        if (op == QVM_OP_BARRIER) {
+            out[(*pos)++] = op;
+            n_ops++;
+            continue;
+        }
+        int x = remap(f, a[0]), y = nops == 2 ? remap(f, a[1]) : 0;
+        if (x < 0 || y < 0) return -1;
+        out[(*pos)++] = op;
+        out[(*pos)++] = (uint8_t)x;
+        if (nops == 2) out[(*pos)++] = (uint8_t)y;
+        // PRINT 与 MEASURE 的第二个操作数是寄存器，不算比特
+        if (op != QVM_OP_PRINT && x + 1 > *width) *width = x + 1;
+        if ((op == QVM_OP_CNOT || op == QVM_OP_SWAP) && y + 1 > *width) *width = y + 1;
+        n_ops++;
+    }
+    // 片段声明的比特（可能有未被任何门触及的）也要算进总宽度
+    if (s->width > 0) {
+        int top = remap(f, s->width - 1);
+        if (top < 0) return -1;
+        if (top + 1 > *width) *width = top + 1;
+    }
+    return n_ops;
+}
+
+int main(int argc, char *argv[]) {
+    const char *out = NULL, *pack = NULL;
+    int tensor = 0, nfrags = 0;
+    Frag *frags = calloc((size_t)argc, sizeof(Frag));
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) out = argv[++i];
+        else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) pack = argv[++i];
+        else if (strcmp(argv[i], "-t") == 0) tensor = 1;
+        else frags[nfrags++].arg = argv[i];
+    }
+    if (!out || nfrags == 0) {
+        fprintf(stderr, "用法: %s -o <out.qbc> [-t] [-P circuits.qpk] <片段>...\n", argv[0]);
+        fprintf(stderr, "  片段: file.qbc | file.qbc@平移 | file.qbc:映射表（如 4,0,1）\n");
+        fprintf(stderr, "  -t  张量积：未指定平移 / 映射的片段自动接在已用比特与寄存器之后\n");
+        fprintf(stderr, "\n在字节码层面拼接 .qbc 片段，改写比特与寄存器操作数并合并 INIT_N，不经编译器\n");
+        return 1;
+    }
+
+    double t0 = now_sec();
+    QvmPack *pk = NULL;
+    if (pack) {
+        const char *err;
+        if (!(pk = qvm_pack_open(pack, QVM_PACK_VERIFY, &err))) {
+            fprintf(stderr, "[LINK] 无法载入归档 %s: %s\n", pack, err);
+            return 1;
+        }
+    }
+    size_t cap = 3;                 // 开头的 INIT_N
+    int next_q = 0;                 // -t 时下一个片段的起点
+    for (int i = 0; i < nfrags; i++) {
+        Frag *f = &frags[i];
+        char *name;
+        if (parse_frag(f->arg, f, &name) != 0) {
+            fprintf(stderr, "[LINK] 无法解析片段 %s（平移 / 映射表超出 0..%d 或映射表有重复）\n", f->arg, MAX_MAP - 1);
+            return 1;
+        }
+        f->src = load_source(name, pk);
+        free(name);
+        if (!f->src) return 1;
+        // 寄存器与比特共用一张改写表，-t 时起点取两者的较大者，避免寄存器撞车
+        int span = f->src->width > f->src->nregs ? f->src->width : f->src->nregs;
+        if (f->offset < 0 && !f->nmap) f->offset = tensor ? next_q : 0;
+        int top = span ? remap(f, span - 1) + 1 : 0;
+        if (tensor && top > next_q) next_q = top;
+        cap += f->src->size;
+    }
+
+    uint8_t *buf = malloc(cap);
+    size_t pos = 3;
+    int width = 0;
+    long n_ops = 1;
+    for (int i = 0; i < nfrags; i++) {
+        long n = emit_frag(&frags[i], i == nfrags - 1, buf, &pos, &width);
+        if (n < 0) {
+            fprintf(stderr, "[LINK] %s: 改写后的比特或寄存器超过 %d\n", frags[i].arg, MAX_MAP - 1);
+            return 1;
+        }
+        n_ops += n;
+    }
+    buf[0] = QVM_OP_INIT_N;
+    buf[1] = (uint8_t)(width & 0xFF);
+    buf[2] = (uint8_t)(width >> 8);
+
+    FILE *fo = fopen(out, "wb");
+    if (!fo || fwrite(buf, 1, pos, fo) != pos || fclose(fo) != 0) {
+        fprintf(stderr, "[LINK] 无法写出 %s\n", out);
+        return 1;
+    }
+    fprintf(stdout, "[LINK] %s: %d 个片段（%d 个不同）, %d 比特, %ld 条指令, %zu 字节, %.2f ms\n", out, nfrags,
+            g_nsources, width, n_ops, pos, (now_sec() - t0) * 1e3);
+    free(buf);
+    free(frags);
+    for (int i = 0; i < g_nsources; i++) {
+        qsm_unmap_file(&g_sources[i]->map);
+        free(g_sources[i]->name);
+        free(g_sources[i]);
+    }
+    free(g_sources);
+    qvm_pack_close(pk);
+    return 0;
+}
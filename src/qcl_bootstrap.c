@@ -2,15 +2,34 @@
  * qcl_bootstrap.c — QCL编译器最小化引导编译器
  *
  * 红线规则：只能解释量子指令子集
- *   init / H / X / Y / Z / T / S / CNOT / MEASURE / PRINT / STOP / EXIT
+ *   init / H / X / Y / Z / T / S / CNOT / SWAP / RESET / BARRIER / MEASURE / PRINT / STOP / EXIT
+ * .qasm 输入走独立的 OpenQASM 2 导入前端，.qir（二进制定长记录，见 qcl_ir.h）直接发码，
+ * 产出的都是同一子集的字节码。
  * 严禁添加 parse_import / parse_type / parse_function 等高级语法解析。
  */
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/un.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "qcl_ir.h"
+#include "qsm_metrics.h"
+
 #define MAX_LINE_LEN 4096
 #define MAX_OPS 131072
 
@@ -42,169 +61,2099 @@ typedef enum {
     OP_EXIT = 17,
 } Opcode;
 
-// ==================== 全局字节码缓冲区 ====================
+// ==================== 编译上下文 ====================
+
+#define STATS_MAX_SKIPPED 1000
+
+// 命令行编译的统计（--stats=json 输出）；--serve / --watch 的上下文不挂统计
+typedef struct {
+    long lines;                 // 读过的行数
+    long skipped;               // 无法识别、被丢掉的行数
+    long skipped_at[STATS_MAX_SKIPPED];     // 前 STATS_MAX_SKIPPED 个的行号（从 1 计）
+    long ops[64];               // 按操作码计的指令条数
+    int init_qubits;            // 最后一条 init 的宽度，-1 表示没有
+    int max_qubit;              // 操作数里最大的比特编号，-1 表示没有
+    int threads;
+    const char *format;         // qentl / qasm / qir
+    long src_bytes;
+    long bc_bytes;
+    double emit_sec;            // 字节码写出耗时
+} QclStats;
+
+// 一次编译的全部可变状态；命令行只用 g_ctx，--serve 每个连接各有一份
+typedef struct {
+    unsigned char *bc;          // MAX_OPS 字节
+    int pos;
+    int n_ops;                  // 已写出的指令条数
+    FILE *sink;                 // 非空时 bc 写满就倒到这里（流式输出），pos 从 0 重新计
+    long flushed;               // 已倒出的字节数
+    int sink_failed;
+    QclStats *stats;            // 非空时记统计
+} QclCtx;
 
 static unsigned char g_bytecode[MAX_OPS];
-static int g_bc_pos = 0;
+static QclCtx g_ctx = { .bc = g_bytecode };
+static FILE *g_log;             // 编译日志去向，NULL 为 stdout（--stats=json 时 stdout 只留统计）
+#define QCL_LOG (g_log ? g_log : stdout)
+
+static double since(const struct timespec *t0) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+static QclStats g_stats;
+
+static void stats_reset(QclStats *st) {
+    memset(st, 0, sizeof(*st));
+    st->init_qubits = -1;
+    st->max_qubit = -1;
+    st->threads = 1;
+}
 
 // ==================== 字节码写入 ====================
 
-static void write_byte(unsigned char b) {
-    if (g_bc_pos < MAX_OPS) {
-        g_bytecode[g_bc_pos++] = b;
+// 把 bc 里已有的字节倒给 sink
+static void qcl_flush(QclCtx *c) {
+    if (c->sink && c->pos) {
+        struct timespec t0;
+        if (c->stats) clock_gettime(CLOCK_MONOTONIC, &t0);
+        if (fwrite(c->bc, 1, (size_t)c->pos, c->sink) != (size_t)c->pos) c->sink_failed = 1;
+        if (c->stats) c->stats->emit_sec += since(&t0);
+        c->flushed += c->pos;
+        c->pos = 0;
     }
 }
 
-static void write_opcode(Opcode op) {
-    write_byte(op);
+static void write_byte(QclCtx *c, unsigned char b) {
+    if (c->pos == MAX_OPS && c->sink) qcl_flush(c);
+    if (c->pos < MAX_OPS) {
+        c->bc[c->pos++] = b;
+    }
 }
 
-static void write_u8(unsigned char v) {
-    write_byte(v);
+static void write_opcode(QclCtx *c, Opcode op) {
+    c->n_ops++;
+    if (c->stats) c->stats->ops[op & 63]++;
+    write_byte(c, op);
 }
 
-static void write_u16(unsigned short v) {
-    write_byte(v & 0xFF);
-    write_byte((v >> 8) & 0xFF);
+static void write_u8(QclCtx *c, unsigned char v) {
+    write_byte(c, v);
 }
 
-static void write_u32(unsigned int v) {
-    write_byte(v & 0xFF);
-    write_byte((v >> 8) & 0xFF);
-    write_byte((v >> 16) & 0xFF);
-    write_byte((v >> 24) & 0xFF);
+static void write_u16(QclCtx *c, unsigned short v) {
+    write_byte(c, v & 0xFF);
+    write_byte(c, (v >> 8) & 0xFF);
+}
+
+static void write_u32(QclCtx *c, unsigned int v) {
+    write_byte(c, v & 0xFF);
+    write_byte(c, (v >> 8) & 0xFF);
+    write_byte(c, (v >> 16) & 0xFF);
+    write_byte(c, (v >> 24) & 0xFF);
 }
 
 // ==================== 量子指令子集编译器 ====================
 
-int compile_file_v2(const char *input_path, const char *output_path) {
+static void note_qubit(QclCtx *c, int q) {
+    if (c->stats && q > c->stats->max_qubit) c->stats->max_qubit = q;
+}
+
+// 编译一行源码；产生了指令返回 1。不认识的行不产生指令，挂了统计时记下行号
+static int compile_line(QclCtx *c, const char *line) {
+    int found = 0;
+    const char *p = line;
+    if (c->stats) c->stats->lines++;
+    while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+
+    if (*p == '/' || *p == '\n' || *p == '\0' || *p == '#') return 0;
+
+    char code[MAX_LINE_LEN];
+    int ci = 0;
+    for (int i = 0; line[i]; i++) {
+        if (line[i] == '/' && line[i+1] == '/') break;
+        if (ci < MAX_LINE_LEN-1) code[ci++] = line[i];
+    }
+    code[ci] = '\0';
+
+    p = code;
+    while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+    if (*p == '/' || *p == '\n' || *p == '\0' || *p == '#') return 0;
+
+    if (strncmp(p, "init ", 5) == 0) {
+        p += 5;
+        unsigned int n = 0;
+        while (*p >= '0' && *p <= '9') { n = n * 10 + (*p - '0'); p++; }
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+        write_opcode(c, OP_INIT_N);
+        write_u8(c, n & 0xFF);
+        write_u8(c, (n >> 8) & 0xFF);
+        if (c->stats) c->stats->init_qubits = (int)(n & 0xFFFF);
+        found = 1;
+    }
+    else if (strncmp(p, "H ", 2) == 0 || strncmp(p, "X ", 2) == 0 ||
+             strncmp(p, "Y ", 2) == 0 || strncmp(p, "Z ", 2) == 0 ||
+             strncmp(p, "T ", 2) == 0 || strncmp(p, "S ", 2) == 0) {
+        Opcode op;
+        if (strncmp(p, "H ", 2) == 0) op = OP_H;
+        else if (strncmp(p, "X ", 2) == 0) op = OP_X;
+        else if (strncmp(p, "Y ", 2) == 0) op = OP_Y;
+        else if (strncmp(p, "Z ", 2) == 0) op = OP_Z;
+        else if (strncmp(p, "T ", 2) == 0) op = OP_T;
+        else if (strncmp(p, "S ", 2) == 0) op = OP_S;
+        else op = OP_NOP;
+        p += 2;
+        int qid = 0;
+        while (*p >= '0' && *p <= '9') { qid = qid * 10 + (*p - '0'); p++; }
+        write_opcode(c, op);
+        write_u8(c, qid);
+        note_qubit(c, qid);
+        found = 1;
+    }
+    else if (strncmp(p, "CNOT ", 5) == 0) {
+        p += 5;
+        int ctrl = 0, tgt = 0;
+        while (*p >= '0' && *p <= '9') { ctrl = ctrl * 10 + (*p - '0'); p++; }
+        while (*p == ' ' || *p == '\t') p++;
+        while (*p >= '0' && *p <= '9') { tgt = tgt * 10 + (*p - '0'); p++; }
+        write_opcode(c, OP_CNOT);
+        write_u8(c, ctrl);
+        write_u8(c, tgt);
+        note_qubit(c, ctrl);
+        note_qubit(c, tgt);
+        found = 1;
+    }
+    else if (strncmp(p, "SWAP ", 5) == 0) {
+        p += 5;
+        int q1 = 0, q2 = 0;
+        while (*p >= '0' && *p <= '9') { q1 = q1 * 10 + (*p - '0'); p++; }
+        while (*p == ' ' || *p == '\t') p++;
+        while (*p >= '0' && *p <= '9') { q2 = q2 * 10 + (*p - '0'); p++; }
+        write_opcode(c, OP_SWAP);
+        write_u8(c, q1);
+        write_u8(c, q2);
+        note_qubit(c, q1);
+        note_qubit(c, q2);
+        found = 1;
+    }
+    else if (strncmp(p, "RESET ", 6) == 0) {
+        p += 6;
+        int qid = 0;
+        while (*p >= '0' && *p <= '9') { qid = qid * 10 + (*p - '0'); p++; }
+        write_opcode(c, OP_RESET);
+        write_u8(c, qid);
+        note_qubit(c, qid);
+        found = 1;
+    }
+    else if (strncmp(p, "BARRIER", 7) == 0) {
+        write_opcode(c, OP_BARRIER);
+        found = 1;
+    }
+    else if (strncmp(p, "MEASURE ", 8) == 0) {
+        p += 8;
+        int qid = 0, reg = 0;
+        while (*p >= '0' && *p <= '9') { qid = qid * 10 + (*p - '0'); p++; }
+        while (*p == ' ' || *p == '\t') p++;
+        while (*p >= '0' && *p <= '9') { reg = reg * 10 + (*p - '0'); p++; }
+        write_opcode(c, OP_MEASURE);
+        write_u8(c, qid);
+        write_u8(c, reg);
+        note_qubit(c, qid);
+        found = 1;
+    }
+    else if (strncmp(p, "PRINT ", 6) == 0) {
+        p += 6;
+        int reg = 0;
+        while (*p >= '0' && *p <= '9') { reg = reg * 10 + (*p - '0'); p++; }
+        write_opcode(c, OP_PRINT);
+        write_u8(c, reg);
+        found = 1;
+    }
+    else if (strncmp(p, "STOP", 4) == 0) {
+        write_opcode(c, OP_STOP);
+        found = 1;
+    }
+    else if (strncmp(p, "EXIT", 4) == 0) {
+        write_opcode(c, OP_EXIT);
+        found = 1;
+    }
+    if (!found && c->stats) {
+        if (c->stats->skipped < STATS_MAX_SKIPPED) c->stats->skipped_at[c->stats->skipped] = c->stats->lines;
+        c->stats->skipped++;
+    }
+    return found;
+}
+
+// 逐行编译 src 追加到 c，返回是否找到可编译的代码（不重置 c，不补 STOP；并行编译的分块也走这里）
+static int compile_lines(QclCtx *c, const char *src, size_t n) {
+    char line[MAX_LINE_LEN];
+    int found_code = 0;
+    for (size_t i = 0; i < n;) {
+        size_t k = 0;
+        while (i < n && src[i] != '\n') {
+            if (k < MAX_LINE_LEN - 2) line[k++] = src[i];
+            i++;
+        }
+        i++;
+        line[k++] = '\n';
+        line[k] = '\0';
+        found_code |= compile_line(c, line);
+    }
+    return found_code;
+}
+
+// 从内存编译整段源码到 c，返回是否找到可编译的代码；没找到时补一条 STOP
+static int compile_buffer_ctx(QclCtx *c, const char *src, size_t n) {
+    c->pos = 0;
+    c->n_ops = 0;
+    int found_code = compile_lines(c, src, n);
+    if (!found_code) write_opcode(c, OP_STOP);
+    return found_code;
+}
+
+// ==================== OpenQASM 2 导入 ====================
+//
+// 公开的基准线路大多是 OpenQASM 2。先转成 .qentl 文本再逐行编译，对几百万门的文件太慢；
+// 这里直接流式解析 .qasm 语句，用上面同一组 write_* 写字节码。只认 Opcode 能表达的子集：
+//   OPENQASM 2.x; include "qelib1.inc"; qreg / creg;
+//   h x y z s t id, cx (CX), swap, measure a -> c, reset, barrier
+// 门作用在整个寄存器上时按下标展开（h q; cx q, r; measure q -> c;）。
+// 多个 qreg / creg 按声明顺序拼成一维编号；编号超过 255 报错（字节码操作数是 u8）。
+// swap、reset 直接发 OP_SWAP / OP_RESET；barrier 每条语句发一条不带操作数的 OP_BARRIER
+// （执行器逐门顺序执行，作用在哪些比特上无关紧要）；id 不产生指令。
+// gate / opaque / if 与带参数的门报错并给出行号。
+// 输入按块读入，语句跨块时把残余挪到块首；输出缓冲满了就写到 sink，文件多大都不受 MAX_OPS 限制。
+
+#define QASM_MAX_REGS 64
+#define QASM_MAX_BITS 256
+
+typedef struct {
+    char name[32];
+    int base, size;
+} QasmReg;
+
+typedef struct {
+    QasmReg q[QASM_MAX_REGS], c[QASM_MAX_REGS];
+    int nq, nc;
+    int nqubits, nclbits;
+    int declared;               // 已写出的 INIT_N 宽度
+    long line;                  // 已消费部分的行数
+    long gates, skipped;
+    char err[160];
+} QasmState;
+
+static const char *qasm_ws(const char *p, const char *e) {
+    for (;;) {
+        while (p < e && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+        if (p + 1 < e && p[0] == '/' && p[1] == '/') {
+            while (p < e && *p != '\n') p++;
+            continue;
+        }
+        return p;
+    }
+}
+
+static int qasm_ident(const char **pp, const char *e, char *out, size_t cap) {
+    const char *p = *pp;
+    size_t n = 0;
+    while (p < e && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || *p == '_' ||
+                     (n && *p >= '0' && *p <= '9'))) {
+        if (n + 1 < cap) out[n++] = *p;
+        p++;
+    }
+    out[n] = '\0';
+    *pp = p;
+    return n > 0;
+}
+
+static int qasm_int(const char **pp, const char *e, long *v) {
+    const char *p = *pp;
+    long x = 0;
+    if (p >= e || *p < '0' || *p > '9') return 0;
+    while (p < e && *p >= '0' && *p <= '9' && x < 100000000) x = x * 10 + (*p++ - '0');
+    *v = x;
+    *pp = p;
+    return 1;
+}
+
+// 报错；行号 = 已消费行数 + 语句起点到 at 之间的换行数
+static void qasm_fail(QasmState *st, const char *s, const char *at, const char *fmt, const char *arg) {
+    long line = st->line + 1;
+    for (const char *p = s; p < at; p++) line += *p == '\n';
+    int n = snprintf(st->err, sizeof(st->err), "第 %ld 行: ", line);
+    snprintf(st->err + n, sizeof(st->err) - (size_t)n, fmt, arg);
+}
+
+// 解析 name 或 name[i]，得到一维编号区间 [*base, *base + *size)
+static int qasm_operand(QasmState *st, const char *s, const char **pp, const char *e, int classical,
+                        int *base, int *size) {
+    const char *p = qasm_ws(*pp, e);
+    char name[32];
+    if (!qasm_ident(&p, e, name, sizeof(name))) {
+        qasm_fail(st, s, p, "缺少%s寄存器", classical ? "经典" : "量子");
+        return -1;
+    }
+    const QasmReg *regs = classical ? st->c : st->q;
+    int n = classical ? st->nc : st->nq;
+    const QasmReg *r = NULL;
+    for (int i = 0; i < n && !r; i++)
+        if (strcmp(regs[i].name, name) == 0) r = &regs[i];
+    if (!r) {
+        qasm_fail(st, s, p, "未声明的寄存器 '%s'", name);
+        return -1;
+    }
+    p = qasm_ws(p, e);
+    if (p < e && *p == '[') {
+        long idx;
+        p = qasm_ws(p + 1, e);
+        if (!qasm_int(&p, e, &idx) || (p = qasm_ws(p, e)) >= e || *p != ']' || idx >= r->size) {
+            qasm_fail(st, s, p, "寄存器 '%s' 下标无效或越界", r->name);
+            return -1;
+        }
+        *base = r->base + (int)idx;
+        *size = 1;
+        p++;
+    } else {
+        *base = r->base;
+        *size = r->size;
+    }
+    *pp = p;
+    return 0;
+}
+
+// 第一条门之前（以及门之后又有新 qreg 时）写出 INIT_N
+static void qasm_sync_width(QclCtx *c, QasmState *st) {
+    if (st->declared == st->nqubits) return;
+    write_opcode(c, OP_INIT_N);
+    write_u16(c, (unsigned short)st->nqubits);
+    st->declared = st->nqubits;
+}
+
+static int qasm_decl(QasmState *st, const char *s, const char *p, const char *e, int classical) {
+    QasmReg *r = classical ? &st->c[st->nc] : &st->q[st->nq];
+    long size;
+    if ((classical ? st->nc : st->nq) == QASM_MAX_REGS) {
+        qasm_fail(st, s, p, "寄存器过多（上限 %s）", "64");
+        return -1;
+    }
+    p = qasm_ws(p, e);
+    int ok = qasm_ident(&p, e, r->name, sizeof(r->name));
+    if (ok && (p = qasm_ws(p, e)) < e && *p == '[') {
+        p = qasm_ws(p + 1, e);
+        ok = qasm_int(&p, e, &size) && (p = qasm_ws(p, e)) < e && *p == ']' && size >= 1;
+        p++;
+    } else ok = 0;
+    if (!ok) {
+        qasm_fail(st, s, p, "%s 声明格式应为 name[n]", classical ? "creg" : "qreg");
+        return -1;
+    }
+    int *total = classical ? &st->nclbits : &st->nqubits;
+    if (*total + size > QASM_MAX_BITS) {
+        qasm_fail(st, s, p, "%s 总数超过 256（字节码操作数是 u8）", classical ? "经典比特" : "量子比特");
+        return -1;
+    }
+    r->base = *total;
+    r->size = (int)size;
+    *total += (int)size;
+    if (classical) st->nc++;
+    else st->nq++;
+    return 0;
+}
+
+// 编译一条语句 [s, e)（不含 ';'）
+static int qasm_statement(QclCtx *c, QasmState *st, const char *s, const char *e) {
+    const char *p = qasm_ws(s, e);
+    if (p == e) return 0;
+    const char *kw = p;
+    char op[32];
+    if (!qasm_ident(&p, e, op, sizeof(op))) {
+        qasm_fail(st, s, kw, "无法识别的语句 '%.16s'", kw);
+        return -1;
+    }
+    if (strcmp(op, "OPENQASM") == 0) {
+        p = qasm_ws(p, e);
+        if (p >= e || *p != '2') {
+            qasm_fail(st, s, p, "只支持 OpenQASM 2%s", "");
+            return -1;
+        }
+        return 0;
+    }
+    if (strcmp(op, "include") == 0) {
+        p = qasm_ws(p, e);
+        if ((size_t)(e - p) < 12 || memcmp(p, "\"qelib1.inc\"", 12) != 0) {
+            qasm_fail(st, s, p, "只支持 include \"qelib1.inc\"%s", "");
+            return -1;
+        }
+        return 0;
+    }
+    if (strcmp(op, "qreg") == 0) return qasm_decl(st, s, p, e, 0);
+    if (strcmp(op, "creg") == 0) return qasm_decl(st, s, p, e, 1);
+
+    Opcode one = OP_NOP;
+    if (op[1] == '\0') {
+        switch (op[0]) {
+        case 'h': one = OP_H; break;
+        case 'x': one = OP_X; break;
+        case 'y': one = OP_Y; break;
+        case 'z': one = OP_Z; break;
+        case 's': one = OP_S; break;
+        case 't': one = OP_T; break;
+        default: break;
+        }
+    }
+    int a, na, b, nb;
+    if (one == OP_NOP && strcmp(op, "reset") == 0) one = OP_RESET;
+    if (one != OP_NOP || strcmp(op, "id") == 0 || strcmp(op, "barrier") == 0) {
+        int is_barrier = op[0] == 'b';
+        do {
+            if (qasm_operand(st, s, &p, e, 0, &a, &na) != 0) return -1;
+            for (int i = 0; i < na && one != OP_NOP; i++) {
+                qasm_sync_width(c, st);
+                write_opcode(c, one);
+                write_u8(c, (unsigned char)(a + i));
+                st->gates++;
+            }
+            if (one == OP_NOP && !is_barrier) st->skipped += na;   // id
+            p = qasm_ws(p, e);
+        } while (is_barrier && p < e && *p == ',' && ++p);
+        if (is_barrier) {
+            qasm_sync_width(c, st);
+            write_opcode(c, OP_BARRIER);
+        }
+    } else if (strcmp(op, "cx") == 0 || strcmp(op, "CX") == 0 || strcmp(op, "swap") == 0) {
+        if (qasm_operand(st, s, &p, e, 0, &a, &na) != 0) return -1;
+        p = qasm_ws(p, e);
+        if (p >= e || *p++ != ',') {
+            qasm_fail(st, s, p, "%s 需要两个操作数", op);
+            return -1;
+        }
+        if (qasm_operand(st, s, &p, e, 0, &b, &nb) != 0) return -1;
+        if (na != nb && na != 1 && nb != 1) {
+            qasm_fail(st, s, kw, "%s 两个寄存器长度不同", op);
+            return -1;
+        }
+        int n = na > nb ? na : nb;
+        qasm_sync_width(c, st);
+        for (int i = 0; i < n; i++) {
+            int x = a + (na > 1 ? i : 0), y = b + (nb > 1 ? i : 0);
+            if (x == y) {
+                qasm_fail(st, s, kw, "%s 的两个操作数是同一个比特", op);
+                return -1;
+            }
+            write_opcode(c, op[0] == 's' ? OP_SWAP : OP_CNOT);
+            write_u8(c, (unsigned char)x);
+            write_u8(c, (unsigned char)y);
+            st->gates++;
+        }
+    } else if (strcmp(op, "measure") == 0) {
+        if (qasm_operand(st, s, &p, e, 0, &a, &na) != 0) return -1;
+        p = qasm_ws(p, e);
+        if (e - p < 2 || p[0] != '-' || p[1] != '>') {
+            qasm_fail(st, s, p, "measure 格式应为 measure q -> c%s", "");
+            return -1;
+        }
+        p += 2;
+        if (qasm_operand(st, s, &p, e, 1, &b, &nb) != 0) return -1;
+        if (na != nb) {
+            qasm_fail(st, s, kw, "measure 两侧长度不同%s", "");
+            return -1;
+        }
+        qasm_sync_width(c, st);
+        for (int i = 0; i < na; i++) {
+            write_opcode(c, OP_MEASURE);
+            write_u8(c, (unsigned char)(a + i));
+            write_u8(c, (unsigned char)(b + i));
+            st->gates++;
+        }
+    } else {
+        const char *why = strcmp(op, "gate") == 0 || strcmp(op, "opaque") == 0 ? "不支持自定义门 '%s'"
+                          : strcmp(op, "if") == 0                               ? "不支持经典条件 '%s'"
+                                                                                : "不支持的门 '%s'（只支持 h x y z s t id cx swap measure reset barrier）";
+        qasm_fail(st, s, kw, why, op);
+        return -1;
+    }
+    p = qasm_ws(p, e);
+    if (p < e) {
+        qasm_fail(st, s, p, "语句结尾多余的内容 '%.16s'", p);
+        return -1;
+    }
+    return 0;
+}
+
+// 编译 [p, p + n) 里所有完整的语句，返回消费的字节数；eof 时剩下的不完整语句也要处理。
+// 出错时 st->err 非空
+static size_t qasm_feed(QclCtx *c, QasmState *st, const char *buf, size_t n, int eof) {
+    const char *p = buf, *end = buf + n;
+    while (p < end) {
+        const char *q = p;
+        while (q < end && *q != ';') {
+            if (*q == '/' && q + 1 < end && q[1] == '/') {
+                while (q < end && *q != '\n') q++;
+            } else if (*q == '"') {
+                for (q++; q < end && *q != '"'; q++) {}
+                if (q < end) q++;
+            } else if (*q == '{') {
+                qasm_fail(st, p, q, "不支持自定义门定义%s", "");
+                return (size_t)(p - buf);
+            } else {
+                q++;
+            }
+        }
+        if (q == end && !eof) break;
+        if (qasm_statement(c, st, p, q) != 0) return (size_t)(p - buf);
+        if (q < end) q++;
+        for (const char *t = p; t < q; t++) st->line += *t == '\n';
+        p = q;
+    }
+    return (size_t)(p - buf);
+}
+
+// 从 fin 流式导入到 c->sink；0 成功，-1 出错（st->err 为原因）
+static int compile_qasm_stream(QclCtx *c, QasmState *st, FILE *fin) {
+    size_t cap = 1 << 20, have = 0;
+    char *buf = malloc(cap);
+    memset(st, 0, sizeof(*st));
+    c->pos = 0;
+    c->n_ops = 0;
+    c->flushed = 0;
+    int eof = 0;
+    while (buf && !eof) {
+        if (have == cap) {      // 单条语句比整块还长
+            char *grown = realloc(buf, cap * 2);
+            if (!grown) {
+                snprintf(st->err, sizeof(st->err), "内存不足（单条语句超过 %zu 字节）", cap);
+                break;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+        size_t r = fread(buf + have, 1, cap - have, fin);
+        eof = r == 0;
+        have += r;
+        if (c->stats) c->stats->src_bytes += (long)r;
+        size_t used = qasm_feed(c, st, buf, have, eof);
+        if (st->err[0]) break;
+        memmove(buf, buf + used, have - used);
+        have -= used;
+    }
+    if (!buf) snprintf(st->err, sizeof(st->err), "内存不足");
+    free(buf);
+    if (!st->err[0] && st->gates == 0) write_opcode(c, OP_STOP);
+    qcl_flush(c);
+    if (c->stats) {
+        c->stats->format = "qasm";
+        c->stats->bc_bytes = c->flushed;
+        c->stats->init_qubits = st->nqubits;
+    }
+    return st->err[0] ? -1 : 0;
+}
+
+static int compile_qasm_file(const char *input_path, const char *output_path) {
     FILE *fin = fopen(input_path, "r");
     if (!fin) {
         fprintf(stderr, "[QCL] 无法打开输入文件: %s\n", input_path);
         return -1;
     }
+    FILE *fout = fopen(output_path, "wb");
+    if (!fout) {
+        fclose(fin);
+        fprintf(stderr, "[QCL] 无法创建输出文件: %s\n", output_path);
+        return -1;
+    }
+    fprintf(QCL_LOG, "[QCL] 导入 OpenQASM 2: %s\n", input_path);
+    fprintf(QCL_LOG, "[QCL] 输出: %s\n", output_path);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    QclCtx *c = &g_ctx;
+    QasmState st;
+    c->sink = fout;
+    c->sink_failed = 0;
+    int ret = compile_qasm_stream(c, &st, fin);
+    fclose(fin);
+    if (fclose(fout) != 0) c->sink_failed = 1;
+    c->sink = NULL;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    if (ret != 0 || c->sink_failed) {
+        fprintf(stderr, "[QCL] %s: %s\n", input_path, ret != 0 ? st.err : "写出失败");
+        remove(output_path);
+        return -1;
+    }
+    fprintf(QCL_LOG, "[QCL] 导入完成: %ld 字节, %d 条指令（%d 比特, %ld 门, 略过 %ld 条 id）, "
+            "%.1f ms, %.2f M 门/秒\n", c->flushed, c->n_ops, st.nqubits, st.gates, st.skipped, sec * 1e3,
+            sec > 0 ? st.gates / sec * 1e-6 : 0);
+    return 0;
+}
 
-    char line[MAX_LINE_LEN];
-    int line_num = 0;
-    int found_code = 0;
+static int has_suffix(const char *s, const char *suf) {
+    size_t n = strlen(s), m = strlen(suf);
+    return n > m && strcmp(s + n - m, suf) == 0;
+}
 
-    fprintf(stdout, "[QCL] 编译: %s\n", input_path);
-    fprintf(stdout, "[QCL] 输出: %s\n", output_path);
-
-    while (fgets(line, sizeof(line), fin)) {
-        line_num++;
-
-        char *p = line;
-        while (*p == ' ' || *p == '\t' || *p == '\r') p++;
-
-        if (*p == '/' || *p == '\n' || *p == '\0' || *p == '#') continue;
-
-        char code[MAX_LINE_LEN];
-        int ci = 0;
-        for (int i = 0; line[i]; i++) {
-            if (line[i] == '/' && line[i+1] == '/') break;
-            if (ci < MAX_LINE_LEN-1) code[ci++] = line[i];
-        }
-        code[ci] = '\0';
-
-        p = code;
-        while (*p == ' ' || *p == '\t' || *p == '\r') p++;
-        if (*p == '/' || *p == '\n' || *p == '\0' || *p == '#') continue;
-
-        if (strncmp(p, "init ", 5) == 0) {
-            p += 5;
-            unsigned int n = 0;
-            while (*p >= '0' && *p <= '9') { n = n * 10 + (*p - '0'); p++; }
-            while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
-            write_opcode(OP_INIT_N);
-            write_u8(n & 0xFF);
-            write_u8((n >> 8) & 0xFF);
-            found_code = 1;
-        }
-        else if (strncmp(p, "H ", 2) == 0 || strncmp(p, "X ", 2) == 0 ||
-                 strncmp(p, "Y ", 2) == 0 || strncmp(p, "Z ", 2) == 0 ||
-                 strncmp(p, "T ", 2) == 0 || strncmp(p, "S ", 2) == 0) {
-            Opcode op;
-            if (strncmp(p, "H ", 2) == 0) op = OP_H;
-            else if (strncmp(p, "X ", 2) == 0) op = OP_X;
-            else if (strncmp(p, "Y ", 2) == 0) op = OP_Y;
-            else if (strncmp(p, "Z ", 2) == 0) op = OP_Z;
-            else if (strncmp(p, "T ", 2) == 0) op = OP_T;
-            else if (strncmp(p, "S ", 2) == 0) op = OP_S;
-            else op = OP_NOP;
-            p += 2;
-            int qid = 0;
-            while (*p >= '0' && *p <= '9') { qid = qid * 10 + (*p - '0'); p++; }
-            write_opcode(op);
-            write_u8(qid);
-            found_code = 1;
-        }
-        else if (strncmp(p, "CNOT ", 5) == 0) {
-            p += 5;
-            int ctrl = 0, tgt = 0;
-            while (*p >= '0' && *p <= '9') { ctrl = ctrl * 10 + (*p - '0'); p++; }
-            while (*p == ' ' || *p == '\t') p++;
-            while (*p >= '0' && *p <= '9') { tgt = tgt * 10 + (*p - '0'); p++; }
-            write_opcode(OP_CNOT);
-            write_u8(ctrl);
-            write_u8(tgt);
-            found_code = 1;
-        }
-        else if (strncmp(p, "MEASURE ", 8) == 0) {
-            p += 8;
-            int qid = 0, reg = 0;
-            while (*p >= '0' && *p <= '9') { qid = qid * 10 + (*p - '0'); p++; }
-            while (*p == ' ' || *p == '\t') p++;
-            while (*p >= '0' && *p <= '9') { reg = reg * 10 + (*p - '0'); p++; }
-            write_opcode(OP_MEASURE);
-            write_u8(qid);
-            write_u8(reg);
-            found_code = 1;
-        }
-        else if (strncmp(p, "PRINT ", 6) == 0) {
-            p += 6;
-            int reg = 0;
-            while (*p >= '0' && *p <= '9') { reg = reg * 10 + (*p - '0'); p++; }
-            write_opcode(OP_PRINT);
-            write_u8(reg);
-            found_code = 1;
-        }
-        else if (strncmp(p, "STOP", 4) == 0) {
-            write_opcode(OP_STOP);
-            found_code = 1;
-        }
-        else if (strncmp(p, "EXIT", 4) == 0) {
-            write_opcode(OP_EXIT);
-            found_code = 1;
+// ==================== 二进制 IR 输入（.qir，格式见 qcl_ir.h） ====================
+//
+// 定长记录直接发字节码，不做文本扫描；同样按块读、经 sink 流式写出。
+// --to-ir / --from-ir 在 .qentl（或 .qasm）与 .qir 之间互转，供生成器与人工核对。
+
+#define QIR_CHUNK 65536
+
+// 操作数个数；记录里不允许出现的操作码返回 -1
+static int qir_arity(int op) {
+    switch (op) {
+    case OP_CNOT: case OP_SWAP: case OP_MEASURE: return 2;
+    case OP_H: case OP_X: case OP_Y: case OP_Z: case OP_T: case OP_S: case OP_RESET: case OP_PRINT: return 1;
+    case OP_BARRIER: case OP_STOP: case OP_EXIT: return 0;
+    default: return -1;
+    }
+}
+
+// 校验一条记录；nqubits 为 0 时不查比特范围
+static int qir_check(const QclIrGate *g, int nqubits) {
+    int k = qir_arity(g->op);
+    if (k < 0 || g->reserved) return -1;
+    int pair = g->op == OP_CNOT || g->op == OP_SWAP;
+    if (pair && g->a == g->b) return -1;
+    if (nqubits && g->op != OP_PRINT && k >= 1 && g->a >= nqubits) return -1;
+    if (nqubits && pair && g->b >= nqubits) return -1;
+    return 0;
+}
+
+static void qir_emit(QclCtx *c, const QclIrGate *g) {
+    int k = qir_arity(g->op);
+    write_opcode(c, (Opcode)g->op);
+    if (k >= 1) write_u8(c, g->a);
+    if (k == 2) write_u8(c, g->b);
+}
+
+// 从 fin 读 .qir 发到 c；0 成功，-1 出错（err 为原因）。*ngates 为读到的记录数
+static int compile_qir_stream(QclCtx *c, FILE *fin, char *err, size_t cap, unsigned long long *ngates) {
+    QclIrHeader h;
+    c->pos = 0;
+    c->n_ops = 0;
+    c->flushed = 0;
+    *ngates = 0;
+    if (fread(&h, sizeof(h), 1, fin) != 1 || h.magic != QCL_IR_MAGIC) {
+        snprintf(err, cap, "不是 .qir 文件");
+        return -1;
+    }
+    if (h.version != QCL_IR_VERSION) {
+        snprintf(err, cap, ".qir 版本 %u 不支持", h.version);
+        return -1;
+    }
+    if (h.nqubits) {
+        write_opcode(c, OP_INIT_N);
+        write_u16(c, h.nqubits);
+    }
+    QclIrGate *buf = malloc(QIR_CHUNK * sizeof(QclIrGate));
+    unsigned long long want = h.ngates == QCL_IR_STREAM ? ~0ull : h.ngates, done = 0;
+    int rc = buf ? 0 : -1;
+    if (!buf) snprintf(err, cap, "内存不足");
+    while (buf && done < want) {
+        size_t n = fread(buf, sizeof(QclIrGate), want - done < QIR_CHUNK ? (size_t)(want - done) : QIR_CHUNK, fin);
+        if (n == 0) break;
+        for (size_t i = 0; i < n; i++) {
+            if (qir_check(&buf[i], h.nqubits) != 0) {
+                snprintf(err, cap, "第 %llu 条记录非法（操作码 %u, 操作数 %u %u）", done + i + 1, buf[i].op,
+                         buf[i].a, buf[i].b);
+                rc = -1;
+                goto out;
+            }
+            qir_emit(c, &buf[i]);
         }
+        done += n;
+    }
+    if (buf && want != ~0ull && done < want) {
+        snprintf(err, cap, "文件被截断：文件头声明 %llu 条记录，只读到 %llu 条", want, done);
+        rc = -1;
+    }
+    if (rc == 0 && done == 0 && !h.nqubits) write_opcode(c, OP_STOP);
+out:
+    free(buf);
+    qcl_flush(c);
+    *ngates = done;
+    if (c->stats) {
+        c->stats->format = "qir";
+        c->stats->bc_bytes = c->flushed;
+        c->stats->src_bytes = (long)(sizeof(h) + done * sizeof(QclIrGate));
+        if (h.nqubits) c->stats->init_qubits = h.nqubits;
     }
+    return rc;
+}
 
+static int compile_qir_file(const char *input_path, const char *output_path) {
+    FILE *fin = fopen(input_path, "rb");
+    if (!fin) {
+        fprintf(stderr, "[QCL] 无法打开输入文件: %s\n", input_path);
+        return -1;
+    }
+    FILE *fout = fopen(output_path, "wb");
+    if (!fout) {
+        fclose(fin);
+        fprintf(stderr, "[QCL] 无法创建输出文件: %s\n", output_path);
+        return -1;
+    }
+    fprintf(QCL_LOG, "[QCL] 读入二进制 IR: %s\n", input_path);
+    fprintf(QCL_LOG, "[QCL] 输出: %s\n", output_path);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    QclCtx *c = &g_ctx;
+    char err[160];
+    unsigned long long ngates;
+    c->sink = fout;
+    c->sink_failed = 0;
+    int ret = compile_qir_stream(c, fin, err, sizeof(err), &ngates);
     fclose(fin);
+    if (fclose(fout) != 0) c->sink_failed = 1;
+    c->sink = NULL;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    if (ret != 0 || c->sink_failed) {
+        fprintf(stderr, "[QCL] %s: %s\n", input_path, ret != 0 ? err : "写出失败");
+        remove(output_path);
+        return -1;
+    }
+    fprintf(QCL_LOG, "[QCL] 编译完成: %ld 字节, %d 条指令（%llu 条记录）, %.1f ms\n", c->flushed, c->n_ops, ngates,
+            sec * 1e3);
+    return 0;
+}
 
-    if (!found_code) {
-        fprintf(stdout, "[QCL] 警告: 未找到可编译的量子代码\n");
-        write_opcode(OP_STOP);
+// --to-ir：先照常编译成字节码（写进内存流，不受 MAX_OPS 限制），再逐条转成定长记录
+static int to_ir_main(const char *input_path, const char *output_path) {
+    FILE *fin = fopen(input_path, "r");
+    if (!fin) {
+        fprintf(stderr, "[QCL] 无法打开输入文件: %s\n", input_path);
+        return 1;
+    }
+    char *bc = NULL;
+    size_t n = 0;
+    QclCtx *c = &g_ctx;
+    c->sink = open_memstream(&bc, &n);
+    c->sink_failed = 0;
+    int ok = 1;
+    if (has_suffix(input_path, ".qasm")) {
+        QasmState st;
+        if (compile_qasm_stream(c, &st, fin) != 0) {
+            fprintf(stderr, "[QCL] %s: %s\n", input_path, st.err);
+            ok = 0;
+        }
+    } else {
+        size_t len = 0, cap = 65536;
+        char *src = malloc(cap);
+        for (size_t r; src && (r = fread(src + len, 1, cap - len, fin)) > 0;) {
+            len += r;
+            if (len == cap) src = realloc(src, cap *= 2);
+        }
+        c->flushed = 0;
+        if (src) compile_buffer_ctx(c, src, len);
+        else ok = 0;
+        free(src);
+        qcl_flush(c);
+    }
+    fclose(fin);
+    fclose(c->sink);
+    c->sink = NULL;
+    if (!ok) {
+        free(bc);
+        return 1;
+    }
+
+    // INIT_N 进文件头（取最后一条，与 qvm_decode 一致），其余一条指令一条记录
+    QclIrHeader h = { QCL_IR_MAGIC, QCL_IR_VERSION, 0, 0, 0 };
+    QclIrGate *gates = malloc((n + 1) * sizeof(QclIrGate));
+    for (size_t i = 0; gates && i < n;) {
+        int op = bc[i++];
+        if (op == OP_INIT_N && i + 2 <= n) {
+            h.nqubits = (uint16_t)(bc[i] | bc[i + 1] << 8);
+            i += 2;
+            continue;
+        }
+        int k = qir_arity(op);
+        if (k < 0 || i + (size_t)k > n) {
+            fprintf(stderr, "[QCL] 字节码偏移 %zu 处无法转成 IR（操作码 %d）\n", i - 1, op);
+            ok = 0;
+            break;
+        }
+        QclIrGate g = { (uint8_t)op, k >= 1 ? (uint8_t)bc[i] : 0, k == 2 ? (uint8_t)bc[i + 1] : 0, 0 };
+        gates[h.ngates++] = g;
+        i += (size_t)k;
+    }
+    free(bc);
+    FILE *fout = ok ? fopen(output_path, "wb") : NULL;
+    if (ok && (!fout || fwrite(&h, sizeof(h), 1, fout) != 1 ||
+               (h.ngates && fwrite(gates, sizeof(QclIrGate), h.ngates, fout) != h.ngates) || fclose(fout) != 0)) {
+        fprintf(stderr, "[QCL] 无法写出 %s\n", output_path);
+        ok = 0;
+    }
+    free(gates);
+    if (ok) fprintf(stdout, "[QCL] %s → %s: %u 比特, %u 条记录\n", input_path, output_path, h.nqubits, h.ngates);
+    return ok ? 0 : 1;
+}
+
+static const char *qir_op_name(int op) {
+    switch (op) {
+    case OP_H: return "H";
+    case OP_X: return "X";
+    case OP_Y: return "Y";
+    case OP_Z: return "Z";
+    case OP_T: return "T";
+    case OP_S: return "S";
+    case OP_CNOT: return "CNOT";
+    case OP_SWAP: return "SWAP";
+    case OP_RESET: return "RESET";
+    case OP_BARRIER: return "BARRIER";
+    case OP_MEASURE: return "MEASURE";
+    case OP_PRINT: return "PRINT";
+    case OP_STOP: return "STOP";
+    case OP_EXIT: return "EXIT";
+    default: return NULL;
+    }
+}
+
+// --from-ir：记录转回 .qentl 文本
+static int from_ir_main(const char *input_path, const char *output_path) {
+    FILE *fin = fopen(input_path, "rb");
+    if (!fin) {
+        fprintf(stderr, "[QCL] 无法打开输入文件: %s\n", input_path);
+        return 1;
+    }
+    QclIrHeader h;
+    if (fread(&h, sizeof(h), 1, fin) != 1 || h.magic != QCL_IR_MAGIC || h.version != QCL_IR_VERSION) {
+        fprintf(stderr, "[QCL] %s: 不是 .qir 文件\n", input_path);
+        fclose(fin);
+        return 1;
+    }
+    FILE *fout = fopen(output_path, "w");
+    if (!fout) {
+        fprintf(stderr, "[QCL] 无法创建输出文件: %s\n", output_path);
+        fclose(fin);
+        return 1;
+    }
+    if (h.nqubits) fprintf(fout, "init %u\n", h.nqubits);
+    unsigned long long want = h.ngates == QCL_IR_STREAM ? ~0ull : h.ngates, done = 0;
+    QclIrGate g;
+    int ok = 1;
+    while (done < want && fread(&g, sizeof(g), 1, fin) == 1) {
+        done++;
+        if (qir_check(&g, h.nqubits) != 0) {
+            fprintf(stderr, "[QCL] %s: 第 %llu 条记录非法（操作码 %u）\n", input_path, done, g.op);
+            ok = 0;
+            break;
+        }
+        switch (qir_arity(g.op)) {
+        case 0: fprintf(fout, "%s\n", qir_op_name(g.op)); break;
+        case 1: fprintf(fout, "%s %u\n", qir_op_name(g.op), g.a); break;
+        default: fprintf(fout, "%s %u %u\n", qir_op_name(g.op), g.a, g.b); break;
+        }
+    }
+    fclose(fin);
+    if (fclose(fout) != 0) ok = 0;
+    if (ok && want != ~0ull && done < want) {
+        fprintf(stderr, "[QCL] %s: 文件被截断（声明 %llu 条记录，只有 %llu 条）\n", input_path, want, done);
+        ok = 0;
+    }
+    if (!ok) {
+        remove(output_path);
+        return 1;
+    }
+    fprintf(stdout, "[QCL] %s → %s: %u 比特, %llu 条记录\n", input_path, output_path, h.nqubits, done);
+    return 0;
+}
+
+static int remote_compile(const char *src, size_t n, QclCtx *c, int *found_code, unsigned char **bc, size_t *len);
+static int g_stats_json;        // --stats=json：要逐操作码计数，不转给编译服务
+
+// ==================== 并行分块编译 ====================
+//
+// .qentl 是逐行独立的（每行最多产出一条指令，行与行之间没有状态），几百 MB 的生成线路
+// 单线程扫描是瓶颈。输入按换行切成若干块，工作线程各拿一块编进私有的 QclCtx（sink 是内存流），
+// 主线程按块的顺序把结果写进输出文件 —— 行序不变，init 落在哪里就还在哪里，产物与单线程逐字节相同。
+// 块数多于线程数，先编完的线程接着拿后面的块；领先已写出的块超过 PAR_WINDOW 个线程宽度时
+// 停下来等，内存里挂着的结果有上限。
+// 线程数取 QCL_THREADS，未设置时取在线 CPU 数；源码小于 PAR_MIN 时不值得起线程，照旧单线程。
+
+#define PAR_MIN (4 << 20)
+#define PAR_CHUNK_MIN (1 << 20)
+#define PAR_CHUNK_MAX (64 << 20)
+#define PAR_WINDOW 2
+
+typedef struct {
+    const char *src;
+    size_t n;
+    char *out;                  // 本块字节码（open_memstream）
+    size_t len;
+    int n_ops, found, failed, done;
+    QclStats *stats;            // 本块统计，行号从块首计；g_ctx 挂了统计时才有
+} ParChunk;
+
+typedef struct {
+    ParChunk *ck;
+    int nchunks, next, written, window;
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+} ParJob;
+
+static void *par_worker(void *arg) {
+    ParJob *pj = arg;
+    unsigned char *bc = malloc(MAX_OPS);
+    for (;;) {
+        pthread_mutex_lock(&pj->mu);
+        while (pj->next < pj->nchunks && pj->next >= pj->written + pj->window) pthread_cond_wait(&pj->cv, &pj->mu);
+        int j = pj->next < pj->nchunks ? pj->next++ : -1;
+        pthread_mutex_unlock(&pj->mu);
+        if (j < 0) break;
+
+        ParChunk *k = &pj->ck[j];
+        QclCtx c = { .bc = bc, .stats = k->stats };
+        c.sink = bc ? open_memstream(&k->out, &k->len) : NULL;
+        if (c.sink) {
+            k->found = compile_lines(&c, k->src, k->n);
+            qcl_flush(&c);
+            k->failed = c.sink_failed | (fclose(c.sink) != 0);
+            k->n_ops = c.n_ops;
+        } else {
+            k->failed = 1;
+        }
+
+        pthread_mutex_lock(&pj->mu);
+        k->done = 1;
+        pthread_cond_broadcast(&pj->cv);
+        pthread_mutex_unlock(&pj->mu);
+    }
+    free(bc);
+    return NULL;
+}
+
+static int compile_threads(size_t n) {
+    if (n < PAR_MIN) return 1;
+    const char *env = getenv("QCL_THREADS");
+    long t = env && *env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    return t < 1 ? 1 : t > 64 ? 64 : (int)t;
+}
+
+// 各块统计按顺序并进 g_ctx 的统计，行号加上前面各块的行数
+static void stats_merge(QclStats *dst, const QclStats *src) {
+    for (long i = 0; i < src->skipped && i < STATS_MAX_SKIPPED; i++) {
+        if (dst->skipped + i < STATS_MAX_SKIPPED) dst->skipped_at[dst->skipped + i] = dst->lines + src->skipped_at[i];
+    }
+    dst->skipped += src->skipped;
+    dst->lines += src->lines;
+    for (int op = 0; op < 64; op++) dst->ops[op] += src->ops[op];
+    if (src->init_qubits >= 0) dst->init_qubits = src->init_qubits;
+    if (src->max_qubit > dst->max_qubit) dst->max_qubit = src->max_qubit;
+}
+
+// 把 src 分块并行编译写到 fout；返回 -1 失败，否则返回是否找到可编译的代码。
+// *bytes 为写出的字节数，g_ctx.n_ops 为各块指令数之和（publish_metrics 用）
+static int compile_parallel(const char *src, size_t n, int threads, FILE *fout, long *bytes) {
+    size_t chunk = n / ((size_t)threads * 4);
+    if (chunk < PAR_CHUNK_MIN) chunk = PAR_CHUNK_MIN;
+    if (chunk > PAR_CHUNK_MAX) chunk = PAR_CHUNK_MAX;
+
+    ParJob pj = { .window = threads * PAR_WINDOW };
+    size_t maxchunks = n / chunk + 2;
+    pj.ck = calloc(maxchunks, sizeof(ParChunk));
+    QclStats *cst = g_ctx.stats ? malloc(maxchunks * sizeof(QclStats)) : NULL;
+    if (!pj.ck || (g_ctx.stats && !cst)) {
+        free(pj.ck);
+        free(cst);
+        return -1;
+    }
+    for (size_t i = 0; i < n;) {
+        size_t end = i + chunk < n ? i + chunk : n;
+        const char *nl = end < n ? memchr(src + end, '\n', n - end) : NULL;
+        end = nl ? (size_t)(nl - src) + 1 : n;
+        if (cst) stats_reset(&cst[pj.nchunks]);
+        pj.ck[pj.nchunks] = (ParChunk){ .src = src + i, .n = end - i, .stats = cst ? &cst[pj.nchunks] : NULL };
+        pj.nchunks++;
+        i = end;
+    }
+    if (threads > pj.nchunks) threads = pj.nchunks;
+    pthread_mutex_init(&pj.mu, NULL);
+    pthread_cond_init(&pj.cv, NULL);
+
+    pthread_t tid[64];
+    int started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&tid[started], NULL, par_worker, &pj) != 0) break;
+    }
+    if (started == 0) par_worker(&pj);
+
+    int found = 0, failed = 0;
+    long total = 0;
+    g_ctx.n_ops = 0;
+    for (int j = 0; j < pj.nchunks; j++) {
+        ParChunk *k = &pj.ck[j];
+        pthread_mutex_lock(&pj.mu);
+        while (!k->done) pthread_cond_wait(&pj.cv, &pj.mu);
+        pthread_mutex_unlock(&pj.mu);
+
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        failed |= k->failed || (k->len && fwrite(k->out, 1, k->len, fout) != k->len);
+        if (g_ctx.stats) {
+            g_ctx.stats->emit_sec += since(&t0);
+            stats_merge(g_ctx.stats, k->stats);
+        }
+        found |= k->found;
+        total += (long)k->len;
+        g_ctx.n_ops += k->n_ops;
+        free(k->out);
+
+        pthread_mutex_lock(&pj.mu);
+        pj.written = j + 1;
+        pthread_cond_broadcast(&pj.cv);
+        pthread_mutex_unlock(&pj.mu);
+    }
+    for (int t = 0; t < started; t++) pthread_join(tid[t], NULL);
+    pthread_mutex_destroy(&pj.mu);
+    pthread_cond_destroy(&pj.cv);
+    free(pj.ck);
+    free(cst);
+
+    if (g_ctx.stats) g_ctx.stats->threads = started ? started : 1;
+    fprintf(QCL_LOG, "[QCL] 并行编译: %d 线程, %d 块\n", started ? started : 1, pj.nchunks);
+    *bytes = total;
+    return failed ? -1 : found;
+}
+
+// 读入整个源文件；普通文件直接映射（大文件不再拷一遍），*mapped 置 1，否则读进堆里
+static char *load_source(FILE *fin, size_t *len, int *mapped) {
+    *mapped = 0;
+    struct stat st;
+    if (fstat(fileno(fin), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(fin), 0);
+        if (p != MAP_FAILED) {
+            madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+            *len = (size_t)st.st_size;
+            *mapped = 1;
+            return p;
+        }
+    }
+    size_t n = 0, cap = 65536;
+    char *src = malloc(cap);
+    for (size_t r; src && (r = fread(src + n, 1, cap - n, fin)) > 0;) {
+        n += r;
+        if (n == cap) src = realloc(src, cap *= 2);
+    }
+    *len = n;
+    return src;
+}
+
+static void unload_source(char *src, size_t len, int mapped) {
+    if (mapped) {
+        munmap(src, len);
+        return;
+    }
+    free(src);
+}
+
+// 不认识的行原来悄悄丢掉，现在报出条数和前几个行号
+static void report_skipped(FILE *f, const QclStats *st) {
+    if (!st || st->skipped == 0 || !st->lines) return;
+    fprintf(f, "[QCL] 警告: %ld 行无法识别，已跳过（第", st->skipped);
+    for (long i = 0; i < st->skipped && i < 8; i++) fprintf(f, "%s%ld", i ? ", " : " ", st->skipped_at[i]);
+    fprintf(f, "%s 行）\n", st->skipped > 8 ? " …" : "");
+}
+
+int compile_file_v2(const char *input_path, const char *output_path) {
+    if (has_suffix(input_path, ".qasm")) return compile_qasm_file(input_path, output_path);
+    if (has_suffix(input_path, ".qir")) return compile_qir_file(input_path, output_path);
+    FILE *fin = fopen(input_path, "r");
+    if (!fin) {
+        fprintf(stderr, "[QCL] 无法打开输入文件: %s\n", input_path);
+        return -1;
     }
 
+    fprintf(QCL_LOG, "[QCL] 编译: %s\n", input_path);
+    fprintf(QCL_LOG, "[QCL] 输出: %s\n", output_path);
+
+    size_t n = 0;
+    int mapped;
+    char *src = load_source(fin, &n, &mapped);
+    fclose(fin);
+    if (!src) {
+        fprintf(stderr, "[QCL] 内存不足: %s\n", input_path);
+        return -1;
+    }
+
+    QclCtx *c = &g_ctx;
+    int found_code = 0, remote = 0;
+    unsigned char *remote_bc = NULL;
+    size_t remote_len = 0;
+    if (c->stats) {
+        c->stats->format = "qentl";
+        c->stats->src_bytes = (long)n;
+    }
+    remote = !g_stats_json && remote_compile(src, n, c, &found_code, &remote_bc, &remote_len) == 0;
+
     FILE *fout = fopen(output_path, "wb");
     if (!fout) {
         fprintf(stderr, "[QCL] 无法创建输出文件: %s\n", output_path);
+        unload_source(src, n, mapped);
+        free(remote_bc);
         return -1;
     }
 
-    fwrite(g_bytecode, 1, g_bc_pos, fout);
-    fclose(fout);
+    // 本地编译时字节码边编边写进 fout，不再受 MAX_OPS 限制
+    long total;
+    if (remote) {
+        if (fwrite(remote_bc, 1, remote_len, fout) != remote_len) found_code = -1;
+        total = (long)remote_len;
+        free(remote_bc);
+        c->stats = NULL;                // 服务端编的，本地没有逐行统计
+    } else {
+        int threads = 1;
+        threads = compile_threads(n);
+        if (threads > 1) found_code = compile_parallel(src, n, threads, fout, &total);
+        if (threads <= 1) {
+            c->sink = fout;
+            c->flushed = 0;
+            c->sink_failed = 0;
+            c->pos = 0;
+            c->n_ops = 0;
+            found_code = compile_lines(c, src, n);
+            if (!found_code) write_opcode(c, OP_STOP);
+            qcl_flush(c);
+            c->sink = NULL;
+            total = c->flushed;
+            if (c->sink_failed) found_code = -1;
+        } else if (found_code == 0) {
+            c->n_ops++;
+            if (c->stats) c->stats->ops[OP_STOP]++;
+            fputc(OP_STOP, fout);
+            total++;
+        }
+    }
+    unload_source(src, n, mapped);
+
+    if (fclose(fout) != 0 || found_code < 0) {
+        fprintf(stderr, "[QCL] 写输出文件失败: %s\n", output_path);
+        remove(output_path);
+        return -1;
+    }
+    if (!found_code) {
+        fprintf(QCL_LOG, "[QCL] 警告: 未找到可编译的量子代码\n");
+    }
+    report_skipped(QCL_LOG, c->stats);
+    if (c->stats) c->stats->bc_bytes = total;
 
-    fprintf(stdout, "[QCL] 编译完成: %d 字节, %d 条指令\n", g_bc_pos, g_bc_pos);
+    fprintf(QCL_LOG, "[QCL] 编译完成: %ld 字节, %d 条指令\n", total, c->n_ops);
 
     return 0;
 }
 
 // ==================== 主函数 ====================
 
+static int g_remote_used = 0;   // 本次由编译服务完成，指标已由服务端记过
+
+// 往 qsm_metrics 共享内存页的 qentl_compiler 槽位记一笔，供 web/apps/monitor 查看。
+// 单次编译要显式设 QSM_METRICS（on 或路径）才记，免得每次编译都去建、映射指标文件；
+// --serve / --watch 常驻进程不经这里，照常发布
+static void publish_metrics(struct timespec *t0, int ret) {
+    if (g_remote_used || !qsm_metrics_requested()) return;
+    double sec = since(t0);
+    QsmMetrics d = { 0 };
+    d.jobs = 1;
+    d.gates = (uint64_t)g_ctx.n_ops;
+    d.errors = ret != 0;
+    d.compile_ns = (uint64_t)(sec * 1e9);
+    qsm_metrics_observe(&d, sec);
+    qsm_metrics_publish(qsm_metrics_attach(qsm_metrics_open(1), "qentl_compiler"), &d);
+}
+
+// ==================== 常驻编译服务（--serve） ====================
+//
+// 运行模式下每次 qcl_bootstrap 调用都要付一次进程启动；web 与终端应用的编译又多又小。
+// --serve 在 Unix 套接字上常驻，每个连接一个线程、一份 QclCtx，可在同一连接上连续发请求：
+//   请求  u32 magic "QCL1", u32 源码长度, 源码
+//   响应  u32 magic, u32 状态（0 成功 / 1 源码过大 / 2 服务端内存不足）,
+//         u32 标志（bit0 找到可编译代码）, u32 指令条数, u32 字节码长度, 字节码   （整数均为小端）
+// 字节码经 open_memstream 边编边写，长度不受 MAX_OPS 限制。按源码内容缓存编译结果
+// （LRU，CACHE_CAP 条，只缓存不超过 MAX_OPS 的字节码）。
+// 转发须显式打开：命令行编译时设了 QCL_SERVER=套接字 才把源码转给服务，连不上照常本地编译。
+// 服务默认监听 $XDG_RUNTIME_DIR/qcl_bootstrap.sock（没有时用 /tmp/qcl_bootstrap-<uid>.sock），
+// 套接字文件权限 0600；同一路径上已有的不是套接字的文件不会被覆盖。
+// 同时服务的连接至多 MAX_CONNS 个，满了 accept 先等；连接空闲 CONN_IDLE_SEC 秒断开。
+
+#define QCL_WIRE_MAGIC 0x314C4351u      // "QCL1"
+#define QCL_MAX_SRC (16 << 20)
+#define QCL_MAX_REPLY (4u * QCL_MAX_SRC + 16)   // 每个源码字节至多产生几个字节码字节，留足余量
+#define CACHE_CAP 256
+#define MAX_CONNS 64
+#define CONN_IDLE_SEC 30
+
+static const char *default_socket(void) {
+    static char path[108];
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    if (dir && *dir) snprintf(path, sizeof(path), "%s/qcl_bootstrap.sock", dir);
+    else snprintf(path, sizeof(path), "/tmp/qcl_bootstrap-%u.sock", (unsigned)geteuid());
+    return path;
+}
+
+typedef struct {
+    uint64_t key;
+    char *src;
+    size_t n;
+    unsigned char *bc;
+    size_t len;
+    int n_ops, found;
+    uint64_t last_used;
+} CacheEntry;
+
+static CacheEntry g_cache[CACHE_CAP];
+static int g_ncache;
+static uint64_t g_tick;
+static pthread_mutex_t g_cache_mu = PTHREAD_MUTEX_INITIALIZER;
+static QsmMetricsSlot *g_metrics;
+static const char *g_sock_path;
+static int g_nconns;
+static pthread_mutex_t g_conn_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_conn_cv = PTHREAD_COND_INITIALIZER;
+
+static uint64_t fnv1a(const char *p, size_t n) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < n; i++) h = (h ^ (unsigned char)p[i]) * 0x100000001b3ull;
+    return h;
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static int read_full(int fd, void *buf, size_t n) {
+    for (char *p = buf; n;) {
+        ssize_t r = read(fd, p, n);
+        if (r <= 0) {
+            if (r < 0 && errno == EINTR) continue;
+            return -1;
+        }
+        p += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t n) {
+    for (const char *p = buf; n;) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0) {
+            if (w < 0 && errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+// 命中时把字节码拷进 *bc（调用方 free），返回 found 标志；未命中或内存不足返回 -1
+static int cache_lookup(uint64_t key, const char *src, size_t n, unsigned char **bc, size_t *len, int *n_ops) {
+    int found = -1;
+    pthread_mutex_lock(&g_cache_mu);
+    for (int i = 0; i < g_ncache; i++) {
+        CacheEntry *e = &g_cache[i];
+        if (e->key != key || e->n != n || memcmp(e->src, src, n) != 0) continue;
+        if (!(*bc = malloc(e->len ? e->len : 1))) break;
+        memcpy(*bc, e->bc, e->len);
+        *len = e->len;
+        *n_ops = e->n_ops;
+        found = e->found;
+        e->last_used = ++g_tick;
+        break;
+    }
+    pthread_mutex_unlock(&g_cache_mu);
+    return found;
+}
+
+static void cache_insert(uint64_t key, const char *src, size_t n, const unsigned char *out, size_t len, int n_ops,
+                         int found) {
+    if (len > MAX_OPS) return;
+    char *s = malloc(n ? n : 1);
+    unsigned char *bc = malloc(len ? len : 1);
+    if (!s || !bc) {
+        free(s);
+        free(bc);
+        return;
+    }
+    memcpy(s, src, n);
+    memcpy(bc, out, len);
+    pthread_mutex_lock(&g_cache_mu);
+    CacheEntry *e = &g_cache[g_ncache < CACHE_CAP ? g_ncache++ : 0];
+    if (g_ncache == CACHE_CAP) {
+        for (int i = 1; i < CACHE_CAP; i++)
+            if (g_cache[i].last_used < e->last_used) e = &g_cache[i];
+        free(e->src);
+        free(e->bc);
+    }
+    *e = (CacheEntry){ key, s, n, bc, len, n_ops, found, ++g_tick };
+    pthread_mutex_unlock(&g_cache_mu);
+}
+
+static void *serve_conn(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    QclCtx c = { .bc = malloc(MAX_OPS) };
+    char *src = NULL;
+    size_t cap = 0;
+    unsigned char hdr[20];
+    while (c.bc && read_full(fd, hdr, 8) == 0 && get_u32(hdr) == QCL_WIRE_MAGIC) {
+        uint32_t n = get_u32(hdr + 4);
+        put_u32(hdr, QCL_WIRE_MAGIC);
+        if (n > QCL_MAX_SRC) {
+            memset(hdr + 4, 0, 16);
+            put_u32(hdr + 4, 1);
+            write_full(fd, hdr, 20);
+            break;
+        }
+        if (n > cap) {
+            char *p = realloc(src, n);
+            if (!p) break;
+            src = p;
+            cap = n;
+        }
+        if (read_full(fd, src, n) != 0) break;
+
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        uint64_t key = fnv1a(src, n);
+        unsigned char *out = NULL;
+        size_t len = 0;
+        int n_ops = 0;
+        int found = cache_lookup(key, src, n, &out, &len, &n_ops), hit = found >= 0;
+        if (!hit) {
+            // 字节码写进内存流，超过 MAX_OPS 的部分由 write_byte 倒出去，不截断
+            c.sink = open_memstream((char **)&out, &len);
+            c.flushed = 0;
+            c.sink_failed = !c.sink;
+            if (c.sink) {
+                found = compile_buffer_ctx(&c, src, n);
+                qcl_flush(&c);
+                if (fclose(c.sink) != 0) c.sink_failed = 1;
+                c.sink = NULL;
+                n_ops = c.n_ops;
+            }
+            if (!c.sink_failed && len <= QCL_MAX_REPLY) cache_insert(key, src, n, out, len, n_ops, found);
+        }
+        if (!hit && (c.sink_failed || len > QCL_MAX_REPLY)) {
+            free(out);
+            memset(hdr + 4, 0, 16);
+            put_u32(hdr + 4, 2);
+            if (write_full(fd, hdr, 20) != 0) break;
+            continue;
+        }
+        put_u32(hdr + 4, 0);
+        put_u32(hdr + 8, found ? 1 : 0);
+        put_u32(hdr + 12, (uint32_t)n_ops);
+        put_u32(hdr + 16, (uint32_t)len);
+        int sent = write_full(fd, hdr, 20) == 0 && write_full(fd, out, len) == 0;
+        free(out);
+        if (!sent) break;
+
+        double sec = since(&t0);
+        QsmMetrics d = { 0 };
+        d.jobs = 1;
+        d.gates = (uint64_t)n_ops;
+        d.cache_hits = hit;
+        d.cache_misses = !hit;
+        d.compile_ns = (uint64_t)(sec * 1e9);
+        qsm_metrics_observe(&d, sec);
+        qsm_metrics_publish(g_metrics, &d);
+    }
+    close(fd);
+    free(src);
+    free(c.bc);
+    pthread_mutex_lock(&g_conn_mu);
+    g_nconns--;
+    pthread_cond_signal(&g_conn_cv);
+    pthread_mutex_unlock(&g_conn_mu);
+    return NULL;
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    unlink(g_sock_path);
+    _exit(0);
+}
+
+static int connect_unix(const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int serve_main(const char *path) {
+    int probe = connect_unix(path);
+    if (probe >= 0) {
+        close(probe);
+        fprintf(stderr, "[QCL] 编译服务已在运行: %s\n", path);
+        return 1;
+    }
+    // 连不上的套接字文件是上一个服务异常退出留下的，可以删；别的文件不碰
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "[QCL] %s 已存在且不是套接字，拒绝覆盖\n", path);
+            return 1;
+        }
+        unlink(path);
+    }
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (strlen(path) >= sizeof(addr.sun_path) || lfd < 0) {
+        fprintf(stderr, "[QCL] 套接字路径无效: %s\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    mode_t old = umask(077);    // 套接字只给本用户连
+    int bound = bind(lfd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old);
+    if (bound != 0 || listen(lfd, 64) != 0) {
+        fprintf(stderr, "[QCL] 无法监听 %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    g_sock_path = path;
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    g_metrics = qsm_metrics_attach(qsm_metrics_open(1), "qentl_compiler");
+    fprintf(stdout, "[QCL] 编译服务监听 %s\n", path);
+    fflush(stdout);
+    struct timeval idle = { .tv_sec = CONN_IDLE_SEC };
+    for (;;) {
+        // 连接数到上限时先不 accept，新连接留在内核的 listen 队列里
+        pthread_mutex_lock(&g_conn_mu);
+        while (g_nconns >= MAX_CONNS) pthread_cond_wait(&g_conn_cv, &g_conn_mu);
+        pthread_mutex_unlock(&g_conn_mu);
+        int fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+        pthread_mutex_lock(&g_conn_mu);
+        g_nconns++;
+        pthread_mutex_unlock(&g_conn_mu);
+        pthread_t th;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&th, &attr, serve_conn, (void *)(intptr_t)fd) != 0) {
+            close(fd);
+            pthread_mutex_lock(&g_conn_mu);
+            g_nconns--;
+            pthread_mutex_unlock(&g_conn_mu);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    unlink(path);
+    return 1;
+}
+
+// 客户端：设了 QCL_SERVER 时把源码转给编译服务，字节码放进 *bc（调用方 free）；
+// 没设、服务不可用或回应异常时返回 -1，由调用方本地编译
+static int remote_compile(const char *src, size_t n, QclCtx *c, int *found_code, unsigned char **bc, size_t *len) {
+    const char *path = getenv("QCL_SERVER");
+    if (!path || !*path || strcmp(path, "off") == 0) return -1;
+    if (n > QCL_MAX_SRC) return -1;
+    int fd = connect_unix(path);
+    if (fd < 0) {
+        fprintf(stderr, "[QCL] 编译服务 %s 不可用，改为本地编译\n", path);
+        return -1;
+    }
+    unsigned char hdr[20];
+    put_u32(hdr, QCL_WIRE_MAGIC);
+    put_u32(hdr + 4, (uint32_t)n);
+    int ok = write_full(fd, hdr, 8) == 0 && write_full(fd, src, n) == 0 && read_full(fd, hdr, 20) == 0 &&
+             get_u32(hdr) == QCL_WIRE_MAGIC && get_u32(hdr + 4) == 0 && get_u32(hdr + 16) <= QCL_MAX_REPLY;
+    unsigned char *out = NULL;
+    if (ok) {
+        out = malloc(get_u32(hdr + 16) ? get_u32(hdr + 16) : 1);
+        ok = out && read_full(fd, out, get_u32(hdr + 16)) == 0;
+    }
+    close(fd);
+    if (!ok) {
+        free(out);
+        return -1;
+    }
+    *found_code = get_u32(hdr + 8) & 1;
+    c->n_ops = (int)get_u32(hdr + 12);
+    *bc = out;
+    *len = get_u32(hdr + 16);
+    g_remote_used = 1;
+    return 0;
+}
+
+// ==================== 监视模式（--watch） ====================
+//
+// --watch <目录> [-o 输出目录] [-j 线程数] [-d 去抖毫秒]：用 inotify 监视目录树里的 .qentl，
+// 一个文件在 -d 毫秒内不再有写入才算保存完成（编辑器保存常是一串事件），交给线程池编译。
+// 每个工作线程有自己的 QclCtx；按文件内容哈希跳过没变的文件（touch、原样保存）。
+// 字节码先写临时文件再改名，读方看不到半个 .qbc。每个文件打印从保存（源文件 mtime）
+// 到 .qbc 落盘的延迟。启动时先把 .qbc 缺失或比源文件旧的编一遍，其余的只记内容哈希。
+
+typedef struct {
+    char *path;
+    uint64_t hash;
+    int known, busy, dirty;     // busy：某个线程正在编译；期间又有改动记 dirty，编完再来一遍
+} WatchFile;
+
+typedef struct WatchJob {
+    char *path;
+    struct WatchJob *next;
+} WatchJob;
+
+typedef struct {
+    char *path;
+    uint64_t last_ns;
+} Pending;
+
+static struct {
+    const char *root, *outdir;
+    size_t root_len;
+    int ifd;
+    struct { int wd; char *path; } *dirs;
+    int ndirs;
+    Pending *pending;
+    int npending, cap_pending;
+
+    pthread_mutex_t mu;         // 保护下面三项
+    pthread_cond_t cv;
+    WatchJob *head, *tail;
+    WatchFile **files;          // 元素单独分配，指针在表扩容后仍有效
+    int nfiles;
+
+    QsmMetricsSlot *metrics;
+} g_watch = { .mu = PTHREAD_MUTEX_INITIALIZER, .cv = PTHREAD_COND_INITIALIZER };
+
+static uint64_t realtime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// 源文件对应的 .qbc：有 -o 时放到输出目录下的同名相对路径
+static void watch_out_path(const char *src, char *out, size_t cap) {
+    if (g_watch.outdir) snprintf(out, cap, "%s%s", g_watch.outdir, src + g_watch.root_len);
+    else snprintf(out, cap, "%s", src);
+    size_t n = strlen(out);
+    if (n >= 6 && n + 1 < cap) strcpy(out + n - 6, ".qbc");
+}
+
+static void mkdir_parents(char *path) {
+    for (char *p = path + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(path, 0755);
+        *p = '/';
+    }
+}
+
+// 调用方持有 g_watch.mu
+static WatchFile *watch_file(const char *path) {
+    for (int i = 0; i < g_watch.nfiles; i++)
+        if (strcmp(g_watch.files[i]->path, path) == 0) return g_watch.files[i];
+    if (g_watch.nfiles % 64 == 0)
+        g_watch.files = realloc(g_watch.files, (size_t)(g_watch.nfiles + 64) * sizeof(WatchFile *));
+    WatchFile *f = malloc(sizeof(WatchFile));
+    *f = (WatchFile){ strdup(path), 0, 0, 0, 0 };
+    g_watch.files[g_watch.nfiles++] = f;
+    return f;
+}
+
+static void watch_enqueue(const char *path) {
+    WatchJob *j = malloc(sizeof(WatchJob));
+    j->path = strdup(path);
+    j->next = NULL;
+    pthread_mutex_lock(&g_watch.mu);
+    if (g_watch.tail) g_watch.tail->next = j;
+    else g_watch.head = j;
+    g_watch.tail = j;
+    pthread_cond_signal(&g_watch.cv);
+    pthread_mutex_unlock(&g_watch.mu);
+}
+
+// 读入整个文件，*st 为打开时的状态；打不开（保存后又被删掉或改名）或内存不足返回 NULL
+static char *watch_read(const char *path, size_t *len, struct stat *st) {
+    FILE *fin = fopen(path, "r");
+    if (!fin || fstat(fileno(fin), st) != 0) {
+        if (fin) fclose(fin);
+        return NULL;
+    }
+    size_t n = 0, cap = (size_t)st->st_size + 1;
+    char *src = malloc(cap);
+    for (size_t r; src && (r = fread(src + n, 1, cap - n, fin)) > 0;) {
+        n += r;
+        if (n < cap) continue;
+        char *grown = realloc(src, cap * 2);
+        if (!grown) {
+            free(src);
+            src = NULL;
+            break;
+        }
+        src = grown;
+        cap *= 2;
+    }
+    fclose(fin);
+    *len = n;
+    return src;
+}
+
+// 编译一个文件；返回 1 表示内容没变被跳过
+static int watch_compile(QclCtx *c, WatchFile *wf) {
+    const char *path = wf->path;
+    struct stat st;
+    size_t n;
+    char *src = watch_read(path, &n, &st);
+    if (!src) return 0;
+    uint64_t saved = (uint64_t)st.st_mtim.tv_sec * 1000000000ull + (uint64_t)st.st_mtim.tv_nsec;
+
+    uint64_t h = fnv1a(src, n);
+    pthread_mutex_lock(&g_watch.mu);
+    int same = wf->known && wf->hash == h;
+    pthread_mutex_unlock(&g_watch.mu);
+    if (same) {
+        free(src);
+        fprintf(stdout, "[QCL] 跳过 %s（内容未变）\n", path + g_watch.root_len + 1);
+        fflush(stdout);
+        return 1;
+    }
+
+    char out[4096], tmp[4200];
+    watch_out_path(path, out, sizeof(out));
+    snprintf(tmp, sizeof(tmp), "%s.tmp%ld", out, (long)syscall(SYS_gettid));
+    if (g_watch.outdir) mkdir_parents(out);
+    FILE *fout = fopen(tmp, "wb");
+
+    // 字节码边编边写进临时文件，不受 MAX_OPS 限制
+    uint64_t t0 = monotonic_ns();
+    int found = 0, ok = fout != NULL;
+    if (ok) {
+        c->sink = fout;
+        c->flushed = 0;
+        c->sink_failed = 0;
+        found = compile_buffer_ctx(c, src, n);
+        qcl_flush(c);
+        c->sink = NULL;
+        ok = !c->sink_failed;
+    }
+    free(src);
+    double compile_ms = (monotonic_ns() - t0) * 1e-6;
+    if (fout && fclose(fout) != 0) ok = 0;
+    if (!ok || rename(tmp, out) != 0) {
+        unlink(tmp);
+        fprintf(stderr, "[QCL] 无法写出 %s: %s\n", out, strerror(errno));
+        return 0;
+    }
+    uint64_t done = realtime_ns();
+    double latency_ms = done > saved ? (done - saved) * 1e-6 : 0;
+
+    pthread_mutex_lock(&g_watch.mu);
+    wf->hash = h;
+    wf->known = 1;
+    pthread_mutex_unlock(&g_watch.mu);
+    fprintf(stdout, "[QCL] 编译 %s → %s: %ld 字节, %d 条指令%s, 编译 %.2f ms, 保存到落盘 %.1f ms\n",
+            path + g_watch.root_len + 1, out, c->flushed, c->n_ops, found ? "" : "（未找到可编译的量子代码）",
+            compile_ms, latency_ms);
+    fflush(stdout);
+
+    QsmMetrics d = { 0 };
+    d.jobs = 1;
+    d.gates = (uint64_t)c->n_ops;
+    d.compile_ns = (uint64_t)(compile_ms * 1e6);
+    qsm_metrics_observe(&d, latency_ms * 1e-3);
+    qsm_metrics_publish(g_watch.metrics, &d);
+    return 0;
+}
+
+static void *watch_worker(void *arg) {
+    (void)arg;
+    QclCtx c = { .bc = malloc(MAX_OPS) };
+    pthread_mutex_lock(&g_watch.mu);
+    for (;;) {
+        while (!g_watch.head) pthread_cond_wait(&g_watch.cv, &g_watch.mu);
+        WatchJob *j = g_watch.head;
+        g_watch.head = j->next;
+        if (!g_watch.head) g_watch.tail = NULL;
+        WatchFile *wf = watch_file(j->path);
+        free(j->path);
+        free(j);
+        if (wf->busy) {
+            wf->dirty = 1;
+            continue;
+        }
+        wf->busy = 1;
+        do {
+            wf->dirty = 0;
+            pthread_mutex_unlock(&g_watch.mu);
+            watch_compile(&c, wf);
+            pthread_mutex_lock(&g_watch.mu);
+        } while (wf->dirty);
+        wf->busy = 0;
+    }
+    return NULL;
+}
+
+static void watch_add_dir(const char *dir);
+
+// 启动扫描：登记每个 .qentl，.qbc 缺失或更旧的排进队列；已是最新的记下内容哈希，
+// 之后只 touch、原样保存不会重编。子目录一并加 inotify 监视
+static void watch_scan(const char *dir) {
+    watch_add_dir(dir);
+    DIR *d = opendir(dir);
+    if (!d) return;
+    for (struct dirent *e; (e = readdir(d));) {
+        if (e->d_name[0] == '.') continue;
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        struct stat st, qs;
+        if (stat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            watch_scan(path);
+        } else if (S_ISREG(st.st_mode) && has_suffix(path, ".qentl")) {
+            char out[4096];
+            watch_out_path(path, out, sizeof(out));
+            if (stat(out, &qs) != 0 || qs.st_mtim.tv_sec < st.st_mtim.tv_sec ||
+                (qs.st_mtim.tv_sec == st.st_mtim.tv_sec && qs.st_mtim.tv_nsec < st.st_mtim.tv_nsec)) {
+                watch_enqueue(path);
+                continue;
+            }
+            size_t n;
+            char *src = watch_read(path, &n, &st);
+            if (!src) continue;
+            pthread_mutex_lock(&g_watch.mu);
+            WatchFile *wf = watch_file(path);
+            wf->hash = fnv1a(src, n);
+            wf->known = 1;
+            pthread_mutex_unlock(&g_watch.mu);
+            free(src);
+        }
+    }
+    closedir(d);
+}
+
+static void watch_add_dir(const char *dir) {
+    int wd = inotify_add_watch(g_watch.ifd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+    if (wd < 0) {
+        fprintf(stderr, "[QCL] 无法监视 %s: %s\n", dir, strerror(errno));
+        return;
+    }
+    for (int i = 0; i < g_watch.ndirs; i++)
+        if (g_watch.dirs[i].wd == wd) return;
+    g_watch.dirs = realloc(g_watch.dirs, (size_t)(g_watch.ndirs + 1) * sizeof(*g_watch.dirs));
+    g_watch.dirs[g_watch.ndirs].wd = wd;
+    g_watch.dirs[g_watch.ndirs++].path = strdup(dir);
+}
+
+static void watch_touch(const char *path) {
+    uint64_t now = monotonic_ns();
+    for (int i = 0; i < g_watch.npending; i++) {
+        if (strcmp(g_watch.pending[i].path, path) == 0) {
+            g_watch.pending[i].last_ns = now;
+            return;
+        }
+    }
+    if (g_watch.npending == g_watch.cap_pending) {
+        g_watch.cap_pending = g_watch.cap_pending ? g_watch.cap_pending * 2 : 16;
+        g_watch.pending = realloc(g_watch.pending, (size_t)g_watch.cap_pending * sizeof(Pending));
+    }
+    g_watch.pending[g_watch.npending++] = (Pending){ strdup(path), now };
+}
+
+static int watch_main(int argc, char *argv[]) {
+    const char *root = NULL, *outdir = NULL;
+    int workers = (int)sysconf(_SC_NPROCESSORS_ONLN), debounce_ms = 50;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) outdir = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) debounce_ms = atoi(argv[++i]);
+        else if (!root) root = argv[i];
+        else root = NULL, i = argc;
+    }
+    if (!root) {
+        fprintf(stderr, "用法: %s --watch <目录> [-o 输出目录] [-j 线程数] [-d 去抖毫秒]\n", argv[0]);
+        return 1;
+    }
+    if (workers < 1) workers = 1;
+    // 去掉末尾的 /，相对路径按 root 前缀截取
+    char *r = strdup(root);
+    for (size_t n = strlen(r); n > 1 && r[n - 1] == '/'; n--) r[n - 1] = '\0';
+    g_watch.root = r;
+    g_watch.root_len = strlen(r);
+    if (outdir) {
+        char *o = strdup(outdir);
+        for (size_t n = strlen(o); n > 1 && o[n - 1] == '/'; n--) o[n - 1] = '\0';
+        g_watch.outdir = o;
+        mkdir(o, 0755);
+    }
+    g_watch.ifd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (g_watch.ifd < 0) {
+        fprintf(stderr, "[QCL] inotify 不可用: %s\n", strerror(errno));
+        return 1;
+    }
+    g_watch.metrics = qsm_metrics_attach(qsm_metrics_open(1), "qentl_compiler");
+    for (int i = 0; i < workers; i++) {
+        pthread_t th;
+        pthread_create(&th, NULL, watch_worker, NULL);
+        pthread_detach(th);
+    }
+    watch_scan(g_watch.root);
+    fprintf(stdout, "[QCL] 监视 %s（%d 个目录）, 输出到 %s, %d 个编译线程, 去抖 %d ms\n", g_watch.root,
+            g_watch.ndirs, g_watch.outdir ? g_watch.outdir : "源文件旁", workers, debounce_ms);
+    fflush(stdout);
+
+    char buf[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        // 等到最早一个待定文件的去抖期满；没有待定时一直等事件
+        int timeout = -1;
+        uint64_t now = monotonic_ns();
+        for (int i = 0; i < g_watch.npending; i++) {
+            uint64_t due = g_watch.pending[i].last_ns + (uint64_t)debounce_ms * 1000000ull;
+            int ms = due > now ? (int)((due - now + 999999) / 1000000) : 0;
+            if (timeout < 0 || ms < timeout) timeout = ms;
+        }
+        struct pollfd pfd = { g_watch.ifd, POLLIN, 0 };
+        int pr = poll(&pfd, 1, timeout);
+        if (pr < 0 && errno != EINTR) break;
+        if (pr > 0) {
+            ssize_t len;
+            while ((len = read(g_watch.ifd, buf, sizeof(buf))) > 0) {
+                for (char *p = buf; p < buf + len;) {
+                    struct inotify_event *ev = (struct inotify_event *)p;
+                    p += sizeof(*ev) + ev->len;
+                    const char *dir = NULL;
+                    for (int i = 0; i < g_watch.ndirs; i++)
+                        if (g_watch.dirs[i].wd == ev->wd) dir = g_watch.dirs[i].path;
+                    if (!dir || !ev->len || ev->name[0] == '.') continue;
+                    char path[4096];
+                    snprintf(path, sizeof(path), "%s/%s", dir, ev->name);
+                    if (ev->mask & IN_ISDIR) {
+                        // 新建的子目录：加监视并扫一遍，避免漏掉监视生效前写进去的文件
+                        if (ev->mask & (IN_CREATE | IN_MOVED_TO)) watch_scan(path);
+                    } else if ((ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && has_suffix(path, ".qentl")) {
+                        watch_touch(path);
+                    }
+                }
+            }
+        }
+        now = monotonic_ns();
+        for (int i = 0; i < g_watch.npending;) {
+            if (now - g_watch.pending[i].last_ns < (uint64_t)debounce_ms * 1000000ull) {
+                i++;
+                continue;
+            }
+            watch_enqueue(g_watch.pending[i].path);
+            free(g_watch.pending[i].path);
+            g_watch.pending[i] = g_watch.pending[--g_watch.npending];
+        }
+    }
+    fprintf(stderr, "[QCL] 监视中断: %s\n", strerror(errno));
+    return 1;
+}
+
+// ==================== 管道模式（- 表示 stdin / stdout） ====================
+//
+// 生成器 → 编译器 → 执行器 的链路原来只能经临时文件中转。输入或输出写 "-" 时走这里：
+//   qentl_compiler - -            stdin 的 .qentl → stdout 的 .qbc
+//   gen | qentl_compiler - out.qbc / qentl_compiler big.qasm - | …
+// stdin 一律按 .qentl 文本解析；输入是文件时照旧按后缀分派 .qasm / .qir。
+// 只读不 seek，内存只占一块输入、一行和 bc；每读进一块就把已产出的字节码写出并 fflush，
+// 下游可以边收边解析。stdout 是字节码，日志改走 stderr。
+
+#define PIPE_CHUNK 65536
+
+static int compile_qentl_stream(QclCtx *c, int fd) {
+    static char buf[PIPE_CHUNK];
+    char line[MAX_LINE_LEN];
+    size_t k = 0;
+    int found_code = 0;
+    c->pos = 0;
+    c->n_ops = 0;
+    c->flushed = 0;
+    for (;;) {
+        ssize_t r = read(fd, buf, sizeof(buf));
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return -1;
+        if (r == 0) break;
+        if (c->stats) c->stats->src_bytes += r;
+        for (ssize_t i = 0; i < r; i++) {
+            if (buf[i] != '\n') {
+                if (k < MAX_LINE_LEN - 2) line[k++] = buf[i];
+                continue;
+            }
+            line[k++] = '\n';
+            line[k] = '\0';
+            found_code |= compile_line(c, line);
+            k = 0;
+        }
+        qcl_flush(c);
+        if (fflush(c->sink) != 0) c->sink_failed = 1;
+        if (c->sink_failed) return -1;
+    }
+    if (k) {    // 最后一行没有换行
+        line[k++] = '\n';
+        line[k] = '\0';
+        found_code |= compile_line(c, line);
+    }
+    if (!found_code) write_opcode(c, OP_STOP);
+    qcl_flush(c);
+    return found_code;
+}
+
+static int compile_pipe(const char *input_path, const char *output_path) {
+    int from_stdin = strcmp(input_path, "-") == 0, to_stdout = strcmp(output_path, "-") == 0;
+    FILE *fin = from_stdin ? stdin : fopen(input_path, "rb");
+    if (!fin) {
+        fprintf(stderr, "[QCL] 无法打开输入文件: %s\n", input_path);
+        return -1;
+    }
+    FILE *fout = to_stdout ? stdout : fopen(output_path, "wb");
+    if (!fout) {
+        if (!from_stdin) fclose(fin);
+        fprintf(stderr, "[QCL] 无法创建输出文件: %s\n", output_path);
+        return -1;
+    }
+    const char *in_name = from_stdin ? "<stdin>" : input_path, *out_name = to_stdout ? "<stdout>" : output_path;
+    fprintf(stderr, "[QCL] 流式编译: %s → %s\n", in_name, out_name);
+
+    QclCtx *c = &g_ctx;
+    c->sink = fout;
+    c->sink_failed = 0;
+    char err[160] = "";
+    int ret = 0;
+    if (!from_stdin && has_suffix(input_path, ".qasm")) {
+        QasmState st;
+        if (compile_qasm_stream(c, &st, fin) != 0) {
+            snprintf(err, sizeof(err), "%s", st.err);
+            ret = -1;
+        }
+    } else if (!from_stdin && has_suffix(input_path, ".qir")) {
+        unsigned long long ngates;
+        ret = compile_qir_stream(c, fin, err, sizeof(err), &ngates);
+    } else {
+        if (c->stats) c->stats->format = "qentl";
+        int found_code = compile_qentl_stream(c, fileno(fin));
+        if (found_code < 0) {
+            snprintf(err, sizeof(err), "%s", c->sink_failed ? "写出失败" : strerror(errno));
+            ret = -1;
+        } else if (!found_code) {
+            fprintf(stderr, "[QCL] 警告: 未找到可编译的量子代码\n");
+        }
+    }
+    if (!from_stdin) fclose(fin);
+    if ((to_stdout ? fflush(fout) : fclose(fout)) != 0) c->sink_failed = 1;
+    c->sink = NULL;
+    if (ret == 0 && c->sink_failed) {
+        snprintf(err, sizeof(err), "写出失败");
+        ret = -1;
+    }
+    if (ret != 0) {
+        fprintf(stderr, "[QCL] %s: %s\n", in_name, err);
+        if (!to_stdout) remove(output_path);
+        return -1;
+    }
+    report_skipped(stderr, c->stats);
+    if (c->stats) c->stats->bc_bytes = c->flushed;
+    fprintf(stderr, "[QCL] 编译完成: %ld 字节, %d 条指令\n", c->flushed, c->n_ops);
+    return 0;
+}
+
+// 命令行的一次编译：任一端是 "-" 走管道模式，否则按文件编译
+static int compile_cli(const char *input_path, const char *output_path) {
+    if (strcmp(input_path, "-") == 0 || strcmp(output_path, "-") == 0) return compile_pipe(input_path, output_path);
+    return compile_file_v2(input_path, output_path);
+}
+
+// ==================== 编译统计（--stats=json） ====================
+//
+// 批处理脚本与看板直接读编译器的性能数据：编译结束后输出一行 JSON（写 stdout；输出是 stdout 时写 stderr），
+// 此时 [QCL] 日志改走 stderr。
+//   {"ok":true,"input":"a.qentl","output":"a.qbc","format":"qentl","threads":1,
+//    "source_bytes":…,"bytecode_bytes":…,"instructions":…,"ops":{"init":1,"H":…},
+//    "qubits":…,"lines":…,"skipped_lines":…,"skipped_at":[…],
+//    "parse_ms":…,"emit_ms":…,"total_ms":…,"mb_per_s":…,"instructions_per_s":…}
+// qubits 取最后一条 init 的宽度，没有 init 时取操作数里最大比特编号 + 1；skipped_at 最多列 STATS_MAX_SKIPPED 个。
+// emit 是字节码写出耗时，parse 是其余的编译耗时（逐行解析与发码交织在一起，不再细分）。
+
+static void json_str(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char ch = (unsigned char)*s;
+        if (ch == '"' || ch == '\\') fprintf(f, "\\%c", ch);
+        else if (ch < 0x20) fprintf(f, "\\u%04x", ch);
+        else fputc(ch, f);
+    }
+    fputc('"', f);
+}
+
+static void print_stats_json(FILE *f, const char *input_path, const char *output_path, int ret, double sec) {
+    const QclStats *st = g_ctx.stats;
+    if (!st) return;
+    fprintf(f, "{\"ok\":%s,\"input\":", ret == 0 ? "true" : "false");
+    json_str(f, input_path);
+    fprintf(f, ",\"output\":");
+    json_str(f, output_path);
+    fprintf(f, ",\"format\":\"%s\",\"threads\":%d,\"source_bytes\":%ld,\"bytecode_bytes\":%ld,\"instructions\":%d,\"ops\":{",
+            st->format ? st->format : "qentl", st->threads, st->src_bytes, st->bc_bytes, g_ctx.n_ops);
+    int first = 1;
+    for (int op = 0; op < 64; op++) {
+        if (!st->ops[op]) continue;
+        const char *name = op == OP_INIT_N ? "init" : qir_op_name(op);
+        if (name) fprintf(f, "%s\"%s\":%ld", first ? "" : ",", name, st->ops[op]);
+        else fprintf(f, "%s\"op%d\":%ld", first ? "" : ",", op, st->ops[op]);
+        first = 0;
+    }
+    int qubits = st->init_qubits >= 0 ? st->init_qubits : st->max_qubit + 1;
+    fprintf(f, "},\"qubits\":%d,\"lines\":%ld,\"skipped_lines\":%ld,\"skipped_at\":[", qubits, st->lines, st->skipped);
+    for (long i = 0; i < st->skipped && i < STATS_MAX_SKIPPED; i++) fprintf(f, "%s%ld", i ? "," : "", st->skipped_at[i]);
+    double parse = sec > st->emit_sec ? sec - st->emit_sec : 0;
+    fprintf(f, "],\"parse_ms\":%.3f,\"emit_ms\":%.3f,\"total_ms\":%.3f,\"mb_per_s\":%.2f,\"instructions_per_s\":%.0f}\n",
+            parse * 1e3, st->emit_sec * 1e3, sec * 1e3, sec > 0 ? st->src_bytes / sec / 1e6 : 0,
+            sec > 0 ? g_ctx.n_ops / sec : 0);
+}
+
 int main(int argc, char *argv[]) {
+    if (argc >= 2 && strncmp(argv[1], "--stats=", 8) == 0) {
+        if (strcmp(argv[1] + 8, "json") != 0) {
+            fprintf(stderr, "[QCL] 不支持的统计格式: %s（只有 --stats=json）\n", argv[1] + 8);
+            return 1;
+        }
+        g_stats_json = 1;
+        g_log = stderr;
+        for (int i = 1; i < argc - 1; i++) argv[i] = argv[i + 1];
+        argc--;
+    }
+    if (argc >= 2 && strcmp(argv[1], "--serve") == 0) return serve_main(argc > 2 ? argv[2] : default_socket());
+    if (argc >= 2 && strcmp(argv[1], "--watch") == 0) return watch_main(argc, argv);
+    if (argc == 4 && strcmp(argv[1], "--to-ir") == 0) return to_ir_main(argv[2], argv[3]);
+    if (argc == 4 && strcmp(argv[1], "--from-ir") == 0) return from_ir_main(argv[2], argv[3]);
     if (argc < 2) {
-        fprintf(stderr, "用法: %s <input.qentl> [output.qbc]\n", argv[0]);
+        fprintf(stderr, "用法: %s <input.qentl|input.qasm|input.qir> [output.qbc]\n", argv[0]);
+        fprintf(stderr, "      %s - -                 从 stdin 读 .qentl，字节码流式写到 stdout（任一端可换成文件）\n", argv[0]);
+        fprintf(stderr, "      %s --stats=json <input> [output.qbc]   编译后输出一行 JSON 统计\n", argv[0]);
+        fprintf(stderr, "      %s --serve [套接字]      常驻编译服务（默认 %s）\n", argv[0], default_socket());
+        fprintf(stderr, "      %s --watch <目录> [-o 输出目录] [-j 线程数] [-d 去抖毫秒]   监视并增量编译\n", argv[0]);
+        fprintf(stderr, "      %s --to-ir <input.qentl|input.qasm> <output.qir>   转成二进制 IR\n", argv[0]);
+        fprintf(stderr, "      %s --from-ir <input.qir> <output.qentl>          二进制 IR 转回文本\n", argv[0]);
         fprintf(stderr, "\nQCL引导编译器 v2 - 最小化C语言引导编译器\n");
         fprintf(stderr, "将QEntL源码编译为QVM可执行的.qbc字节码\n");
         fprintf(stderr, "\n支持指令:\n");
@@ -213,6 +2162,9 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "  运算符: ===, !==, ==, !=, <, >, +, -, *, /\n");
         fprintf(stderr, "  控制流: 否则, 循环, 跳出, 继续\n");
         fprintf(stderr, "\n注: 高级QEntL语法(类定义、函数体等)会被简化处理\n");
+        fprintf(stderr, "设 QCL_SERVER=套接字 时把编译转发给该服务（连不上则本地编译）；未设置或为 off 时总是本地编译\n");
+        fprintf(stderr, "大于 4 MB 的 .qentl 按行分块多线程编译；QCL_THREADS=N 指定线程数（默认在线 CPU 数，1 为单线程）\n");
+        fprintf(stderr, "设 QSM_METRICS=on（或指标文件路径）时把本次编译记进共享内存指标页；--serve / --watch 默认就记\n");
         return 1;
     }
     
@@ -224,7 +2176,13 @@ int main(int argc, char *argv[]) {
         snprintf(tmp_qbc, sizeof(tmp_qbc), "/tmp/qcl_exec_%d.qbc", getpid());
         
         fprintf(stderr, "[QCL] 执行模式：编译 %s → %s\n", input, tmp_qbc);
-        int ret = compile_file_v2(input, tmp_qbc);
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        stats_reset(&g_stats);
+        g_ctx.stats = &g_stats;
+        int ret = compile_cli(input, tmp_qbc);
+        publish_metrics(&t0, ret);
+        if (g_stats_json) print_stats_json(stderr, input, tmp_qbc, ret, since(&t0));
         if (ret != 0) {
             fprintf(stderr, "[QCL] 编译失败\n");
             return ret;
@@ -242,7 +2200,13 @@ int main(int argc, char *argv[]) {
         // 编译模式
         const char *output = argv[2];
         srand((unsigned int)time(NULL));
-        int ret = compile_file_v2(input, output);
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        stats_reset(&g_stats);
+        g_ctx.stats = &g_stats;
+        int ret = compile_cli(input, output);
+        publish_metrics(&t0, ret);
+        if (g_stats_json) print_stats_json(strcmp(output, "-") == 0 ? stderr : stdout, input, output, ret, since(&t0));
         return ret;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,47 @@
+/*
+ * qcl_ir.h — 二进制线路 IR（.qir）
+ *
+ * 给线路生成器用的输入格式：生成器不必再写 .qentl 文本让编译器逐位数字地重新解析，
+ * 直接写定长门记录，qentl_compiler 读到 .qir 时不做任何文本扫描就能发出 .qbc。
+ * 记录定长，可以按下标随机访问、原地改写，后续的优化遍直接在记录数组上做。
+ *
+ * 布局（整数均为小端）：
+ *   QclIrHeader（16 字节）+ QclIrGate[ngates]（每条 4 字节）
+ *
+ *   nqubits 为 0 时由操作数推断；ngates 为 QCL_IR_STREAM 时读到文件尾（生成器不知道总数时用）。
+ *   op 与 .qbc 操作码相同，操作数含义：
+ *     H X Y Z T S      a = 比特
+ *     CNOT             a = 控制比特, b = 目标比特（不能相同）
+ *     SWAP             a, b = 交换的两个比特（不能相同）
+ *     RESET            a = 比特
+ *     MEASURE          a = 比特, b = 经典寄存器
+ *     PRINT            a = 经典寄存器
+ *     BARRIER STOP EXIT 无操作数
+ *   未用的操作数与 reserved 写 0。宽度由文件头给出，记录里不出现 INIT_N。
+ *
+ * qentl_compiler --to-ir / --from-ir 在 .qentl 与 .qir 之间互转。
+ */
+#ifndef QCL_IR_H
+#define QCL_IR_H
+
+#include <stdint.h>
+
+#define QCL_IR_MAGIC 0x31524951u    // "QIR1"
+#define QCL_IR_VERSION 1
+#define QCL_IR_STREAM 0xFFFFFFFFu
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t nqubits;
+    uint32_t ngates;
+    uint32_t reserved;
+} QclIrHeader;
+
+typedef struct {
+    uint8_t op;
+    uint8_t a, b;
+    uint8_t reserved;
+} QclIrGate;
+
+#endif
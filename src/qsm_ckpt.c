@@ -0,0 +1,341 @@
+/*
+ * qsm_ckpt.c — 模型二进制检查点实现
+ */
+#define _GNU_SOURCE
+#include "qsm_ckpt.h"
+#include "qsm_jsonl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HASH_SEED 0x71636b31ULL
+
+// ==================== 写 ====================
+
+struct QsmCkptWriter {
+    FILE *f;
+    char *path;
+    char *tmp;
+    uint64_t pos;
+    QsmCkptEntry *ents;
+    uint32_t n, cap;
+    int failed;
+};
+
+static void w_pad(QsmCkptWriter *w) {
+    static const uint8_t zero[QSM_CKPT_ALIGN] = { 0 };
+    size_t pad = (size_t)((QSM_CKPT_ALIGN - w->pos % QSM_CKPT_ALIGN) % QSM_CKPT_ALIGN);
+    if (pad && fwrite(zero, 1, pad, w->f) != pad) w->failed = 1;
+    w->pos += pad;
+}
+
+static void w_put(QsmCkptWriter *w, const void *p, size_t n) {
+    if (n && fwrite(p, 1, n, w->f) != n) w->failed = 1;
+    w->pos += n;
+}
+
+QsmCkptWriter *qsm_ckpt_create(const char *path) {
+    QsmCkptWriter *w = calloc(1, sizeof(*w));
+    if (!w) return NULL;
+    w->path = strdup(path);
+    if (asprintf(&w->tmp, "%s.tmp", path) < 0) w->tmp = NULL;
+    w->f = w->tmp ? fopen(w->tmp, "wb") : NULL;
+    if (!w->f) {
+        free(w->path);
+        free(w->tmp);
+        free(w);
+        return NULL;
+    }
+    QsmCkptHeader h;
+    memset(&h, 0, sizeof(h));
+    w_put(w, &h, sizeof(h));             // finish 时回填
+    return w;
+}
+
+static int valid_name(const char *name) {
+    return name && *name && strlen(name) < QSM_CKPT_NAME_LEN;
+}
+
+int qsm_ckpt_add(QsmCkptWriter *w, QsmCkptKind kind, const char *name, QsmCkptDtype dtype,
+                 uint32_t ndim, const uint64_t *shape, const void *data, size_t size) {
+    if (w->failed || !valid_name(name) || ndim > QSM_CKPT_MAX_DIM) return -1;
+    for (uint32_t i = 0; i < w->n; i++)
+        if (w->ents[i].kind == (uint32_t)kind && strcmp(w->ents[i].name, name) == 0) return -1;
+    if (w->n == w->cap) {
+        w->cap = w->cap ? w->cap * 2 : 16;
+        w->ents = realloc(w->ents, w->cap * sizeof(QsmCkptEntry));
+    }
+    w_pad(w);
+    QsmCkptEntry *e = &w->ents[w->n++];
+    memset(e, 0, sizeof(*e));
+    e->kind = kind;
+    e->dtype = dtype;
+    e->ndim = ndim;
+    for (uint32_t i = 0; i < ndim; i++) e->shape[i] = shape[i];
+    e->off = w->pos;
+    e->size = size;
+    e->hash = qsm_hash64(data, size, HASH_SEED);
+    strcpy(e->name, name);
+    w_put(w, data, size);
+    return w->failed ? -1 : 0;
+}
+
+int qsm_ckpt_add_tensor(QsmCkptWriter *w, const char *name, QsmCkptDtype dtype,
+                        uint32_t ndim, const uint64_t *shape, const void *data) {
+    size_t count = 1;
+    for (uint32_t i = 0; i < ndim; i++) count *= shape[i];
+    return qsm_ckpt_add(w, QSM_CKPT_TENSOR, name, dtype, ndim, shape, data,
+                        count * qsm_ckpt_dtype_size(dtype));
+}
+
+typedef struct {
+    const char *const *tok;
+    const uint32_t *len;
+} SortCtx;
+
+static int cmp_order(const void *pa, const void *pb, void *ud) {
+    const SortCtx *sc = ud;
+    uint32_t a = *(const uint32_t *)pa, b = *(const uint32_t *)pb;
+    uint32_t la = sc->len[a], lb = sc->len[b];
+    int c = memcmp(sc->tok[a], sc->tok[b], la < lb ? la : lb);
+    if (c == 0) c = la < lb ? -1 : la > lb;
+    return c ? c : (a < b ? -1 : 1);
+}
+
+int qsm_ckpt_add_vocab(QsmCkptWriter *w, const char *name, const char *const *tokens,
+                       const uint32_t *lens, uint32_t n) {
+    size_t text = 0;
+    for (uint32_t i = 0; i < n; i++) text += lens[i] + 1;
+    size_t size = sizeof(QsmCkptVocabHdr) + (size_t)(n + 1) * 4 + (size_t)n * 4 + text;
+    uint8_t *buf = malloc(size);
+    if (!buf) return -1;
+    QsmCkptVocabHdr *h = (QsmCkptVocabHdr *)buf;
+    h->n = n;
+    h->pad = 0;
+    uint32_t *off = (uint32_t *)(buf + sizeof(*h));
+    uint32_t *order = off + n + 1;
+    char *s = (char *)(order + n);
+    uint32_t pos = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        off[i] = pos;
+        memcpy(s + pos, tokens[i], lens[i]);
+        s[pos + lens[i]] = '\0';
+        pos += lens[i] + 1;
+        order[i] = i;
+    }
+    off[n] = pos;
+    SortCtx sc = { tokens, lens };
+    qsort_r(order, n, sizeof(uint32_t), cmp_order, &sc);
+    uint64_t shape[1] = { n };
+    int r = qsm_ckpt_add(w, QSM_CKPT_VOCAB, name, QSM_CKPT_U8, 1, shape, buf, size);
+    free(buf);
+    return r;
+}
+
+static void writer_free(QsmCkptWriter *w) {
+    free(w->ents);
+    free(w->path);
+    free(w->tmp);
+    free(w);
+}
+
+void qsm_ckpt_abort(QsmCkptWriter *w) {
+    if (!w) return;
+    fclose(w->f);
+    remove(w->tmp);
+    writer_free(w);
+}
+
+int qsm_ckpt_finish(QsmCkptWriter *w) {
+    w_pad(w);
+    QsmCkptHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = QSM_CKPT_MAGIC;
+    h.version = QSM_CKPT_VERSION;
+    h.nentries = w->n;
+    h.dir_off = w->pos;
+    h.dir_hash = qsm_hash64(w->ents, (size_t)w->n * sizeof(QsmCkptEntry), HASH_SEED);
+    w_put(w, w->ents, (size_t)w->n * sizeof(QsmCkptEntry));
+    h.file_size = w->pos;
+    if (fseek(w->f, 0, SEEK_SET) != 0) w->failed = 1;
+    if (fwrite(&h, sizeof(h), 1, w->f) != 1) w->failed = 1;
+    if (fclose(w->f) != 0) w->failed = 1;
+    int ok = !w->failed && rename(w->tmp, w->path) == 0;
+    if (!ok) remove(w->tmp);
+    writer_free(w);
+    return ok ? 0 : -1;
+}
+
+// ==================== 读 ====================
+
+struct QsmCkpt {
+    QsmMap map;
+    const QsmCkptHeader *h;
+    const QsmCkptEntry *ents;
+};
+
+// VOCAB 段内部结构：下标表、order 表、字符串区都在段内，偏移单调且每个字符串以 '\0' 结尾。
+// 查询路径不再做边界检查，所以打开时无论是否 QSM_CKPT_VERIFY 都要查
+static int vocab_ok(const uint8_t *base, uint64_t size) {
+    if (size < sizeof(QsmCkptVocabHdr)) return -1;
+    uint64_t n = ((const QsmCkptVocabHdr *)base)->n;
+    uint64_t tables = sizeof(QsmCkptVocabHdr) + (2 * n + 1) * 4;
+    if (tables > size) return -1;
+    const uint32_t *off = (const uint32_t *)(base + sizeof(QsmCkptVocabHdr));
+    const uint32_t *order = off + n + 1;
+    const char *s = (const char *)(order + n);
+    uint64_t text = size - tables;
+    if (off[0] != 0 || off[n] > text) return -1;
+    for (uint64_t i = 0; i < n; i++) {
+        if (off[i + 1] <= off[i] || off[i + 1] > text || s[off[i + 1] - 1] != '\0' || order[i] >= n) return -1;
+    }
+    return 0;
+}
+
+QsmCkpt *qsm_ckpt_open(const char *path, int flags, const char **err) {
+    const char *why = NULL;
+    QsmCkpt *ck = calloc(1, sizeof(*ck));
+    if (!ck) return NULL;
+    if (qsm_map_file(path, &ck->map) != 0) { why = "无法映射文件"; goto fail; }
+    if (ck->map.size < sizeof(QsmCkptHeader)) { why = "文件过短"; goto fail; }
+    ck->h = (const QsmCkptHeader *)ck->map.data;
+    if (ck->h->magic != QSM_CKPT_MAGIC) { why = "不是 .qck 检查点"; goto fail; }
+    if (ck->h->version != QSM_CKPT_VERSION) { why = "版本不支持"; goto fail; }
+    if (ck->h->file_size != ck->map.size) { why = "文件长度与文件头不符（被截断？）"; goto fail; }
+    uint64_t dir_bytes = (uint64_t)ck->h->nentries * sizeof(QsmCkptEntry);
+    if (ck->h->dir_off % QSM_CKPT_ALIGN || ck->h->dir_off < sizeof(QsmCkptHeader) || ck->h->dir_off > ck->map.size ||
+        dir_bytes > ck->map.size - ck->h->dir_off) { why = "目录越界"; goto fail; }
+    ck->ents = (const QsmCkptEntry *)(ck->map.data + ck->h->dir_off);
+    if (qsm_hash64(ck->ents, dir_bytes, HASH_SEED) != ck->h->dir_hash) { why = "目录校验失败"; goto fail; }
+    for (uint32_t i = 0; i < ck->h->nentries; i++) {
+        const QsmCkptEntry *e = &ck->ents[i];
+        // 先比 size 再比 off，off + size 不会回绕
+        if (e->off % QSM_CKPT_ALIGN || e->off < sizeof(QsmCkptHeader) || e->size > ck->h->dir_off ||
+            e->off > ck->h->dir_off - e->size || e->ndim > QSM_CKPT_MAX_DIM ||
+            memchr(e->name, '\0', QSM_CKPT_NAME_LEN) == NULL) { why = "段描述无效"; goto fail; }
+        if (e->kind == QSM_CKPT_VOCAB && vocab_ok((const uint8_t *)ck->map.data + e->off, e->size) != 0) {
+            why = "词表段结构无效";
+            goto fail;
+        }
+    }
+    if ((flags & QSM_CKPT_VERIFY) && qsm_ckpt_verify(ck) != 0) { why = "段内容校验失败"; goto fail; }
+    if (err) *err = NULL;
+    return ck;
+fail:
+    if (err) *err = why;
+    qsm_ckpt_close(ck);
+    return NULL;
+}
+
+void qsm_ckpt_close(QsmCkpt *ck) {
+    if (!ck) return;
+    qsm_unmap_file(&ck->map);
+    free(ck);
+}
+
+uint32_t qsm_ckpt_count(const QsmCkpt *ck) {
+    return ck->h->nentries;
+}
+
+const QsmCkptEntry *qsm_ckpt_entry(const QsmCkpt *ck, uint32_t i) {
+    return i < ck->h->nentries ? &ck->ents[i] : NULL;
+}
+
+const QsmCkptEntry *qsm_ckpt_find(const QsmCkpt *ck, QsmCkptKind kind, const char *name) {
+    for (uint32_t i = 0; i < ck->h->nentries; i++)
+        if (ck->ents[i].kind == (uint32_t)kind && strcmp(ck->ents[i].name, name) == 0) return &ck->ents[i];
+    return NULL;
+}
+
+const void *qsm_ckpt_data(const QsmCkpt *ck, const QsmCkptEntry *e) {
+    return ck->map.data + e->off;
+}
+
+int qsm_ckpt_verify_entry(const QsmCkpt *ck, const QsmCkptEntry *e) {
+    return qsm_hash64(ck->map.data + e->off, e->size, HASH_SEED) == e->hash ? 0 : -1;
+}
+
+int qsm_ckpt_verify(const QsmCkpt *ck) {
+    int bad = 0;
+    for (uint32_t i = 0; i < ck->h->nentries; i++) bad += qsm_ckpt_verify_entry(ck, &ck->ents[i]) != 0;
+    return bad;
+}
+
+const char *qsm_ckpt_meta(const QsmCkpt *ck, const char *key, size_t *len) {
+    size_t klen = strlen(key);
+    for (uint32_t i = 0; i < ck->h->nentries; i++) {
+        const QsmCkptEntry *e = &ck->ents[i];
+        if (e->kind != QSM_CKPT_META) continue;
+        const char *p = ck->map.data + e->off, *end = p + e->size;
+        while (p < end) {
+            const char *eol;
+            const char *nx = qsm_next_line(p, end, &eol);
+            if ((size_t)(eol - p) > klen && memcmp(p, key, klen) == 0 && p[klen] == '=') {
+                if (len) *len = (size_t)(eol - p - (ptrdiff_t)klen - 1);
+                return p + klen + 1;
+            }
+            p = nx;
+        }
+    }
+    return NULL;
+}
+
+// ==================== 词表 ====================
+
+uint32_t qsm_ckpt_vocab_size(const QsmCkpt *ck, const QsmCkptEntry *e) {
+    return ((const QsmCkptVocabHdr *)(ck->map.data + e->off))->n;
+}
+
+const char *qsm_ckpt_vocab_get(const QsmCkpt *ck, const QsmCkptEntry *e, uint32_t id, size_t *len) {
+    const uint8_t *base = (const uint8_t *)ck->map.data + e->off;
+    uint32_t n = ((const QsmCkptVocabHdr *)base)->n;
+    if (id >= n) return NULL;
+    const uint32_t *off = (const uint32_t *)(base + sizeof(QsmCkptVocabHdr));
+    const char *s = (const char *)(off + n + 1 + n);
+    if (len) *len = off[id + 1] - off[id] - 1;
+    return s + off[id];
+}
+
+int64_t qsm_ckpt_vocab_find(const QsmCkpt *ck, const QsmCkptEntry *e, const char *str, size_t len) {
+    const uint8_t *base = (const uint8_t *)ck->map.data + e->off;
+    uint32_t n = ((const QsmCkptVocabHdr *)base)->n;
+    const uint32_t *off = (const uint32_t *)(base + sizeof(QsmCkptVocabHdr));
+    const uint32_t *order = off + n + 1;
+    const char *s = (const char *)(order + n);
+    uint32_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2, id = order[mid];
+        size_t l = off[id + 1] - off[id] - 1;
+        int c = memcmp(s + off[id], str, l < len ? l : len);
+        if (c == 0) c = l < len ? -1 : l > len;
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < n) {
+        uint32_t id = order[lo];
+        size_t l = off[id + 1] - off[id] - 1;
+        if (l == len && memcmp(s + off[id], str, len) == 0) return id;
+    }
+    return -1;
+}
+
+const char *qsm_ckpt_kind_name(uint32_t kind) {
+    switch (kind) {
+    case QSM_CKPT_META: return "META";
+    case QSM_CKPT_TENSOR: return "TENSOR";
+    case QSM_CKPT_BYTECODE: return "BYTECODE";
+    case QSM_CKPT_VOCAB: return "VOCAB";
+    default: return "?";
+    }
+}
+
+size_t qsm_ckpt_dtype_size(uint32_t dtype) {
+    switch (dtype) {
+    case QSM_CKPT_U8: return 1;
+    case QSM_CKPT_I32: return 4;
+    case QSM_CKPT_F32: return 4;
+    case QSM_CKPT_F64: return 8;
+    default: return 0;
+    }
+}
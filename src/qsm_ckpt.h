@@ -0,0 +1,115 @@
+/*
+ * qsm_ckpt.h — 模型二进制检查点（.qck）
+ *
+ * 取代 model.meta 单行文本与 950 KB 的模型 JSON：一个文件里放
+ *   - META：key=value 文本（name / version / build 等）；
+ *   - TENSOR：带名字、类型与形状的参数张量；
+ *   - BYTECODE：编译好的线路字节码（.qbc 原样）；
+ *   - VOCAB：字符串表（词表等），附按字节序排好的下标，可二分查 token → id。
+ *
+ * 布局：64 字节文件头 + 各段数据（起点 64 字节对齐）+ 段目录。
+ * 每段有 64 位内容哈希，目录本身的哈希记在文件头里。
+ * 打开只映射文件、校验文件头与目录，各段数据零拷贝直接指向映射区，冷启动在毫秒级；
+ * 需要逐段核对内容时调用 qsm_ckpt_verify（或打开时带 QSM_CKPT_VERIFY）。
+ */
+#ifndef QSM_CKPT_H
+#define QSM_CKPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define QSM_CKPT_MAGIC 0x314B4351u  // "QCK1"
+#define QSM_CKPT_VERSION 1
+#define QSM_CKPT_ALIGN 64
+#define QSM_CKPT_MAX_DIM 4
+#define QSM_CKPT_NAME_LEN 48
+
+typedef enum {
+    QSM_CKPT_META = 1,
+    QSM_CKPT_TENSOR = 2,
+    QSM_CKPT_BYTECODE = 3,
+    QSM_CKPT_VOCAB = 4,
+} QsmCkptKind;
+
+typedef enum {
+    QSM_CKPT_U8 = 1,
+    QSM_CKPT_I32 = 2,
+    QSM_CKPT_F32 = 3,
+    QSM_CKPT_F64 = 4,
+} QsmCkptDtype;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nentries;
+    uint32_t pad;
+    uint64_t file_size;
+    uint64_t dir_off;           // QsmCkptEntry[nentries]
+    uint64_t dir_hash;
+    uint64_t reserved[3];
+} QsmCkptHeader;
+
+typedef struct {
+    uint32_t kind;
+    uint32_t dtype;             // TENSOR 之外为 U8
+    uint32_t ndim;
+    uint32_t pad;
+    uint64_t shape[QSM_CKPT_MAX_DIM];
+    uint64_t off;               // 相对文件起点，QSM_CKPT_ALIGN 对齐
+    uint64_t size;              // 字节数
+    uint64_t hash;
+    char name[QSM_CKPT_NAME_LEN];
+} QsmCkptEntry;
+
+// VOCAB 段：QsmCkptVocabHdr + off[n+1] + order[n] + 字符串区（每个以 '\0' 结尾）
+typedef struct {
+    uint32_t n;
+    uint32_t pad;
+} QsmCkptVocabHdr;
+
+// ==================== 写 ====================
+
+typedef struct QsmCkptWriter QsmCkptWriter;
+
+// 写到 path.tmp，finish 成功后改名；失败时不留半个文件
+QsmCkptWriter *qsm_ckpt_create(const char *path);
+int qsm_ckpt_add(QsmCkptWriter *w, QsmCkptKind kind, const char *name, QsmCkptDtype dtype,
+                 uint32_t ndim, const uint64_t *shape, const void *data, size_t size);
+int qsm_ckpt_add_tensor(QsmCkptWriter *w, const char *name, QsmCkptDtype dtype,
+                        uint32_t ndim, const uint64_t *shape, const void *data);
+int qsm_ckpt_add_vocab(QsmCkptWriter *w, const char *name, const char *const *tokens,
+                       const uint32_t *lens, uint32_t n);
+int qsm_ckpt_finish(QsmCkptWriter *w);     // 同时释放 w
+void qsm_ckpt_abort(QsmCkptWriter *w);
+
+// ==================== 读 ====================
+
+#define QSM_CKPT_VERIFY 1
+
+typedef struct QsmCkpt QsmCkpt;
+
+// 失败返回 NULL，err 写入原因（可为 NULL）
+QsmCkpt *qsm_ckpt_open(const char *path, int flags, const char **err);
+void qsm_ckpt_close(QsmCkpt *ck);
+
+uint32_t qsm_ckpt_count(const QsmCkpt *ck);
+const QsmCkptEntry *qsm_ckpt_entry(const QsmCkpt *ck, uint32_t i);
+const QsmCkptEntry *qsm_ckpt_find(const QsmCkpt *ck, QsmCkptKind kind, const char *name);
+const void *qsm_ckpt_data(const QsmCkpt *ck, const QsmCkptEntry *e);
+
+// 逐段核对内容哈希，返回不一致的段数；单段一致返回 0
+int qsm_ckpt_verify(const QsmCkpt *ck);
+int qsm_ckpt_verify_entry(const QsmCkpt *ck, const QsmCkptEntry *e);
+
+// META 段中 key 的值（不以 '\0' 结尾），没有返回 NULL
+const char *qsm_ckpt_meta(const QsmCkpt *ck, const char *key, size_t *len);
+
+// VOCAB 段
+uint32_t qsm_ckpt_vocab_size(const QsmCkpt *ck, const QsmCkptEntry *e);
+const char *qsm_ckpt_vocab_get(const QsmCkpt *ck, const QsmCkptEntry *e, uint32_t id, size_t *len);
+int64_t qsm_ckpt_vocab_find(const QsmCkpt *ck, const QsmCkptEntry *e, const char *s, size_t len);
+
+const char *qsm_ckpt_kind_name(uint32_t kind);
+size_t qsm_ckpt_dtype_size(uint32_t dtype);
+
+#endif
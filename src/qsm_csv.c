@@ -0,0 +1,209 @@
+/*
+ * qsm_csv.c — 模型训练特征 CSV 加载器实现
+ */
+#define _GNU_SOURCE
+#include "qsm_csv.h"
+#include "qsm_jsonl.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define COL_ALIGN 64
+#define ROW_PAD 8
+
+// ==================== 行数 ====================
+
+// 数 '\n'；SSE2 每次比 16 字节，尾部逐字节
+static size_t count_newlines(const char *p, size_t n) {
+    size_t count = 0, i = 0;
+#ifdef __SSE2__
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        count += (size_t)__builtin_popcount((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)));
+    }
+#endif
+    for (; i < n; i++) count += p[i] == '\n';
+    return count;
+}
+
+// ==================== 浮点解析 ====================
+
+// 10^0 .. 10^22 都能用 double 精确表示
+static const double k_pow10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static int parse_slow(const char *p, const char *end, double *out) {
+    char buf[128];
+    size_t n = (size_t)(end - p);
+    if (n >= sizeof(buf)) return -1;
+    memcpy(buf, p, n);
+    buf[n] = '\0';
+    char *stop;
+    *out = strtod(buf, &stop);
+    return stop == buf + n && n > 0 ? 0 : -1;
+}
+
+// 返回 0 快速路径成功，1 交给 strtod（含 nan / inf 与非数字）
+static int parse_fast(const char *p, const char *end, double *out) {
+    int neg = 0;
+    if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+    uint64_t mant = 0;
+    int digits = 0, exp10 = 0, any = 0;
+    for (; p < end && (unsigned)(*p - '0') < 10; p++, any = 1) {
+        if (mant == 0 && *p == '0') continue;
+        if (digits < 19) { mant = mant * 10 + (uint64_t)(*p - '0'); digits++; }
+        else exp10++;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && (unsigned)(*p - '0') < 10; p++, any = 1) {
+            if (mant == 0 && *p == '0') { exp10--; continue; }
+            if (digits < 19) { mant = mant * 10 + (uint64_t)(*p - '0'); digits++; exp10--; }
+        }
+    }
+    if (!any) return 1;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        int eneg = 0, e = 0, edig = 0;
+        if (p < end && (*p == '-' || *p == '+')) eneg = *p++ == '-';
+        for (; p < end && (unsigned)(*p - '0') < 10; p++, edig++)
+            if (e < 100000) e = e * 10 + (*p - '0');
+        if (!edig) return 1;
+        exp10 += eneg ? -e : e;
+    }
+    if (p != end) return 1;
+    if (digits == 19) return 1;             // 可能截断了有效数字
+    if (mant == 0) { *out = neg ? -0.0 : 0.0; return 0; }
+    // Clinger 快速路径：尾数与 10 的幂都精确时，一次乘除即正确舍入
+    if (mant > (1ULL << 53) || exp10 < -22 || exp10 > 22) return 1;
+    double v = (double)mant;
+    v = exp10 < 0 ? v / k_pow10[-exp10] : v * k_pow10[exp10];
+    *out = neg ? -v : v;
+    return 0;
+}
+
+int qsm_parse_double(const char *p, const char *end, double *out) {
+    return parse_fast(p, end, out) == 0 ? 0 : parse_slow(p, end, out);
+}
+
+// ==================== 表 ====================
+
+static const char *trim_left(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+static const char *trim_right(const char *p, const char *end) {
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) end--;
+    return end;
+}
+
+// 首行只要有一个字段不是数字就当表头
+static int is_header(const char *p, const char *eol) {
+    while (p <= eol) {
+        const char *q = memchr(p, ',', (size_t)(eol - p));
+        if (!q) q = eol;
+        double v;
+        const char *a = trim_left(p, q), *b = trim_right(a, q);
+        if (a == b || qsm_parse_double(a, b, &v) != 0) return 1;
+        p = q + 1;
+    }
+    return 0;
+}
+
+int qsm_csv_parse(const char *p, size_t n, QsmCsv *out) {
+    memset(out, 0, sizeof(*out));
+    const char *end = p + n;
+    if (n >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) p += 3;  // UTF-8 BOM
+    while (p < end && (*p == '\n' || *p == '\r')) p++;
+    if (p >= end) return -1;
+
+    const char *eol = memchr(p, '\n', (size_t)(end - p));
+    if (!eol) eol = end;
+    const char *first_end = trim_right(p, eol);
+    size_t cols = 1;
+    for (const char *q = p; q < first_end; q++) cols += *q == ',';
+    int header = is_header(p, first_end);
+    size_t max_rows = count_newlines(p, (size_t)(end - p)) + 1 - (size_t)header;
+
+    out->cols = cols;
+    out->stride = (max_rows + ROW_PAD - 1) / ROW_PAD * ROW_PAD;
+    out->names = calloc(cols, sizeof(char *));
+    size_t bytes = cols * out->stride * sizeof(double);
+    out->data = aligned_alloc(COL_ALIGN, (bytes + COL_ALIGN - 1) / COL_ALIGN * COL_ALIGN);
+    if (!out->names || !out->data) { qsm_csv_free(out); return -1; }
+    memset(out->data, 0, bytes);
+
+    const char *q = p;
+    for (size_t j = 0; j < cols; j++) {
+        char tmp[32];
+        if (header) {
+            const char *c = memchr(q, ',', (size_t)(first_end - q));
+            if (!c) c = first_end;
+            const char *a = trim_left(q, c), *b = trim_right(a, c);
+            out->names[j] = strndup(a, (size_t)(b - a));
+            q = c + 1;
+        } else {
+            snprintf(tmp, sizeof(tmp), "c%zu", j);
+            out->names[j] = strdup(tmp);
+        }
+    }
+    if (header) p = eol < end ? eol + 1 : end;
+
+    size_t row = 0;
+    while (p < end) {
+        eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        const char *le = trim_right(p, eol);
+        if (le > p) {
+            size_t j = 0;
+            for (const char *f = p; j < cols; j++) {
+                double *dst = out->data + j * out->stride + row;
+                if (f > le) { *dst = NAN; out->bad++; continue; }
+                const char *c = memchr(f, ',', (size_t)(le - f));
+                if (!c) c = le;
+                const char *a = trim_left(f, c), *b = trim_right(a, c);
+                if (parse_fast(a, b, dst) != 0) {
+                    out->slow++;
+                    if (parse_slow(a, b, dst) != 0) { *dst = NAN; out->bad++; }
+                }
+                f = c + 1;
+                if (j + 1 == cols && c < le) out->bad++;   // 多出的字段不收
+            }
+            row++;
+        }
+        p = eol + 1;
+    }
+    out->rows = row;
+    return row ? 0 : -1;
+}
+
+int qsm_csv_load(const char *path, QsmCsv *out) {
+    QsmMap m;
+    memset(out, 0, sizeof(*out));
+    if (qsm_map_file(path, &m) != 0) return -1;
+    int r = qsm_csv_parse(m.data, m.size, out);
+    qsm_unmap_file(&m);
+    return r;
+}
+
+void qsm_csv_free(QsmCsv *csv) {
+    if (csv->names)
+        for (size_t j = 0; j < csv->cols; j++) free(csv->names[j]);
+    free(csv->names);
+    free(csv->data);
+    memset(csv, 0, sizeof(*csv));
+}
+
+int qsm_csv_find(const QsmCsv *csv, const char *name) {
+    for (size_t j = 0; j < csv->cols; j++)
+        if (strcmp(csv->names[j], name) == 0) return (int)j;
+    return -1;
+}
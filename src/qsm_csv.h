@@ -0,0 +1,43 @@
+/*
+ * qsm_csv.h — 模型训练特征 CSV 加载器
+ *
+ * models 目录下各模型的 train_data.csv 是带表头的纯数值表（x1,x2,y）。
+ * 加载时 mmap 整个文件，用 SIMD 数出行数一次分配好，再单遍解析字段；
+ * 浮点先走精确的快速路径（≤19 位有效数字、10 的幂可精确表示时直接乘除），
+ * 其余才回退 strtod，结果与 strtod 逐位一致。
+ *
+ * 数据按列存放（column-major），每列起点 64 字节对齐，列长按 8 个 double 补齐，
+ * 可直接交给按批计算的线路求值循环。
+ */
+#ifndef QSM_CSV_H
+#define QSM_CSV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    size_t rows;
+    size_t cols;
+    size_t stride;              // 列间距（元素数），rows 向上取 8 的倍数，补齐部分为 0
+    char **names;               // [cols] 表头；没有表头时为 "c0", "c1", ...
+    double *data;               // 第 j 列起于 data + j * stride
+    uint64_t bad;               // 无法解析或缺失的字段数（记为 NaN）
+    uint64_t slow;              // 回退 strtod 的字段数
+} QsmCsv;
+
+// 0 成功，-1 无法读取或没有数据行
+int  qsm_csv_load(const char *path, QsmCsv *out);
+int  qsm_csv_parse(const char *p, size_t n, QsmCsv *out);
+void qsm_csv_free(QsmCsv *csv);
+
+// 按表头名找列，找不到返回 -1
+int qsm_csv_find(const QsmCsv *csv, const char *name);
+
+static inline const double *qsm_csv_col(const QsmCsv *csv, size_t j) {
+    return csv->data + j * csv->stride;
+}
+
+// 单个字段的快速解析（也供别的数值文本复用）；[p, end) 须是完整数字，失败返回 -1
+int qsm_parse_double(const char *p, const char *end, double *out);
+
+#endif
@@ -0,0 +1,426 @@
+/*
+ * qsm_jsonl.c — 语料 JSONL 公共读取层实现
+ */
+#define _GNU_SOURCE
+#include "qsm_jsonl.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ==================== 文件映射 ====================
+
+int qsm_map_file(const char *path, QsmMap *m) {
+    m->data = NULL;
+    m->size = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return -1; }
+    if (st.st_size == 0) { close(fd); m->data = ""; return 0; }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return -1;
+    madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+    m->data = (const char *)p;
+    m->size = (size_t)st.st_size;
+    return 0;
+}
+
+void qsm_unmap_file(QsmMap *m) {
+    if (m->size) munmap((void *)m->data, m->size);
+    m->data = NULL;
+    m->size = 0;
+}
+
+static int cmp_str(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+typedef struct {
+    char **v;
+    int n, cap;
+} PathList;
+
+static int push_path(PathList *l, char *p) {
+    if (!p) return -1;
+    if (l->n == l->cap) {
+        int cap = l->cap ? l->cap * 2 : 64;
+        char **v = realloc(l->v, cap * sizeof(char *));
+        if (!v) { free(p); return -1; }
+        l->v = v;
+        l->cap = cap;
+    }
+    l->v[l->n++] = p;
+    return 0;
+}
+
+// 递归收集 dir 下的 *.jsonl；跳过以 '.' 开头的项（.git 之类）。打不开的子目录算失败，不悄悄漏掉
+static int walk_dir(const char *dir, PathList *l) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "[JSONL] 无法打开目录: %s\n", dir);
+        return -1;
+    }
+    int rc = 0;
+    struct dirent *e;
+    while (rc == 0 && (e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        size_t len = strlen(e->d_name);
+        char *full = malloc(strlen(dir) + len + 2);
+        if (!full) { rc = -1; break; }
+        sprintf(full, "%s/%s", dir, e->d_name);
+        int is_dir = e->d_type == DT_DIR, is_reg = e->d_type == DT_REG;
+        if (e->d_type == DT_UNKNOWN || e->d_type == DT_LNK) {
+            struct stat st;
+            if (stat(full, &st) == 0) {
+                is_dir = S_ISDIR(st.st_mode);
+                is_reg = S_ISREG(st.st_mode);
+            }
+        }
+        if (is_dir) {
+            rc = walk_dir(full, l);
+            free(full);
+        } else if (is_reg && len >= 7 && strcmp(e->d_name + len - 6, ".jsonl") == 0) {
+            rc = push_path(l, full);
+        } else {
+            free(full);
+        }
+    }
+    closedir(d);
+    return rc;
+}
+
+int qsm_list_jsonl(const char *path, char ***out) {
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+    if (!S_ISDIR(st.st_mode)) {
+        *out = malloc(sizeof(char *));
+        (*out)[0] = strdup(path);
+        return 1;
+    }
+    PathList l = { 0 };
+    if (walk_dir(path, &l) != 0) {
+        qsm_free_list(l.v, l.n);
+        return -1;
+    }
+    qsort(l.v, l.n, sizeof(char *), cmp_str);
+    *out = l.v ? l.v : malloc(sizeof(char *));
+    return l.n;
+}
+
+void qsm_free_list(char **list, int n) {
+    for (int i = 0; i < n; i++) free(list[i]);
+    free(list);
+}
+
+// ==================== 按行切分 ====================
+
+const char *qsm_next_line(const char *p, const char *end, const char **eol) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    if (!nl) { *eol = end; return end; }
+    *eol = nl;
+    return nl + 1;
+}
+
+int qsm_is_blank_line(const char *p, const char *eol) {
+    while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p == eol || *p == '#';
+}
+
+int qsm_make_chunks(const QsmMap *maps, int nfiles, size_t target, QsmChunk **out) {
+    if (target < 4096) target = 4096;
+    int n = 0, cap = 64;
+    QsmChunk *ch = malloc(cap * sizeof(QsmChunk));
+    for (int f = 0; f < nfiles; f++) {
+        const char *p = maps[f].data, *end = p + maps[f].size;
+        while (p < end) {
+            const char *hi = (size_t)(end - p) > target ? p + target : end;
+            if (hi < end) {
+                const char *nl = memchr(hi, '\n', (size_t)(end - hi));
+                hi = nl ? nl + 1 : end;
+            }
+            if (n == cap) { cap *= 2; ch = realloc(ch, cap * sizeof(QsmChunk)); }
+            ch[n].file = f;
+            ch[n].lo = p;
+            ch[n].hi = hi;
+            n++;
+            p = hi;
+        }
+    }
+    *out = ch;
+    return n;
+}
+
+// ==================== JSON 字符串扫描 ====================
+
+typedef struct {
+    const char *p;
+    const char *end;
+    QsmJsonStrFn fn;
+    void *ud;
+    int stopped;
+} JsonScan;
+
+static void skip_ws(JsonScan *s) {
+    while (s->p < s->end && (*s->p == ' ' || *s->p == '\t' || *s->p == '\r' || *s->p == '\n')) s->p++;
+}
+
+// 读字符串体：返回 0 并给出 [lo, hi)，s->p 停在闭引号之后
+static int scan_string(JsonScan *s, const char **lo, const char **hi) {
+    if (s->p >= s->end || *s->p != '"') return -1;
+    const char *q = ++s->p;
+    while (q < s->end) {
+        unsigned char c = (unsigned char)*q;
+        if (c == '"') {
+            *lo = s->p;
+            *hi = q;
+            s->p = q + 1;
+            return 0;
+        }
+        if (c == '\\') {
+            if (q + 1 >= s->end) return -1;
+            char e = q[1];
+            if (e == 'u') {
+                if (q + 6 > s->end) return -1;
+                q += 6;
+                continue;
+            }
+            if (!strchr("\"\\/bfnrt", e)) return -1;
+            q += 2;
+            continue;
+        }
+        if (c < 0x20) return -1;
+        q++;
+    }
+    return -1;
+}
+
+static int scan_value(JsonScan *s, const char *key, size_t klen, int depth);
+
+static int scan_object(JsonScan *s, int depth) {
+    s->p++;
+    skip_ws(s);
+    if (s->p < s->end && *s->p == '}') { s->p++; return 0; }
+    for (;;) {
+        const char *klo, *khi;
+        skip_ws(s);
+        if (scan_string(s, &klo, &khi) != 0) return -1;
+        skip_ws(s);
+        if (s->p >= s->end || *s->p != ':') return -1;
+        s->p++;
+        skip_ws(s);
+        if (scan_value(s, klo, (size_t)(khi - klo), depth) != 0) return -1;
+        if (s->stopped) return 0;
+        skip_ws(s);
+        if (s->p >= s->end) return -1;
+        if (*s->p == ',') { s->p++; continue; }
+        if (*s->p == '}') { s->p++; return 0; }
+        return -1;
+    }
+}
+
+static int scan_array(JsonScan *s, const char *key, size_t klen, int depth) {
+    s->p++;
+    skip_ws(s);
+    if (s->p < s->end && *s->p == ']') { s->p++; return 0; }
+    for (;;) {
+        skip_ws(s);
+        if (scan_value(s, key, klen, depth) != 0) return -1;
+        if (s->stopped) return 0;
+        skip_ws(s);
+        if (s->p >= s->end) return -1;
+        if (*s->p == ',') { s->p++; continue; }
+        if (*s->p == ']') { s->p++; return 0; }
+        return -1;
+    }
+}
+
+static int scan_value(JsonScan *s, const char *key, size_t klen, int depth) {
+    if (s->p >= s->end || depth > 64) return -1;
+    char c = *s->p;
+    if (c == '{') return scan_object(s, depth + 1);
+    if (c == '[') return scan_array(s, key, klen, depth);
+    if (c == '"') {
+        const char *lo, *hi;
+        if (scan_string(s, &lo, &hi) != 0) return -1;
+        if (s->fn && s->fn(s->ud, key, klen, lo, (size_t)(hi - lo), depth)) s->stopped = 1;
+        return 0;
+    }
+    // 数字 / true / false / null：只校验字符集，不求值
+    const char *start = s->p;
+    while (s->p < s->end && strchr("+-0123456789.eEtrufalsn", *s->p)) s->p++;
+    return s->p == start ? -1 : 0;
+}
+
+int qsm_json_scan(const char *p, const char *end, QsmJsonStrFn fn, void *ud) {
+    JsonScan s = { p, end, fn, ud, 0 };
+    skip_ws(&s);
+    if (s.p >= s.end || *s.p != '{') return -1;
+    if (scan_object(&s, 1) != 0) return -1;
+    if (s.stopped) return 1;
+    skip_ws(&s);
+    return s.p == s.end ? 0 : -1;
+}
+
+static int hexval(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int read_u4(const char *p, const char *end, uint32_t *v) {
+    if (p + 4 > end) return -1;
+    uint32_t x = 0;
+    for (int i = 0; i < 4; i++) {
+        int h = hexval(p[i]);
+        if (h < 0) return -1;
+        x = (x << 4) | (uint32_t)h;
+    }
+    *v = x;
+    return 0;
+}
+
+size_t qsm_json_unescape(const char *raw, size_t rlen, char *out) {
+    const char *p = raw, *end = raw + rlen;
+    char *o = out;
+    while (p < end) {
+        const char *bs = memchr(p, '\\', (size_t)(end - p));
+        if (!bs) {
+            memcpy(o, p, (size_t)(end - p));
+            o += end - p;
+            break;
+        }
+        memcpy(o, p, (size_t)(bs - p));
+        o += bs - p;
+        p = bs + 1;
+        if (p >= end) break;
+        char e = *p++;
+        switch (e) {
+        case 'n': *o++ = '\n'; break;
+        case 't': *o++ = '\t'; break;
+        case 'r': *o++ = '\r'; break;
+        case 'b': *o++ = '\b'; break;
+        case 'f': *o++ = '\f'; break;
+        case 'u': {
+            uint32_t cp;
+            if (read_u4(p, end, &cp) != 0) { *o++ = '?'; break; }
+            p += 4;
+            if (cp >= 0xD800 && cp <= 0xDBFF && p + 6 <= end && p[0] == '\\' && p[1] == 'u') {
+                uint32_t lo;
+                if (read_u4(p + 2, end, &lo) == 0 && lo >= 0xDC00 && lo <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    p += 6;
+                }
+            }
+            if (cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD;
+            o += qsm_utf8_put(cp, o);
+            break;
+        }
+        default: *o++ = e; break;
+        }
+    }
+    return (size_t)(o - out);
+}
+
+size_t qsm_json_escape(const char *s, size_t len, char *out) {
+    static const char hex[] = "0123456789abcdef";
+    char *o = out;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') { *o++ = '\\'; *o++ = (char)c; }
+        else if (c == '\n') { *o++ = '\\'; *o++ = 'n'; }
+        else if (c == '\t') { *o++ = '\\'; *o++ = 't'; }
+        else if (c == '\r') { *o++ = '\\'; *o++ = 'r'; }
+        else if (c < 0x20) {
+            *o++ = '\\'; *o++ = 'u'; *o++ = '0'; *o++ = '0';
+            *o++ = hex[c >> 4]; *o++ = hex[c & 15];
+        }
+        else *o++ = (char)c;
+    }
+    return (size_t)(o - out);
+}
+
+// ==================== UTF-8 与字符分类 ====================
+
+int qsm_utf8_next(const char *p, const char *end, uint32_t *cp) {
+    const unsigned char *u = (const unsigned char *)p;
+    size_t avail = (size_t)(end - p);
+    unsigned char c = u[0];
+    if (c < 0x80) { *cp = c; return 1; }
+    int n;
+    uint32_t v;
+    if ((c & 0xE0) == 0xC0) { n = 2; v = c & 0x1F; }
+    else if ((c & 0xF0) == 0xE0) { n = 3; v = c & 0x0F; }
+    else if ((c & 0xF8) == 0xF0) { n = 4; v = c & 0x07; }
+    else { *cp = 0xFFFD; return 1; }
+    if (avail < (size_t)n) { *cp = 0xFFFD; return 1; }
+    for (int i = 1; i < n; i++) {
+        if ((u[i] & 0xC0) != 0x80) { *cp = 0xFFFD; return 1; }
+        v = (v << 6) | (u[i] & 0x3F);
+    }
+    *cp = v;
+    return n;
+}
+
+int qsm_utf8_put(uint32_t cp, char *out) {
+    unsigned char *o = (unsigned char *)out;
+    if (cp < 0x80) { o[0] = (unsigned char)cp; return 1; }
+    if (cp < 0x800) {
+        o[0] = (unsigned char)(0xC0 | (cp >> 6));
+        o[1] = (unsigned char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        o[0] = (unsigned char)(0xE0 | (cp >> 12));
+        o[1] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+        o[2] = (unsigned char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    o[0] = (unsigned char)(0xF0 | (cp >> 18));
+    o[1] = (unsigned char)(0x80 | ((cp >> 12) & 0x3F));
+    o[2] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+    o[3] = (unsigned char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+QsmScript qsm_script_of(uint32_t cp) {
+    if (qsm_is_yi_pua(cp) || (cp >= 0xA000 && cp <= 0xA4CF)) return QSM_SCRIPT_YI;
+    if ((cp >= 0x4E00 && cp <= 0x9FFF) || (cp >= 0x3400 && cp <= 0x4DBF) ||
+        (cp >= 0x20000 && cp <= 0x2EBEF) || (cp >= 0xF900 && cp <= 0xFAFF)) return QSM_SCRIPT_HAN;
+    if ((cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z') ||
+        (cp >= 0xC0 && cp <= 0x24F && cp != 0xD7 && cp != 0xF7)) return QSM_SCRIPT_LATIN;
+    if (cp >= '0' && cp <= '9') return QSM_SCRIPT_DIGIT;
+    if (cp == ' ' || cp == '\t' || cp == '\n' || cp == '\r' || cp == 0x3000 || cp == 0xA0) return QSM_SCRIPT_SPACE;
+    if ((cp >= 0x21 && cp <= 0x7E) || (cp >= 0x3000 && cp <= 0x303F) ||
+        (cp >= 0xFF00 && cp <= 0xFFEF) || (cp >= 0x2000 && cp <= 0x206F)) return QSM_SCRIPT_PUNCT;
+    return QSM_SCRIPT_OTHER;
+}
+
+// ==================== 哈希 ====================
+
+uint64_t qsm_hash64(const void *p, size_t len, uint64_t seed) {
+    const unsigned char *u = p;
+    uint64_t h = seed ^ (0x9E3779B97F4A7C15ULL * (len + 1));
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, u, 8);
+        h = qsm_mix64(h ^ w) + 0x9E3779B97F4A7C15ULL;
+        u += 8;
+        len -= 8;
+    }
+    uint64_t w = 0;
+    memcpy(&w, u, len);
+    return qsm_mix64(h ^ w ^ ((uint64_t)len << 56));
+}
+
+int qsm_default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : (n > 64 ? 64 : (int)n);
+}
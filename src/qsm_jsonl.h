@@ -0,0 +1,106 @@
+/*
+ * qsm_jsonl.h — 语料 JSONL 公共读取层
+ *
+ * data 目录下 *.jsonl 上的各原生工具共用这一层：mmap 映射、按行切分、
+ * 最小 JSON 扫描（只关心字符串值）、UTF-8 解码与彝文 PUA 判定。
+ * 不做完整 JSON 解析，不分配 DOM；调用方在回调里直接拿原始切片。
+ */
+#ifndef QSM_JSONL_H
+#define QSM_JSONL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ==================== 文件映射 ====================
+
+typedef struct {
+    const char *data;
+    size_t size;
+} QsmMap;
+
+int  qsm_map_file(const char *path, QsmMap *m);
+void qsm_unmap_file(QsmMap *m);
+
+// 目录 → 递归收集的 *.jsonl 路径（按路径排序，跳过 . 开头的项）；普通文件 → 自身。
+// 返回条数，失败（含某个子目录打不开）-1
+int  qsm_list_jsonl(const char *path, char ***out);
+void qsm_free_list(char **list, int n);
+
+// ==================== 按行切分 ====================
+
+// 返回 [p, *eol) 为一行（不含 '\n'），函数值为下一行起点
+const char *qsm_next_line(const char *p, const char *end, const char **eol);
+
+// 空行与 '#' 注释行（部分数据文件带表头说明）不算记录
+int qsm_is_blank_line(const char *p, const char *eol);
+
+// 多文件按行对齐切块，供线程分片；块不跨文件
+typedef struct {
+    int file;
+    const char *lo;
+    const char *hi;
+} QsmChunk;
+
+int qsm_make_chunks(const QsmMap *maps, int nfiles, size_t target, QsmChunk **out);
+
+// ==================== JSON 字符串扫描 ====================
+
+// key 为最近一层对象键（数组元素沿用外层键），raw 为未反转义的字符串体。
+// depth 为对象嵌套深度（顶层对象内为 1）。返回非 0 提前终止扫描。
+typedef int (*QsmJsonStrFn)(void *ud, const char *key, size_t klen,
+                            const char *raw, size_t rlen, int depth);
+
+// 0=完整扫描，1=回调提前终止，-1=格式错误
+int qsm_json_scan(const char *p, const char *end, QsmJsonStrFn fn, void *ud);
+
+// 反转义到 out（容量不小于 rlen 即可，\uXXXX 展开后不会变长），返回字节数
+size_t qsm_json_unescape(const char *raw, size_t rlen, char *out);
+
+// 按需转义写回；只有 '"' '\\' 与控制字符需要处理，返回写入字节数（out 容量 6*len）
+size_t qsm_json_escape(const char *s, size_t len, char *out);
+
+static inline int qsm_json_needs_escape(const char *s, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c < 0x20 || c == '"' || c == '\\') return 1;
+    }
+    return 0;
+}
+
+// ==================== UTF-8 与字符分类 ====================
+
+// 解码一个码点，返回消耗字节数（>=1）；非法序列返回 1 并给出 U+FFFD
+int qsm_utf8_next(const char *p, const char *end, uint32_t *cp);
+int qsm_utf8_put(uint32_t cp, char *out);
+
+typedef enum {
+    QSM_SCRIPT_YI = 0,   // 滇川黔贵通用彝文（PUA 平面 15）与规范彝文音节
+    QSM_SCRIPT_HAN,
+    QSM_SCRIPT_LATIN,
+    QSM_SCRIPT_DIGIT,
+    QSM_SCRIPT_SPACE,
+    QSM_SCRIPT_PUNCT,
+    QSM_SCRIPT_OTHER,
+    QSM_SCRIPT_COUNT
+} QsmScript;
+
+static inline int qsm_is_yi_pua(uint32_t cp) {
+    return cp >= 0xF0000 && cp <= 0xFFFFD;
+}
+
+QsmScript qsm_script_of(uint32_t cp);
+
+// ==================== 哈希 ====================
+
+static inline uint64_t qsm_mix64(uint64_t x) {
+    x ^= x >> 33; x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33; x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t qsm_hash64(const void *p, size_t len, uint64_t seed);
+
+int qsm_default_threads(void);
+
+#endif
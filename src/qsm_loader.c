@@ -0,0 +1,322 @@
+/*
+ * qsm_loader.c — 训练数据预取加载器实现
+ */
+#define _GNU_SOURCE
+#include "qsm_loader.h"
+#include "qsm_jsonl.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 自旋一小会儿再让出 CPU；等待通常只有几微秒
+static void backoff(int *spins) {
+    if (++*spins < 64) return;
+    if (*spins < 256) { sched_yield(); return; }
+    struct timespec ts = { 0, 50000 };
+    nanosleep(&ts, NULL);
+}
+
+// ==================== 记录索引 ====================
+
+typedef struct {
+    uint64_t off;
+    uint32_t len;
+    uint32_t file;
+} RecRef;
+
+typedef struct {
+    atomic_ullong seq;
+    uint32_t epoch;
+    uint32_t n;
+    uint32_t *rec;
+    uint32_t *off;
+    char *text;
+    size_t text_cap;
+} Slot;
+
+struct QsmLoader {
+    QsmLoaderConfig cfg;
+    char **files;
+    int nfiles;
+    QsmMap *maps;
+    RecRef *recs;
+    uint64_t nrec, rec_cap;
+    uint64_t per_epoch;         // 每个 epoch 的批数
+    uint64_t total;             // 总批数，epochs 为 0 时为 UINT64_MAX
+    int perm_bits;              // Feistel 半宽
+    Slot *slots;
+    pthread_t *threads;
+    atomic_ullong next_batch;   // 工作线程领取
+    uint64_t consumed;          // 消费方下一个要取的批
+    atomic_int stop;
+    // 指标
+    uint64_t stalls, stall_ns, max_stall_ns, batches;
+    atomic_ullong producer_wait_ns, decode_ns, bytes;
+};
+
+static void index_file(QsmLoader *L, int f) {
+    const char *base = L->maps[f].data, *end = base + L->maps[f].size;
+    for (const char *p = base; p < end;) {
+        const char *eol;
+        const char *nx = qsm_next_line(p, end, &eol);
+        if (!qsm_is_blank_line(p, eol)) {
+            if (L->nrec == L->rec_cap) {
+                L->rec_cap = L->rec_cap ? L->rec_cap * 2 : 1 << 12;
+                L->recs = realloc(L->recs, L->rec_cap * sizeof(RecRef));
+            }
+            RecRef *r = &L->recs[L->nrec++];
+            r->off = (uint64_t)(p - base);
+            r->len = (uint32_t)(eol - p);
+            r->file = (uint32_t)f;
+        }
+        p = nx;
+    }
+}
+
+// ==================== Feistel 置换 ====================
+//
+// 在 [0, 2^(2*bits)) 上做 4 轮平衡 Feistel，再对 >= nrec 的结果循环迭代
+// （cycle walking）。定义域不超过 4*nrec，平均迭代不到 4 次。
+
+static uint64_t feistel(uint64_t x, int bits, uint64_t key) {
+    uint64_t mask = ((uint64_t)1 << bits) - 1;
+    uint64_t l = x >> bits, r = x & mask;
+    for (int round = 0; round < 4; round++) {
+        uint64_t t = l ^ (qsm_mix64(r ^ (key + (uint64_t)round * 0x9e3779b97f4a7c15ULL)) & mask);
+        l = r;
+        r = t;
+    }
+    return (l << bits) | r;
+}
+
+uint64_t qsm_loader_permute(const QsmLoader *L, uint32_t epoch, uint64_t i) {
+    uint64_t key = qsm_mix64(L->cfg.seed ^ qsm_mix64((uint64_t)epoch + 1));
+    uint64_t x = i;
+    do x = feistel(x, L->perm_bits, key); while (x >= L->nrec);
+    return x;
+}
+
+// ==================== 解码 ====================
+
+typedef struct {
+    Slot *s;
+    size_t len;
+    const char *prompt, *response;          // 原始切片（未反转义）
+    size_t plen, rlen;
+    const char *instr;
+    size_t ilen;
+    int last_user;
+} DecodeCtx;
+
+static int on_string(void *ud, const char *key, size_t klen, const char *raw, size_t rlen, int depth) {
+    DecodeCtx *c = ud;
+    if (!key) return 0;
+    if (depth >= 2) {
+        if (klen == 4 && memcmp(key, "role", 4) == 0) {
+            c->last_user = rlen == 4 && memcmp(raw, "user", 4) == 0 ? 1 :
+                           rlen == 9 && memcmp(raw, "assistant", 9) == 0 ? 0 : -1;
+        } else if (klen == 7 && memcmp(key, "content", 7) == 0) {
+            if (c->last_user == 1 && !c->prompt) { c->prompt = raw; c->plen = rlen; }
+            else if (c->last_user == 0 && !c->response) { c->response = raw; c->rlen = rlen; }
+        }
+        return 0;
+    }
+    if (klen == 5 && memcmp(key, "input", 5) == 0) { c->prompt = raw; c->plen = rlen; }
+    else if (klen == 6 && memcmp(key, "output", 6) == 0) { c->response = raw; c->rlen = rlen; }
+    else if (klen == 11 && memcmp(key, "instruction", 11) == 0) { c->instr = raw; c->ilen = rlen; }
+    return 0;
+}
+
+static void put_text(DecodeCtx *c, const char *raw, size_t rlen, const char *raw2, size_t rlen2) {
+    Slot *s = c->s;
+    size_t need = c->len + rlen + rlen2 + 2;
+    if (need > s->text_cap) {
+        while (need > s->text_cap) s->text_cap = s->text_cap ? s->text_cap * 2 : 1 << 16;
+        s->text = realloc(s->text, s->text_cap);
+    }
+    if (raw) c->len += qsm_json_unescape(raw, rlen, s->text + c->len);
+    if (raw && raw2) s->text[c->len++] = '\n';
+    if (raw2) c->len += qsm_json_unescape(raw2, rlen2, s->text + c->len);
+    s->text[c->len++] = '\0';
+}
+
+static void decode_batch(QsmLoader *L, Slot *s, uint64_t b) {
+    uint32_t bs = L->cfg.batch_size;
+    uint64_t epoch = b / L->per_epoch, first = (b % L->per_epoch) * bs;
+    uint32_t n = (uint32_t)(L->nrec - first < bs ? L->nrec - first : bs);
+    s->epoch = (uint32_t)epoch;
+    s->n = n;
+    DecodeCtx c;
+    memset(&c, 0, sizeof(c));
+    c.s = s;
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t id = qsm_loader_permute(L, (uint32_t)epoch, first + i);
+        const RecRef *r = &L->recs[id];
+        const char *p = L->maps[r->file].data + r->off;
+        c.prompt = c.response = c.instr = NULL;
+        c.plen = c.rlen = c.ilen = 0;
+        c.last_user = -1;
+        qsm_json_scan(p, p + r->len, on_string, &c);
+        s->rec[i] = (uint32_t)id;
+        s->off[2 * i] = (uint32_t)c.len;
+        if (c.instr) put_text(&c, c.instr, c.ilen, c.prompt, c.plen);
+        else put_text(&c, c.prompt, c.plen, NULL, 0);
+        s->off[2 * i + 1] = (uint32_t)c.len;
+        put_text(&c, c.response, c.rlen, NULL, 0);
+        bytes += r->len;
+    }
+    s->off[2 * n] = (uint32_t)c.len;
+    atomic_fetch_add(&L->bytes, bytes);
+}
+
+static void *worker(void *arg) {
+    QsmLoader *L = arg;
+    for (;;) {
+        uint64_t b = atomic_fetch_add(&L->next_batch, 1);
+        if (b >= L->total || atomic_load(&L->stop)) break;
+        Slot *s = &L->slots[b % (uint64_t)L->cfg.ring];
+        // 等消费方归还第 b - ring 批
+        uint64_t t0 = now_ns();
+        int spins = 0;
+        while (atomic_load_explicit(&s->seq, memory_order_acquire) != 2 * b) {
+            if (atomic_load(&L->stop)) return NULL;
+            backoff(&spins);
+        }
+        uint64_t t1 = now_ns();
+        decode_batch(L, s, b);
+        atomic_fetch_add(&L->producer_wait_ns, t1 - t0);
+        atomic_fetch_add(&L->decode_ns, now_ns() - t1);
+        atomic_store_explicit(&s->seq, 2 * b + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+// ==================== 打开 / 关闭 ====================
+
+QsmLoader *qsm_loader_open(const QsmLoaderConfig *cfg) {
+    QsmLoader *L = calloc(1, sizeof(QsmLoader));
+    L->cfg = *cfg;
+    if (!L->cfg.batch_size) L->cfg.batch_size = 32;
+    if (L->cfg.threads < 1) L->cfg.threads = 2;
+    if (L->cfg.ring < 2) L->cfg.ring = 4;
+    for (int i = 0; i < cfg->npaths; i++) {
+        char **list;
+        int n = qsm_list_jsonl(cfg->paths[i], &list);
+        if (n < 0) { qsm_loader_close(L); return NULL; }
+        L->files = realloc(L->files, (L->nfiles + n) * sizeof(char *));
+        memcpy(L->files + L->nfiles, list, n * sizeof(char *));
+        L->nfiles += n;
+        free(list);
+    }
+    L->maps = calloc(L->nfiles ? L->nfiles : 1, sizeof(QsmMap));
+    for (int f = 0; f < L->nfiles; f++) {
+        if (qsm_map_file(L->files[f], &L->maps[f]) != 0) { qsm_loader_close(L); return NULL; }
+        index_file(L, f);
+    }
+    uint32_t bs = L->cfg.batch_size;
+    L->per_epoch = L->cfg.drop_last ? L->nrec / bs : (L->nrec + bs - 1) / bs;
+    if (L->per_epoch == 0) { qsm_loader_close(L); return NULL; }
+    L->total = L->cfg.epochs ? L->per_epoch * L->cfg.epochs : UINT64_MAX;
+    int bits = 1;
+    while (((uint64_t)1 << (2 * bits)) < L->nrec) bits++;
+    L->perm_bits = bits;
+
+    L->slots = calloc(L->cfg.ring, sizeof(Slot));
+    for (int i = 0; i < L->cfg.ring; i++) {
+        atomic_init(&L->slots[i].seq, 2 * (uint64_t)i);
+        L->slots[i].rec = malloc(bs * sizeof(uint32_t));
+        L->slots[i].off = malloc((2 * (size_t)bs + 1) * sizeof(uint32_t));
+    }
+    atomic_init(&L->next_batch, 0);
+    atomic_init(&L->stop, 0);
+    atomic_init(&L->producer_wait_ns, 0);
+    atomic_init(&L->decode_ns, 0);
+    atomic_init(&L->bytes, 0);
+    L->threads = malloc(L->cfg.threads * sizeof(pthread_t));
+    for (int t = 0; t < L->cfg.threads; t++) pthread_create(&L->threads[t], NULL, worker, L);
+    return L;
+}
+
+void qsm_loader_close(QsmLoader *L) {
+    if (!L) return;
+    if (L->threads) {
+        atomic_store(&L->stop, 1);
+        for (int t = 0; t < L->cfg.threads; t++) pthread_join(L->threads[t], NULL);
+        free(L->threads);
+    }
+    if (L->slots) {
+        for (int i = 0; i < L->cfg.ring; i++) {
+            free(L->slots[i].rec);
+            free(L->slots[i].off);
+            free(L->slots[i].text);
+        }
+        free(L->slots);
+    }
+    for (int f = 0; f < L->nfiles; f++) qsm_unmap_file(&L->maps[f]);
+    free(L->maps);
+    if (L->files) qsm_free_list(L->files, L->nfiles);
+    free(L->recs);
+    free(L);
+}
+
+uint64_t qsm_loader_records(const QsmLoader *L) {
+    return L->nrec;
+}
+
+uint64_t qsm_loader_batches_per_epoch(const QsmLoader *L) {
+    return L->per_epoch;
+}
+
+// ==================== 消费 ====================
+
+int qsm_loader_next(QsmLoader *L, QsmBatch *out) {
+    uint64_t b = L->consumed;
+    if (b >= L->total) return 0;
+    Slot *s = &L->slots[b % (uint64_t)L->cfg.ring];
+    if (atomic_load_explicit(&s->seq, memory_order_acquire) != 2 * b + 1) {
+        uint64_t t0 = now_ns();
+        int spins = 0;
+        while (atomic_load_explicit(&s->seq, memory_order_acquire) != 2 * b + 1) backoff(&spins);
+        uint64_t dt = now_ns() - t0;
+        L->stalls++;
+        L->stall_ns += dt;
+        if (dt > L->max_stall_ns) L->max_stall_ns = dt;
+    }
+    out->index = b;
+    out->epoch = s->epoch;
+    out->n = s->n;
+    out->rec = s->rec;
+    out->off = s->off;
+    out->text = s->text;
+    L->consumed = b + 1;
+    L->batches++;
+    return 1;
+}
+
+void qsm_loader_release(QsmLoader *L, const QsmBatch *b) {
+    Slot *s = &L->slots[b->index % (uint64_t)L->cfg.ring];
+    atomic_store_explicit(&s->seq, 2 * (b->index + (uint64_t)L->cfg.ring), memory_order_release);
+}
+
+void qsm_loader_stats(const QsmLoader *L, QsmLoaderStats *out) {
+    QsmLoader *m = (QsmLoader *)L;   // 只读原子计数
+    out->records = L->nrec;
+    out->batches = L->batches;
+    out->stalls = L->stalls;
+    out->stall_ns = L->stall_ns;
+    out->max_stall_ns = L->max_stall_ns;
+    out->producer_wait_ns = atomic_load(&m->producer_wait_ns);
+    out->decode_ns = atomic_load(&m->decode_ns);
+    out->bytes = atomic_load(&m->bytes);
+}
@@ -0,0 +1,81 @@
+/*
+ * qsm_loader.h — 训练数据预取加载器
+ *
+ * 后台线程读取、解码并组批，放进一个无锁的就绪批次环，训练循环只需
+ * qsm_loader_next / qsm_loader_release，不在取批时做任何解析。
+ *
+ * - 记录顺序：每个 epoch 用 (seed, epoch) 生成一个 Feistel 置换，
+ *   第 b 批固定是置换后的第 [b*batch, (b+1)*batch) 条，与线程数无关；
+ * - 环：ring 个槽位，每个槽位一个序号（2b 表示可写第 b 批，2b+1 表示第 b 批就绪），
+ *   工作线程与消费方只靠原子序号交接，不加锁；
+ * - 指标：消费方等待时间（stall）说明训练是否在等 I/O，
+ *   工作线程等待空槽的时间说明预取是否已经领先。
+ *
+ * 每条记录解码为 prompt / response 两段 UTF-8（已反转义，以 '\0' 结尾），
+ * 兼容 messages 与 input/output 两种格式。
+ */
+#ifndef QSM_LOADER_H
+#define QSM_LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    const char *const *paths;   // 目录或 .jsonl 文件
+    int npaths;
+    uint32_t batch_size;        // 默认 32
+    uint64_t seed;
+    uint32_t epochs;            // 0 = 不限
+    int threads;                // 解码线程，默认 2
+    int ring;                   // 槽位数，默认 4（>= 2 即双缓冲）
+    int drop_last;              // 丢弃每个 epoch 末尾不足一批的记录
+} QsmLoaderConfig;
+
+typedef struct {
+    uint64_t index;             // 全局批序号（跨 epoch 连续）
+    uint32_t epoch;
+    uint32_t n;                 // 本批记录数
+    const uint32_t *rec;        // [n] 记录全局序号
+    const uint32_t *off;        // [2n+1] 字符串起点；第 j 段长度 off[j+1]-off[j]-1
+    const char *text;
+} QsmBatch;
+
+static inline const char *qsm_batch_prompt(const QsmBatch *b, uint32_t i, size_t *len) {
+    if (len) *len = b->off[2 * i + 1] - b->off[2 * i] - 1;
+    return b->text + b->off[2 * i];
+}
+
+static inline const char *qsm_batch_response(const QsmBatch *b, uint32_t i, size_t *len) {
+    if (len) *len = b->off[2 * i + 2] - b->off[2 * i + 1] - 1;
+    return b->text + b->off[2 * i + 1];
+}
+
+typedef struct {
+    uint64_t records;           // 索引中的记录数
+    uint64_t batches;           // 已交给消费方的批数
+    uint64_t stalls;            // 取批时需要等待的次数
+    uint64_t stall_ns;          // 消费方累计等待
+    uint64_t max_stall_ns;
+    uint64_t producer_wait_ns;  // 工作线程累计等待空槽（越大说明预取越领先）
+    uint64_t decode_ns;         // 工作线程累计解码耗时
+    uint64_t bytes;             // 已解码的原始行字节数
+} QsmLoaderStats;
+
+typedef struct QsmLoader QsmLoader;
+
+QsmLoader *qsm_loader_open(const QsmLoaderConfig *cfg);
+void qsm_loader_close(QsmLoader *L);
+
+uint64_t qsm_loader_records(const QsmLoader *L);
+uint64_t qsm_loader_batches_per_epoch(const QsmLoader *L);
+
+// 取下一批；全部 epoch 结束返回 0。用完后必须 release 才会被复用
+int  qsm_loader_next(QsmLoader *L, QsmBatch *out);
+void qsm_loader_release(QsmLoader *L, const QsmBatch *b);
+
+void qsm_loader_stats(const QsmLoader *L, QsmLoaderStats *out);
+
+// 第 epoch 个 epoch 中第 i 个位置对应的记录序号（供复现与校验）
+uint64_t qsm_loader_permute(const QsmLoader *L, uint32_t epoch, uint64_t i);
+
+#endif
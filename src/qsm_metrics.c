@@ -0,0 +1,209 @@
+/*
+ * qsm_metrics.c — 共享内存指标页（顺序锁）
+ */
+#define _GNU_SOURCE
+#include "qsm_metrics.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+const double qsm_metrics_bounds[QSM_METRICS_BUCKETS - 1] = {
+    100e-6, 250e-6, 500e-6, 1e-3, 2.5e-3, 5e-3, 10e-3, 25e-3, 50e-3, 0.1, 0.25, 0.5, 1, 2.5, 5
+};
+
+// 同一写者持锁超过 1 秒才去查它是否还活着；确实已死（死在发布中途）才接管
+#define STALE_NS 1000000000L
+
+static uint64_t now_ns(clockid_t clk) {
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// QSM_METRICS 给的路径；没设、为空或为 on 时返回 NULL，表示用默认路径
+static const char *env_path(void) {
+    const char *env = getenv("QSM_METRICS");
+    return env && *env && strcmp(env, "on") != 0 ? env : NULL;
+}
+
+const char *qsm_metrics_path(void) {
+    const char *env = env_path();
+    if (env) return env;
+    return access("/dev/shm", W_OK) == 0 ? "/dev/shm/qsm_metrics" : "/tmp/qsm_metrics";
+}
+
+int qsm_metrics_requested(void) {
+    const char *env = getenv("QSM_METRICS");
+    return env && *env && strcmp(env, "off") != 0;
+}
+
+QsmMetricsPage *qsm_metrics_open(int writable) {
+    const char *path = qsm_metrics_path();
+    if (strcmp(path, "off") == 0) return NULL;
+    int fixed = !env_path();    // 默认路径在全局可写目录里，只认自己建的文件
+    int flags = O_CLOEXEC | (fixed ? O_NOFOLLOW : 0);
+    int fd = writable ? open(path, O_RDWR | O_CREAT | flags, 0600) : open(path, O_RDONLY | flags);
+    if (fd < 0) return NULL;
+    struct stat st;
+    // 扩到整页；多个进程同时创建时各自 ftruncate 到同一长度，互不影响
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (fixed && st.st_uid != geteuid()) ||
+        ((size_t)st.st_size < sizeof(QsmMetricsPage) &&
+         (!writable || ftruncate(fd, sizeof(QsmMetricsPage)) != 0))) {
+        close(fd);
+        return NULL;
+    }
+    QsmMetricsPage *pg = mmap(NULL, sizeof(QsmMetricsPage), writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                              MAP_SHARED, fd, 0);
+    close(fd);
+    if (pg == MAP_FAILED) return NULL;
+    if (writable && __atomic_load_n(&pg->magic, __ATOMIC_ACQUIRE) == 0) {
+        pg->version = QSM_METRICS_VERSION;
+        pg->nslots = QSM_METRICS_SLOTS;
+        pg->slot_size = sizeof(QsmMetricsSlot);
+        uint32_t zero = 0;
+        __atomic_compare_exchange_n(&pg->magic, &zero, QSM_METRICS_MAGIC, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    }
+    if (__atomic_load_n(&pg->magic, __ATOMIC_ACQUIRE) != QSM_METRICS_MAGIC || pg->version != QSM_METRICS_VERSION ||
+        pg->nslots != QSM_METRICS_SLOTS || pg->slot_size != sizeof(QsmMetricsSlot)) {
+        munmap(pg, sizeof(QsmMetricsPage));
+        return NULL;
+    }
+    return pg;
+}
+
+// 持锁进程是否还在；0 表示刚 CAS 成功还没来得及记下 pid，已持锁超过 1 秒说明它死在了这两步之间
+static int owner_alive(uint32_t pid) {
+    return pid && (kill((pid_t)pid, 0) == 0 || errno != ESRCH);
+}
+
+// 把 *word 从偶数 CAS 成奇数并在 *owner 记下本进程；返回自己置上的奇数值，解锁时凭它认领
+static uint32_t lock_word(uint32_t *word, uint32_t *owner) {
+    uint64_t since = 0;
+    uint32_t s, held = 0;
+    for (;;) {
+        s = __atomic_load_n(word, __ATOMIC_RELAXED);
+        if (!(s & 1)) {
+            if (__atomic_compare_exchange_n(word, &s, s + 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                s++;
+                break;
+            }
+            continue;
+        }
+        // 只有同一个奇数值一直不变才算持锁过久，换了写者就重新计时
+        uint64_t t = now_ns(CLOCK_MONOTONIC);
+        if (s != held) {
+            held = s;
+            since = t;
+        } else if (t - since > STALE_NS) {
+            if (owner_alive(__atomic_load_n(owner, __ATOMIC_RELAXED))) {
+                since = t;  // 还活着，只是慢：继续等，隔 1 秒再查
+            } else {
+                // 接管时换成下一个奇数：仍是加锁状态，原持有者迟到的 unlock_word 因值不符而落空
+                uint32_t old = s;
+                if (__atomic_compare_exchange_n(word, &old, s + 2, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                    s += 2;
+                    break;
+                }
+                held = 0;
+            }
+        }
+        sched_yield();
+    }
+    __atomic_store_n(owner, (uint32_t)getpid(), __ATOMIC_RELAXED);
+    // 之后对数据的写不能排到 seq 变奇数之前
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return s;
+}
+
+// 只有锁字仍是自己置上的奇数值才放开；已被接管则什么也不做
+static void unlock_word(uint32_t *word, uint32_t *owner, uint32_t mine) {
+    if (__atomic_load_n(word, __ATOMIC_RELAXED) == mine) __atomic_store_n(owner, 0, __ATOMIC_RELAXED);
+    __atomic_compare_exchange_n(word, &mine, mine + 1, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+QsmMetricsSlot *qsm_metrics_attach(QsmMetricsPage *page, const char *name) {
+    if (!page) return NULL;
+    uint32_t was = lock_word(&page->lock, &page->lock_owner);
+    QsmMetricsSlot *free_slot = NULL, *found = NULL;
+    for (int i = 0; i < QSM_METRICS_SLOTS && !found; i++) {
+        QsmMetricsSlot *s = &page->slot[i];
+        if (!s->name[0]) {
+            if (!free_slot) free_slot = s;
+        } else if (strncmp(s->name, name, sizeof(s->name) - 1) == 0) {
+            found = s;
+        }
+    }
+    if (!found && free_slot) {
+        found = free_slot;
+        uint32_t sw = lock_word(&found->seq, &found->owner);
+        snprintf(found->name, sizeof(found->name), "%s", name);
+        unlock_word(&found->seq, &found->owner, sw);
+    }
+    unlock_word(&page->lock, &page->lock_owner, was);
+    return found;
+}
+
+static inline void add64(uint64_t *p, uint64_t v) {
+    __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+}
+
+void qsm_metrics_publish(QsmMetricsSlot *slot, const QsmMetrics *d) {
+    if (!slot) return;
+    uint32_t was = lock_word(&slot->seq, &slot->owner);
+    QsmMetrics *m = &slot->m;
+    add64(&m->jobs, d->jobs);
+    add64(&m->gates, d->gates);
+    add64(&m->errors, d->errors);
+    add64(&m->cache_hits, d->cache_hits);
+    add64(&m->cache_misses, d->cache_misses);
+    add64(&m->compile_ns, d->compile_ns);
+    add64(&m->sim_ns, d->sim_ns);
+    __atomic_store_n(&m->state_bytes, d->state_bytes, __ATOMIC_RELAXED);
+    __atomic_store_n(&m->queue_depth, d->queue_depth, __ATOMIC_RELAXED);
+    add64(&m->lat_count, d->lat_count);
+    add64(&m->lat_sum_ns, d->lat_sum_ns);
+    for (int b = 0; b < QSM_METRICS_BUCKETS; b++) add64(&m->lat[b], d->lat[b]);
+    __atomic_store_n(&slot->pid, (uint32_t)getpid(), __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->updated_ms, now_ns(CLOCK_REALTIME) / 1000000, __ATOMIC_RELAXED);
+    unlock_word(&slot->seq, &slot->owner, was);
+}
+
+void qsm_metrics_observe(QsmMetrics *m, double sec) {
+    int b = 0;
+    while (b < QSM_METRICS_BUCKETS - 1 && sec > qsm_metrics_bounds[b]) b++;
+    m->lat[b]++;
+    m->lat_count++;
+    m->lat_sum_ns += (uint64_t)(sec * 1e9);
+}
+
+int qsm_metrics_read(const QsmMetricsSlot *slot, QsmMetricsSlot *out) {
+    // 槽位从 name 起全是 8 字节对齐的字，逐字原子读；seq / pid 单独读，owner 读方用不到
+    const size_t off = offsetof(QsmMetricsSlot, name), nw = (sizeof(QsmMetricsSlot) - off) / 8;
+    const uint64_t *src = (const uint64_t *)((const char *)slot + off);
+    uint64_t *dst = (uint64_t *)((char *)out + off);
+    for (int tries = 0; tries < 10000; tries++) {
+        uint32_t s1 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) {
+            sched_yield();
+            continue;
+        }
+        out->pid = __atomic_load_n(&slot->pid, __ATOMIC_RELAXED);
+        for (size_t i = 0; i < nw; i++) dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == s1) {
+            out->seq = s1;
+            return 0;
+        }
+    }
+    return -1;
+}
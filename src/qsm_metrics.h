@@ -0,0 +1,84 @@
+/*
+ * qsm_metrics.h — 共享内存指标页
+ *
+ * 编译器（qentl_compiler）与执行器（qvm_job_server）把计数器发布到一个共享内存文件里，
+ * qsm_metrics_exporter 只读映射同一文件，以 JSON / Prometheus 文本提供给 web/apps/monitor。
+ * 发布方在热路径上只累加自己的局部 QsmMetrics，每批（或每次编译）调用一次
+ * qsm_metrics_publish 合并进页里；读方不加锁，页里每个槽位用顺序锁（seqlock）保护：
+ *
+ *   seq 为奇数表示有写者正在改，读方复制整个槽位前后 seq 相同且为偶数才算一致的快照。
+ *   写者之间用 CAS 把 seq 从偶数改成奇数互斥（编译器可能有多个进程同时写同一槽位）。
+ *
+ * 文件默认是 /dev/shm/qsm_metrics（没有 /dev/shm 时用 /tmp），以 0600 创建，只映射当前用户自己的文件；
+ * 环境变量 QSM_METRICS 可改路径（跨用户共享时预先建好文件并设好权限），设为 off 则不发布，设为 on 用默认路径。
+ * 常驻进程默认发布；命令行单次编译只在显式设了 QSM_METRICS（且不是 off）时发布。
+ * 槽位按名字认领，进程重启后沿用原槽位，计数器不归零。
+ *
+ * 每把锁旁边记着持锁进程（owner）。写者持锁超过 1 秒时，等待方用 kill(owner, 0) 确认它已不在，
+ * 才把 seq 换成下一个奇数接管；持锁的进程还活着（只是被调度出去）就继续等，不会与它并发写。
+ * 解锁按自己置上的奇数值 CAS，被接管的旧写者解锁时落空，不会放掉新写者的锁。计数器用原子加。
+ */
+#ifndef QSM_METRICS_H
+#define QSM_METRICS_H
+
+#include <stdint.h>
+
+#define QSM_METRICS_MAGIC 0x3152544du   // "MTR1"
+#define QSM_METRICS_VERSION 2
+#define QSM_METRICS_SLOTS 32
+#define QSM_METRICS_BUCKETS 16          // 延迟直方图桶数，最后一桶为 +Inf
+
+// 延迟直方图各桶上界（秒），与 Prometheus 的 le 标签一致
+extern const double qsm_metrics_bounds[QSM_METRICS_BUCKETS - 1];
+
+// 全部字段都是 uint64_t，读方按 8 字节字逐个原子读
+typedef struct {
+    uint64_t jobs;              // 完成的作业（编译器为编译次数）
+    uint64_t gates;             // 执行的门数（编译器为生成的指令数）
+    uint64_t errors;
+    uint64_t cache_hits, cache_misses;
+    uint64_t compile_ns, sim_ns;
+    uint64_t state_bytes;       // 量表：最近一次模拟的态矢量字节数
+    uint64_t queue_depth;       // 量表：发布时的排队作业数
+    uint64_t lat_count, lat_sum_ns;
+    uint64_t lat[QSM_METRICS_BUCKETS];  // 各桶计数（非累积）
+} QsmMetrics;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t owner;             // 持有 seq 锁的进程，0 为没人持有
+    uint32_t pid;               // 最近一次发布的进程
+    uint32_t pad;
+    char name[24];
+    uint64_t updated_ms;        // 最近一次发布的 Unix 时间（毫秒）
+    QsmMetrics m;
+} __attribute__((aligned(64))) QsmMetricsSlot;
+
+typedef struct {
+    uint32_t magic, version, nslots, slot_size;
+    uint32_t lock;              // 认领槽位时的页锁
+    uint32_t lock_owner;        // 持有页锁的进程
+    uint32_t pad[10];
+    QsmMetricsSlot slot[QSM_METRICS_SLOTS];
+} QsmMetricsPage;
+
+// 映射指标页；writable 时不存在就创建。QSM_METRICS=off 或失败时返回 NULL（发布方据此静默跳过）
+QsmMetricsPage *qsm_metrics_open(int writable);
+const char *qsm_metrics_path(void);
+
+// 是否显式要求发布（QSM_METRICS 设了且不是 off）；一次性的命令行工具据此决定要不要碰指标页
+int qsm_metrics_requested(void);
+
+// 按名字找到或认领一个槽位；页已满或 page 为 NULL 时返回 NULL
+QsmMetricsSlot *qsm_metrics_attach(QsmMetricsPage *page, const char *name);
+
+// 把局部累计合并进槽位：计数器相加，两个量表直接覆盖；slot 为 NULL 时什么都不做
+void qsm_metrics_publish(QsmMetricsSlot *slot, const QsmMetrics *delta);
+
+// 在局部累计里记一次延迟
+void qsm_metrics_observe(QsmMetrics *m, double sec);
+
+// 读一致快照；写者长时间不放锁（进程死在发布中途）时返回 -1
+int qsm_metrics_read(const QsmMetricsSlot *slot, QsmMetricsSlot *out);
+
+#endif
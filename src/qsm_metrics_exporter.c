@@ -0,0 +1,351 @@
+/*
+ * qsm_metrics_exporter.c — 本机指标导出器
+ *
+ * 只读映射 qsm_metrics 共享内存页（src/qsm_metrics.h），把编译器、执行器发布的计数器
+ * 提供给 web/apps/monitor 与 Prometheus：
+ *   GET /metrics        Prometheus 文本格式（qsm_*，按 backend 标签区分发布方）
+ *   GET /metrics.json   同一份快照的 JSON，monitor 页每秒轮询，速率由前后两次快照相减得出
+ * 读每个槽位都走顺序锁，不碰发布方的热路径；指标页还不存在时返回空列表，下次请求再尝试映射。
+ *
+ * 用法: qsm_metrics_exporter [-p 9100]      只监听 127.0.0.1
+ *       qsm_metrics_exporter --once         把 JSON 快照打到标准输出
+ *       qsm_metrics_exporter --selftest N   一个子进程加一个线程并发发布，读 N 次快照核对一致性
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "qsm_jsonl.h"
+#include "qsm_metrics.h"
+
+// ==================== 输出缓冲 ====================
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+} Str;
+
+static void str_put(Str *s, const char *p, size_t n) {
+    if (s->len + n + 1 > s->cap) {
+        s->cap = s->cap ? s->cap : 256;
+        while (s->len + n + 1 > s->cap) s->cap *= 2;
+        s->data = realloc(s->data, s->cap);
+    }
+    memcpy(s->data + s->len, p, n);
+    s->len += n;
+    s->data[s->len] = '\0';
+}
+
+static void str_printf(Str *s, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void str_printf(Str *s, const char *fmt, ...) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n > 0) str_put(s, buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+static void str_json(Str *s, const char *p, size_t n) {
+    char *tmp = malloc(6 * n + 1);
+    size_t m = qsm_json_escape(p, n, tmp);
+    str_put(s, "\"", 1);
+    str_put(s, tmp, m);
+    str_put(s, "\"", 1);
+    free(tmp);
+}
+
+// ==================== 快照 ====================
+
+typedef struct {
+    QsmMetricsSlot s;
+    int alive;
+} Backend;
+
+static QsmMetricsPage *g_page;
+
+// 读出所有已认领的槽位；读不到一致快照的（写者死在发布中途）跳过
+static int snapshot(Backend *out) {
+    if (!g_page) g_page = qsm_metrics_open(0);
+    if (!g_page) return 0;
+    int n = 0;
+    for (int i = 0; i < QSM_METRICS_SLOTS; i++) {
+        if (!g_page->slot[i].name[0] || qsm_metrics_read(&g_page->slot[i], &out[n].s) != 0) continue;
+        out[n].s.name[sizeof(out[n].s.name) - 1] = '\0';
+        pid_t pid = (pid_t)out[n].s.pid;
+        out[n].alive = pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+        n++;
+    }
+    return n;
+}
+
+static void render_json(Str *o) {
+    Backend b[QSM_METRICS_SLOTS];
+    int n = snapshot(b);
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    str_put(o, "{\"path\":", 8);
+    str_json(o, qsm_metrics_path(), strlen(qsm_metrics_path()));
+    str_printf(o, ",\"time_ms\":%lld,\"le\":[", (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+    for (int k = 0; k < QSM_METRICS_BUCKETS - 1; k++) str_printf(o, "%s%g", k ? "," : "", qsm_metrics_bounds[k]);
+    str_put(o, "],\"backends\":[", 14);
+    for (int i = 0; i < n; i++) {
+        const QsmMetrics *m = &b[i].s.m;
+        str_put(o, i ? ",{\"name\":" : "{\"name\":", i ? 9 : 8);
+        str_json(o, b[i].s.name, strlen(b[i].s.name));
+        str_printf(o, ",\"pid\":%u,\"alive\":%s,\"updated_ms\":%llu,\"jobs\":%llu,\"gates\":%llu,\"errors\":%llu,",
+                   b[i].s.pid, b[i].alive ? "true" : "false", (unsigned long long)b[i].s.updated_ms,
+                   (unsigned long long)m->jobs, (unsigned long long)m->gates, (unsigned long long)m->errors);
+        str_printf(o, "\"cache_hits\":%llu,\"cache_misses\":%llu,\"compile_s\":%.6f,\"sim_s\":%.6f,"
+                   "\"state_bytes\":%llu,\"queue_depth\":%llu,",
+                   (unsigned long long)m->cache_hits, (unsigned long long)m->cache_misses, m->compile_ns * 1e-9,
+                   m->sim_ns * 1e-9, (unsigned long long)m->state_bytes, (unsigned long long)m->queue_depth);
+        // 桶计数输出为累积值，与 Prometheus 的 _bucket 一致，最后一个即 count
+        str_printf(o, "\"latency\":{\"count\":%llu,\"sum_s\":%.6f,\"buckets\":[",
+                   (unsigned long long)m->lat_count, m->lat_sum_ns * 1e-9);
+        uint64_t cum = 0;
+        for (int k = 0; k < QSM_METRICS_BUCKETS; k++) {
+            cum += m->lat[k];
+            str_printf(o, "%s%llu", k ? "," : "", (unsigned long long)cum);
+        }
+        str_put(o, "]}}", 3);
+    }
+    str_put(o, "]}\n", 3);
+}
+
+static void prom_family(Str *o, const char *name, const char *type, const char *help) {
+    str_printf(o, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void render_prometheus(Str *o) {
+    Backend b[QSM_METRICS_SLOTS];
+    int n = snapshot(b);
+    static const struct {
+        const char *name, *type, *help;
+        size_t off;
+        double scale;
+    } fields[] = {
+        { "qsm_jobs_total", "counter", "Completed jobs (compiler: compilations)", offsetof(QsmMetrics, jobs), 1 },
+        { "qsm_gates_total", "counter", "Gates executed (compiler: instructions emitted)", offsetof(QsmMetrics, gates), 1 },
+        { "qsm_errors_total", "counter", "Failed jobs", offsetof(QsmMetrics, errors), 1 },
+        { "qsm_cache_hits_total", "counter", "Compile cache hits", offsetof(QsmMetrics, cache_hits), 1 },
+        { "qsm_cache_misses_total", "counter", "Compile cache misses", offsetof(QsmMetrics, cache_misses), 1 },
+        { "qsm_compile_seconds_total", "counter", "Time spent compiling", offsetof(QsmMetrics, compile_ns), 1e-9 },
+        { "qsm_sim_seconds_total", "counter", "Time spent simulating", offsetof(QsmMetrics, sim_ns), 1e-9 },
+        { "qsm_state_bytes", "gauge", "State vector bytes of the latest simulation", offsetof(QsmMetrics, state_bytes), 1 },
+        { "qsm_queue_depth", "gauge", "Queued jobs at last publish", offsetof(QsmMetrics, queue_depth), 1 },
+    };
+    prom_family(o, "qsm_up", "gauge", "Whether the last publishing process is still running");
+    for (int i = 0; i < n; i++) str_printf(o, "qsm_up{backend=\"%s\"} %d\n", b[i].s.name, b[i].alive);
+    for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+        prom_family(o, fields[f].name, fields[f].type, fields[f].help);
+        for (int i = 0; i < n; i++) {
+            uint64_t v = *(const uint64_t *)((const char *)&b[i].s.m + fields[f].off);
+            if (fields[f].scale == 1) str_printf(o, "%s{backend=\"%s\"} %llu\n", fields[f].name, b[i].s.name, (unsigned long long)v);
+            else str_printf(o, "%s{backend=\"%s\"} %.9f\n", fields[f].name, b[i].s.name, v * fields[f].scale);
+        }
+    }
+    prom_family(o, "qsm_latency_seconds", "histogram", "Job latency from arrival to result");
+    for (int i = 0; i < n; i++) {
+        const QsmMetrics *m = &b[i].s.m;
+        uint64_t cum = 0;
+        for (int k = 0; k < QSM_METRICS_BUCKETS; k++) {
+            cum += m->lat[k];
+            if (k < QSM_METRICS_BUCKETS - 1)
+                str_printf(o, "qsm_latency_seconds_bucket{backend=\"%s\",le=\"%g\"} %llu\n", b[i].s.name,
+                           qsm_metrics_bounds[k], (unsigned long long)cum);
+            else
+                str_printf(o, "qsm_latency_seconds_bucket{backend=\"%s\",le=\"+Inf\"} %llu\n", b[i].s.name,
+                           (unsigned long long)cum);
+        }
+        str_printf(o, "qsm_latency_seconds_sum{backend=\"%s\"} %.9f\n", b[i].s.name, m->lat_sum_ns * 1e-9);
+        str_printf(o, "qsm_latency_seconds_count{backend=\"%s\"} %llu\n", b[i].s.name, (unsigned long long)m->lat_count);
+    }
+}
+
+// ==================== HTTP ====================
+
+static int send_all(int fd, const char *p, size_t n) {
+    while (n) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0) {
+            if (w < 0 && errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+static void respond(int fd, int status, const char *type, const char *body, size_t n) {
+    char hdr[512];
+    int h = snprintf(hdr, sizeof(hdr),
+                     "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+                     "Access-Control-Allow-Origin: *\r\nCache-Control: no-store\r\nConnection: close\r\n\r\n",
+                     status, status == 200 ? "OK" : status == 404 ? "Not Found" : "Bad Request", type, n);
+    if (send_all(fd, hdr, (size_t)h) == 0 && n) send_all(fd, body, n);
+}
+
+// 每个连接只处理一个请求；monitor 一秒一次，单线程足够
+static void serve(int fd) {
+    char req[4096];
+    size_t got = 0;
+    struct timeval tv = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    while (got < sizeof(req) - 1) {
+        ssize_t r = recv(fd, req + got, sizeof(req) - 1 - got, 0);
+        if (r <= 0) break;
+        got += (size_t)r;
+        req[got] = '\0';
+        if (strstr(req, "\r\n\r\n")) break;
+    }
+    req[got] = '\0';
+    char method[8], path[256];
+    if (sscanf(req, "%7s %255s", method, path) != 2) {
+        respond(fd, 400, "text/plain", "", 0);
+        return;
+    }
+    char *q = strchr(path, '?');
+    if (q) *q = '\0';
+    Str o = { 0 };
+    if (strcmp(method, "GET") != 0) {
+        respond(fd, 400, "text/plain", "", 0);
+    } else if (strcmp(path, "/metrics") == 0) {
+        render_prometheus(&o);
+        respond(fd, 200, "text/plain; version=0.0.4; charset=utf-8", o.data ? o.data : "", o.len);
+    } else if (strcmp(path, "/metrics.json") == 0) {
+        render_json(&o);
+        respond(fd, 200, "application/json; charset=utf-8", o.data, o.len);
+    } else {
+        respond(fd, 404, "text/plain", "", 0);
+    }
+    free(o.data);
+}
+
+// ==================== 自测 ====================
+
+// 每次发布所有计数器、所有桶都加 1：一致的快照里它们必须全都相等
+static void publish_loop(QsmMetricsSlot *slot, long rounds) {
+    QsmMetrics d = { 1, 1, 1, 1, 1, 1, 1, 0, 0, QSM_METRICS_BUCKETS, 1, { 0 } };
+    for (int k = 0; k < QSM_METRICS_BUCKETS; k++) d.lat[k] = 1;
+    for (long r = 0; r < rounds; r++) qsm_metrics_publish(slot, &d);
+}
+
+static void *publish_thread(void *arg) {
+    publish_loop(arg, 200000);
+    return NULL;
+}
+
+static int consistent(const QsmMetrics *m) {
+    const uint64_t v = m->jobs;
+    if (m->gates != v || m->errors != v || m->cache_hits != v || m->cache_misses != v || m->compile_ns != v ||
+        m->sim_ns != v || m->lat_sum_ns != v || m->lat_count != v * QSM_METRICS_BUCKETS)
+        return 0;
+    for (int k = 0; k < QSM_METRICS_BUCKETS; k++)
+        if (m->lat[k] != v) return 0;
+    return 1;
+}
+
+static int selftest(long reads) {
+    char path[] = "/tmp/qsm_metrics_test.XXXXXX";
+    int tfd = mkstemp(path);
+    if (tfd < 0) return 1;
+    close(tfd);
+    setenv("QSM_METRICS", path, 1);
+    QsmMetricsPage *page = qsm_metrics_open(1);
+    QsmMetricsSlot *slot = qsm_metrics_attach(page, "selftest");
+    if (!slot || qsm_metrics_attach(page, "selftest") != slot) {
+        fprintf(stderr, "[METRICS] 自测: 无法认领槽位\n");
+        unlink(path);
+        return 1;
+    }
+    // 子进程另行映射同一文件，与本进程的线程一起写同一槽位
+    pid_t child = fork();
+    if (child == 0) {
+        QsmMetricsSlot *s = qsm_metrics_attach(qsm_metrics_open(1), "selftest");
+        for (;;) publish_loop(s, 1000);
+    }
+    pthread_t th;
+    pthread_create(&th, NULL, publish_thread, slot);
+    long bad = 0, failed = 0;
+    uint64_t last = 0;
+    for (long i = 0; i < reads; i++) {
+        QsmMetricsSlot snap;
+        if (qsm_metrics_read(slot, &snap) != 0) {
+            failed++;
+            continue;
+        }
+        if (!consistent(&snap.m) || snap.m.jobs < last) bad++;
+        last = snap.m.jobs;
+    }
+    pthread_join(th, NULL);
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+    // 子进程可能死在发布中途，正好验证写者接管
+    QsmMetricsSlot snap;
+    uint64_t mine = 200000;
+    qsm_metrics_publish(slot, &(QsmMetrics){ 0 });
+    int final_ok = qsm_metrics_read(slot, &snap) == 0 && snap.m.jobs >= mine;
+    unlink(path);
+    printf("[METRICS] 自测: 读 %ld 次, 不一致 %ld, 读失败 %ld, 发布 %llu 次\n", reads, bad, failed,
+           (unsigned long long)snap.m.jobs);
+    return bad || failed || !final_ok;
+}
+
+int main(int argc, char *argv[]) {
+    int port = 9100;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--once") == 0) {
+            Str o = { 0 };
+            render_json(&o);
+            fputs(o.data, stdout);
+            free(o.data);
+            return 0;
+        }
+        if (i + 1 >= argc) goto usage;
+        if (strcmp(argv[i], "-p") == 0) port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--selftest") == 0) return selftest(atol(argv[++i]));
+        else goto usage;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, 64) != 0) {
+        fprintf(stderr, "[METRICS] 无法监听 127.0.0.1:%d: %s\n", port, strerror(errno));
+        return 1;
+    }
+    fprintf(stdout, "[METRICS] 监听 127.0.0.1:%d, 指标页 %s\n", port, qsm_metrics_path());
+    fflush(stdout);
+    for (;;) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        serve(fd);
+        close(fd);
+    }
+    return 1;
+
+usage:
+    fprintf(stderr, "用法: %s [-p 9100] | --once | --selftest N\n", argv[0]);
+    fprintf(stderr, "\n以 JSON（/metrics.json）与 Prometheus 文本（/metrics）导出 qsm_metrics 共享内存指标页\n");
+    return 1;
+}
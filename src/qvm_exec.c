@@ -0,0 +1,323 @@
+/*
+ * qvm_exec.c — 原生 QVM 态矢量执行器
+ */
+#define _GNU_SOURCE
+#include "qvm_exec.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ==================== 解码 ====================
+
+// 测量之后仍有 H / X / Y、CNOT 目标、SWAP 或 RESET 落在该比特上时，末态已不是测量时的值：
+// 把 MEASURE 换成 CNOT q→辅助比特，结果留在辅助比特里。Z / S / T 与作 CNOT 控制位
+// 不改变计算基分量，这种测量直接读末态。RESET 各占一个辅助比特，换成 SWAP q↔辅助比特
+enum { OP_DEFER = 0xff };       // 解码内部用：需要辅助比特的 MEASURE
+
+static int defer_measure(QvmCircuit *c, int max_qubits) {
+    uint64_t later = 0;         // 后面还会被翻转 / 叠加的比特
+    int nanc = 0;
+    for (int k = c->ngates - 1; k >= 0; k--) {
+        QvmGate *g = &c->gates[k];
+        switch (g->op) {
+        case QVM_OP_H: case QVM_OP_X: case QVM_OP_Y:
+            later |= 1ull << g->a;
+            break;
+        case QVM_OP_CNOT:
+            later |= 1ull << g->b;
+            break;
+        case QVM_OP_SWAP:
+            later |= 1ull << g->a | 1ull << g->b;
+            break;
+        case QVM_OP_RESET:
+            later |= 1ull << g->a;
+            nanc++;
+            break;
+        case QVM_OP_MEASURE:
+            if (later >> g->a & 1) {
+                g->op = OP_DEFER;
+                nanc++;
+            }
+            break;
+        }
+    }
+    if (c->nqubits + nanc > max_qubits) return -1;
+    int anc = c->nqubits, out = 0;
+    for (int k = 0; k < c->ngates; k++) {
+        QvmGate g = c->gates[k];
+        if (g.op == QVM_OP_MEASURE) {
+            c->regs |= 1ull << g.b;
+            c->reg_qubit[g.b] = g.a;
+            continue;
+        }
+        if (g.op == OP_DEFER) {
+            c->regs |= 1ull << g.b;
+            c->reg_qubit[g.b] = (uint8_t)anc;
+            g = (QvmGate){ QVM_OP_CNOT, g.a, (uint8_t)anc++ };
+        } else if (g.op == QVM_OP_RESET) {
+            g = (QvmGate){ QVM_OP_SWAP, g.a, (uint8_t)anc++ };
+        }
+        c->gates[out++] = g;
+    }
+    c->ngates = out;
+    c->nqubits = anc;
+    return 0;
+}
+
+int qvm_decode(const uint8_t *p, size_t n, int max_qubits, QvmCircuit *c) {
+    memset(c, 0, sizeof(*c));
+    c->gates = malloc((n + 1) * sizeof(QvmGate));
+    if (!c->gates) return -1;
+    if (max_qubits > QVM_MAX_QUBITS) max_qubits = QVM_MAX_QUBITS;
+    int maxq = -1;
+    uint8_t touched[256] = { 0 };   // 已被门作用过的比特；之前没动过的比特上的 RESET 什么都不做
+    for (size_t i = 0; i < n;) {
+        uint8_t op = p[i++];
+        QvmGate g = { op, 0, 0 };
+        switch (op) {
+        case QVM_OP_INIT_N:
+            if (i + 2 > n) goto bad;
+            c->nqubits = p[i] | p[i + 1] << 8;
+            i += 2;
+            continue;
+        case QVM_OP_H: case QVM_OP_X: case QVM_OP_Y: case QVM_OP_Z: case QVM_OP_T: case QVM_OP_S:
+        case QVM_OP_RESET:
+            if (i + 1 > n) goto bad;
+            g.a = p[i++];
+            if (g.a > maxq) maxq = g.a;
+            if (op == QVM_OP_RESET && !touched[g.a]) continue;
+            touched[g.a] = 1;
+            break;
+        case QVM_OP_CNOT: case QVM_OP_SWAP: case QVM_OP_MEASURE:
+            if (i + 2 > n) goto bad;
+            g.a = p[i];
+            g.b = p[i + 1];
+            i += 2;
+            if (g.a > maxq) maxq = g.a;
+            if (op != QVM_OP_MEASURE) {
+                if (g.b > maxq) maxq = g.b;
+                if (g.a == g.b) goto bad;
+                touched[g.a] = touched[g.b] = 1;
+            } else if (g.b >= QVM_MAX_REGS) {
+                goto bad;
+            }
+            break;
+        case QVM_OP_BARRIER:
+            continue;
+        case QVM_OP_PRINT:
+            if (i + 1 > n) goto bad;
+            i++;
+            continue;
+        case QVM_OP_STOP: case QVM_OP_EXIT:
+            i = n;
+            continue;
+        default:
+            goto bad;
+        }
+        c->gates[c->ngates++] = g;
+    }
+    if (maxq + 1 > c->nqubits) c->nqubits = maxq + 1;
+    if (c->nqubits < 1) c->nqubits = 1;
+    c->nprog = c->nqubits;
+    if (c->nqubits > max_qubits || defer_measure(c, max_qubits) != 0) {
+        qvm_circuit_free(c);
+        return -2;
+    }
+    return 0;
+bad:
+    qvm_circuit_free(c);
+    return -1;
+}
+
+int qvm_outputs(const QvmCircuit *c, int *label, int *qubit) {
+    int n = 0;
+    for (int r = 0; r < QVM_MAX_REGS; r++) {
+        if (!(c->regs >> r & 1)) continue;
+        label[n] = r;
+        qubit[n++] = c->reg_qubit[r];
+    }
+    if (n) return n;
+    for (int q = 0; q < c->nprog; q++) label[q] = qubit[q] = q;
+    return c->nprog;
+}
+
+void qvm_circuit_free(QvmCircuit *c) {
+    free(c->gates);
+    c->gates = NULL;
+    c->ngates = 0;
+}
+
+// ==================== 态矢量 ====================
+
+int qvm_state_init(QvmState *s, int nqubits) {
+    memset(s, 0, sizeof(*s));
+    if (nqubits < 1 || nqubits > QVM_MAX_QUBITS) return -1;
+    s->nqubits = nqubits;
+    s->dim = (size_t)1 << nqubits;
+    size_t bytes = (s->dim * sizeof(double) + 63) & ~(size_t)63;
+    s->re = aligned_alloc(64, bytes);
+    s->im = aligned_alloc(64, bytes);
+    if (!s->re || !s->im) {
+        qvm_state_free(s);
+        return -1;
+    }
+    memset(s->re, 0, bytes);
+    memset(s->im, 0, bytes);
+    s->re[0] = 1;
+    return 0;
+}
+
+void qvm_state_free(QvmState *s) {
+    free(s->re);
+    free(s->im);
+    s->re = s->im = NULL;
+}
+
+// 门只作用在成对的振幅上：a 为该比特取 0 的下标，b 为取 1 的下标。
+// 同一份代码展开两次：T = v2d 走连续段，v2d 是 GCC / Clang 的向量扩展，x86 上编成 SSE2；
+// T = double、步长 2 给配对振幅交错排列的 q0 用。
+typedef double v2d __attribute__((vector_size(16), may_alias));
+
+#define SPAN_KERNEL(T, NAME, STEP)                                                      \
+    static void NAME(int op, T *restrict ra, T *restrict ia, T *restrict rb, T *restrict ib, size_t n) { \
+        const double r = M_SQRT1_2;                                                     \
+        switch (op) {                                                                   \
+        case QVM_OP_H:                                                                  \
+            for (size_t k = 0; k < n * STEP; k += STEP) {                               \
+                T xr = ra[k], xi = ia[k], yr = rb[k], yi = ib[k];                       \
+                ra[k] = r * (xr + yr); ia[k] = r * (xi + yi);                           \
+                rb[k] = r * (xr - yr); ib[k] = r * (xi - yi);                           \
+            }                                                                           \
+            break;                                                                      \
+        case QVM_OP_X:                                                                  \
+            for (size_t k = 0; k < n * STEP; k += STEP) {                               \
+                T t = ra[k]; ra[k] = rb[k]; rb[k] = t;                                  \
+                t = ia[k]; ia[k] = ib[k]; ib[k] = t;                                    \
+            }                                                                           \
+            break;                                                                      \
+        case QVM_OP_Y: /* (a, b) → (-i·b, i·a) */                                       \
+            for (size_t k = 0; k < n * STEP; k += STEP) {                               \
+                T xr = ra[k], xi = ia[k], yr = rb[k], yi = ib[k];                       \
+                ra[k] = yi; ia[k] = -yr;                                                \
+                rb[k] = -xi; ib[k] = xr;                                                \
+            }                                                                           \
+            break;                                                                      \
+        case QVM_OP_Z:                                                                  \
+            for (size_t k = 0; k < n * STEP; k += STEP) { rb[k] = -rb[k]; ib[k] = -ib[k]; } \
+            break;                                                                      \
+        case QVM_OP_S:                                                                  \
+            for (size_t k = 0; k < n * STEP; k += STEP) { T t = rb[k]; rb[k] = -ib[k]; ib[k] = t; } \
+            break;                                                                      \
+        case QVM_OP_T:                                                                  \
+            for (size_t k = 0; k < n * STEP; k += STEP) {                               \
+                T yr = rb[k], yi = ib[k];                                               \
+                rb[k] = r * (yr - yi); ib[k] = r * (yr + yi);                           \
+            }                                                                           \
+            break;                                                                      \
+        }                                                                               \
+    }
+
+SPAN_KERNEL(v2d, span_simd, 1)
+SPAN_KERNEL(double, span_step2, 2)
+
+// 从下标 k 起连续 len（偶数）个振幅与 k+bit 起的配对；态矢量 64 字节对齐，len >= 2 时 k 是偶数
+static inline void span(const QvmState *s, int op, size_t k, size_t bit, size_t len) {
+    span_simd(op, (v2d *)(s->re + k), (v2d *)(s->im + k), (v2d *)(s->re + k + bit), (v2d *)(s->im + k + bit), len / 2);
+}
+
+void qvm_apply(QvmState *s, const QvmGate *g) {
+    size_t dim = s->dim, bit = (size_t)1 << g->a;
+    if (g->op != QVM_OP_CNOT && g->op != QVM_OP_SWAP) {
+        // 以 2*bit 为块：块的前半 [i0, i0+bit) 与后半一一配对；q0 的配对振幅相邻，隔一个取一个
+        if (bit == 1) span_step2(g->op, s->re, s->im, s->re + 1, s->im + 1, dim / 2);
+        else
+            for (size_t i0 = 0; i0 < dim; i0 += 2 * bit) span(s, g->op, i0, bit, bit);
+        return;
+    }
+    // CNOT 就是只在控制比特为 1 的下标上作用 X：在每个 2*hi 块里枚举控制位 1、目标位 0 的
+    // 连续段，段长为两个比特中较低那一位的权重；较低的是 q0 时这些下标隔一个出现一次
+    size_t cb = bit, tb = (size_t)1 << g->b;
+    size_t lo = cb < tb ? cb : tb, hi = cb < tb ? tb : cb;
+    if (g->op == QVM_OP_SWAP) {
+        // SWAP 只对调两个比特取值不同的振幅：同样按段枚举 a=0,b=0 的下标 k，交换 k|cb 与 k|tb
+        double *re = s->re, *im = s->im;
+        for (size_t a = 0; a < dim; a += 2 * hi)
+            for (size_t b = a; b < a + hi; b += 2 * lo)
+                for (size_t k = b; k < b + lo; k++) {
+                    double t = re[k | cb]; re[k | cb] = re[k | tb]; re[k | tb] = t;
+                    t = im[k | cb]; im[k | cb] = im[k | tb]; im[k | tb] = t;
+                }
+        return;
+    }
+    for (size_t a = 0; a < dim; a += 2 * hi) {
+        if (lo == 1) {
+            size_t k = a | cb;
+            span_step2(QVM_OP_X, s->re + k, s->im + k, s->re + k + tb, s->im + k + tb, hi / 2);
+        } else {
+            for (size_t b = a; b < a + hi; b += 2 * lo) span(s, QVM_OP_X, b | cb, tb, lo);
+        }
+    }
+}
+
+void qvm_run(QvmState *s, const QvmCircuit *c) {
+    for (int k = 0; k < c->ngates; k++) qvm_apply(s, &c->gates[k]);
+}
+
+double qvm_prob_one(const QvmState *s, int q) {
+    size_t bit = (size_t)1 << q;
+    double p1 = 0;
+    for (size_t i0 = bit; i0 < s->dim; i0 += 2 * bit)
+        for (size_t j = i0; j < i0 + bit; j++) p1 += qvm_prob(s, j);
+    return p1;
+}
+
+int qvm_top(const QvmState *s, size_t *idx, int k) {
+    int n = 0;
+    for (size_t i = 0; i < s->dim; i++) {
+        double p = qvm_prob(s, i);
+        if (p < 1e-12) continue;
+        int j = n < k ? n++ : k;
+        if (j == k) {
+            if (p <= qvm_prob(s, idx[k - 1])) continue;
+            j = k - 1;
+        }
+        while (j > 0 && qvm_prob(s, idx[j - 1]) < p) { idx[j] = idx[j - 1]; j--; }
+        idx[j] = i;
+    }
+    return n;
+}
+
+static uint64_t splitmix(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void qvm_sample(const QvmState *s, uint64_t seed, size_t shots, uint64_t *out) {
+    if (!shots) return;
+    double total = 0;
+    size_t last = 0;            // 舍入误差不能让样本落到概率为 0 的尾部
+    for (size_t i = 0; i < s->dim; i++) {
+        double p = qvm_prob(s, i);
+        total += p;
+        if (p > 0) last = i;
+    }
+    // 指数间隔的累加和归一化后就是升序的均匀样本，扫一遍态矢量即可，不用排序
+    double *u = malloc(shots * sizeof(double));
+    double acc = 0;
+    for (size_t k = 0; k < shots; k++) {
+        acc -= log(((double)(splitmix(&seed) >> 11) + 0.5) * 0x1p-53);
+        u[k] = acc;
+    }
+    acc -= log(((double)(splitmix(&seed) >> 11) + 0.5) * 0x1p-53);
+    double scale = total / acc, cum = 0;
+    size_t i = 0;
+    for (size_t k = 0; k < shots; k++) {
+        double target = u[k] * scale;
+        while (i < last && cum + qvm_prob(s, i) <= target) cum += qvm_prob(s, i++);
+        out[k] = i;
+    }
+    free(u);
+}
@@ -0,0 +1,78 @@
+/*
+ * qvm_exec.h — 原生 QVM 态矢量执行器
+ *
+ * 执行 qcl_bootstrap 产生的 .qbc：先解码成门序列（QvmCircuit），
+ * 再在 2^n 维态矢量上逐门作用。态矢量按实部 / 虚部分开存放（各自 64 字节对齐），
+ * 内层循环是连续的成对更新，便于编译器向量化。
+ *
+ * MEASURE q r 按延迟测量处理：之后不再有门改变比特 q 的计算基分量时，寄存器 r 直接读末态的 q；
+ * 否则在测量处插入 CNOT q→辅助比特，寄存器 r 读辅助比特。辅助比特排在程序比特之后，
+ * 计入 nqubits 与 max_qubits。这样对末态做 qvm_sample 抽样得到的寄存器联合分布
+ * 与逐次坍缩一致，态矢量只需演化一次。
+ *
+ * RESET q 同理：q 还没被任何门作用过时它就是 |0⟩，解码时丢掉；否则换成 SWAP q↔新的辅助比特，
+ * q 回到 |0⟩，原来的内容留在之后不再用到的辅助比特里（等于把它迹掉）。BARRIER 解码时丢掉。
+ */
+#ifndef QVM_EXEC_H
+#define QVM_EXEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define QVM_MAX_QUBITS 30
+#define QVM_MAX_REGS 64
+
+// 与 qcl_bootstrap.c 的操作码一致
+enum { QVM_OP_H = 1, QVM_OP_X = 2, QVM_OP_Z = 3, QVM_OP_CNOT = 4, QVM_OP_MEASURE = 5,
+       QVM_OP_RESET = 6, QVM_OP_SWAP = 7, QVM_OP_PRINT = 11, QVM_OP_STOP = 12, QVM_OP_EXIT = 17,
+       QVM_OP_BARRIER = 18, QVM_OP_INIT_N = 20,
+       QVM_OP_T = 35, QVM_OP_S = 36, QVM_OP_Y = 37 };
+
+typedef struct {
+    uint8_t op, a, b;
+} QvmGate;
+
+typedef struct {
+    int nqubits;                // 含辅助比特
+    int nprog;                  // 程序里出现的比特数
+    int ngates;
+    QvmGate *gates;
+    uint64_t regs;              // 被 MEASURE 写过的经典寄存器
+    uint8_t reg_qubit[QVM_MAX_REGS];  // 寄存器 r 的值在末态里由哪个比特给出
+} QvmCircuit;
+
+// 解码 .qbc；0 成功，-1 字节码非法，-2 比特数（含辅助比特）超过 max_qubits
+int qvm_decode(const uint8_t *p, size_t n, int max_qubits, QvmCircuit *c);
+void qvm_circuit_free(QvmCircuit *c);
+
+// 要报告的结果位：有 MEASURE 时按寄存器编号升序，label 是寄存器号；
+// 否则是全部程序比特，label 是比特号。qubit 是该位在末态里的比特，返回位数
+int qvm_outputs(const QvmCircuit *c, int *label, int *qubit);
+
+typedef struct {
+    int nqubits;
+    size_t dim;
+    double *re, *im;
+} QvmState;
+
+// 置为 |0...0⟩；内存不足返回 -1
+int qvm_state_init(QvmState *s, int nqubits);
+void qvm_state_free(QvmState *s);
+
+void qvm_apply(QvmState *s, const QvmGate *g);
+void qvm_run(QvmState *s, const QvmCircuit *c);
+
+static inline double qvm_prob(const QvmState *s, size_t i) {
+    return s->re[i] * s->re[i] + s->im[i] * s->im[i];
+}
+
+// 比特 q 测得 1 的概率
+double qvm_prob_one(const QvmState *s, int q);
+
+// 概率最大的至多 k 个基态下标（降序，忽略 < 1e-12 的），返回个数
+int qvm_top(const QvmState *s, size_t *idx, int k);
+
+// 按末态分布抽 shots 次，out 里是升序排好的基态下标
+void qvm_sample(const QvmState *s, uint64_t seed, size_t shots, uint64_t *out);
+
+#endif
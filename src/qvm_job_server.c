@@ -0,0 +1,1208 @@
+/*
+ * qvm_job_server.c — 本机原生 QVM 作业服务
+ *
+ * web/apps/qvm 原先在浏览器里用 qvm-simulator.js 逐比特模拟，表示不了纠缠。
+ * 这个守护进程接收 .qentl 源码或 .qbc 字节码作业，用 qentl_compiler（src/qcl_bootstrap.c）
+ * 编译，在原生态矢量执行器（src/qvm_exec.h）上运行，结果按 NDJSON 分块流式返回：
+ *   GET  /api/qvm/health   {status, backend, max_qubits, compiler}
+ *   POST /api/qvm/jobs     {qentl: 源码 | qbc: base64 字节码 | circuit: 归档里的线路名, shots?, seed?}
+ *        → 每行一个事件：queued → compiled → result（出错时为 error）
+ *   GET  /api/qvm/stats    作业数、批大小、编译缓存命中、延迟 p50 / p99
+ * 每批结束时把计数器发布到 qsm_metrics 共享内存页的 qvm_job_server 槽位（src/qsm_metrics.h），
+ * 由 qsm_metrics_exporter 导出给 web/apps/monitor。
+ * 只监听 127.0.0.1（-p），也可以同时监听一个 Unix 套接字（-u）。
+ * Host 头不是 localhost / 127.0.0.1 / [::1] 的请求一律 403（挡 DNS 重绑定）；带 Origin 的请求
+ * 只接受本机回环地址上的页面与 -O 指定的来源，CORS 头只回显这些来源，其他网站不能提交作业。
+ *
+ * - 批处理：与 yi_infer_server 相同，凑满 -B 个作业、最早一个已等 -W 微秒，
+ *   或 -W/8 内没有新作业进来，就整批处理。批内未命中缓存的源码并行起编译进程，
+ *   相同线路只模拟一次，各作业再按自己的 seed 抽样；
+ * - 编译缓存：按 (类型, 内容) 哈希缓存解码后的线路，反复提交同一段源码不再编译；
+ * - 线路归档：-P 载入 qvm_pack_tool 打的 .qpk（src/qvm_pack.h），circuit 作业按名字
+ *   直接取映射区里的字节码解码，不经编译器、不拷贝；
+ * - 自测：--selftest N 起服务，用 -c 个长连接客户端提交 GHZ 线路（源码与字节码各半），
+ *   逐个核对末态，完全离线。
+ *
+ * 用法: qvm_job_server [-p 8100] [-u 套接字] [-C qentl_compiler] [-Q 22] [-B 16] [-W 2000]
+ *                      [-P circuits.qpk] [-O 来源]... [--selftest N [-c 8]]
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "qsm_jsonl.h"
+#include "qsm_metrics.h"
+#include "qvm_exec.h"
+#include "qvm_pack.h"
+
+#define MAX_BODY (4 << 20)
+#define LAT_RING 8192
+#define TOP_STATES 8
+#define TOP_COUNTS 64
+#define CACHE_CAP 256
+#define MAX_SHOTS (1 << 20)
+#define MAX_ORIGINS 8
+
+extern char **environ;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ==================== 输出缓冲 ====================
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+} Str;
+
+static void str_put(Str *s, const char *p, size_t n) {
+    if (s->len + n + 1 > s->cap) {
+        s->cap = s->cap ? s->cap : 256;
+        while (s->len + n + 1 > s->cap) s->cap *= 2;
+        s->data = realloc(s->data, s->cap);
+    }
+    memcpy(s->data + s->len, p, n);
+    s->len += n;
+    s->data[s->len] = '\0';
+}
+
+static void str_printf(Str *s, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void str_printf(Str *s, const char *fmt, ...) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n > 0) str_put(s, buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+static void str_json(Str *s, const char *p, size_t n) {
+    char *tmp = malloc(6 * n + 1);
+    size_t m = qsm_json_escape(p, n, tmp);
+    str_put(s, "\"", 1);
+    str_put(s, tmp, m);
+    str_put(s, "\"", 1);
+    free(tmp);
+}
+
+// ==================== base64 ====================
+
+static const char B64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static size_t b64_encode(const uint8_t *p, size_t n, char *out) {
+    size_t o = 0;
+    for (size_t i = 0; i < n; i += 3) {
+        uint32_t v = (uint32_t)p[i] << 16 | (i + 1 < n ? (uint32_t)p[i + 1] << 8 : 0) | (i + 2 < n ? p[i + 2] : 0);
+        out[o++] = B64[v >> 18 & 63];
+        out[o++] = B64[v >> 12 & 63];
+        out[o++] = i + 1 < n ? B64[v >> 6 & 63] : '=';
+        out[o++] = i + 2 < n ? B64[v & 63] : '=';
+    }
+    return o;
+}
+
+// 原地解码，跳过空白；非法字符返回 -1
+static long b64_decode(char *s, size_t n) {
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t o = 0;
+    for (size_t i = 0; i < n; i++) {
+        char c = s[i];
+        int v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '+' || c == '-') v = 62;
+        else if (c == '/' || c == '_') v = 63;
+        else if (c == '=' || c == ' ' || c == '\n' || c == '\r') continue;
+        else return -1;
+        acc = acc << 6 | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            s[o++] = (char)(acc >> bits & 0xFF);
+        }
+    }
+    return (long)o;
+}
+
+// ==================== 作业 ====================
+
+enum { SRC_QENTL, SRC_QBC };
+enum { ST_QUEUED, ST_COMPILED, ST_DONE };
+
+typedef struct Job {
+    uint64_t id;
+    int kind;
+    char *src;
+    size_t len;
+    long shots;
+    uint64_t seed;
+    uint64_t key;               // (类型, 内容) 哈希，批内去重与编译缓存共用
+    double arrived;
+    int stage;
+    int failed;
+    int released;               // 批处理线程用完整批后才置位，连接线程此后才能释放作业
+    Str ev;                     // 待发送的事件行，批处理线程追加、连接线程取走
+    struct Job *next;
+} Job;
+
+typedef struct {
+    uint64_t key;
+    QvmCircuit qc;
+    size_t bytes;
+    uint64_t last_used;
+} CacheEntry;
+
+typedef struct {
+    int max_qubits, max_batch;
+    double max_wait;
+    char compiler[512];
+    int has_compiler;
+    char tmpdir[64];
+    QvmPack *pack;              // -P 载入的线路归档，只读映射，各线程共用
+    const char *origins[MAX_ORIGINS];   // -O 额外允许的跨域来源
+    int norigins;
+
+    pthread_mutex_t mu;
+    pthread_cond_t nonempty, progress;
+    Job *head, *tail;
+    int depth;
+    double last_arrival;
+    atomic_int stop;
+    atomic_ullong next_id;
+
+    // 只由批处理线程访问
+    CacheEntry cache[CACHE_CAP];
+    int ncache;
+    uint64_t tick;
+    QsmMetricsSlot *metrics;    // 指标页不可用时为 NULL
+    QsmMetrics mt;              // 本批累计，批末发布
+
+    // 统计（mu 保护）
+    double started;
+    uint64_t jobs, errors, batches, max_batch_seen, sims, compiles, cache_hits, cache_misses;
+    double compile_sec, sim_sec;
+    double lat[LAT_RING], lat_at[LAT_RING];
+    uint64_t lat_n;
+} Server;
+
+static Server g_srv;
+
+static CacheEntry *cache_find(uint64_t key) {
+    for (int i = 0; i < g_srv.ncache; i++)
+        if (g_srv.cache[i].key == key) {
+            g_srv.cache[i].last_used = g_srv.tick;
+            return &g_srv.cache[i];
+        }
+    return NULL;
+}
+
+// 放进缓存并接管 qc；满了就替换最久没用的
+static void cache_put(uint64_t key, QvmCircuit *qc, size_t bytes) {
+    CacheEntry *e;
+    if (g_srv.ncache < CACHE_CAP) e = &g_srv.cache[g_srv.ncache++];
+    else {
+        e = &g_srv.cache[0];
+        for (int i = 1; i < CACHE_CAP; i++)
+            if (g_srv.cache[i].last_used < e->last_used) e = &g_srv.cache[i];
+        qvm_circuit_free(&e->qc);
+    }
+    e->key = key;
+    e->qc = *qc;
+    e->bytes = bytes;
+    e->last_used = g_srv.tick;
+    memset(qc, 0, sizeof(*qc));
+}
+
+// 批处理线程写事件：先在锁外拼好，再追加到作业并唤醒连接线程
+static void emit(Job *j, Str *line, int stage) {
+    str_put(line, "\n", 1);
+    pthread_mutex_lock(&g_srv.mu);
+    str_put(&j->ev, line->data, line->len);
+    if (stage > j->stage) j->stage = stage;
+    pthread_cond_broadcast(&g_srv.progress);
+    pthread_mutex_unlock(&g_srv.mu);
+    line->len = 0;
+}
+
+static void emit_error(Job *j, const char *msg) {
+    Str o = { 0 };
+    str_printf(&o, "{\"event\":\"error\",\"job\":%llu,\"error\":", (unsigned long long)j->id);
+    str_json(&o, msg, strlen(msg));
+    str_put(&o, "}", 1);
+    j->failed = 1;
+    emit(j, &o, ST_DONE);
+    free(o.data);
+}
+
+// 批内一段去重后的程序
+typedef struct {
+    Job *first;
+    CacheEntry *cached;
+    QvmCircuit own;             // 本批新编译的，批末放进缓存
+    size_t bytes;
+    int ok;
+    pid_t pid;
+    char base[128];
+    char err[160];
+    char warning[512];
+    double compile_ms;
+} Prog;
+
+static int write_file(const char *path, const char *p, size_t n) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    size_t w = fwrite(p, 1, n, f);
+    return fclose(f) == 0 && w == n ? 0 : -1;
+}
+
+static void decode_into(Prog *pr, const uint8_t *p, size_t n) {
+    int r = qvm_decode(p, n, g_srv.max_qubits, &pr->own);
+    pr->bytes = n;
+    pr->ok = r == 0;
+    if (r == -1) snprintf(pr->err, sizeof(pr->err), "字节码非法（含执行器不支持的指令）");
+    else if (r == -2) snprintf(pr->err, sizeof(pr->err), "量子比特数超过上限 %d", g_srv.max_qubits);
+}
+
+// 并行编译：先把本批所有未命中的源码各起一个编译进程，再逐个收结果
+static void compile_all(Prog *progs, int np) {
+    double t0 = now_sec();
+    for (int i = 0; i < np; i++) {
+        Prog *pr = &progs[i];
+        if (pr->cached || pr->first->kind != SRC_QENTL) continue;
+        snprintf(pr->base, sizeof(pr->base), "%s/j%llu", g_srv.tmpdir, (unsigned long long)pr->first->id);
+        char in[160], out[160], log[160];
+        snprintf(in, sizeof(in), "%s.qentl", pr->base);
+        snprintf(out, sizeof(out), "%s.qbc", pr->base);
+        snprintf(log, sizeof(log), "%s.log", pr->base);
+        pr->pid = -1;
+        if (write_file(in, pr->first->src, pr->first->len) != 0) {
+            snprintf(pr->err, sizeof(pr->err), "无法写临时文件");
+            continue;
+        }
+        posix_spawn_file_actions_t fa;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_addopen(&fa, 1, log, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        posix_spawn_file_actions_adddup2(&fa, 1, 2);
+        char *argv[] = { g_srv.compiler, in, out, NULL };
+        if (posix_spawn(&pr->pid, g_srv.compiler, &fa, NULL, argv, environ) != 0) {
+            pr->pid = -1;
+            snprintf(pr->err, sizeof(pr->err), "无法启动编译器");
+            unlink(in);
+            unlink(log);
+        }
+        posix_spawn_file_actions_destroy(&fa);
+    }
+    int spawned = 0;
+    for (int i = 0; i < np; i++) {
+        Prog *pr = &progs[i];
+        if (pr->cached) continue;
+        if (pr->first->kind == SRC_QBC) {
+            decode_into(pr, (const uint8_t *)pr->first->src, pr->first->len);
+            continue;
+        }
+        if (pr->pid <= 0) continue;
+        spawned++;
+        int status;
+        while (waitpid(pr->pid, &status, 0) < 0 && errno == EINTR) {}
+        char in[160], out[160], log[160];
+        snprintf(in, sizeof(in), "%s.qentl", pr->base);
+        snprintf(out, sizeof(out), "%s.qbc", pr->base);
+        snprintf(log, sizeof(log), "%s.log", pr->base);
+        // 编译器把警告写在标准输出里，原样转给前端
+        FILE *f = fopen(log, "r");
+        char line[512];
+        while (f && fgets(line, sizeof(line), f)) {
+            char *w = strstr(line, "警告");
+            if (!w) continue;
+            line[strcspn(line, "\n")] = '\0';
+            snprintf(pr->warning, sizeof(pr->warning), "%s", line);
+            break;
+        }
+        if (f) fclose(f);
+        QsmMap m;
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0 && qsm_map_file(out, &m) == 0) {
+            decode_into(pr, (const uint8_t *)m.data, m.size);
+            qsm_unmap_file(&m);
+        } else {
+            snprintf(pr->err, sizeof(pr->err), "编译失败（退出码 %d）", WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        }
+        unlink(in);
+        unlink(out);
+        unlink(log);
+    }
+    double el = now_sec() - t0;
+    for (int i = 0; i < np; i++)
+        if (!progs[i].cached) progs[i].compile_ms = el * 1e3;
+    if (spawned) g_srv.mt.compile_ns += (uint64_t)(el * 1e9);
+    pthread_mutex_lock(&g_srv.mu);
+    g_srv.compiles += (uint64_t)spawned;
+    g_srv.compile_sec += el;
+    pthread_mutex_unlock(&g_srv.mu);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+typedef struct {
+    uint64_t v, n;
+} Count;
+
+static int cmp_count(const void *a, const void *b) {
+    const Count *x = a, *y = b;
+    return x->n != y->n ? (x->n < y->n ? 1 : -1) : (x->v > y->v) - (x->v < y->v);
+}
+
+// 把基态下标投影到结果位上，高位在左
+static void bits_of(uint64_t v, int nbits, char *out) {
+    for (int q = 0; q < nbits; q++) out[nbits - 1 - q] = (v >> q) & 1 ? '1' : '0';
+    out[nbits] = '\0';
+}
+
+// 抽样并写 result 事件；末态的 probs / measured 部分已在 head 里
+static void finish_job(Job *j, const QvmState *st, const int *qs, int nm, const Str *head, double sim_ms,
+                       int shared) {
+    Str o = { 0 };
+    str_printf(&o, "{\"event\":\"result\",\"job\":%llu,", (unsigned long long)j->id);
+    str_put(&o, head->data, head->len);
+    if (j->shots > 0) {
+        uint64_t *idx = malloc((size_t)j->shots * sizeof(uint64_t));
+        qvm_sample(st, j->seed, (size_t)j->shots, idx);
+        for (long s = 0; s < j->shots; s++) {
+            uint64_t v = 0;
+            for (int b = 0; b < nm; b++) v |= (idx[s] >> qs[b] & 1) << b;
+            idx[s] = v;
+        }
+        qsort(idx, (size_t)j->shots, sizeof(uint64_t), cmp_u64);
+        Count *cs = malloc((size_t)j->shots * sizeof(Count));
+        size_t nc = 0;
+        for (long s = 0; s < j->shots; s++) {
+            if (nc && cs[nc - 1].v == idx[s]) cs[nc - 1].n++;
+            else cs[nc++] = (Count){ idx[s], 1 };
+        }
+        qsort(cs, nc, sizeof(Count), cmp_count);
+        str_printf(&o, ",\"shots\":%ld,\"distinct\":%zu,\"counts\":{", j->shots, nc);
+        for (size_t c = 0; c < nc && c < TOP_COUNTS; c++) {
+            char bits[QVM_MAX_REGS + 1];
+            bits_of(cs[c].v, nm, bits);
+            str_printf(&o, "%s\"%s\":%llu", c ? "," : "", bits, (unsigned long long)cs[c].n);
+        }
+        str_put(&o, "}", 1);
+        free(cs);
+        free(idx);
+    }
+    str_printf(&o, ",\"sim_ms\":%.3f,\"shared\":%d,\"latency_ms\":%.3f}", sim_ms, shared,
+               (now_sec() - j->arrived) * 1e3);
+    emit(j, &o, ST_DONE);
+    free(o.data);
+}
+
+static void run_prog(Prog *pr, Job **batch, int n) {
+    const QvmCircuit *qc = pr->cached ? &pr->cached->qc : &pr->own;
+    double t0 = now_sec();
+    QvmState st;
+    if (qvm_state_init(&st, qc->nqubits) != 0) {
+        for (int i = 0; i < n; i++)
+            if (batch[i]->key == pr->first->key) emit_error(batch[i], "内存不足");
+        return;
+    }
+    qvm_run(&st, qc);
+    double sim_ms = (now_sec() - t0) * 1e3;
+    g_srv.mt.gates += (uint64_t)qc->ngates;
+    g_srv.mt.sim_ns += (uint64_t)(sim_ms * 1e6);
+    g_srv.mt.state_bytes = st.dim * 2 * sizeof(double);
+    // 有 MEASURE 时报告寄存器，否则报告全部比特
+    int label[QVM_MAX_REGS], qs[QVM_MAX_REGS];
+    int nm = qvm_outputs(qc, label, qs);
+    Str head = { 0 };
+    size_t top[TOP_STATES];
+    int ntop = qvm_top(&st, top, TOP_STATES);
+    str_printf(&head, "\"qubits\":%d,\"gates\":%d,\"probs\":{", st.nqubits, qc->ngates);
+    for (int t = 0; t < ntop; t++) {
+        char bits[QVM_MAX_QUBITS + 1];
+        bits_of(top[t], st.nqubits, bits);
+        str_printf(&head, "%s\"%s\":%.6f", t ? "," : "", bits, qvm_prob(&st, top[t]));
+    }
+    str_put(&head, "},\"measured\":{", 14);
+    for (int b = 0; b < nm; b++)
+        str_printf(&head, "%s\"%d\":%.6f", b ? "," : "", label[b], qvm_prob_one(&st, qs[b]));
+    str_put(&head, "}", 1);
+    int shared = 0;
+    for (int i = 0; i < n; i++) shared += !batch[i]->failed && batch[i]->key == pr->first->key;
+    for (int i = 0; i < n; i++)
+        if (!batch[i]->failed && batch[i]->key == pr->first->key) finish_job(batch[i], &st, qs, nm, &head, sim_ms, shared);
+    free(head.data);
+    qvm_state_free(&st);
+    pthread_mutex_lock(&g_srv.mu);
+    g_srv.sims++;
+    g_srv.sim_sec += sim_ms * 1e-3;
+    pthread_mutex_unlock(&g_srv.mu);
+}
+
+static void process_batch(Job **batch, int n) {
+    Prog *progs = calloc((size_t)n, sizeof(Prog));
+    int np = 0;
+    uint64_t hits = 0, misses = 0;
+    g_srv.tick++;
+    for (int i = 0; i < n; i++) {
+        Job *j = batch[i];
+        int k = 0;
+        for (; k < np; k++)
+            if (progs[k].first->key == j->key) break;
+        if (k < np) continue;
+        progs[np].first = j;
+        progs[np].cached = cache_find(j->key);
+        if (progs[np].cached) hits++;
+        else misses++;
+        np++;
+    }
+    compile_all(progs, np);
+
+    Str o = { 0 };
+    for (int k = 0; k < np; k++) {
+        Prog *pr = &progs[k];
+        const QvmCircuit *qc = pr->cached ? &pr->cached->qc : &pr->own;
+        for (int i = 0; i < n; i++) {
+            Job *j = batch[i];
+            if (j->key != pr->first->key) continue;
+            if (!pr->cached && !pr->ok) {
+                emit_error(j, pr->err[0] ? pr->err : "编译失败");
+                continue;
+            }
+            str_printf(&o, "{\"event\":\"compiled\",\"job\":%llu,\"cached\":%s,\"bytes\":%zu,\"qubits\":%d,"
+                       "\"gates\":%d,\"compile_ms\":%.3f", (unsigned long long)j->id, pr->cached ? "true" : "false",
+                       pr->cached ? pr->cached->bytes : pr->bytes, qc->nqubits, qc->ngates, pr->compile_ms);
+            if (pr->warning[0]) {
+                str_put(&o, ",\"warning\":", 11);
+                str_json(&o, pr->warning, strlen(pr->warning));
+            }
+            str_put(&o, "}", 1);
+            emit(j, &o, ST_COMPILED);
+        }
+    }
+    free(o.data);
+    for (int k = 0; k < np; k++)
+        if (progs[k].cached || progs[k].ok) run_prog(&progs[k], batch, n);
+    for (int k = 0; k < np; k++)
+        if (!progs[k].cached && progs[k].ok) cache_put(progs[k].first->key, &progs[k].own, progs[k].bytes);
+
+    pthread_mutex_lock(&g_srv.mu);
+    double t = now_sec();
+    for (int i = 0; i < n; i++) {
+        g_srv.lat[g_srv.lat_n % LAT_RING] = t - batch[i]->arrived;
+        g_srv.lat_at[g_srv.lat_n % LAT_RING] = t;
+        g_srv.lat_n++;
+        g_srv.errors += (uint64_t)batch[i]->failed;
+        g_srv.mt.errors += (uint64_t)batch[i]->failed;
+        qsm_metrics_observe(&g_srv.mt, t - batch[i]->arrived);
+    }
+    for (int i = 0; i < n; i++) batch[i]->released = 1;
+    pthread_cond_broadcast(&g_srv.progress);
+    g_srv.jobs += (uint64_t)n;
+    g_srv.batches++;
+    g_srv.cache_hits += hits;
+    g_srv.cache_misses += misses;
+    if ((uint64_t)n > g_srv.max_batch_seen) g_srv.max_batch_seen = (uint64_t)n;
+    g_srv.mt.queue_depth = (uint64_t)g_srv.depth;
+    pthread_mutex_unlock(&g_srv.mu);
+    free(progs);
+
+    g_srv.mt.jobs = (uint64_t)n;
+    g_srv.mt.cache_hits = hits;
+    g_srv.mt.cache_misses = misses;
+    qsm_metrics_publish(g_srv.metrics, &g_srv.mt);
+    uint64_t state_bytes = g_srv.mt.state_bytes;    // 量表保留到下一次模拟
+    memset(&g_srv.mt, 0, sizeof(g_srv.mt));
+    g_srv.mt.state_bytes = state_bytes;
+}
+
+static void *batch_thread(void *arg) {
+    (void)arg;
+    Job **batch = malloc((size_t)g_srv.max_batch * sizeof(Job *));
+    pthread_mutex_lock(&g_srv.mu);
+    for (;;) {
+        while (!g_srv.head && !atomic_load(&g_srv.stop)) pthread_cond_wait(&g_srv.nonempty, &g_srv.mu);
+        if (!g_srv.head) break;
+        double deadline = g_srv.head->arrived + g_srv.max_wait;
+        while (g_srv.depth < g_srv.max_batch && !atomic_load(&g_srv.stop)) {
+            double idle = g_srv.last_arrival + g_srv.max_wait / 8;
+            double left = (idle < deadline ? idle : deadline) - now_sec();
+            if (left <= 0) break;
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            long ns = ts.tv_nsec + (long)(left * 1e9);
+            ts.tv_sec += ns / 1000000000L;
+            ts.tv_nsec = ns % 1000000000L;
+            pthread_cond_timedwait(&g_srv.nonempty, &g_srv.mu, &ts);
+        }
+        int n = 0;
+        while (g_srv.head && n < g_srv.max_batch) {
+            batch[n++] = g_srv.head;
+            g_srv.head = g_srv.head->next;
+            g_srv.depth--;
+        }
+        if (!g_srv.head) g_srv.tail = NULL;
+        pthread_mutex_unlock(&g_srv.mu);
+        process_batch(batch, n);
+        pthread_mutex_lock(&g_srv.mu);
+    }
+    pthread_mutex_unlock(&g_srv.mu);
+    free(batch);
+    return NULL;
+}
+
+static int submit(Job *j) {
+    j->arrived = now_sec();
+    pthread_mutex_lock(&g_srv.mu);
+    if (g_srv.tail) g_srv.tail->next = j;
+    else g_srv.head = j;
+    g_srv.tail = j;
+    int depth = ++g_srv.depth;
+    g_srv.last_arrival = j->arrived;
+    if (depth == 1 || depth >= g_srv.max_batch) pthread_cond_signal(&g_srv.nonempty);
+    pthread_mutex_unlock(&g_srv.mu);
+    return depth;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void stats_json(Str *o) {
+    pthread_mutex_lock(&g_srv.mu);
+    size_t n = g_srv.lat_n < LAT_RING ? (size_t)g_srv.lat_n : LAT_RING;
+    double *v = malloc((n ? n : 1) * sizeof(double));
+    double t = now_sec();
+    size_t recent = 0;
+    for (size_t i = 0; i < n; i++) {
+        v[i] = g_srv.lat[i];
+        recent += t - g_srv.lat_at[i] <= 10.0;
+    }
+    struct {
+        uint64_t jobs, errors, batches, max_batch_seen, sims, compiles, cache_hits, cache_misses;
+        double compile_sec, sim_sec;
+        int depth, ncache;
+    } s = { g_srv.jobs, g_srv.errors, g_srv.batches, g_srv.max_batch_seen, g_srv.sims, g_srv.compiles,
+            g_srv.cache_hits, g_srv.cache_misses, g_srv.compile_sec, g_srv.sim_sec, g_srv.depth, g_srv.ncache };
+    pthread_mutex_unlock(&g_srv.mu);
+    qsort(v, n, sizeof(double), cmp_double);
+    double up = t - g_srv.started;
+    str_printf(o, "{\"uptime_s\":%.1f,\"jobs\":%llu,\"errors\":%llu,\"batches\":%llu,\"avg_batch\":%.2f,"
+               "\"max_batch\":%llu,\"queue_depth\":%d,",
+               up, (unsigned long long)s.jobs, (unsigned long long)s.errors, (unsigned long long)s.batches,
+               s.batches ? (double)s.jobs / (double)s.batches : 0, (unsigned long long)s.max_batch_seen, s.depth);
+    str_printf(o, "\"simulations\":%llu,\"sim_ms_total\":%.1f,\"compiles\":%llu,\"compile_ms_total\":%.1f,",
+               (unsigned long long)s.sims, s.sim_sec * 1e3, (unsigned long long)s.compiles, s.compile_sec * 1e3);
+    str_printf(o, "\"compile_cache\":{\"entries\":%d,\"hits\":%llu,\"misses\":%llu},", s.ncache,
+               (unsigned long long)s.cache_hits, (unsigned long long)s.cache_misses);
+    str_printf(o, "\"latency_ms\":{\"p50\":%.3f,\"p99\":%.3f,\"max\":%.3f,\"window\":%zu},",
+               n ? v[n / 2] * 1e3 : 0, n ? v[(size_t)((double)(n - 1) * 0.99)] * 1e3 : 0, n ? v[n - 1] * 1e3 : 0, n);
+    str_printf(o, "\"throughput_jps\":{\"total\":%.1f,\"last_10s\":%.1f}}",
+               up > 0 ? (double)s.jobs / up : 0, (double)recent / (up < 10 ? (up > 0 ? up : 1) : 10));
+    free(v);
+}
+
+// ==================== HTTP ====================
+
+typedef struct {
+    const char *qentl, *qbc, *circuit;
+    size_t qentl_len, qbc_len, circuit_len;
+    char *buf;
+    size_t used, cap;
+} Body;
+
+static int on_field(void *ud, const char *key, size_t klen, const char *raw, size_t rlen, int depth) {
+    Body *b = ud;
+    if (depth != 1 || !key) return 0;
+    const char **dst = NULL;
+    size_t *dlen = NULL;
+    if (klen == 5 && memcmp(key, "qentl", 5) == 0) { dst = &b->qentl; dlen = &b->qentl_len; }
+    else if (klen == 3 && memcmp(key, "qbc", 3) == 0) { dst = &b->qbc; dlen = &b->qbc_len; }
+    else if (klen == 7 && memcmp(key, "circuit", 7) == 0) { dst = &b->circuit; dlen = &b->circuit_len; }
+    if (!dst || b->used + rlen + 1 > b->cap) return 0;
+    char *s = b->buf + b->used;
+    *dlen = qsm_json_unescape(raw, rlen, s);
+    s[*dlen] = '\0';
+    *dst = s;
+    b->used += *dlen + 1;
+    return 0;
+}
+
+// qsm_json_scan 只回调字符串值，数字字段单独找：键前不能是反斜杠（那是字符串里转义的引号）
+static int json_number(const char *p, size_t n, const char *key, double *out) {
+    size_t kl = strlen(key);
+    for (const char *q = p; (q = memmem(q, (size_t)(p + n - q), key, kl)) != NULL; q += kl) {
+        if (q == p || q[-1] != '"' || (q - p >= 2 && q[-2] == '\\') || q + kl >= p + n || q[kl] != '"') continue;
+        const char *v = q + kl + 1;
+        while (v < p + n && (*v == ' ' || *v == '\t' || *v == '\n' || *v == '\r')) v++;
+        if (v >= p + n || *v != ':') continue;
+        char *stop;
+        *out = strtod(v + 1, &stop);
+        return stop != v + 1 ? 0 : -1;
+    }
+    return -1;
+}
+
+static int send_all(int fd, const char *p, size_t n) {
+    while (n) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0) {
+            if (w < 0 && errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+// ==================== 来源检查 ====================
+
+typedef struct {
+    int fd;
+    int keep;
+    char origin[256];           // 允许的 Origin，原样回显；空串表示请求没带 Origin
+} Conn;
+
+// host[:port] 是否指向本机回环地址
+static int host_is_local(const char *h, size_t n) {
+    size_t l = n;
+    if (n && h[0] == '[') {
+        const char *e = memchr(h, ']', n);
+        l = e ? (size_t)(e - h) + 1 : n;
+    } else {
+        const char *e = memchr(h, ':', n);
+        if (e) l = (size_t)(e - h);
+    }
+    if (l < n && h[l] != ':') return 0;
+    return (l == 9 && strncasecmp(h, "localhost", 9) == 0) || (l == 9 && memcmp(h, "127.0.0.1", 9) == 0) ||
+           (l == 5 && memcmp(h, "[::1]", 5) == 0);
+}
+
+// 本机回环地址上的页面（web 应用自己）或 -O 指定的来源
+static int origin_allowed(const char *o, size_t n) {
+    for (int i = 0; i < g_srv.norigins; i++)
+        if (strlen(g_srv.origins[i]) == n && memcmp(g_srv.origins[i], o, n) == 0) return 1;
+    if (n > 7 && memcmp(o, "http://", 7) == 0) return host_is_local(o + 7, n - 7);
+    if (n > 8 && memcmp(o, "https://", 8) == 0) return host_is_local(o + 8, n - 8);
+    return 0;
+}
+
+static int cors_headers(const Conn *c, char *out, size_t cap) {
+    if (!c->origin[0]) return snprintf(out, cap, "%s", "");
+    return snprintf(out, cap, "Access-Control-Allow-Origin: %s\r\nVary: Origin\r\n"
+                    "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\nAccess-Control-Allow-Headers: Content-Type\r\n",
+                    c->origin);
+}
+
+static int respond(Conn *c, int status, const char *body, size_t n) {
+    const char *reason = status == 200 ? "OK" : status == 204 ? "No Content" : status == 400 ? "Bad Request"
+                       : status == 403 ? "Forbidden" : status == 404 ? "Not Found" : status == 413 ? "Payload Too Large"
+                       : status == 503 ? "Service Unavailable" : "Error";
+    char cors[512], hdr[1024];
+    cors_headers(c, cors, sizeof(cors));
+    int h = snprintf(hdr, sizeof(hdr),
+                     "HTTP/1.1 %d %s\r\nContent-Type: application/json; charset=utf-8\r\nContent-Length: %zu\r\n"
+                     "%sConnection: %s\r\n\r\n", status, reason, n, cors, c->keep ? "keep-alive" : "close");
+    if (send_all(c->fd, hdr, (size_t)h) != 0) return -1;
+    return n ? send_all(c->fd, body, n) : 0;
+}
+
+static int error_json(Conn *c, int status, const char *msg) {
+    Str o = { 0 };
+    str_put(&o, "{\"error\":", 9);
+    str_json(&o, msg, strlen(msg));
+    str_put(&o, "}", 1);
+    int r = respond(c, status, o.data, o.len);
+    free(o.data);
+    return r;
+}
+
+static int send_chunk(int fd, const char *p, size_t n) {
+    char h[32];
+    int l = snprintf(h, sizeof(h), "%zx\r\n", n);
+    if (send_all(fd, h, (size_t)l) != 0 || send_all(fd, p, n) != 0) return -1;
+    return send_all(fd, "\r\n", 2);
+}
+
+// 提交作业并把事件逐块写回；客户端中途断开也要等作业结束再释放
+static int stream_job(Conn *c, Job *j) {
+    int fd = c->fd;
+    char cors[512], hdr[1024];
+    cors_headers(c, cors, sizeof(cors));
+    int h = snprintf(hdr, sizeof(hdr),
+                     "HTTP/1.1 200 OK\r\nContent-Type: application/x-ndjson; charset=utf-8\r\n"
+                     "Transfer-Encoding: chunked\r\nCache-Control: no-cache\r\n%sConnection: %s\r\n\r\n",
+                     cors, c->keep ? "keep-alive" : "close");
+    int alive = send_all(fd, hdr, (size_t)h) == 0;
+    j->id = atomic_fetch_add(&g_srv.next_id, 1) + 1;
+    int depth = submit(j);
+    char q[96];
+    int ql = snprintf(q, sizeof(q), "{\"event\":\"queued\",\"job\":%llu,\"depth\":%d}\n", (unsigned long long)j->id, depth);
+    alive = alive && send_chunk(fd, q, (size_t)ql) == 0;
+    Str pending = { 0 };
+    pthread_mutex_lock(&g_srv.mu);
+    for (;;) {
+        while (j->ev.len == 0 && j->stage != ST_DONE) pthread_cond_wait(&g_srv.progress, &g_srv.mu);
+        Str ev = j->ev;
+        j->ev = pending;
+        int done = j->stage == ST_DONE;
+        pthread_mutex_unlock(&g_srv.mu);
+        if (ev.len) alive = alive && send_chunk(fd, ev.data, ev.len) == 0;
+        pending = ev;
+        pending.len = 0;
+        if (done) break;
+        pthread_mutex_lock(&g_srv.mu);
+    }
+    pthread_mutex_lock(&g_srv.mu);
+    while (!j->released) pthread_cond_wait(&g_srv.progress, &g_srv.mu);
+    pthread_mutex_unlock(&g_srv.mu);
+    free(pending.data);
+    free(j->ev.data);
+    alive = alive && send_all(fd, "0\r\n\r\n", 5) == 0;
+    return alive ? 0 : -1;
+}
+
+static int handle(Conn *c, const char *method, const char *path, const char *body, size_t blen) {
+    if (strcmp(method, "OPTIONS") == 0) return respond(c, 204, NULL, 0);
+    Str o = { 0 };
+    int r;
+    if (strcmp(method, "GET") == 0 && strcmp(path, "/api/qvm/health") == 0) {
+        str_printf(&o, "{\"status\":\"ok\",\"backend\":\"native\",\"max_qubits\":%d,\"compiler\":%s,\"max_batch\":%d,\"circuits\":%u}",
+                   g_srv.max_qubits, g_srv.has_compiler ? "true" : "false", g_srv.max_batch,
+                   g_srv.pack ? qvm_pack_count(g_srv.pack) : 0);
+        r = respond(c, 200, o.data, o.len);
+        free(o.data);
+        return r;
+    }
+    if (strcmp(method, "GET") == 0 && strcmp(path, "/api/qvm/stats") == 0) {
+        stats_json(&o);
+        r = respond(c, 200, o.data, o.len);
+        free(o.data);
+        return r;
+    }
+    if (strcmp(method, "POST") != 0 || strcmp(path, "/api/qvm/jobs") != 0) return error_json(c, 404, "未知接口");
+
+    Body b;
+    memset(&b, 0, sizeof(b));
+    b.cap = blen + 16;
+    b.buf = malloc(b.cap);
+    if (qsm_json_scan(body, body + blen, on_field, &b) < 0) {
+        free(b.buf);
+        return error_json(c, 400, "请求体不是有效 JSON");
+    }
+    Job j;
+    memset(&j, 0, sizeof(j));
+    double v;
+    j.shots = json_number(body, blen, "shots", &v) == 0 ? (long)v : 1024;
+    j.seed = json_number(body, blen, "seed", &v) == 0 ? (uint64_t)v : (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)&j;
+    const char *bad = NULL;
+    int status = 400;
+    if (b.qentl) {
+        j.kind = SRC_QENTL;
+        j.src = (char *)b.qentl;
+        j.len = b.qentl_len;
+        if (!g_srv.has_compiler) { bad = "编译器不可用，只能提交 qbc 字节码"; status = 503; }
+    } else if (b.qbc) {
+        long n = b64_decode((char *)b.qbc, b.qbc_len);
+        j.kind = SRC_QBC;
+        j.src = (char *)b.qbc;
+        j.len = n > 0 ? (size_t)n : 0;
+        if (n <= 0) bad = "qbc 不是有效的 base64";
+    } else if (b.circuit) {
+        const QvmPackEntry *e = g_srv.pack ? qvm_pack_find(g_srv.pack, b.circuit, b.circuit_len) : NULL;
+        j.kind = SRC_QBC;
+        if (e) {
+            j.src = (char *)qvm_pack_data(g_srv.pack, e);
+            j.len = e->size;
+        } else {
+            bad = g_srv.pack ? "归档里没有这条线路" : "未载入线路归档（-P）";
+            status = 404;
+        }
+    } else bad = "缺少 qentl、qbc 或 circuit 字段";
+    if (!bad && (j.shots < 0 || j.shots > MAX_SHOTS)) bad = "shots 超出范围";
+    if (bad) {
+        free(b.buf);
+        return error_json(c, status, bad);
+    }
+    j.key = qsm_mix64(qsm_hash64(j.src, j.len, (uint64_t)j.kind + 0x51564D));
+    r = stream_job(c, &j);
+    free(b.buf);
+    return r;
+}
+
+static void *conn_thread(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    size_t cap = 64 * 1024, have = 0;
+    char *buf = malloc(cap + 1);
+    for (;;) {
+        char *hend = NULL;
+        while (!(hend = have ? memmem(buf, have, "\r\n\r\n", 4) : NULL)) {
+            if (have == cap) goto out;
+            ssize_t r = recv(fd, buf + have, cap - have, 0);
+            if (r <= 0) goto out;
+            have += (size_t)r;
+        }
+        *hend = '\0';
+        char method[16], path[256];
+        if (sscanf(buf, "%15s %255s", method, path) != 2) break;
+        size_t clen = 0;
+        Conn c = { .fd = fd, .keep = strstr(buf, "HTTP/1.1") != NULL };
+        int host_ok = 1, origin_ok = 1;
+        for (char *line = strstr(buf, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+            if (strncasecmp(line + 2, "Content-Length:", 15) == 0) clen = strtoul(line + 17, NULL, 10);
+            else if (strncasecmp(line + 2, "Connection:", 11) == 0) {
+                const char *v = line + 13;
+                while (*v == ' ') v++;
+                if (strncasecmp(v, "close", 5) == 0) c.keep = 0;
+                else if (strncasecmp(v, "keep-alive", 10) == 0) c.keep = 1;
+            } else if (strncasecmp(line + 2, "Host:", 5) == 0 || strncasecmp(line + 2, "Origin:", 7) == 0) {
+                int is_host = (line[2] | 0x20) == 'h';
+                const char *v = line + (is_host ? 7 : 9);
+                while (*v == ' ') v++;
+                const char *e = strstr(v, "\r\n");
+                size_t n = e ? (size_t)(e - v) : strlen(v);
+                while (n && v[n - 1] == ' ') n--;
+                if (is_host) host_ok = host_is_local(v, n);
+                else if (!(origin_ok = origin_allowed(v, n) && n < sizeof(c.origin))) c.origin[0] = '\0';
+                else snprintf(c.origin, sizeof(c.origin), "%.*s", (int)n, v);
+            }
+        }
+        // 浏览器总会带 Host；不是本机名说明是经 DNS 重绑定打过来的
+        if (!host_ok || !origin_ok) {
+            c.keep = 0;
+            error_json(&c, 403, host_ok ? "来源不在允许列表" : "Host 不是本机");
+            break;
+        }
+        char *q = strchr(path, '?');
+        if (q) *q = '\0';
+        size_t hlen = (size_t)(hend - buf) + 4;
+        if (clen > MAX_BODY) {
+            c.keep = 0;
+            error_json(&c, 413, "请求体过大");
+            break;
+        }
+        if (hlen + clen > cap) {
+            cap = hlen + clen;
+            buf = realloc(buf, cap + 1);
+        }
+        while (have < hlen + clen) {
+            ssize_t r = recv(fd, buf + have, cap - have, 0);
+            if (r <= 0) goto out;
+            have += (size_t)r;
+        }
+        if (handle(&c, method, path, buf + hlen, clen) != 0 || !c.keep) break;
+        memmove(buf, buf + hlen + clen, have - hlen - clen);
+        have -= hlen + clen;
+    }
+out:
+    close(fd);
+    free(buf);
+    return NULL;
+}
+
+static void *accept_thread(void *arg) {
+    int lfd = (int)(intptr_t)arg;
+    for (;;) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));   // Unix 套接字上会失败，无妨
+        pthread_t th;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        pthread_attr_setstacksize(&attr, 256 * 1024);
+        if (pthread_create(&th, &attr, conn_thread, (void *)(intptr_t)fd) != 0) close(fd);
+        pthread_attr_destroy(&attr);
+    }
+    return NULL;
+}
+
+// ==================== 自测客户端 ====================
+
+typedef struct {
+    int port;
+    int n;
+    int id;
+    int failures;
+    double *lat;
+} Client;
+
+// 发一个请求，读到分块结束（或 Content-Length 读满）为止，返回状态码
+static int http_call(int fd, const char *method, const char *path, const char *body, Str *resp) {
+    Str req = { 0 };
+    str_printf(&req, "%s %s HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n",
+               method, path, body ? strlen(body) : 0);
+    if (body) str_put(&req, body, strlen(body));
+    int r = send_all(fd, req.data, req.len);
+    free(req.data);
+    if (r != 0) return -1;
+    resp->len = 0;
+    char tmp[16384];
+    for (;;) {
+        char *hend = resp->len ? memmem(resp->data, resp->len, "\r\n\r\n", 4) : NULL;
+        if (hend) {
+            if (strcasestr(resp->data, "Transfer-Encoding: chunked")) {
+                if (resp->len >= (size_t)(hend - resp->data) + 4 + 5 &&
+                    memcmp(resp->data + resp->len - 5, "0\r\n\r\n", 5) == 0) break;
+            } else {
+                const char *cl = strcasestr(resp->data, "Content-Length:");
+                if ((size_t)(hend - resp->data) + 4 + (cl ? strtoul(cl + 15, NULL, 10) : 0) <= resp->len) break;
+            }
+        }
+        ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) return -1;
+        str_put(resp, tmp, (size_t)n);
+    }
+    return atoi(resp->data + 9);
+}
+
+static int connect_local(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&a, sizeof(a)) != 0) { close(fd); return -1; }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// GHZ_k：末态只有 0...0 与 1...1，各 1/2
+static void *client_thread(void *arg) {
+    Client *c = arg;
+    int fd = connect_local(c->port);
+    if (fd < 0) { c->failures = c->n; return NULL; }
+    Str resp = { 0 }, body = { 0 }, src = { 0 };
+    uint64_t rng = qsm_mix64((uint64_t)c->id + 1);
+    for (int i = 0; i < c->n; i++) {
+        rng = qsm_mix64(rng);
+        int k = 2 + (int)(rng % 9);
+        src.len = body.len = 0;
+        if (i % 2 == 0) {
+            str_printf(&src, "# GHZ %d\ninit %d\nH 0\n", k, k);
+            for (int q = 1; q < k; q++) str_printf(&src, "CNOT %d %d\n", q - 1, q);
+            for (int q = 0; q < k; q++) str_printf(&src, "MEASURE %d %d\n", q, q);
+            str_put(&body, "{\"qentl\":", 9);
+            str_json(&body, src.data, src.len);
+        } else {
+            uint8_t qbc[256];
+            size_t n = 0;
+            qbc[n++] = QVM_OP_INIT_N; qbc[n++] = (uint8_t)k; qbc[n++] = 0;
+            qbc[n++] = QVM_OP_H; qbc[n++] = 0;
+            for (int q = 1; q < k; q++) { qbc[n++] = QVM_OP_CNOT; qbc[n++] = (uint8_t)(q - 1); qbc[n++] = (uint8_t)q; }
+            qbc[n++] = QVM_OP_STOP;
+            char b64[400];
+            size_t e = b64_encode(qbc, n, b64);
+            str_printf(&body, "{\"qbc\":\"%.*s\"", (int)e, b64);
+        }
+        str_printf(&body, ",\"shots\":256,\"seed\":%d}", i);
+        double t0 = now_sec();
+        int st = http_call(fd, "POST", "/api/qvm/jobs", body.data, &resp);
+        c->lat[i] = now_sec() - t0;
+        if (st < 0) { c->failures += c->n - i; break; }
+        char zeros[40], ones[40];
+        snprintf(zeros, sizeof(zeros), "\"%.*s\":0.500000", k, "0000000000000000");
+        snprintf(ones, sizeof(ones), "\"%.*s\":0.500000", k, "1111111111111111");
+        if (st != 200 || !strstr(resp.data, "\"event\":\"result\"") || !strstr(resp.data, zeros) || !strstr(resp.data, ones))
+            c->failures++;
+    }
+    free(resp.data);
+    free(body.data);
+    free(src.data);
+    close(fd);
+    return NULL;
+}
+
+static int selftest(int port, int total, int nclients) {
+    if (nclients < 1) nclients = 1;
+    Client *cs = calloc((size_t)nclients, sizeof(Client));
+    pthread_t *th = malloc((size_t)nclients * sizeof(pthread_t));
+    double t0 = now_sec();
+    for (int i = 0; i < nclients; i++) {
+        cs[i].port = port;
+        cs[i].id = i;
+        cs[i].n = total / nclients + (i < total % nclients);
+        cs[i].lat = calloc(cs[i].n ? (size_t)cs[i].n : 1, sizeof(double));
+        pthread_create(&th[i], NULL, client_thread, &cs[i]);
+    }
+    int failures = 0, n = 0;
+    double *all = malloc((total ? (size_t)total : 1) * sizeof(double));
+    for (int i = 0; i < nclients; i++) {
+        pthread_join(th[i], NULL);
+        failures += cs[i].failures;
+        memcpy(all + n, cs[i].lat, (size_t)cs[i].n * sizeof(double));
+        n += cs[i].n;
+        free(cs[i].lat);
+    }
+    double el = now_sec() - t0;
+    qsort(all, (size_t)n, sizeof(double), cmp_double);
+    fprintf(stdout, "[QVM] 自测: %d 个作业, %d 个连接, 失败 %d, %.2fs (%.0f 作业/秒), 客户端 p50 %.3f ms, p99 %.3f ms\n",
+            n, nclients, failures, el, n / el, n ? all[n / 2] * 1e3 : 0, n ? all[(size_t)((n - 1) * 0.99)] * 1e3 : 0);
+    int fd = connect_local(port);
+    Str resp = { 0 };
+    if (fd >= 0 && http_call(fd, "GET", "/api/qvm/stats", NULL, &resp) == 200)
+        fprintf(stdout, "[QVM] 服务端: %s\n", strstr(resp.data, "\r\n\r\n") + 4);
+    if (fd >= 0) close(fd);
+    free(resp.data);
+    free(all);
+    free(cs);
+    free(th);
+    rmdir(g_srv.tmpdir);
+    return failures ? 1 : 0;
+}
+
+// 路径上已有文件时只清掉连不上的旧套接字；普通文件或还有服务在听的套接字都不动
+static int listen_unix(const char *path) {
+    struct sockaddr_un a = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(a.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(a.sun_path, path);
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            errno = EEXIST;
+            return -1;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe < 0) return -1;
+        int live = connect(probe, (struct sockaddr *)&a, sizeof(a)) == 0 || errno != ECONNREFUSED;
+        close(probe);
+        if (live) {
+            errno = EADDRINUSE;
+            return -1;
+        }
+        unlink(path);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (bind(fd, (struct sockaddr *)&a, sizeof(a)) != 0 || chmod(path, 0600) != 0 || listen(fd, 128) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char *argv[]) {
+    int port = 8100, selftest_n = 0, clients = 8;
+    const char *unix_path = NULL, *compiler = NULL, *pack = NULL;
+    g_srv.max_qubits = 22;
+    g_srv.max_batch = 16;
+    g_srv.max_wait = 2000e-6;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (i + 1 >= argc) goto usage;
+        if (strcmp(a, "-p") == 0) port = atoi(argv[++i]);
+        else if (strcmp(a, "-u") == 0) unix_path = argv[++i];
+        else if (strcmp(a, "-C") == 0) compiler = argv[++i];
+        else if (strcmp(a, "-P") == 0) pack = argv[++i];
+        else if (strcmp(a, "-Q") == 0) g_srv.max_qubits = atoi(argv[++i]);
+        else if (strcmp(a, "-B") == 0) g_srv.max_batch = atoi(argv[++i]);
+        else if (strcmp(a, "-W") == 0) g_srv.max_wait = atof(argv[++i]) * 1e-6;
+        else if (strcmp(a, "--selftest") == 0) selftest_n = atoi(argv[++i]);
+        else if (strcmp(a, "-c") == 0) clients = atoi(argv[++i]);
+        else if (strcmp(a, "-O") == 0 && g_srv.norigins < MAX_ORIGINS) g_srv.origins[g_srv.norigins++] = argv[++i];
+        else goto usage;
+    }
+    if (g_srv.max_batch < 1 || g_srv.max_qubits < 1 || g_srv.max_qubits > QVM_MAX_QUBITS) goto usage;
+
+    // 默认用与本程序同目录的 qentl_compiler
+    if (compiler) snprintf(g_srv.compiler, sizeof(g_srv.compiler), "%s", compiler);
+    else {
+        char self[480];
+        ssize_t l = readlink("/proc/self/exe", self, sizeof(self) - 1);
+        self[l > 0 ? l : 0] = '\0';
+        snprintf(g_srv.compiler, sizeof(g_srv.compiler), "%s/qentl_compiler", l > 0 ? dirname(self) : ".");
+    }
+    g_srv.has_compiler = access(g_srv.compiler, X_OK) == 0;
+    if (pack) {
+        const char *err;
+        if (!(g_srv.pack = qvm_pack_open(pack, QVM_PACK_VERIFY, &err))) {
+            fprintf(stderr, "[QVM] 无法载入线路归档 %s: %s\n", pack, err);
+            return 1;
+        }
+    }
+    snprintf(g_srv.tmpdir, sizeof(g_srv.tmpdir), "/tmp/qvm_jobs.XXXXXX");
+    if (!mkdtemp(g_srv.tmpdir)) {
+        fprintf(stderr, "[QVM] 无法创建临时目录: %s\n", strerror(errno));
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)(selftest_n ? 0 : port)) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, 128) != 0 ||
+        getsockname(lfd, (struct sockaddr *)&addr, &alen) != 0) {
+        fprintf(stderr, "[QVM] 无法监听 127.0.0.1:%d: %s\n", port, strerror(errno));
+        return 1;
+    }
+    port = ntohs(addr.sin_port);
+    int ufd = -1;
+    if (unix_path && (ufd = listen_unix(unix_path)) < 0) {
+        fprintf(stderr, "[QVM] 无法监听 Unix 套接字 %s: %s\n", unix_path, strerror(errno));
+        return 1;
+    }
+
+    pthread_mutex_init(&g_srv.mu, NULL);
+    pthread_cond_init(&g_srv.nonempty, NULL);
+    pthread_cond_init(&g_srv.progress, NULL);
+    atomic_init(&g_srv.stop, 0);
+    atomic_init(&g_srv.next_id, 0);
+    g_srv.started = now_sec();
+    if (!selftest_n)    // 自测的作业不计入真实指标
+        g_srv.metrics = qsm_metrics_attach(qsm_metrics_open(1), "qvm_job_server");
+    pthread_t bt, at, ut;
+    pthread_create(&bt, NULL, batch_thread, NULL);
+    pthread_create(&at, NULL, accept_thread, (void *)(intptr_t)lfd);
+    if (ufd >= 0) pthread_create(&ut, NULL, accept_thread, (void *)(intptr_t)ufd);
+    fprintf(stdout, "[QVM] 监听 127.0.0.1:%d%s%s, 编译器 %s%s, 最多 %d 比特, 微批 %d / %.1f ms",
+            port, ufd >= 0 ? " 与 " : "", ufd >= 0 ? unix_path : "", g_srv.compiler,
+            g_srv.has_compiler ? "" : "（不可用，只接受 qbc）", g_srv.max_qubits, g_srv.max_batch, g_srv.max_wait * 1e3);
+    if (g_srv.pack) fprintf(stdout, ", 归档 %s（%u 条线路）", pack, qvm_pack_count(g_srv.pack));
+    fputc('\n', stdout);
+    fflush(stdout);
+    if (selftest_n > 0) return selftest(port, selftest_n, clients);
+    pthread_join(at, NULL);
+    return 0;
+
+usage:
+    fprintf(stderr, "用法: %s [-p 8100] [-u 套接字] [-C qentl_compiler] [-Q 22] [-B 16] [-W 2000] [-P circuits.qpk] [-O 来源]... [--selftest N [-c 8]]\n", argv[0]);
+    fprintf(stderr, "\n本机原生 QVM 作业服务：编译 .qentl 或直接载入 .qbc，在态矢量执行器上运行，\n");
+    fprintf(stderr, "POST /api/qvm/jobs 以 NDJSON 流式返回 queued / compiled / result 事件\n");
+    fprintf(stderr, "跨域只接受本机回环地址上的页面；-O https://example.org 额外允许一个来源（可重复）\n");
+    return 1;
+}
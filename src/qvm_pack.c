@@ -0,0 +1,201 @@
+/*
+ * qvm_pack.c — 线路字节码归档实现
+ */
+#define _GNU_SOURCE
+#include "qvm_pack.h"
+#include "qsm_jsonl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HASH_SEED 0x71706b31ULL
+
+static int name_cmp(const char *a, size_t al, const char *b, size_t bl) {
+    int c = memcmp(a, b, al < bl ? al : bl);
+    return c ? c : (al > bl) - (al < bl);
+}
+
+// ==================== 写 ====================
+
+typedef struct {
+    const char *const *names;
+    const uint32_t *lens;
+} SortCtx;
+
+static int cmp_order(const void *a, const void *b, void *ud) {
+    const SortCtx *s = ud;
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return name_cmp(s->names[x], s->lens[x], s->names[y], s->lens[y]);
+}
+
+int qvm_pack_write(const char *path, const char *const *names, const uint8_t *const *data,
+                   const uint32_t *sizes, uint32_t n) {
+    uint32_t *order = malloc((n + 1) * sizeof(uint32_t)), *lens = malloc((n + 1) * sizeof(uint32_t));
+    QvmPackEntry *ents = calloc(n + 1, sizeof(QvmPackEntry));
+    char *tmp = NULL;
+    FILE *f = NULL;
+    int rc = -1;
+    if (!order || !lens || !ents || asprintf(&tmp, "%s.tmp", path) < 0) goto out;
+    for (uint32_t i = 0; i < n; i++) {
+        order[i] = i;
+        lens[i] = (uint32_t)strlen(names[i]);
+    }
+    SortCtx sc = { names, lens };
+    qsort_r(order, n, sizeof(uint32_t), cmp_order, &sc);
+    for (uint32_t i = 1; i < n; i++) {
+        if (cmp_order(&order[i - 1], &order[i], &sc) == 0) {
+            rc = -2;
+            goto out;
+        }
+    }
+
+    // 先排好偏移再一次写出；名字区每个名字后带 '\0'，方便直接当 C 字符串用
+    QvmPackHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = QVM_PACK_MAGIC;
+    h.version = QVM_PACK_VERSION;
+    h.count = n;
+    h.index_off = sizeof(h);
+    h.names_off = h.index_off + (uint64_t)n * sizeof(QvmPackEntry);
+    for (uint32_t i = 0; i < n; i++) {
+        QvmPackEntry *e = &ents[i];
+        e->name_off = (uint32_t)h.names_size;
+        e->name_len = lens[order[i]];
+        h.names_size += e->name_len + 1;
+    }
+    uint64_t pos = h.names_off + h.names_size;
+    for (uint32_t i = 0; i < n; i++) {
+        QvmPackEntry *e = &ents[i];
+        pos = (pos + QVM_PACK_ALIGN - 1) / QVM_PACK_ALIGN * QVM_PACK_ALIGN;
+        e->off = pos;
+        e->size = sizes[order[i]];
+        e->hash = qsm_hash64(data[order[i]], e->size, HASH_SEED);
+        pos += e->size;
+    }
+    h.file_size = pos;
+
+    char *names_buf = malloc(h.names_size + 1);
+    if (!names_buf) goto out;
+    for (uint32_t i = 0; i < n; i++) memcpy(names_buf + ents[i].name_off, names[order[i]], ents[i].name_len + 1);
+    uint64_t hs = qsm_hash64(ents, (size_t)n * sizeof(QvmPackEntry), HASH_SEED);
+    h.index_hash = qsm_hash64(names_buf, h.names_size, hs);
+
+    int failed = (f = fopen(tmp, "wb")) == NULL;
+    if (!failed) {
+        static const uint8_t zero[QVM_PACK_ALIGN] = { 0 };
+        failed |= fwrite(&h, sizeof(h), 1, f) != 1;
+        failed |= n && fwrite(ents, sizeof(QvmPackEntry), n, f) != n;
+        failed |= fwrite(names_buf, 1, h.names_size, f) != h.names_size;
+        pos = h.names_off + h.names_size;
+        for (uint32_t i = 0; i < n && !failed; i++) {
+            size_t pad = (size_t)(ents[i].off - pos);
+            failed |= pad && fwrite(zero, 1, pad, f) != pad;
+            failed |= ents[i].size && fwrite(data[order[i]], 1, ents[i].size, f) != ents[i].size;
+            pos = ents[i].off + ents[i].size;
+        }
+        failed |= fclose(f) != 0;
+    }
+    free(names_buf);
+    if (!failed && rename(tmp, path) == 0) rc = 0;
+    else remove(tmp);
+out:
+    free(order);
+    free(lens);
+    free(ents);
+    free(tmp);
+    return rc;
+}
+
+// ==================== 读 ====================
+
+struct QvmPack {
+    QsmMap map;
+    const QvmPackHeader *h;
+    const QvmPackEntry *ents;
+    const char *names;
+};
+
+QvmPack *qvm_pack_open(const char *path, int flags, const char **err) {
+    const char *why = NULL;
+    QvmPack *pk = calloc(1, sizeof(*pk));
+    if (!pk) return NULL;
+    if (qsm_map_file(path, &pk->map) != 0) { why = "无法映射文件"; goto fail; }
+    if (pk->map.size < sizeof(QvmPackHeader)) { why = "文件过短"; goto fail; }
+    pk->h = (const QvmPackHeader *)pk->map.data;
+    if (pk->h->magic != QVM_PACK_MAGIC) { why = "不是 .qpk 归档"; goto fail; }
+    if (pk->h->version != QVM_PACK_VERSION) { why = "版本不支持"; goto fail; }
+    if (pk->h->file_size != pk->map.size) { why = "文件长度与文件头不符（被截断？）"; goto fail; }
+    uint64_t index_bytes = (uint64_t)pk->h->count * sizeof(QvmPackEntry);
+    if (pk->h->index_off != sizeof(QvmPackHeader) || pk->h->names_off != pk->h->index_off + index_bytes ||
+        pk->h->names_off + pk->h->names_size > pk->map.size || pk->h->names_size > UINT32_MAX) {
+        why = "索引越界";
+        goto fail;
+    }
+    pk->ents = (const QvmPackEntry *)(pk->map.data + pk->h->index_off);
+    pk->names = pk->map.data + pk->h->names_off;
+    uint64_t hs = qsm_hash64(pk->ents, index_bytes, HASH_SEED);
+    if (qsm_hash64(pk->names, pk->h->names_size, hs) != pk->h->index_hash) { why = "索引校验失败"; goto fail; }
+    uint64_t data_lo = pk->h->names_off + pk->h->names_size;
+    for (uint32_t i = 0; i < pk->h->count; i++) {
+        const QvmPackEntry *e = &pk->ents[i];
+        if (e->off % QVM_PACK_ALIGN || e->off < data_lo || e->off + e->size > pk->map.size ||
+            (uint64_t)e->name_off + e->name_len >= pk->h->names_size || pk->names[e->name_off + e->name_len] != '\0' ||
+            (i && name_cmp(pk->names + e[-1].name_off, e[-1].name_len, pk->names + e->name_off, e->name_len) >= 0)) {
+            why = "条目描述无效";
+            goto fail;
+        }
+    }
+    if ((flags & QVM_PACK_VERIFY) && qvm_pack_verify(pk) != 0) { why = "字节码校验失败"; goto fail; }
+    if (err) *err = NULL;
+    return pk;
+fail:
+    if (err) *err = why;
+    qvm_pack_close(pk);
+    return NULL;
+}
+
+void qvm_pack_close(QvmPack *pk) {
+    if (!pk) return;
+    qsm_unmap_file(&pk->map);
+    free(pk);
+}
+
+uint32_t qvm_pack_count(const QvmPack *pk) {
+    return pk->h->count;
+}
+
+const QvmPackEntry *qvm_pack_entry(const QvmPack *pk, uint32_t i) {
+    return i < pk->h->count ? &pk->ents[i] : NULL;
+}
+
+const QvmPackEntry *qvm_pack_find(const QvmPack *pk, const char *name, size_t len) {
+    uint32_t lo = 0, hi = pk->h->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const QvmPackEntry *e = &pk->ents[mid];
+        int c = name_cmp(pk->names + e->name_off, e->name_len, name, len);
+        if (c == 0) return e;
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+const char *qvm_pack_name(const QvmPack *pk, const QvmPackEntry *e) {
+    return pk->names + e->name_off;
+}
+
+const uint8_t *qvm_pack_data(const QvmPack *pk, const QvmPackEntry *e) {
+    return (const uint8_t *)pk->map.data + e->off;
+}
+
+int qvm_pack_verify_entry(const QvmPack *pk, const QvmPackEntry *e) {
+    return qsm_hash64(pk->map.data + e->off, e->size, HASH_SEED) == e->hash ? 0 : -1;
+}
+
+int qvm_pack_verify(const QvmPack *pk) {
+    int bad = 0;
+    for (uint32_t i = 0; i < pk->h->count; i++) bad += qvm_pack_verify_entry(pk, &pk->ents[i]) != 0;
+    return bad;
+}
@@ -0,0 +1,72 @@
+/*
+ * qvm_pack.h — 线路字节码归档（.qpk）
+ *
+ * reports/ 下是十几个 12～38 字节的 .qbc，大一点的工程树里有成千上万个，
+ * 逐个 open / stat 的开销比字节码本身还大，小文件也各占一个 inode 和一个块。
+ * .qpk 把它们打成一个文件：
+ *
+ *   64 字节文件头 + 条目索引（按名字字节序排好）+ 名字区 + 各线路字节码（起点 16 字节对齐）
+ *
+ * 名字是线路在源目录里的相对路径去掉 .qbc（如 bell、sub/ghz）。每条字节码有 64 位内容哈希，
+ * 索引与名字区的哈希记在文件头里。打开只映射文件、校验文件头与索引；按名字二分查找，
+ * 返回的字节码直接指向映射区，交给 qvm_decode 时不拷贝。
+ */
+#ifndef QVM_PACK_H
+#define QVM_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define QVM_PACK_MAGIC 0x314B5051u  // "QPK1"
+#define QVM_PACK_VERSION 1
+#define QVM_PACK_ALIGN 16
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t pad;
+    uint64_t file_size;
+    uint64_t index_off;         // QvmPackEntry[count]
+    uint64_t names_off;         // 名字区，紧跟索引
+    uint64_t names_size;
+    uint64_t index_hash;        // 索引 + 名字区
+    uint64_t reserved;
+} QvmPackHeader;
+
+typedef struct {
+    uint64_t off;               // 相对文件起点，QVM_PACK_ALIGN 对齐
+    uint32_t size;
+    uint32_t name_off;          // 相对名字区起点
+    uint32_t name_len;          // 不含结尾 '\0'
+    uint32_t pad;
+    uint64_t hash;
+} QvmPackEntry;
+
+// ==================== 写 ====================
+
+// 写到 path.tmp，成功后改名。names 不能重复；返回 0 成功，-1 写失败，-2 名字重复
+int qvm_pack_write(const char *path, const char *const *names, const uint8_t *const *data,
+                   const uint32_t *sizes, uint32_t n);
+
+// ==================== 读 ====================
+
+#define QVM_PACK_VERIFY 1
+
+typedef struct QvmPack QvmPack;
+
+// 失败返回 NULL，err 写入原因（可为 NULL）
+QvmPack *qvm_pack_open(const char *path, int flags, const char **err);
+void qvm_pack_close(QvmPack *pk);
+
+uint32_t qvm_pack_count(const QvmPack *pk);
+const QvmPackEntry *qvm_pack_entry(const QvmPack *pk, uint32_t i);
+const QvmPackEntry *qvm_pack_find(const QvmPack *pk, const char *name, size_t len);
+const char *qvm_pack_name(const QvmPack *pk, const QvmPackEntry *e);
+const uint8_t *qvm_pack_data(const QvmPack *pk, const QvmPackEntry *e);
+
+// 逐条核对内容哈希，返回不一致的条数；单条一致返回 0
+int qvm_pack_verify(const QvmPack *pk);
+int qvm_pack_verify_entry(const QvmPack *pk, const QvmPackEntry *e);
+
+#endif
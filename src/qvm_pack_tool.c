@@ -0,0 +1,390 @@
+/*
+ * qvm_pack_tool.c — 线路字节码归档（.qpk）打包与执行
+ *
+ * pack   把目录树（或逐个列出的）.qbc 打成一个 .qpk，名字是相对路径去掉 .qbc；
+ * list   列出各条线路、大小与偏移（-v 同时逐条校验）；
+ * verify 逐条核对内容哈希；
+ * run    映射归档、按名字二分查到字节码，零拷贝交给 qvm_exec 解码执行，打印末态与抽样；
+ * bench  同一批线路逐个 open/read .qbc 与从归档按名字取，比较每条的载入 + 解码耗时。
+ *
+ * 用法: qvm_pack_tool pack -o <out.qpk> <目录|file.qbc>...
+ *       qvm_pack_tool list [-v] <file.qpk>
+ *       qvm_pack_tool verify <file.qpk>
+ *       qvm_pack_tool run [-s 1024] [--seed N] <file.qpk> <名字>...
+ *       qvm_pack_tool bench [-r 200] <目录> <file.qpk>
+ */
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "qsm_jsonl.h"
+#include "qvm_exec.h"
+#include "qvm_pack.h"
+
+#define TOP_STATES 8
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ==================== 收集 .qbc ====================
+
+typedef struct {
+    char **paths, **names;
+    int n, cap;
+} FileList;
+
+static int has_suffix(const char *s, const char *suf) {
+    size_t n = strlen(s), m = strlen(suf);
+    return n > m && strcmp(s + n - m, suf) == 0;
+}
+
+static void list_add(FileList *l, const char *path, const char *name) {
+    if (l->n == l->cap) {
+        l->cap = l->cap ? l->cap * 2 : 64;
+        l->paths = realloc(l->paths, (size_t)l->cap * sizeof(char *));
+        l->names = realloc(l->names, (size_t)l->cap * sizeof(char *));
+    }
+    l->paths[l->n] = strdup(path);
+    l->names[l->n] = strndup(name, strlen(name) - 4);      // 去掉 .qbc
+    l->n++;
+}
+
+// prefix 为相对 root 的目录前缀（顶层为空）
+static void collect_dir(FileList *l, const char *dir, const char *prefix) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+    for (struct dirent *e; (e = readdir(d));) {
+        if (e->d_name[0] == '.') continue;
+        char path[4096], name[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        snprintf(name, sizeof(name), "%s%s", prefix, e->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            strcat(name, "/");
+            collect_dir(l, path, name);
+        } else if (S_ISREG(st.st_mode) && has_suffix(e->d_name, ".qbc")) {
+            list_add(l, path, name);
+        }
+    }
+    closedir(d);
+}
+
+static void list_free(FileList *l) {
+    for (int i = 0; i < l->n; i++) {
+        free(l->paths[i]);
+        free(l->names[i]);
+    }
+    free(l->paths);
+    free(l->names);
+}
+
+// ==================== pack ====================
+
+static int cmd_pack(int argc, char **argv) {
+    const char *out = NULL;
+    FileList fl = { 0 };
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out = argv[++i];
+            continue;
+        }
+        struct stat st;
+        if (stat(argv[i], &st) != 0) {
+            fprintf(stderr, "[QPK] 找不到 %s\n", argv[i]);
+            list_free(&fl);
+            return 1;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            collect_dir(&fl, argv[i], "");
+        } else {
+            const char *base = strrchr(argv[i], '/');
+            base = base ? base + 1 : argv[i];
+            if (!has_suffix(base, ".qbc")) {
+                fprintf(stderr, "[QPK] 不是 .qbc: %s\n", argv[i]);
+                list_free(&fl);
+                return 1;
+            }
+            list_add(&fl, argv[i], base);
+        }
+    }
+    if (!out || fl.n == 0) {
+        fprintf(stderr, "用法: qvm_pack_tool pack -o <out.qpk> <目录|file.qbc>...\n");
+        list_free(&fl);
+        return 1;
+    }
+    double t0 = now_sec();
+    QsmMap *maps = calloc((size_t)fl.n, sizeof(QsmMap));
+    const uint8_t **data = malloc((size_t)fl.n * sizeof(uint8_t *));
+    uint32_t *sizes = malloc((size_t)fl.n * sizeof(uint32_t));
+    uint64_t loose = 0;
+    int rc = 1;
+    for (int i = 0; i < fl.n; i++) {
+        if (qsm_map_file(fl.paths[i], &maps[i]) != 0 || maps[i].size > UINT32_MAX) {
+            fprintf(stderr, "[QPK] 无法读取 %s\n", fl.paths[i]);
+            goto out;
+        }
+        data[i] = (const uint8_t *)maps[i].data;
+        sizes[i] = (uint32_t)maps[i].size;
+        struct stat st;
+        if (stat(fl.paths[i], &st) == 0) loose += (uint64_t)st.st_blocks * 512;
+    }
+    int r = qvm_pack_write(out, (const char *const *)fl.names, data, sizes, (uint32_t)fl.n);
+    if (r == -2) {
+        fprintf(stderr, "[QPK] 线路名字重复（同名 .qbc 来自不同参数？）\n");
+        goto out;
+    }
+    if (r != 0) {
+        fprintf(stderr, "[QPK] 写入失败: %s\n", out);
+        goto out;
+    }
+    struct stat st;
+    stat(out, &st);
+    fprintf(stdout, "[QPK] %s: %d 条线路, %lld 字节（原先 %d 个文件占 %.1f KB 磁盘）, %.1f ms\n", out, fl.n,
+            (long long)st.st_size, fl.n, loose / 1024.0, (now_sec() - t0) * 1e3);
+    rc = 0;
+out:
+    for (int i = 0; i < fl.n; i++) qsm_unmap_file(&maps[i]);
+    free(maps);
+    free(data);
+    free(sizes);
+    list_free(&fl);
+    return rc;
+}
+
+// ==================== list / verify ====================
+
+static QvmPack *open_or_die(const char *path, int flags, double *ms) {
+    const char *err;
+    double t0 = now_sec();
+    QvmPack *pk = qvm_pack_open(path, flags, &err);
+    if (ms) *ms = (now_sec() - t0) * 1e3;
+    if (!pk) fprintf(stderr, "[QPK] %s: %s\n", path, err);
+    return pk;
+}
+
+static int cmd_list(int argc, char **argv) {
+    int verify = argc == 2 && strcmp(argv[0], "-v") == 0;
+    if (argc != 1 + verify) {
+        fprintf(stderr, "用法: qvm_pack_tool list [-v] <file.qpk>\n");
+        return 1;
+    }
+    double ms;
+    QvmPack *pk = open_or_die(argv[verify], verify ? QVM_PACK_VERIFY : 0, &ms);
+    if (!pk) return 1;
+    for (uint32_t i = 0; i < qvm_pack_count(pk); i++) {
+        const QvmPackEntry *e = qvm_pack_entry(pk, i);
+        fprintf(stdout, "  %-32s %5u B @%llu\n", qvm_pack_name(pk, e), e->size, (unsigned long long)e->off);
+    }
+    fprintf(stdout, "[QPK] %u 条线路, 打开%s %.3f ms\n", qvm_pack_count(pk), verify ? "并校验" : "", ms);
+    qvm_pack_close(pk);
+    return 0;
+}
+
+static int cmd_verify(int argc, char **argv) {
+    if (argc != 1) {
+        fprintf(stderr, "用法: qvm_pack_tool verify <file.qpk>\n");
+        return 1;
+    }
+    QvmPack *pk = open_or_die(argv[0], 0, NULL);
+    if (!pk) return 1;
+    int bad = qvm_pack_verify(pk);
+    for (uint32_t i = 0; bad && i < qvm_pack_count(pk); i++) {
+        const QvmPackEntry *e = qvm_pack_entry(pk, i);
+        if (qvm_pack_verify_entry(pk, e) != 0) fprintf(stdout, "  校验失败: %s\n", qvm_pack_name(pk, e));
+    }
+    fprintf(stdout, "[QPK] %s: %u 条线路, %s\n", argv[0], qvm_pack_count(pk), bad ? "校验失败" : "校验通过");
+    qvm_pack_close(pk);
+    return bad ? 1 : 0;
+}
+
+// ==================== run ====================
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// 基态下标写成比特串，高位在左
+static void bits_of(uint64_t v, int nbits, char *out) {
+    for (int q = 0; q < nbits; q++) out[nbits - 1 - q] = (v >> q) & 1 ? '1' : '0';
+    out[nbits] = '\0';
+}
+
+static int run_one(const QvmPack *pk, const char *name, long shots, uint64_t seed) {
+    double t0 = now_sec();
+    const QvmPackEntry *e = qvm_pack_find(pk, name, strlen(name));
+    double t1 = now_sec();
+    if (!e) {
+        fprintf(stderr, "[QPK] 归档里没有线路 %s\n", name);
+        return 1;
+    }
+    if (qvm_pack_verify_entry(pk, e) != 0) {
+        fprintf(stderr, "[QPK] %s: 字节码校验失败\n", name);
+        return 1;
+    }
+    QvmCircuit qc;
+    int r = qvm_decode(qvm_pack_data(pk, e), e->size, QVM_MAX_QUBITS, &qc);
+    double t2 = now_sec();
+    if (r != 0) {
+        fprintf(stderr, "[QPK] %s: %s\n", name, r == -2 ? "比特数超出上限" : "字节码非法");
+        return 1;
+    }
+    QvmState st;
+    if (qvm_state_init(&st, qc.nqubits) != 0) {
+        fprintf(stderr, "[QPK] %s: 态矢量内存不足（%d 比特）\n", name, qc.nqubits);
+        qvm_circuit_free(&qc);
+        return 1;
+    }
+    qvm_run(&st, &qc);
+    double t3 = now_sec();
+    fprintf(stdout, "[QPK] %s: %d 比特, %d 门, 查找 %.1f µs, 解码 %.1f µs, 模拟 %.1f µs\n", name, qc.nqubits,
+            qc.ngates, (t1 - t0) * 1e6, (t2 - t1) * 1e6, (t3 - t2) * 1e6);
+    size_t top[TOP_STATES];
+    int ntop = qvm_top(&st, top, TOP_STATES);
+    for (int t = 0; t < ntop; t++) {
+        char bits[QVM_MAX_QUBITS + 1];
+        bits_of(top[t], st.nqubits, bits);
+        fprintf(stdout, "  |%s⟩ %.6f\n", bits, qvm_prob(&st, top[t]));
+    }
+    if (shots > 0) {
+        // 有 MEASURE 时统计寄存器（高位是编号大的寄存器），否则统计全部比特
+        int label[QVM_MAX_REGS], qs[QVM_MAX_REGS];
+        int nm = qvm_outputs(&qc, label, qs);
+        uint64_t *idx = malloc((size_t)shots * sizeof(uint64_t));
+        qvm_sample(&st, seed, (size_t)shots, idx);
+        for (long s = 0; s < shots; s++) {
+            uint64_t v = 0;
+            for (int b = 0; b < nm; b++) v |= (idx[s] >> qs[b] & 1) << b;
+            idx[s] = v;
+        }
+        qsort(idx, (size_t)shots, sizeof(uint64_t), cmp_u64);
+        fprintf(stdout, "  抽样 %ld 次:", shots);
+        for (long s = 0, c = 1; s < shots; s++, c++) {
+            if (s + 1 < shots && idx[s + 1] == idx[s]) continue;
+            char bits[QVM_MAX_REGS + 1];
+            bits_of(idx[s], nm, bits);
+            fprintf(stdout, " %s:%ld", bits, c);
+            c = 0;
+        }
+        fputc('\n', stdout);
+        free(idx);
+    }
+    qvm_state_free(&st);
+    qvm_circuit_free(&qc);
+    return 0;
+}
+
+static int cmd_run(int argc, char **argv) {
+    long shots = 1024;
+    uint64_t seed = (uint64_t)time(NULL);
+    int i = 0;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (strcmp(argv[i], "-s") == 0) shots = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0) seed = strtoull(argv[i + 1], NULL, 10);
+        else break;
+    }
+    if (argc - i < 2 || shots < 0) {
+        fprintf(stderr, "用法: qvm_pack_tool run [-s 1024] [--seed N] <file.qpk> <名字>...\n");
+        return 1;
+    }
+    double ms;
+    QvmPack *pk = open_or_die(argv[i], 0, &ms);
+    if (!pk) return 1;
+    fprintf(stdout, "[QPK] 打开 %s: %u 条线路, %.3f ms\n", argv[i], qvm_pack_count(pk), ms);
+    int bad = 0;
+    for (int k = i + 1; k < argc; k++) bad |= run_one(pk, argv[k], shots, seed);
+    qvm_pack_close(pk);
+    return bad;
+}
+
+// ==================== bench ====================
+
+static int cmd_bench(int argc, char **argv) {
+    int rounds = 200, i = 0;
+    if (argc >= 2 && strcmp(argv[0], "-r") == 0) {
+        rounds = atoi(argv[1]);
+        i = 2;
+    }
+    if (argc - i != 2 || rounds < 1) {
+        fprintf(stderr, "用法: qvm_pack_tool bench [-r 200] <目录> <file.qpk>\n");
+        return 1;
+    }
+    FileList fl = { 0 };
+    collect_dir(&fl, argv[i], "");
+    QvmPack *pk = open_or_die(argv[i + 1], 0, NULL);
+    if (!pk || fl.n == 0) {
+        if (!fl.n) fprintf(stderr, "[QPK] %s 下没有 .qbc\n", argv[i]);
+        list_free(&fl);
+        qvm_pack_close(pk);
+        return 1;
+    }
+    // 两边都是「拿到字节 + 解码」，页缓存都是热的；差别只在逐个 open/fstat/read/close 与一次二分查找
+    uint8_t buf[65536];
+    int gates_loose = 0, gates_pack = 0, missing = 0;
+    double t0 = now_sec();
+    for (int r = 0; r < rounds; r++) {
+        for (int f = 0; f < fl.n; f++) {
+            int fd = open(fl.paths[f], O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size > sizeof(buf)) {
+                if (fd >= 0) close(fd);
+                continue;
+            }
+            ssize_t n = read(fd, buf, (size_t)st.st_size);
+            close(fd);
+            QvmCircuit qc;
+            if (n >= 0 && qvm_decode(buf, (size_t)n, QVM_MAX_QUBITS, &qc) == 0) {
+                gates_loose += qc.ngates;
+                qvm_circuit_free(&qc);
+            }
+        }
+    }
+    double t1 = now_sec();
+    for (int r = 0; r < rounds; r++) {
+        for (int f = 0; f < fl.n; f++) {
+            const QvmPackEntry *e = qvm_pack_find(pk, fl.names[f], strlen(fl.names[f]));
+            QvmCircuit qc;
+            if (!e) {
+                missing += r == 0;
+                continue;
+            }
+            if (qvm_decode(qvm_pack_data(pk, e), e->size, QVM_MAX_QUBITS, &qc) == 0) {
+                gates_pack += qc.ngates;
+                qvm_circuit_free(&qc);
+            }
+        }
+    }
+    double t2 = now_sec(), per = (double)rounds * fl.n;
+    fprintf(stdout, "[QPK] %d 条线路 × %d 轮: 逐个文件 %.2f µs/条, 归档 %.2f µs/条, %.1fx\n", fl.n, rounds,
+            (t1 - t0) * 1e6 / per, (t2 - t1) * 1e6 / per, (t1 - t0) / (t2 - t1 > 0 ? t2 - t1 : 1e-9));
+    if (missing || gates_loose != gates_pack)
+        fprintf(stdout, "[QPK] 警告: 归档与目录不一致（%d 条线路不在归档里）\n", missing);
+    list_free(&fl);
+    qvm_pack_close(pk);
+    return missing || gates_loose != gates_pack;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "pack") == 0) return cmd_pack(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "list") == 0) return cmd_list(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "verify") == 0) return cmd_verify(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "run") == 0) return cmd_run(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) return cmd_bench(argc - 2, argv + 2);
+    fprintf(stderr, "用法: %s pack -o <out.qpk> <目录|file.qbc>...\n", argv[0]);
+    fprintf(stderr, "      %s list [-v] <file.qpk>\n", argv[0]);
+    fprintf(stderr, "      %s verify <file.qpk>\n", argv[0]);
+    fprintf(stderr, "      %s run [-s 1024] [--seed N] <file.qpk> <名字>...\n", argv[0]);
+    fprintf(stderr, "      %s bench [-r 200] <目录> <file.qpk>\n", argv[0]);
+    fprintf(stderr, "\n线路字节码归档：按名字排序的索引 + 16 字节对齐、带校验的字节码，mmap 后按名字零拷贝执行\n");
+    return 1;
+}
@@ -0,0 +1,758 @@
+/*
+ * yi_bpe_trainer.c — 三语语料子词词表训练器（BPE）
+ *
+ * 流程：
+ *   1. 多线程扫描 data 目录下的 *.jsonl，预切词后写入线程本地分片哈希表；
+ *      第二步按分片并行归并（每个分片只由一个线程写，无锁）。
+ *   2. 以码点为基础符号：滇川黔贵通用彝文 PUA 码点永远是原子符号，
+ *      不会像字节级 BPE 那样被拆成 4 个 UTF-8 字节。
+ *   3. 增量合并：pair → 出现词表 + 最大堆（惰性失效），每轮只更新
+ *      受影响词的相邻 pair，不重新全量统计。
+ *
+ * 内存：-w 限制进入合并阶段的词数（位置链表、pair 表按它分配），也限制阶段 1 的词频表：
+ * 线程本地表与归并表各自最多 2N 个词，装满时按频次淘汰低频的一半（有损计数，
+ * 被淘汰词之后再出现从头计）。被淘汰词的码点计数记进固定大小的 g_cp_spill，
+ * 基础符号与其频次仍覆盖全部语料。
+ *
+ * 输出 <prefix>.vocab（token\t频次，按 id 顺序）与 <prefix>.merges（左 右）。
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "qsm_jsonl.h"
+
+#define NUM_SHARDS 64
+#define MAX_WORD_CP 16
+#define SPACE_MARK 0x2581   // ▁ ：前导空格标记（同 sentencepiece）
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ==================== 词频分片哈希表 ====================
+
+typedef struct {
+    uint64_t hash;
+    uint32_t off;
+    uint32_t len;
+    uint64_t count;
+} WordEnt;
+
+typedef struct {
+    WordEnt *ents;
+    size_t cap;
+    size_t n;
+    size_t limit;         // 词数上限，到了就淘汰低频词
+    char *arena;
+    size_t arena_len;
+    size_t arena_cap;
+} WordTab;
+
+static uint64_t *g_cp_spill;            // 被淘汰词按码点累计的频次 [0x110000]
+static atomic_ullong g_evicted;
+
+static void wt_init(WordTab *t, size_t cap) {
+    t->cap = cap;
+    t->n = 0;
+    t->limit = 0;
+    t->ents = calloc(cap, sizeof(WordEnt));
+    t->arena_cap = cap * 8;
+    t->arena = malloc(t->arena_cap);
+    t->arena_len = 0;
+}
+
+static void wt_free(WordTab *t) {
+    free(t->ents);
+    free(t->arena);
+    memset(t, 0, sizeof(*t));
+}
+
+static void wt_grow(WordTab *t) {
+    size_t ncap = t->cap * 2;
+    WordEnt *ne = calloc(ncap, sizeof(WordEnt));
+    for (size_t i = 0; i < t->cap; i++) {
+        if (!t->ents[i].len) continue;
+        size_t j = t->ents[i].hash & (ncap - 1);
+        while (ne[j].len) j = (j + 1) & (ncap - 1);
+        ne[j] = t->ents[i];
+    }
+    free(t->ents);
+    t->ents = ne;
+    t->cap = ncap;
+}
+
+// 阈值从 1 起翻倍，直到留下的词不超过上限的一半；淘汰词的频次摊到各码点上
+static void wt_prune(WordTab *t) {
+    uint64_t thresh = 1;
+    for (;;) {
+        size_t keep = 0;
+        for (size_t i = 0; i < t->cap; i++) keep += t->ents[i].len && t->ents[i].count > thresh;
+        if (keep <= t->limit / 2) break;
+        thresh *= 2;
+    }
+    WordEnt *ne = calloc(t->cap, sizeof(WordEnt));
+    char *na = malloc(t->arena_cap);
+    size_t nlen = 0, n = 0;
+    for (size_t i = 0; i < t->cap; i++) {
+        WordEnt *e = &t->ents[i];
+        if (!e->len) continue;
+        const char *w = t->arena + e->off;
+        if (e->count <= thresh) {
+            for (const char *p = w, *end = w + e->len; p < end;) {
+                uint32_t cp;
+                p += qsm_utf8_next(p, end, &cp);
+                if (cp >= 0x110000) cp = 0xFFFD;
+                __atomic_fetch_add(&g_cp_spill[cp], e->count, __ATOMIC_RELAXED);
+            }
+            continue;
+        }
+        size_t j = e->hash & (t->cap - 1);
+        while (ne[j].len) j = (j + 1) & (t->cap - 1);
+        ne[j] = *e;
+        ne[j].off = (uint32_t)nlen;
+        memcpy(na + nlen, w, e->len);
+        nlen += e->len;
+        n++;
+    }
+    atomic_fetch_add(&g_evicted, t->n - n);
+    free(t->ents);
+    free(t->arena);
+    t->ents = ne;
+    t->arena = na;
+    t->arena_len = nlen;
+    t->n = n;
+}
+
+static void wt_add(WordTab *t, const char *w, uint32_t len, uint64_t h, uint64_t count) {
+    if ((t->n + 1) * 4 > t->cap * 3) wt_grow(t);
+    size_t j = h & (t->cap - 1);
+    while (t->ents[j].len) {
+        WordEnt *e = &t->ents[j];
+        if (e->hash == h && e->len == len && memcmp(t->arena + e->off, w, len) == 0) {
+            e->count += count;
+            return;
+        }
+        j = (j + 1) & (t->cap - 1);
+    }
+    if (t->limit && t->n >= t->limit) {
+        wt_prune(t);
+        j = h & (t->cap - 1);
+        while (t->ents[j].len) j = (j + 1) & (t->cap - 1);
+    }
+    if (t->arena_len + len > t->arena_cap) {
+        while (t->arena_len + len > t->arena_cap) t->arena_cap *= 2;
+        t->arena = realloc(t->arena, t->arena_cap);
+    }
+    memcpy(t->arena + t->arena_len, w, len);
+    t->ents[j].hash = h;
+    t->ents[j].off = (uint32_t)t->arena_len;
+    t->ents[j].len = len;
+    t->ents[j].count = count;
+    t->arena_len += len;
+    t->n++;
+}
+
+// ==================== 阶段 1：并行预切词与计数 ====================
+
+typedef struct {
+    const QsmChunk *chunks;
+    int nchunks;
+    atomic_int next;
+    int nthreads;
+    WordTab *local;       // [nthreads][NUM_SHARDS]
+    WordTab global[NUM_SHARDS];
+    size_t local_limit, global_limit;
+    atomic_ullong records;
+    atomic_ullong bad;
+} CountJob;
+
+typedef struct {
+    WordTab *shards;
+    char *buf;
+    size_t buf_cap;
+    char word[MAX_WORD_CP * 4 + 4];
+    int wlen;
+    int wcp;
+} CountCtx;
+
+static void flush_word(CountCtx *c) {
+    if (c->wlen == 0) return;
+    uint64_t h = qsm_hash64(c->word, (size_t)c->wlen, 0);
+    wt_add(&c->shards[h % NUM_SHARDS], c->word, (uint32_t)c->wlen, h, 1);
+    c->wlen = 0;
+    c->wcp = 0;
+}
+
+// 预切词：空白切分；文字类别变化处切分；标点单独成词；
+// 拉丁/数字词若前面有空白则带 ▁ 前缀；过长的连续汉字/彝文按 MAX_WORD_CP 截段
+static void pretokenize(CountCtx *c, const char *s, size_t len) {
+    const char *p = s, *end = s + len;
+    int cls = -1, pending_space = 0;
+    while (p < end) {
+        uint32_t cp;
+        p += qsm_utf8_next(p, end, &cp);
+        QsmScript sc = qsm_script_of(cp);
+        if (sc == QSM_SCRIPT_SPACE) {
+            flush_word(c);
+            cls = -1;
+            pending_space = 1;
+            continue;
+        }
+        if ((int)sc != cls || sc == QSM_SCRIPT_PUNCT || c->wcp >= MAX_WORD_CP) {
+            flush_word(c);
+            if (pending_space && (sc == QSM_SCRIPT_LATIN || sc == QSM_SCRIPT_DIGIT)) {
+                c->wlen += qsm_utf8_put(SPACE_MARK, c->word + c->wlen);
+                c->wcp++;
+            }
+            cls = (int)sc;
+        }
+        pending_space = 0;
+        c->wlen += qsm_utf8_put(cp, c->word + c->wlen);
+        c->wcp++;
+    }
+    flush_word(c);
+}
+
+static int is_text_key(const char *k, size_t kl) {
+    return (kl == 7 && memcmp(k, "content", 7) == 0) ||
+           (kl == 5 && memcmp(k, "input", 5) == 0) ||
+           (kl == 6 && memcmp(k, "output", 6) == 0) ||
+           (kl == 4 && memcmp(k, "text", 4) == 0);
+}
+
+static int on_string(void *ud, const char *key, size_t klen, const char *raw, size_t rlen, int depth) {
+    (void)depth;
+    CountCtx *c = ud;
+    if (!is_text_key(key, klen)) return 0;
+    if (rlen > c->buf_cap) {
+        c->buf_cap = rlen * 2;
+        c->buf = realloc(c->buf, c->buf_cap);
+    }
+    size_t n = qsm_json_unescape(raw, rlen, c->buf);
+    pretokenize(c, c->buf, n);
+    return 0;
+}
+
+typedef struct {
+    CountJob *job;
+    int tid;
+} WorkerArg;
+
+static void *count_thread(void *arg) {
+    WorkerArg *wa = arg;
+    CountJob *job = wa->job;
+    CountCtx c = { 0 };
+    c.shards = job->local + (size_t)wa->tid * NUM_SHARDS;
+    c.buf_cap = 1 << 16;
+    c.buf = malloc(c.buf_cap);
+    unsigned long long recs = 0, bad = 0;
+    for (;;) {
+        int i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->nchunks) break;
+        const char *p = job->chunks[i].lo, *end = job->chunks[i].hi;
+        while (p < end) {
+            const char *eol;
+            const char *nx = qsm_next_line(p, end, &eol);
+            if (!qsm_is_blank_line(p, eol)) {
+                recs++;
+                if (qsm_json_scan(p, eol, on_string, &c) < 0) bad++;
+            }
+            p = nx;
+        }
+    }
+    free(c.buf);
+    atomic_fetch_add(&job->records, recs);
+    atomic_fetch_add(&job->bad, bad);
+    return NULL;
+}
+
+// 分片归并：线程 t 负责分片 s ≡ t (mod nthreads)，分片之间互不相交，无需加锁
+static void *merge_thread(void *arg) {
+    WorkerArg *wa = arg;
+    CountJob *job = wa->job;
+    for (int s = wa->tid; s < NUM_SHARDS; s += job->nthreads) {
+        WordTab *g = &job->global[s];
+        wt_init(g, 1 << 12);
+        g->limit = job->global_limit;
+        for (int t = 0; t < job->nthreads; t++) {
+            WordTab *l = &job->local[(size_t)t * NUM_SHARDS + s];
+            for (size_t i = 0; i < l->cap; i++) {
+                WordEnt *e = &l->ents[i];
+                if (e->len) wt_add(g, l->arena + e->off, e->len, e->hash, e->count);
+            }
+            wt_free(l);
+        }
+    }
+    return NULL;
+}
+
+static void run_threads(int n, void *(*fn)(void *), CountJob *job) {
+    pthread_t *th = malloc(n * sizeof(pthread_t));
+    WorkerArg *wa = malloc(n * sizeof(WorkerArg));
+    for (int t = 0; t < n; t++) {
+        wa[t].job = job;
+        wa[t].tid = t;
+        pthread_create(&th[t], NULL, fn, &wa[t]);
+    }
+    for (int t = 0; t < n; t++) pthread_join(th[t], NULL);
+    free(th);
+    free(wa);
+}
+
+// ==================== 阶段 2：增量 BPE 合并 ====================
+
+typedef struct {
+    const char *bytes;
+    uint32_t len;
+    uint64_t count;
+} UWord;
+
+typedef struct {
+    int64_t count;
+    uint32_t *words;
+    uint32_t nw;
+    uint32_t cap;
+    uint32_t a, b;
+    uint32_t dirty;
+} Pair;
+
+typedef struct {
+    int64_t count;
+    uint32_t pair;
+} HeapEnt;
+
+typedef struct {
+    // 符号表：token 字符串池
+    char *str;
+    size_t str_len, str_cap;
+    uint32_t *sym_off, *sym_len;
+    uint64_t *sym_cnt;
+    uint32_t nsym, sym_cap;
+    // 词：位置链表
+    int32_t *pos_sym, *pos_next, *pos_prev;
+    uint32_t *word_start;
+    uint64_t *word_freq;
+    uint32_t *word_stamp;
+    uint32_t nwords;
+    // pair 哈希 → Pair 下标
+    uint64_t *pkey;
+    uint32_t *pidx;
+    size_t pcap, pn;
+    Pair *pairs;
+    uint32_t npairs, pairs_cap;
+    HeapEnt *heap;
+    size_t hn, hcap;
+    uint32_t *dirty;
+    uint32_t ndirty, dirty_cap;
+} Bpe;
+
+static uint32_t add_symbol(Bpe *b, const char *s, uint32_t len, uint64_t cnt) {
+    if (b->nsym == b->sym_cap) {
+        b->sym_cap = b->sym_cap ? b->sym_cap * 2 : 1024;
+        b->sym_off = realloc(b->sym_off, b->sym_cap * sizeof(uint32_t));
+        b->sym_len = realloc(b->sym_len, b->sym_cap * sizeof(uint32_t));
+        b->sym_cnt = realloc(b->sym_cnt, b->sym_cap * sizeof(uint64_t));
+    }
+    if (b->str_len + len > b->str_cap) {
+        while (b->str_len + len > b->str_cap) b->str_cap = b->str_cap ? b->str_cap * 2 : 65536;
+        b->str = realloc(b->str, b->str_cap);
+    }
+    memcpy(b->str + b->str_len, s, len);
+    b->sym_off[b->nsym] = (uint32_t)b->str_len;
+    b->sym_len[b->nsym] = len;
+    b->sym_cnt[b->nsym] = cnt;
+    b->str_len += len;
+    return b->nsym++;
+}
+
+static void pair_map_grow(Bpe *b) {
+    size_t ncap = b->pcap ? b->pcap * 2 : 1 << 16;
+    uint64_t *nk = malloc(ncap * sizeof(uint64_t));
+    uint32_t *ni = malloc(ncap * sizeof(uint32_t));
+    memset(ni, 0xFF, ncap * sizeof(uint32_t));
+    for (size_t i = 0; i < b->pcap; i++) {
+        if (b->pidx[i] == UINT32_MAX) continue;
+        size_t j = qsm_mix64(b->pkey[i]) & (ncap - 1);
+        while (ni[j] != UINT32_MAX) j = (j + 1) & (ncap - 1);
+        nk[j] = b->pkey[i];
+        ni[j] = b->pidx[i];
+    }
+    free(b->pkey);
+    free(b->pidx);
+    b->pkey = nk;
+    b->pidx = ni;
+    b->pcap = ncap;
+}
+
+static Pair *get_pair(Bpe *b, uint32_t x, uint32_t y) {
+    if ((b->pn + 1) * 2 > b->pcap) pair_map_grow(b);
+    uint64_t key = ((uint64_t)x << 32) | y;
+    size_t j = qsm_mix64(key) & (b->pcap - 1);
+    while (b->pidx[j] != UINT32_MAX) {
+        if (b->pkey[j] == key) return &b->pairs[b->pidx[j]];
+        j = (j + 1) & (b->pcap - 1);
+    }
+    if (b->npairs == b->pairs_cap) {
+        b->pairs_cap = b->pairs_cap ? b->pairs_cap * 2 : 1 << 16;
+        b->pairs = realloc(b->pairs, b->pairs_cap * sizeof(Pair));
+    }
+    Pair *p = &b->pairs[b->npairs];
+    memset(p, 0, sizeof(*p));
+    p->a = x;
+    p->b = y;
+    b->pkey[j] = key;
+    b->pidx[j] = b->npairs++;
+    b->pn++;
+    return p;
+}
+
+static void pair_add_word(Pair *p, uint32_t w) {
+    if (p->nw && p->words[p->nw - 1] == w) return;
+    if (p->nw == p->cap) {
+        p->cap = p->cap ? p->cap * 2 : 4;
+        p->words = realloc(p->words, p->cap * sizeof(uint32_t));
+    }
+    p->words[p->nw++] = w;
+}
+
+static int heap_less(const HeapEnt *x, const HeapEnt *y) {
+    // 频次高者优先；同频按 pair 首次出现顺序，保证结果确定
+    if (x->count != y->count) return x->count > y->count;
+    return x->pair < y->pair;
+}
+
+static void heap_push(Bpe *b, int64_t count, uint32_t pair) {
+    if (b->hn == b->hcap) {
+        b->hcap = b->hcap ? b->hcap * 2 : 1 << 16;
+        b->heap = realloc(b->heap, b->hcap * sizeof(HeapEnt));
+    }
+    size_t i = b->hn++;
+    HeapEnt e = { count, pair };
+    while (i > 0) {
+        size_t par = (i - 1) / 2;
+        if (!heap_less(&e, &b->heap[par])) break;
+        b->heap[i] = b->heap[par];
+        i = par;
+    }
+    b->heap[i] = e;
+}
+
+static HeapEnt heap_pop(Bpe *b) {
+    HeapEnt top = b->heap[0];
+    HeapEnt last = b->heap[--b->hn];
+    size_t i = 0;
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        const HeapEnt *best = &last;
+        if (l < b->hn && heap_less(&b->heap[l], best)) { m = l; best = &b->heap[l]; }
+        if (r < b->hn && heap_less(&b->heap[r], best)) { m = r; }
+        if (m == i) break;
+        b->heap[i] = b->heap[m];
+        i = m;
+    }
+    if (b->hn) b->heap[i] = last;
+    return top;
+}
+
+static void mark_dirty(Bpe *b, Pair *p) {
+    if (p->dirty) return;
+    p->dirty = 1;
+    if (b->ndirty == b->dirty_cap) {
+        b->dirty_cap = b->dirty_cap ? b->dirty_cap * 2 : 1024;
+        b->dirty = realloc(b->dirty, b->dirty_cap * sizeof(uint32_t));
+    }
+    b->dirty[b->ndirty++] = (uint32_t)(p - b->pairs);
+}
+
+// 注意：get_pair 可能 realloc b->pairs，调用后不得再使用旧 Pair 指针
+static void pair_inc(Bpe *b, uint32_t x, uint32_t y, int64_t f, uint32_t w) {
+    Pair *p = get_pair(b, x, y);
+    p->count += f;
+    pair_add_word(p, w);
+    mark_dirty(b, p);
+}
+
+static void pair_dec(Bpe *b, uint32_t x, uint32_t y, int64_t f) {
+    Pair *p = get_pair(b, x, y);
+    p->count -= f;
+}
+
+static void apply_merge(Bpe *b, uint32_t pi, uint32_t stamp) {
+    uint32_t a = b->pairs[pi].a, bb = b->pairs[pi].b;
+    char tmp[1024];
+    uint32_t la = b->sym_len[a], lb = b->sym_len[bb];
+    uint32_t nl = la + lb < sizeof(tmp) ? la + lb : (uint32_t)sizeof(tmp);
+    memcpy(tmp, b->str + b->sym_off[a], la < nl ? la : nl);
+    if (la < nl) memcpy(tmp + la, b->str + b->sym_off[bb], nl - la);
+    uint32_t c = add_symbol(b, tmp, nl, (uint64_t)b->pairs[pi].count);
+
+    // 先取走词表：处理过程中 pairs 可能 realloc
+    uint32_t nw = b->pairs[pi].nw;
+    uint32_t *words = b->pairs[pi].words;
+    b->pairs[pi].words = NULL;
+    b->pairs[pi].nw = b->pairs[pi].cap = 0;
+
+    for (uint32_t k = 0; k < nw; k++) {
+        uint32_t w = words[k];
+        if (b->word_stamp[w] == stamp) continue;
+        b->word_stamp[w] = stamp;
+        int64_t f = (int64_t)b->word_freq[w];
+        int32_t i = (int32_t)b->word_start[w];
+        while (i >= 0) {
+            int32_t j = b->pos_next[i];
+            if (j < 0) break;
+            if ((uint32_t)b->pos_sym[i] != a || (uint32_t)b->pos_sym[j] != bb) { i = j; continue; }
+            int32_t pv = b->pos_prev[i], nx = b->pos_next[j];
+            if (pv >= 0) pair_dec(b, (uint32_t)b->pos_sym[pv], a, f);
+            if (nx >= 0) pair_dec(b, bb, (uint32_t)b->pos_sym[nx], f);
+            b->pairs[pi].count -= f;
+            b->pos_sym[i] = (int32_t)c;
+            b->pos_sym[j] = -1;
+            b->pos_next[i] = nx;
+            if (nx >= 0) b->pos_prev[nx] = i;
+            if (pv >= 0) pair_inc(b, (uint32_t)b->pos_sym[pv], c, f, w);
+            if (nx >= 0) pair_inc(b, c, (uint32_t)b->pos_sym[nx], f, w);
+            i = nx;
+        }
+    }
+    free(words);
+
+    for (uint32_t k = 0; k < b->ndirty; k++) {
+        Pair *p = &b->pairs[b->dirty[k]];
+        p->dirty = 0;
+        if (p->count > 0) heap_push(b, p->count, b->dirty[k]);
+    }
+    b->ndirty = 0;
+}
+
+static int cmp_uword(const void *x, const void *y) {
+    const UWord *a = x, *b = y;
+    if (a->count != b->count) return a->count > b->count ? -1 : 1;
+    uint32_t n = a->len < b->len ? a->len : b->len;
+    int c = memcmp(a->bytes, b->bytes, n);
+    if (c) return c;
+    return (int)a->len - (int)b->len;
+}
+
+// ==================== 主函数 ====================
+
+static void usage(const char *prog) {
+    fprintf(stderr, "用法: %s [选项] <data目录|文件.jsonl>...\n", prog);
+    fprintf(stderr, "\n彝/汉/英三语子词词表训练器（码点级 BPE，彝文 PUA 码点为原子符号）\n");
+    fprintf(stderr, "\n选项:\n");
+    fprintf(stderr, "  -v N   目标词表大小（默认 32000）\n");
+    fprintf(stderr, "  -t N   线程数（默认 CPU 核数）\n");
+    fprintf(stderr, "  -m N   参与合并的最低词频（默认 2）\n");
+    fprintf(stderr, "  -w N   参与合并的不同词数上限（按频次取前 N，默认 2000000）；阶段 1 的词频表\n");
+    fprintf(stderr, "         最多保留约 2N 个词，超出时淘汰低频词，内存与语料大小无关\n");
+    fprintf(stderr, "  -o P   输出前缀（默认 yi_bpe → yi_bpe.vocab / yi_bpe.merges）\n");
+}
+
+int main(int argc, char *argv[]) {
+    int vocab_size = 32000, nthreads = qsm_default_threads();
+    uint64_t min_freq = 2;
+    size_t max_words = 2000000;
+    const char *prefix = "yi_bpe";
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-' && argv[argi][1]; argi++) {
+        if (argi + 1 >= argc) { usage(argv[0]); return 1; }
+        char opt = argv[argi][1];
+        const char *val = argv[++argi];
+        if (opt == 'v') vocab_size = atoi(val);
+        else if (opt == 't') nthreads = atoi(val);
+        else if (opt == 'm') min_freq = strtoull(val, NULL, 10);
+        else if (opt == 'w') max_words = strtoull(val, NULL, 10);
+        else if (opt == 'o') prefix = val;
+        else { usage(argv[0]); return 1; }
+    }
+    if (argi >= argc) { usage(argv[0]); return 1; }
+    if (nthreads < 1) nthreads = 1;
+
+    double t0 = now_sec();
+
+    // 收集输入文件
+    char **files = NULL;
+    int nfiles = 0;
+    for (; argi < argc; argi++) {
+        char **list;
+        int n = qsm_list_jsonl(argv[argi], &list);
+        if (n < 0) { fprintf(stderr, "[BPE] 无法读取: %s\n", argv[argi]); return 1; }
+        files = realloc(files, (nfiles + n) * sizeof(char *));
+        memcpy(files + nfiles, list, n * sizeof(char *));
+        nfiles += n;
+        free(list);
+    }
+    QsmMap *maps = calloc(nfiles, sizeof(QsmMap));
+    size_t total = 0;
+    for (int i = 0; i < nfiles; i++) {
+        if (qsm_map_file(files[i], &maps[i]) != 0) {
+            fprintf(stderr, "[BPE] 无法映射: %s\n", files[i]);
+            return 1;
+        }
+        total += maps[i].size;
+    }
+
+    // 阶段 1：计数
+    CountJob job;
+    memset(&job, 0, sizeof(job));
+    QsmChunk *chunks;
+    job.nchunks = qsm_make_chunks(maps, nfiles, total / ((size_t)nthreads * 8) + 1, &chunks);
+    job.chunks = chunks;
+    job.nthreads = nthreads;
+    atomic_init(&job.next, 0);
+    atomic_init(&job.records, 0);
+    atomic_init(&job.bad, 0);
+    job.global_limit = 2 * max_words / NUM_SHARDS;
+    if (job.global_limit < 1024) job.global_limit = 1024;
+    job.local_limit = job.global_limit / (size_t)nthreads;
+    if (job.local_limit < 1024) job.local_limit = 1024;
+    g_cp_spill = calloc(0x110000, sizeof(uint64_t));
+    job.local = malloc((size_t)nthreads * NUM_SHARDS * sizeof(WordTab));
+    for (int i = 0; i < nthreads * NUM_SHARDS; i++) {
+        wt_init(&job.local[i], 1 << 8);
+        job.local[i].limit = job.local_limit;
+    }
+    run_threads(nthreads, count_thread, &job);
+    run_threads(nthreads, merge_thread, &job);
+    for (int i = 0; i < nfiles; i++) qsm_unmap_file(&maps[i]);
+    free(maps);
+    free(chunks);
+    free(job.local);
+
+    size_t nuniq = 0;
+    for (int s = 0; s < NUM_SHARDS; s++) nuniq += job.global[s].n;
+    UWord *uw = malloc((nuniq ? nuniq : 1) * sizeof(UWord));
+    size_t k = 0;
+    for (int s = 0; s < NUM_SHARDS; s++) {
+        WordTab *g = &job.global[s];
+        for (size_t i = 0; i < g->cap; i++) {
+            if (!g->ents[i].len) continue;
+            uw[k].bytes = g->arena + g->ents[i].off;
+            uw[k].len = g->ents[i].len;
+            uw[k].count = g->ents[i].count;
+            k++;
+        }
+    }
+    qsort(uw, nuniq, sizeof(UWord), cmp_uword);
+    double t1 = now_sec();
+    fprintf(stdout, "[BPE] 扫描: %d 个文件, %.1f MB, %llu 条记录 (格式错误 %llu), %zu 个不同词 (淘汰低频 %llu), %.2fs\n",
+            nfiles, total / 1048576.0, (unsigned long long)atomic_load(&job.records),
+            (unsigned long long)atomic_load(&job.bad), nuniq, (unsigned long long)atomic_load(&g_evicted), t1 - t0);
+
+    // 阶段 2：建立基础符号（全部码点，彝文 PUA 单独计数）与位置链表
+    Bpe b;
+    memset(&b, 0, sizeof(b));
+    int32_t *cp2sym = malloc(0x110000 * sizeof(int32_t));
+    memset(cp2sym, 0xFF, 0x110000 * sizeof(int32_t));
+    size_t ntrain = 0, npos = 0;
+    for (size_t i = 0; i < nuniq; i++) {
+        if (uw[i].count >= min_freq && ntrain < max_words) { ntrain++; npos += uw[i].len; }
+    }
+    b.pos_sym = malloc((npos + 1) * sizeof(int32_t));
+    b.pos_next = malloc((npos + 1) * sizeof(int32_t));
+    b.pos_prev = malloc((npos + 1) * sizeof(int32_t));
+    b.word_start = malloc((ntrain + 1) * sizeof(uint32_t));
+    b.word_freq = malloc((ntrain + 1) * sizeof(uint64_t));
+    b.word_stamp = calloc(ntrain + 1, sizeof(uint32_t));
+    uint32_t yi_base = 0;
+    size_t pos = 0;
+    for (size_t i = 0; i < nuniq; i++) {
+        int train = i < ntrain;   // 已按频次降序，前 ntrain 个即满足 min_freq 与上限
+        const char *p = uw[i].bytes, *end = p + uw[i].len;
+        if (train) {
+            b.word_start[b.nwords] = (uint32_t)pos;
+            b.word_freq[b.nwords] = uw[i].count;
+        }
+        int32_t first = (int32_t)pos;
+        while (p < end) {
+            uint32_t cp;
+            int n = qsm_utf8_next(p, end, &cp);
+            if (cp >= 0x110000) cp = 0xFFFD;
+            if (cp2sym[cp] < 0) {
+                cp2sym[cp] = (int32_t)add_symbol(&b, p, (uint32_t)n, 0);
+                if (qsm_is_yi_pua(cp)) yi_base++;
+            }
+            b.sym_cnt[cp2sym[cp]] += uw[i].count;
+            if (train) {
+                b.pos_sym[pos] = cp2sym[cp];
+                b.pos_prev[pos] = pos == (size_t)first ? -1 : (int32_t)pos - 1;
+                b.pos_next[pos] = (int32_t)pos + 1;
+                pos++;
+            }
+            p += n;
+        }
+        if (train) {
+            b.pos_next[pos - 1] = -1;
+            b.nwords++;
+        }
+    }
+    // 被淘汰词里的码点：补上频次，只在淘汰词里出现过的码点也成为基础符号
+    for (uint32_t cp = 0; cp < 0x110000; cp++) {
+        if (!g_cp_spill[cp]) continue;
+        if (cp2sym[cp] < 0) {
+            char u[4];
+            cp2sym[cp] = (int32_t)add_symbol(&b, u, (uint32_t)qsm_utf8_put(cp, u), 0);
+            if (qsm_is_yi_pua(cp)) yi_base++;
+        }
+        b.sym_cnt[cp2sym[cp]] += g_cp_spill[cp];
+    }
+    free(g_cp_spill);
+    free(cp2sym);
+    uint32_t nbase = b.nsym;
+    free(uw);
+    for (int s = 0; s < NUM_SHARDS; s++) wt_free(&job.global[s]);
+
+    for (uint32_t w = 0; w < b.nwords; w++) {
+        int64_t f = (int64_t)b.word_freq[w];
+        for (int32_t i = (int32_t)b.word_start[w]; b.pos_next[i] >= 0; i = b.pos_next[i])
+            pair_inc(&b, (uint32_t)b.pos_sym[i], (uint32_t)b.pos_sym[b.pos_next[i]], f, w);
+    }
+    for (uint32_t k2 = 0; k2 < b.ndirty; k2++) {
+        b.pairs[b.dirty[k2]].dirty = 0;
+        heap_push(&b, b.pairs[b.dirty[k2]].count, b.dirty[k2]);
+    }
+    b.ndirty = 0;
+    double t2 = now_sec();
+    fprintf(stdout, "[BPE] 基础符号: %u (彝文 PUA %u), 训练词: %u, 初始 pair: %u, %.2fs\n",
+            nbase, yi_base, b.nwords, b.npairs, t2 - t1);
+
+    // 合并循环
+    char path[1024];
+    snprintf(path, sizeof(path), "%s.merges", prefix);
+    FILE *fm = fopen(path, "w");
+    if (!fm) { fprintf(stderr, "[BPE] 无法创建输出文件: %s\n", path); return 1; }
+    uint32_t merges = 0, stamp = 0;
+    while ((int)b.nsym < vocab_size && b.hn) {
+        HeapEnt top = heap_pop(&b);
+        Pair *p = &b.pairs[top.pair];
+        if (p->count != top.count) {
+            if (p->count > 0) heap_push(&b, p->count, top.pair);
+            continue;
+        }
+        if (p->count < 2) break;
+        fprintf(fm, "%.*s %.*s\n", (int)b.sym_len[p->a], b.str + b.sym_off[p->a],
+                (int)b.sym_len[p->b], b.str + b.sym_off[p->b]);
+        apply_merge(&b, top.pair, ++stamp);
+        merges++;
+    }
+    fclose(fm);
+    double t3 = now_sec();
+
+    snprintf(path, sizeof(path), "%s.vocab", prefix);
+    FILE *fv = fopen(path, "w");
+    if (!fv) { fprintf(stderr, "[BPE] 无法创建输出文件: %s\n", path); return 1; }
+    for (uint32_t i = 0; i < b.nsym; i++)
+        fprintf(fv, "%.*s\t%llu\n", (int)b.sym_len[i], b.str + b.sym_off[i], (unsigned long long)b.sym_cnt[i]);
+    fclose(fv);
+
+    fprintf(stdout, "[BPE] 合并: %u 次, 词表: %u, %.2fs\n", merges, b.nsym, t3 - t2);
+    fprintf(stdout, "[BPE] 输出: %s.vocab / %s.merges, 总耗时 %.2fs\n", prefix, prefix, now_sec() - t0);
+    return 0;
+}
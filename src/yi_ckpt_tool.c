@@ -0,0 +1,458 @@
+/*
+ * yi_ckpt_tool.c — 模型检查点（.qck）打包与检查
+ *
+ * pack   把 model.meta、模型 JSON（vocab / quantum_states）、CSV 张量与 .qbc 线路
+ *        打成一个 .qck；
+ * info   列出各段、META 与打开耗时（-v 同时逐段校验）；
+ * verify 逐段核对内容哈希；
+ * lookup 零拷贝查词表与状态表，演示推理端的用法。
+ *
+ * 用法: yi_ckpt_tool pack -o <out.qck> [-m model.meta] [-j model.json]
+ *                         [-c 名字=file.csv]... [-b 名字=file.qbc]...
+ *       yi_ckpt_tool info [-v] <file.qck>
+ *       yi_ckpt_tool verify <file.qck>
+ *       yi_ckpt_tool lookup <file.qck> <token>...
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "qsm_ckpt.h"
+#include "qsm_csv.h"
+#include "qsm_jsonl.h"
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ==================== 模型 JSON ====================
+
+// 只认 {"vocab": {tok: id}, "quantum_states": {tok: {"target": s, "confidence": x}}, "timestamp": s}
+typedef struct {
+    const char *p, *end;
+} Cur;
+
+typedef struct {
+    char **s;
+    uint32_t *len;
+    uint32_t n, cap;
+} StrVec;
+
+typedef struct {
+    StrVec vocab;               // 按 id 排好
+    StrVec state_key, state_target;
+    float *confidence;
+    uint32_t conf_cap;
+    char timestamp[64];
+} ModelJson;
+
+static void ws(Cur *c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\n' || *c->p == '\r' || *c->p == '\t')) c->p++;
+}
+
+static int expect(Cur *c, char ch) {
+    ws(c);
+    if (c->p >= c->end || *c->p != ch) return -1;
+    c->p++;
+    return 0;
+}
+
+// 读一个字符串，返回反转义后的副本
+static char *read_str(Cur *c, uint32_t *len) {
+    ws(c);
+    if (c->p >= c->end || *c->p != '"') return NULL;
+    const char *raw = ++c->p;
+    while (c->p < c->end && *c->p != '"') c->p += *c->p == '\\' ? 2 : 1;
+    if (c->p >= c->end) return NULL;
+    size_t rlen = (size_t)(c->p++ - raw);
+    char *s = malloc(rlen + 1);
+    *len = (uint32_t)qsm_json_unescape(raw, rlen, s);
+    s[*len] = '\0';
+    return s;
+}
+
+static int read_num(Cur *c, double *v) {
+    ws(c);
+    const char *a = c->p;
+    while (c->p < c->end && strchr("+-.0123456789eE", *c->p)) c->p++;
+    return a < c->p ? qsm_parse_double(a, c->p, v) : -1;
+}
+
+static int skip_value(Cur *c) {
+    ws(c);
+    if (c->p >= c->end) return -1;
+    if (*c->p == '"') {
+        uint32_t l;
+        free(read_str(c, &l));
+        return 0;
+    }
+    if (*c->p == '{' || *c->p == '[') {
+        int depth = 0;
+        for (; c->p < c->end; c->p++) {
+            if (*c->p == '"') {
+                uint32_t l;
+                free(read_str(c, &l));
+                c->p--;
+            } else if (*c->p == '{' || *c->p == '[') depth++;
+            else if ((*c->p == '}' || *c->p == ']') && --depth == 0) { c->p++; return 0; }
+        }
+        return -1;
+    }
+    while (c->p < c->end && !strchr(",}]", *c->p)) c->p++;
+    return 0;
+}
+
+static void vec_set(StrVec *v, uint32_t i, char *s, uint32_t len) {
+    if (i >= v->cap) {
+        uint32_t cap = v->cap ? v->cap : 1024;
+        while (cap <= i) cap *= 2;
+        v->s = realloc(v->s, cap * sizeof(char *));
+        v->len = realloc(v->len, cap * sizeof(uint32_t));
+        memset(v->s + v->cap, 0, (cap - v->cap) * sizeof(char *));
+        memset(v->len + v->cap, 0, (cap - v->cap) * sizeof(uint32_t));
+        v->cap = cap;
+    }
+    free(v->s[i]);
+    v->s[i] = s;
+    v->len[i] = len;
+    if (i >= v->n) v->n = i + 1;
+}
+
+static void vec_free(StrVec *v) {
+    for (uint32_t i = 0; i < v->n; i++) free(v->s[i]);
+    free(v->s);
+    free(v->len);
+}
+
+// 对象 {k: v, ...}：每个键调用 fn，fn 负责读走值
+static int each_member(Cur *c, int (*fn)(Cur *, char *, uint32_t, void *), void *ud) {
+    if (expect(c, '{') != 0) return -1;
+    ws(c);
+    if (c->p < c->end && *c->p == '}') { c->p++; return 0; }
+    for (;;) {
+        uint32_t klen;
+        char *k = read_str(c, &klen);
+        if (!k || expect(c, ':') != 0) { free(k); return -1; }
+        if (fn(c, k, klen, ud) != 0) return -1;
+        ws(c);
+        if (c->p < c->end && *c->p == ',') { c->p++; continue; }
+        return expect(c, '}');
+    }
+}
+
+static int on_vocab(Cur *c, char *k, uint32_t klen, void *ud) {
+    ModelJson *m = ud;
+    double id;
+    if (read_num(c, &id) != 0 || id < 0 || id > 1e8) { free(k); return -1; }
+    vec_set(&m->vocab, (uint32_t)id, k, klen);
+    return 0;
+}
+
+typedef struct {
+    ModelJson *m;
+    uint32_t i;
+} StateCtx;
+
+static int on_state_field(Cur *c, char *k, uint32_t klen, void *ud) {
+    StateCtx *s = ud;
+    int r = 0;
+    if (klen == 6 && memcmp(k, "target", 6) == 0) {
+        uint32_t len;
+        char *t = read_str(c, &len);
+        if (t) vec_set(&s->m->state_target, s->i, t, len);
+        else r = -1;
+    } else if (klen == 10 && memcmp(k, "confidence", 10) == 0) {
+        double v;
+        r = read_num(c, &v);
+        s->m->confidence[s->i] = (float)v;
+    } else {
+        r = skip_value(c);
+    }
+    free(k);
+    return r;
+}
+
+static int on_state(Cur *c, char *k, uint32_t klen, void *ud) {
+    ModelJson *m = ud;
+    uint32_t i = m->state_key.n;
+    vec_set(&m->state_key, i, k, klen);
+    vec_set(&m->state_target, i, strdup(""), 0);
+    if (i >= m->conf_cap) {
+        m->conf_cap = m->conf_cap ? m->conf_cap * 2 : 1024;
+        m->confidence = realloc(m->confidence, m->conf_cap * sizeof(float));
+    }
+    m->confidence[i] = 0;
+    StateCtx s = { m, i };
+    return each_member(c, on_state_field, &s);
+}
+
+static int on_top(Cur *c, char *k, uint32_t klen, void *ud) {
+    ModelJson *m = ud;
+    int r;
+    if (klen == 5 && memcmp(k, "vocab", 5) == 0) r = each_member(c, on_vocab, m);
+    else if (klen == 14 && memcmp(k, "quantum_states", 14) == 0) r = each_member(c, on_state, m);
+    else if (klen == 9 && memcmp(k, "timestamp", 9) == 0) {
+        uint32_t len;
+        char *t = read_str(c, &len);
+        r = t ? 0 : -1;
+        if (t) snprintf(m->timestamp, sizeof(m->timestamp), "%s", t);
+        free(t);
+    } else r = skip_value(c);
+    free(k);
+    return r;
+}
+
+// ==================== pack ====================
+
+static int split_arg(const char *arg, char *name, size_t cap, const char **path) {
+    const char *eq = strchr(arg, '=');
+    if (!eq || (size_t)(eq - arg) >= cap || eq == arg) return -1;
+    memcpy(name, arg, (size_t)(eq - arg));
+    name[eq - arg] = '\0';
+    *path = eq + 1;
+    return 0;
+}
+
+static int pack_meta(QsmCkptWriter *w, const char *path, const char *timestamp) {
+    char text[4096];
+    size_t n = 0;
+    if (path) {
+        QsmMap m;
+        if (qsm_map_file(path, &m) != 0) return -1;
+        // model.meta 是一行逗号分隔的 key=value，改成每行一项
+        for (size_t i = 0; i < m.size && n + 2 < sizeof(text); i++) {
+            char ch = m.data[i];
+            if (ch == '\r') continue;
+            text[n++] = ch == ',' ? '\n' : ch;
+        }
+        qsm_unmap_file(&m);
+        while (n && text[n - 1] == '\n') n--;
+        text[n++] = '\n';
+    }
+    if (timestamp && timestamp[0])
+        n += (size_t)snprintf(text + n, sizeof(text) - n, "timestamp=%s\n", timestamp);
+    if (n == 0) return 0;
+    return qsm_ckpt_add(w, QSM_CKPT_META, "meta", QSM_CKPT_U8, 0, NULL, text, n);
+}
+
+static int pack_json(QsmCkptWriter *w, const char *path, ModelJson *mj, double *ms) {
+    QsmMap m;
+    if (qsm_map_file(path, &m) != 0) return -1;
+    double t0 = now_sec();
+    Cur c = { m.data, m.data + m.size };
+    int r = each_member(&c, on_top, mj);
+    *ms = (now_sec() - t0) * 1e3;
+    qsm_unmap_file(&m);
+    if (r != 0) return -1;
+    for (uint32_t i = 0; i < mj->vocab.n; i++)
+        if (!mj->vocab.s[i]) vec_set(&mj->vocab, i, strdup(""), 0);   // id 有空洞时补空串
+    if (mj->vocab.n &&
+        qsm_ckpt_add_vocab(w, "vocab", (const char *const *)mj->vocab.s, mj->vocab.len, mj->vocab.n) != 0) return -1;
+    uint32_t ns = mj->state_key.n;
+    if (ns) {
+        uint64_t shape[1] = { ns };
+        if (qsm_ckpt_add_vocab(w, "states.key", (const char *const *)mj->state_key.s, mj->state_key.len, ns) != 0 ||
+            qsm_ckpt_add_vocab(w, "states.target", (const char *const *)mj->state_target.s, mj->state_target.len, ns) != 0 ||
+            qsm_ckpt_add_tensor(w, "states.confidence", QSM_CKPT_F32, 1, shape, mj->confidence) != 0) return -1;
+    }
+    return 0;
+}
+
+static int pack_csv(QsmCkptWriter *w, const char *name, const char *path) {
+    QsmCsv csv;
+    if (qsm_csv_load(path, &csv) != 0) return -1;
+    int r = 0;
+    for (size_t j = 0; j < csv.cols && r == 0; j++) {
+        char full[QSM_CKPT_NAME_LEN];
+        if ((size_t)snprintf(full, sizeof(full), "%s.%s", name, csv.names[j]) >= sizeof(full)) { r = -1; break; }
+        uint64_t shape[1] = { csv.rows };
+        r = qsm_ckpt_add_tensor(w, full, QSM_CKPT_F64, 1, shape, qsm_csv_col(&csv, j));
+    }
+    qsm_csv_free(&csv);
+    return r;
+}
+
+static int pack_qbc(QsmCkptWriter *w, const char *name, const char *path) {
+    QsmMap m;
+    if (qsm_map_file(path, &m) != 0) return -1;
+    uint64_t shape[1] = { m.size };
+    int r = qsm_ckpt_add(w, QSM_CKPT_BYTECODE, name, QSM_CKPT_U8, 1, shape, m.data, m.size);
+    qsm_unmap_file(&m);
+    return r;
+}
+
+static int cmd_pack(int argc, char **argv) {
+    const char *out = NULL, *meta = NULL, *json = NULL;
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-o") == 0) out = argv[i + 1];
+        else if (strcmp(argv[i], "-m") == 0) meta = argv[i + 1];
+        else if (strcmp(argv[i], "-j") == 0) json = argv[i + 1];
+    }
+    if (!out || argc % 2) {
+        fprintf(stderr, "用法: yi_ckpt_tool pack -o <out.qck> [-m model.meta] [-j model.json] [-c 名字=file.csv]... [-b 名字=file.qbc]...\n");
+        return 1;
+    }
+    double t0 = now_sec(), json_ms = 0;
+    QsmCkptWriter *w = qsm_ckpt_create(out);
+    if (!w) { fprintf(stderr, "[CKPT] 无法写: %s\n", out); return 1; }
+    ModelJson mj;
+    memset(&mj, 0, sizeof(mj));
+    int r = 0;
+    if (json && pack_json(w, json, &mj, &json_ms) != 0) {
+        fprintf(stderr, "[CKPT] 无法解析模型 JSON: %s\n", json);
+        r = -1;
+    }
+    if (r == 0 && pack_meta(w, meta, mj.timestamp) != 0) {
+        fprintf(stderr, "[CKPT] 无法读取: %s\n", meta);
+        r = -1;
+    }
+    for (int i = 0; i + 1 < argc && r == 0; i += 2) {
+        char name[QSM_CKPT_NAME_LEN];
+        const char *path;
+        int is_csv = strcmp(argv[i], "-c") == 0, is_qbc = strcmp(argv[i], "-b") == 0;
+        if (!is_csv && !is_qbc) continue;
+        if (split_arg(argv[i + 1], name, sizeof(name), &path) != 0) {
+            fprintf(stderr, "[CKPT] 参数应为 名字=路径: %s\n", argv[i + 1]);
+            r = -1;
+        } else if ((is_csv ? pack_csv(w, name, path) : pack_qbc(w, name, path)) != 0) {
+            fprintf(stderr, "[CKPT] 无法加入: %s（文件无效或段名重复）\n", argv[i + 1]);
+            r = -1;
+        }
+    }
+    vec_free(&mj.vocab);
+    vec_free(&mj.state_key);
+    vec_free(&mj.state_target);
+    free(mj.confidence);
+    if (r != 0) { qsm_ckpt_abort(w); return 1; }
+    if (qsm_ckpt_finish(w) != 0) { fprintf(stderr, "[CKPT] 写入失败: %s\n", out); return 1; }
+    const char *err;
+    QsmCkpt *ck = qsm_ckpt_open(out, 0, &err);
+    if (!ck) { fprintf(stderr, "[CKPT] 回读失败: %s\n", err); return 1; }
+    QsmMap m;
+    qsm_map_file(out, &m);
+    fprintf(stdout, "[CKPT] %s: %u 段, %.1f KB, %.1f ms", out, qsm_ckpt_count(ck), m.size / 1024.0, (now_sec() - t0) * 1e3);
+    if (json) fprintf(stdout, "（其中解析 JSON %.1f ms）", json_ms);
+    fputc('\n', stdout);
+    qsm_unmap_file(&m);
+    qsm_ckpt_close(ck);
+    return 0;
+}
+
+// ==================== info / verify / lookup ====================
+
+static QsmCkpt *open_or_die(const char *path, int flags, double *ms) {
+    const char *err;
+    double t0 = now_sec();
+    QsmCkpt *ck = qsm_ckpt_open(path, flags, &err);
+    if (ms) *ms = (now_sec() - t0) * 1e3;
+    if (!ck) fprintf(stderr, "[CKPT] %s: %s\n", path, err);
+    return ck;
+}
+
+static const char *dtype_name(uint32_t dtype) {
+    switch (dtype) {
+    case QSM_CKPT_U8: return "u8";
+    case QSM_CKPT_I32: return "i32";
+    case QSM_CKPT_F32: return "f32";
+    case QSM_CKPT_F64: return "f64";
+    default: return "?";
+    }
+}
+
+static int cmd_info(int argc, char **argv) {
+    int verify = argc == 2 && strcmp(argv[0], "-v") == 0;
+    if (argc != 1 + verify) {
+        fprintf(stderr, "用法: yi_ckpt_tool info [-v] <file.qck>\n");
+        return 1;
+    }
+    double ms;
+    QsmCkpt *ck = open_or_die(argv[verify], verify ? QSM_CKPT_VERIFY : 0, &ms);
+    if (!ck) return 1;
+    for (uint32_t i = 0; i < qsm_ckpt_count(ck); i++) {
+        const QsmCkptEntry *e = qsm_ckpt_entry(ck, i);
+        fprintf(stdout, "  %-8s %-24s %-3s [", qsm_ckpt_kind_name(e->kind), e->name, dtype_name(e->dtype));
+        for (uint32_t d = 0; d < e->ndim; d++) fprintf(stdout, d ? "x%llu" : "%llu", (unsigned long long)e->shape[d]);
+        fprintf(stdout, "] %llu B @%llu\n", (unsigned long long)e->size, (unsigned long long)e->off);
+    }
+    const QsmCkptEntry *meta = qsm_ckpt_find(ck, QSM_CKPT_META, "meta");
+    if (meta) {
+        const char *p = qsm_ckpt_data(ck, meta), *end = p + meta->size;
+        fprintf(stdout, "  ---\n");
+        while (p < end) {
+            const char *eol;
+            const char *nx = qsm_next_line(p, end, &eol);
+            fprintf(stdout, "  %.*s\n", (int)(eol - p), p);
+            p = nx;
+        }
+    }
+    fprintf(stdout, "[CKPT] 打开%s %.3f ms\n", verify ? "并校验" : "", ms);
+    qsm_ckpt_close(ck);
+    return 0;
+}
+
+static int cmd_verify(int argc, char **argv) {
+    if (argc != 1) {
+        fprintf(stderr, "用法: yi_ckpt_tool verify <file.qck>\n");
+        return 1;
+    }
+    QsmCkpt *ck = open_or_die(argv[0], 0, NULL);
+    if (!ck) return 1;
+    int bad = qsm_ckpt_verify(ck);
+    for (uint32_t i = 0; bad && i < qsm_ckpt_count(ck); i++) {
+        const QsmCkptEntry *e = qsm_ckpt_entry(ck, i);
+        if (qsm_ckpt_verify_entry(ck, e) != 0)
+            fprintf(stdout, "  校验失败: %s %s\n", qsm_ckpt_kind_name(e->kind), e->name);
+    }
+    fprintf(stdout, "[CKPT] %s: %u 段, %s\n", argv[0], qsm_ckpt_count(ck), bad ? "校验失败" : "校验通过");
+    qsm_ckpt_close(ck);
+    return bad ? 1 : 0;
+}
+
+static int cmd_lookup(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "用法: yi_ckpt_tool lookup <file.qck> <token>...\n");
+        return 1;
+    }
+    double ms;
+    QsmCkpt *ck = open_or_die(argv[0], 0, &ms);
+    if (!ck) return 1;
+    const QsmCkptEntry *vocab = qsm_ckpt_find(ck, QSM_CKPT_VOCAB, "vocab");
+    const QsmCkptEntry *keys = qsm_ckpt_find(ck, QSM_CKPT_VOCAB, "states.key");
+    const QsmCkptEntry *targets = qsm_ckpt_find(ck, QSM_CKPT_VOCAB, "states.target");
+    const QsmCkptEntry *conf = qsm_ckpt_find(ck, QSM_CKPT_TENSOR, "states.confidence");
+    int missing = 0;
+    for (int i = 1; i < argc; i++) {
+        const char *t = argv[i];
+        int64_t id = vocab ? qsm_ckpt_vocab_find(ck, vocab, t, strlen(t)) : -1;
+        int64_t st = keys ? qsm_ckpt_vocab_find(ck, keys, t, strlen(t)) : -1;
+        fprintf(stdout, "%s\tid=%lld", t, (long long)id);
+        if (st >= 0 && targets && conf) {
+            size_t len;
+            const char *tg = qsm_ckpt_vocab_get(ck, targets, (uint32_t)st, &len);
+            fprintf(stdout, "\ttarget=%.*s\tconfidence=%.4f", (int)len, tg,
+                    ((const float *)qsm_ckpt_data(ck, conf))[st]);
+        }
+        fputc('\n', stdout);
+        missing += id < 0 && st < 0;
+    }
+    fprintf(stdout, "[CKPT] 打开 %.3f ms\n", ms);
+    qsm_ckpt_close(ck);
+    return missing ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "pack") == 0) return cmd_pack(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "info") == 0) return cmd_info(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "verify") == 0) return cmd_verify(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "lookup") == 0) return cmd_lookup(argc - 2, argv + 2);
+    fprintf(stderr, "用法: %s pack -o <out.qck> [-m model.meta] [-j model.json] [-c 名字=file.csv]... [-b 名字=file.qbc]...\n", argv[0]);
+    fprintf(stderr, "      %s info [-v] <file.qck>\n", argv[0]);
+    fprintf(stderr, "      %s verify <file.qck>\n", argv[0]);
+    fprintf(stderr, "      %s lookup <file.qck> <token>...\n", argv[0]);
+    fprintf(stderr, "\n模型二进制检查点：META / 张量 / 线路字节码 / 词表，各段 64 字节对齐并带校验，mmap 零拷贝加载\n");
+    return 1;
+}
@@ -0,0 +1,449 @@
+/*
+ * yi_corpus_diff.c — 数据集版本对比（新增 / 删除 / 修改）
+ *
+ * 同一份语料常有 v3 / v4 / v5 几个版本，需要知道到底改了什么。
+ * 两侧（文件或目录）每条记录只留 24 字节：
+ *   - 键哈希：默认取提示（user 消息 / instruction+input / original 等），-k 指定字段；
+ *   - 内容哈希：按 (键名, 反转义后的值) 顺序计算，JSON 排版或转义写法不同不算修改；
+ *   - 位置：文件序号 + 字节偏移，输出时再换算行号。
+ * 同一键下先配对内容完全相同的记录，剩下的按出现顺序两两配为“修改”，多余的记为新增 / 删除。
+ * 记录在文件之间搬动不算变化。
+ *
+ * 哈希按块多线程计算；估算条目超过 -M 预算时按键哈希分成若干趟，每趟只保留一个分区，
+ * 内存与记录长度、文件大小无关。
+ *
+ * 用法: yi_corpus_diff [-t 线程] [-k 字段] [-M MB] [-n 10 | -a] [-v] <旧> <新>
+ * 返回: 0 无差异，1 有差异，2 出错
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "qsm_jsonl.h"
+
+#define CHUNK_BYTES (1 << 20)
+#define OFF_BITS 40
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    uint64_t key;
+    uint64_t val;
+    uint64_t loc;                   // 文件序号 << OFF_BITS | 偏移
+} Entry;
+
+typedef struct {
+    Entry *e;
+    size_t n, cap;
+} EntryVec;
+
+static void vec_push(EntryVec *v, const Entry *e) {
+    if (v->n == v->cap) {
+        v->cap = v->cap ? v->cap * 2 : 4096;
+        v->e = realloc(v->e, v->cap * sizeof(Entry));
+    }
+    v->e[v->n++] = *e;
+}
+
+typedef struct {
+    char **files;
+    int nfiles;
+    QsmMap *maps;
+    uint64_t **lines;               // 懒建的行首偏移表，只为要输出的文件建
+    size_t *nlines;
+} Side;
+
+// ==================== 记录哈希 ====================
+
+typedef struct {
+    const char *field;              // -k；为空时用默认提示规则
+    size_t field_len;
+    char *buf;
+    size_t buf_cap;
+    uint64_t key, val;
+    int have_key;
+    int user_turn;                  // 上一个 role 是 user
+    int seen_user;
+} RecCtx;
+
+static int key_is(const char *k, size_t kl, const char *s) {
+    return k && kl == strlen(s) && memcmp(k, s, kl) == 0;
+}
+
+static int on_string(void *ud, const char *key, size_t klen, const char *raw, size_t rlen, int depth) {
+    RecCtx *c = ud;
+    if (rlen > c->buf_cap) {
+        c->buf_cap = rlen * 2;
+        c->buf = realloc(c->buf, c->buf_cap);
+    }
+    size_t n = qsm_json_unescape(raw, rlen, c->buf);
+    uint64_t hk = key ? qsm_hash64(key, klen, (uint64_t)depth) : 0;
+    uint64_t hv = qsm_hash64(c->buf, n, hk);
+    c->val = qsm_mix64(c->val ^ hv) + hk;
+
+    int is_key = 0;
+    if (c->field) {
+        is_key = key && klen == c->field_len && memcmp(key, c->field, klen) == 0;
+    } else if (key_is(key, klen, "role")) {
+        c->user_turn = n == 4 && memcmp(c->buf, "user", 4) == 0;
+    } else if (key_is(key, klen, "content")) {
+        // messages 格式只取第一个 user 消息作为键
+        is_key = c->user_turn && !c->seen_user;
+        if (is_key) c->seen_user = 1;
+    } else {
+        is_key = depth == 1 && (key_is(key, klen, "instruction") || key_is(key, klen, "input") ||
+                                key_is(key, klen, "original") || key_is(key, klen, "prompt") ||
+                                key_is(key, klen, "question"));
+    }
+    if (is_key) {
+        c->key = qsm_mix64(c->key ^ qsm_hash64(c->buf, n, 0x6b6579));
+        c->have_key = 1;
+    }
+    return 0;
+}
+
+// ==================== 并行扫描 ====================
+
+typedef struct {
+    const QsmMap *maps;             // 旧侧文件在前，新侧在后
+    QsmChunk *chunks;
+    int nchunks;
+    int split;                      // chunks[0, split) 属于旧侧
+    int nfiles_a;
+    const char *field;
+    uint64_t part_mask, part;       // 只保留 (键哈希 >> 52) & mask == part 的条目
+    atomic_int next;
+    EntryVec *out_a, *out_b;        // [nthreads]
+    atomic_ullong malformed;
+} ScanJob;
+
+typedef struct {
+    ScanJob *job;
+    int id;
+} ScanArg;
+
+static void *scan_thread(void *arg) {
+    ScanArg *a = arg;
+    ScanJob *job = a->job;
+    RecCtx c;
+    memset(&c, 0, sizeof(c));
+    c.field = job->field;
+    c.field_len = job->field ? strlen(job->field) : 0;
+    uint64_t bad = 0;
+    for (;;) {
+        int i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->nchunks) break;
+        const QsmChunk *ch = &job->chunks[i];
+        int side_b = i >= job->split;
+        EntryVec *out = side_b ? &job->out_b[a->id] : &job->out_a[a->id];
+        uint64_t file = (uint64_t)(side_b ? ch->file - job->nfiles_a : ch->file);
+        const char *base = job->maps[ch->file].data;
+        for (const char *p = ch->lo; p < ch->hi;) {
+            const char *eol;
+            const char *nx = qsm_next_line(p, ch->hi, &eol);
+            if (!qsm_is_blank_line(p, eol)) {
+                c.key = c.val = 0;
+                c.have_key = c.user_turn = c.seen_user = 0;
+                if (qsm_json_scan(p, eol, on_string, &c) < 0) bad++;
+                Entry e;
+                e.val = c.val;
+                e.key = c.have_key ? c.key : c.val;
+                if (((e.key >> 52) & job->part_mask) == job->part) {
+                    e.loc = file << OFF_BITS | (uint64_t)(p - base);
+                    vec_push(out, &e);
+                }
+            }
+            p = nx;
+        }
+    }
+    if (job->part == 0) atomic_fetch_add(&job->malformed, bad);
+    free(c.buf);
+    return NULL;
+}
+
+// ==================== 位置与输出 ====================
+
+static int load_side(const char *path, Side *s) {
+    memset(s, 0, sizeof(*s));
+    s->nfiles = qsm_list_jsonl(path, &s->files);
+    if (s->nfiles <= 0) return -1;
+    s->maps = calloc(s->nfiles, sizeof(QsmMap));
+    s->lines = calloc(s->nfiles, sizeof(uint64_t *));
+    s->nlines = calloc(s->nfiles, sizeof(size_t));
+    for (int i = 0; i < s->nfiles; i++)
+        if (qsm_map_file(s->files[i], &s->maps[i]) != 0) return -1;
+    return 0;
+}
+
+static void free_side(Side *s) {
+    for (int i = 0; i < s->nfiles; i++) {
+        qsm_unmap_file(&s->maps[i]);
+        free(s->lines[i]);
+    }
+    free(s->maps);
+    free(s->lines);
+    free(s->nlines);
+    qsm_free_list(s->files, s->nfiles);
+}
+
+static unsigned line_of(Side *s, int file, uint64_t off) {
+    if (!s->lines[file]) {
+        const char *p = s->maps[file].data, *end = p + s->maps[file].size;
+        size_t n = 0, cap = 1024;
+        uint64_t *t = malloc(cap * sizeof(uint64_t));
+        t[n++] = 0;
+        while ((p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+            if (n == cap) { cap *= 2; t = realloc(t, cap * sizeof(uint64_t)); }
+            t[n++] = (uint64_t)(++p - s->maps[file].data);
+        }
+        s->lines[file] = t;
+        s->nlines[file] = n;
+    }
+    const uint64_t *t = s->lines[file];
+    size_t lo = 0, hi = s->nlines[file];
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (t[mid] <= off) lo = mid;
+        else hi = mid;
+    }
+    return (unsigned)lo + 1;
+}
+
+static void print_loc(Side *s, uint64_t loc) {
+    int file = (int)(loc >> OFF_BITS);
+    fprintf(stdout, "%s:%u", s->files[file], line_of(s, file, loc & ((1ULL << OFF_BITS) - 1)));
+}
+
+// 原始行的前若干字节（不切坏 UTF-8）
+static void print_excerpt(const Side *s, uint64_t loc, const char *mark) {
+    const QsmMap *m = &s->maps[loc >> OFF_BITS];
+    const char *p = m->data + (loc & ((1ULL << OFF_BITS) - 1)), *end = m->data + m->size;
+    const char *eol = memchr(p, '\n', (size_t)(end - p));
+    if (!eol) eol = end;
+    const char *cut = eol - p > 160 ? p + 160 : eol;
+    while (cut < eol && ((unsigned char)*cut & 0xC0) == 0x80) cut++;
+    fprintf(stdout, "    %s %.*s%s\n", mark, (int)(cut - p), p, cut < eol ? " ..." : "");
+}
+
+// ==================== 对齐 ====================
+
+enum { K_ADD, K_DEL, K_MOD, K_COUNT };
+
+typedef struct {
+    int kind;
+    uint64_t a, b;                  // 删除只有 a，新增只有 b
+} Report;
+
+typedef struct {
+    Report *r;
+    size_t n, cap;
+    uint64_t count[K_COUNT];
+    uint64_t same;
+} Result;
+
+static void add_report(Result *res, int kind, uint64_t a, uint64_t b) {
+    res->count[kind]++;
+    if (res->n == res->cap) {
+        res->cap = res->cap ? res->cap * 2 : 1024;
+        res->r = realloc(res->r, res->cap * sizeof(Report));
+    }
+    res->r[res->n].kind = kind;
+    res->r[res->n].a = a;
+    res->r[res->n].b = b;
+    res->n++;
+}
+
+static int cmp_entry(const void *a, const void *b) {
+    const Entry *x = a, *y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    if (x->val != y->val) return x->val < y->val ? -1 : 1;
+    return x->loc < y->loc ? -1 : x->loc > y->loc;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_report(const void *a, const void *b) {
+    const Report *x = a, *y = b;
+    if (x->kind != y->kind) return x->kind < y->kind ? -1 : 1;
+    uint64_t px = x->kind == K_DEL ? x->a : x->b, py = y->kind == K_DEL ? y->a : y->b;
+    return px < py ? -1 : px > py;
+}
+
+// 两侧都按 (键, 内容, 位置) 排好序；逐个键分组对齐
+static void align(const Entry *A, size_t na, const Entry *B, size_t nb, Result *res) {
+    uint64_t *ra = NULL, *rb = NULL;
+    size_t cap = 0;
+    size_t i = 0, j = 0;
+    while (i < na || j < nb) {
+        uint64_t key = i < na && (j >= nb || A[i].key <= B[j].key) ? A[i].key : B[j].key;
+        size_t i2 = i, j2 = j;
+        while (i2 < na && A[i2].key == key) i2++;
+        while (j2 < nb && B[j2].key == key) j2++;
+        if (cap < (i2 - i) + (j2 - j)) {
+            cap = (i2 - i) + (j2 - j);
+            ra = realloc(ra, cap * sizeof(uint64_t));
+            rb = realloc(rb, cap * sizeof(uint64_t));
+        }
+        size_t nra = 0, nrb = 0;
+        while (i < i2 && j < j2) {
+            if (A[i].val == B[j].val) { res->same++; i++; j++; }
+            else if (A[i].val < B[j].val) ra[nra++] = A[i++].loc;
+            else rb[nrb++] = B[j++].loc;
+        }
+        while (i < i2) ra[nra++] = A[i++].loc;
+        while (j < j2) rb[nrb++] = B[j++].loc;
+        // 同一键下剩余的按出现顺序配对
+        qsort(ra, nra, sizeof(uint64_t), cmp_u64);
+        qsort(rb, nrb, sizeof(uint64_t), cmp_u64);
+        size_t k = 0;
+        for (; k < nra && k < nrb; k++) add_report(res, K_MOD, ra[k], rb[k]);
+        for (size_t x = k; x < nra; x++) add_report(res, K_DEL, ra[x], 0);
+        for (size_t x = k; x < nrb; x++) add_report(res, K_ADD, 0, rb[x]);
+    }
+    free(ra);
+    free(rb);
+}
+
+static EntryVec concat(EntryVec *parts, int n) {
+    EntryVec v = { 0 };
+    for (int t = 0; t < n; t++) v.cap += parts[t].n;
+    v.e = malloc((v.cap ? v.cap : 1) * sizeof(Entry));
+    for (int t = 0; t < n; t++) {
+        memcpy(v.e + v.n, parts[t].e, parts[t].n * sizeof(Entry));
+        v.n += parts[t].n;
+        free(parts[t].e);
+        parts[t].e = NULL;
+        parts[t].n = parts[t].cap = 0;
+    }
+    return v;
+}
+
+int main(int argc, char *argv[]) {
+    int nthreads = qsm_default_threads(), verbose = 0, argi = 1;
+    long limit = 10;
+    double budget_mb = 256;
+    const char *field = NULL;
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        const char *a = argv[argi];
+        if (strcmp(a, "-a") == 0) { limit = -1; continue; }
+        if (strcmp(a, "-v") == 0) { verbose = 1; continue; }
+        if (argi + 1 >= argc) break;
+        if (strcmp(a, "-t") == 0) nthreads = atoi(argv[++argi]);
+        else if (strcmp(a, "-k") == 0) field = argv[++argi];
+        else if (strcmp(a, "-M") == 0) budget_mb = atof(argv[++argi]);
+        else if (strcmp(a, "-n") == 0) limit = atol(argv[++argi]);
+        else break;
+    }
+    if (argi + 2 != argc) {
+        fprintf(stderr, "用法: %s [-t 线程] [-k 字段] [-M 256] [-n 10 | -a] [-v] <旧> <新>\n", argv[0]);
+        fprintf(stderr, "\n对比两个版本的语料（文件或目录）：新增 / 删除 / 修改的记录，修改按键对齐\n");
+        fprintf(stderr, "  -k  对齐用的字段（默认取提示：user 消息 / instruction+input / original）\n");
+        fprintf(stderr, "  -M  哈希表内存预算，超出时按键哈希分趟\n");
+        fprintf(stderr, "  -n  每类最多列出几条（-a 全部列出），-v 同时列出记录内容\n");
+        return 2;
+    }
+    if (nthreads < 1) nthreads = 1;
+    double t0 = now_sec();
+    Side sa, sb;
+    if (load_side(argv[argi], &sa) != 0 || load_side(argv[argi + 1], &sb) != 0) {
+        fprintf(stderr, "[DIFF] 无法读取: %s / %s\n", argv[argi], argv[argi + 1]);
+        return 2;
+    }
+    int nall = sa.nfiles + sb.nfiles;
+    QsmMap *maps = malloc(nall * sizeof(QsmMap));
+    memcpy(maps, sa.maps, sa.nfiles * sizeof(QsmMap));
+    memcpy(maps + sa.nfiles, sb.maps, sb.nfiles * sizeof(QsmMap));
+
+    // 行数估算条目数，决定分几趟
+    uint64_t lines = 0;
+    for (int f = 0; f < nall; f++)
+        for (const char *p = maps[f].data, *end = p + maps[f].size; (p = memchr(p, '\n', (size_t)(end - p))) != NULL; p++)
+            lines++;
+    uint64_t need = (lines + nall) * sizeof(Entry) * 2;
+    uint64_t passes = 1;
+    while (passes < 4096 && need / passes > (uint64_t)(budget_mb * 1048576)) passes *= 2;
+
+    ScanJob job;
+    memset(&job, 0, sizeof(job));
+    job.maps = maps;
+    job.nchunks = qsm_make_chunks(maps, nall, CHUNK_BYTES, &job.chunks);
+    job.split = 0;
+    while (job.split < job.nchunks && job.chunks[job.split].file < sa.nfiles) job.split++;
+    job.nfiles_a = sa.nfiles;
+    job.field = field;
+    job.part_mask = passes - 1;
+    job.out_a = calloc(nthreads, sizeof(EntryVec));
+    job.out_b = calloc(nthreads, sizeof(EntryVec));
+    atomic_init(&job.malformed, 0);
+
+    Result res;
+    memset(&res, 0, sizeof(res));
+    uint64_t rec_a = 0, rec_b = 0;
+    long shown[K_COUNT] = { 0 };
+    static const char *const mark[K_COUNT] = { "+", "-", "~" };
+    pthread_t *th = malloc(nthreads * sizeof(pthread_t));
+    ScanArg *args = malloc(nthreads * sizeof(ScanArg));
+    for (uint64_t part = 0; part < passes; part++) {
+        job.part = part;
+        atomic_init(&job.next, 0);
+        for (int t = 0; t < nthreads; t++) {
+            args[t].job = &job;
+            args[t].id = t;
+            pthread_create(&th[t], NULL, scan_thread, &args[t]);
+        }
+        for (int t = 0; t < nthreads; t++) pthread_join(th[t], NULL);
+        EntryVec A = concat(job.out_a, nthreads), B = concat(job.out_b, nthreads);
+        rec_a += A.n;
+        rec_b += B.n;
+        qsort(A.e, A.n, sizeof(Entry), cmp_entry);
+        qsort(B.e, B.n, sizeof(Entry), cmp_entry);
+        res.n = 0;
+        align(A.e, A.n, B.e, B.n, &res);
+        free(A.e);
+        free(B.e);
+
+        qsort(res.r, res.n, sizeof(Report), cmp_report);
+        for (size_t k = 0; k < res.n; k++) {
+            const Report *r = &res.r[k];
+            if (limit >= 0 && shown[r->kind] >= limit) continue;
+            shown[r->kind]++;
+            fprintf(stdout, "%s ", mark[r->kind]);
+            if (r->kind != K_ADD) print_loc(&sa, r->a);
+            if (r->kind == K_MOD) fprintf(stdout, " -> ");
+            if (r->kind != K_DEL) print_loc(&sb, r->b);
+            fputc('\n', stdout);
+            if (verbose && r->kind != K_ADD) print_excerpt(&sa, r->a, "<");
+            if (verbose && r->kind != K_DEL) print_excerpt(&sb, r->b, ">");
+        }
+    }
+    uint64_t changes = res.count[K_ADD] + res.count[K_DEL] + res.count[K_MOD];
+    fprintf(stdout, "[DIFF] 旧 %llu 条 / 新 %llu 条: 相同 %llu, 修改 %llu, 新增 %llu, 删除 %llu",
+            (unsigned long long)rec_a, (unsigned long long)rec_b, (unsigned long long)res.same,
+            (unsigned long long)res.count[K_MOD], (unsigned long long)res.count[K_ADD],
+            (unsigned long long)res.count[K_DEL]);
+    if (atomic_load(&job.malformed))
+        fprintf(stdout, ", 格式错误 %llu", (unsigned long long)atomic_load(&job.malformed));
+    fprintf(stdout, " (%llu 趟, %.2fs)\n", (unsigned long long)passes, now_sec() - t0);
+
+    free(th);
+    free(args);
+    free(res.r);
+    free(job.chunks);
+    free(job.out_a);
+    free(job.out_b);
+    free(maps);
+    free_side(&sa);
+    free_side(&sb);
+    return changes ? 1 : 0;
+}
@@ -0,0 +1,584 @@
+/*
+ * yi_corpus_index.c — 语料全文倒排索引（码点 n-gram）
+ *
+ * 整理语料时经常要找某个彝文字或中文短语出现在哪些记录里。
+ * build 为每个 *.jsonl 建一个段：记录表 + 码点一元 / 二元 gram 词典 + 倒排表
+ * （文档号差分后 varint 编码）；query 通过 mmap 直接在段里二分查 gram，
+ * 取最稀有的几个二元 gram 求交，再回源文件逐条核对子串。
+ *
+ * 段内偏移都相对段起点，可整体搬移：重建时源文件大小、mtime 与内容哈希
+ * 都没变的段原样拷贝，只重新索引改过的文件。
+ *
+ * 只索引字符串值（role 除外），gram 不跨字符串；查询按反转义后的原文精确匹配。
+ *
+ * 用法: yi_corpus_index build [-t 线程] -o <index.yix> <目录|文件>...
+ *       yi_corpus_index query [-n 20] [-c] <index.yix> <文本>
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "qsm_jsonl.h"
+
+#define YIX_MAGIC 0x31584959u       // "YIX1"
+#define YIX_VERSION 1
+#define BIGRAM_FLAG ((uint64_t)1 << 42)
+#define MAX_QUERY_CP 256
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ==================== 文件格式 ====================
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nsegs;
+    uint32_t pad;
+    uint64_t file_size;
+    uint64_t dir_off;               // YixDirEnt[nsegs]
+} YixHeader;
+
+typedef struct {
+    uint64_t off;                   // 段在索引文件中的起点（8 字节对齐）
+    uint64_t size;
+    uint64_t src_size;
+    int64_t src_mtime_ns;
+    uint64_t src_hash;
+} YixDirEnt;
+
+// 段头；以下偏移均相对段起点
+typedef struct {
+    uint32_t ndocs;
+    uint32_t ngrams;
+    uint64_t docs_off;              // YixDoc[ndocs]
+    uint64_t grams_off;             // YixGram[ngrams]，按 key 升序
+    uint64_t post_off;
+    uint64_t post_size;
+    uint64_t path_off;
+    uint32_t path_len;
+    uint32_t pad;
+} YixSegHdr;
+
+typedef struct {
+    uint64_t off;                   // 记录在源文件中的字节偏移
+    uint32_t len;
+    uint32_t line;                  // 1 起
+} YixDoc;
+
+typedef struct {
+    uint64_t key;                   // 一元: cp；二元: BIGRAM_FLAG | cp1 << 21 | cp2
+    uint64_t post;                  // 相对 post_off
+    uint32_t count;
+    uint32_t pad;
+} YixGram;
+
+static uint64_t bigram_key(uint32_t a, uint32_t b) {
+    return BIGRAM_FLAG | ((uint64_t)a << 21) | b;
+}
+
+// ==================== 字节缓冲 ====================
+
+typedef struct {
+    uint8_t *data;
+    size_t len, cap;
+} Buf;
+
+static void buf_put(Buf *b, const void *p, size_t n) {
+    if (b->len + n > b->cap) {
+        b->cap = b->cap ? b->cap : 1 << 16;
+        while (b->len + n > b->cap) b->cap *= 2;
+        b->data = realloc(b->data, b->cap);
+    }
+    memcpy(b->data + b->len, p, n);
+    b->len += n;
+}
+
+static void buf_align(Buf *b) {
+    static const uint8_t zero[8] = { 0 };
+    if (b->len % 8) buf_put(b, zero, 8 - b->len % 8);
+}
+
+static void put_varint(Buf *b, uint32_t v) {
+    uint8_t tmp[5];
+    int n = 0;
+    while (v >= 0x80) { tmp[n++] = (uint8_t)(v | 0x80); v >>= 7; }
+    tmp[n++] = (uint8_t)v;
+    buf_put(b, tmp, n);
+}
+
+static const uint8_t *get_varint(const uint8_t *p, uint32_t *v) {
+    uint32_t x = 0;
+    int shift = 0;
+    while (*p & 0x80) { x |= (uint32_t)(*p++ & 0x7F) << shift; shift += 7; }
+    *v = x | ((uint32_t)*p++ << shift);
+    return p;
+}
+
+// ==================== 建段 ====================
+
+typedef struct {
+    uint64_t key;
+    uint32_t doc;
+    uint32_t pad;
+} Hit;
+
+typedef struct {
+    Hit *hits;
+    size_t n, cap;
+    uint32_t doc;
+    char *buf;
+    size_t buf_cap;
+} SegCtx;
+
+static void add_hit(SegCtx *c, uint64_t key) {
+    if (c->n == c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 1 << 16;
+        c->hits = realloc(c->hits, c->cap * sizeof(Hit));
+    }
+    c->hits[c->n].key = key;
+    c->hits[c->n].doc = c->doc;
+    c->hits[c->n].pad = 0;
+    c->n++;
+}
+
+static int on_string(void *ud, const char *key, size_t klen, const char *raw, size_t rlen, int depth) {
+    SegCtx *c = ud;
+    (void)depth;
+    if (key && klen == 4 && memcmp(key, "role", 4) == 0) return 0;
+    if (rlen > c->buf_cap) {
+        c->buf_cap = rlen * 2;
+        c->buf = realloc(c->buf, c->buf_cap);
+    }
+    size_t n = qsm_json_unescape(raw, rlen, c->buf);
+    const char *p = c->buf, *end = c->buf + n;
+    uint32_t prev = 0;
+    int have_prev = 0;
+    while (p < end) {
+        uint32_t cp;
+        p += qsm_utf8_next(p, end, &cp);
+        add_hit(c, cp);
+        if (have_prev) add_hit(c, bigram_key(prev, cp));
+        prev = cp;
+        have_prev = 1;
+    }
+    return 0;
+}
+
+static int cmp_hit(const void *a, const void *b) {
+    const Hit *x = a, *y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return x->doc < y->doc ? -1 : x->doc > y->doc;
+}
+
+// 索引一个源文件，生成可搬移的段
+static void build_segment(const char *path, const QsmMap *m, Buf *seg) {
+    SegCtx c;
+    memset(&c, 0, sizeof(c));
+    Buf docs = { 0 };
+    uint32_t line = 0;
+    for (const char *p = m->data, *end = m->data + m->size; p < end;) {
+        const char *eol;
+        const char *nx = qsm_next_line(p, end, &eol);
+        line++;
+        if (!qsm_is_blank_line(p, eol)) {
+            YixDoc d = { (uint64_t)(p - m->data), (uint32_t)(eol - p), line };
+            buf_put(&docs, &d, sizeof(d));
+            qsm_json_scan(p, eol, on_string, &c);
+            c.doc++;
+        }
+        p = nx;
+    }
+    qsort(c.hits, c.n, sizeof(Hit), cmp_hit);
+
+    Buf grams = { 0 }, post = { 0 };
+    for (size_t i = 0; i < c.n;) {
+        YixGram g = { c.hits[i].key, post.len, 0, 0 };
+        uint32_t last = 0;
+        int first = 1;
+        for (; i < c.n && c.hits[i].key == g.key; i++) {
+            uint32_t doc = c.hits[i].doc;
+            if (!first && doc == last) continue;
+            put_varint(&post, first ? doc : doc - last);
+            last = doc;
+            first = 0;
+            g.count++;
+        }
+        buf_put(&grams, &g, sizeof(g));
+    }
+
+    YixSegHdr h;
+    memset(&h, 0, sizeof(h));
+    h.ndocs = c.doc;
+    h.ngrams = (uint32_t)(grams.len / sizeof(YixGram));
+    seg->len = 0;
+    buf_put(seg, &h, sizeof(h));
+    h.docs_off = seg->len;
+    buf_put(seg, docs.data, docs.len);
+    buf_align(seg);
+    h.grams_off = seg->len;
+    buf_put(seg, grams.data, grams.len);
+    h.post_off = seg->len;
+    h.post_size = post.len;
+    buf_put(seg, post.data, post.len);
+    h.path_off = seg->len;
+    h.path_len = (uint32_t)strlen(path);
+    buf_put(seg, path, h.path_len + 1);
+    buf_align(seg);
+    memcpy(seg->data, &h, sizeof(h));
+    free(c.hits);
+    free(c.buf);
+    free(docs.data);
+    free(grams.data);
+    free(post.data);
+}
+
+// ==================== build ====================
+
+typedef struct {
+    char **files;
+    int nfiles;
+    YixDirEnt *ents;
+    Buf *segs;
+    const uint8_t *old;             // 旧索引（可为空）
+    const YixDirEnt *old_ents;
+    uint32_t old_nsegs;
+    atomic_int next;
+    atomic_int reused;
+    atomic_int failed;
+} BuildJob;
+
+static const char *seg_path(const uint8_t *seg) {
+    const YixSegHdr *h = (const YixSegHdr *)seg;
+    return (const char *)seg + h->path_off;
+}
+
+static void *build_thread(void *arg) {
+    BuildJob *job = arg;
+    for (;;) {
+        int i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->nfiles) break;
+        const char *path = job->files[i];
+        YixDirEnt *e = &job->ents[i];
+        struct stat st;
+        QsmMap m;
+        if (stat(path, &st) != 0 || qsm_map_file(path, &m) != 0) {
+            fprintf(stderr, "[INDEX] 无法映射: %s\n", path);
+            atomic_store(&job->failed, 1);
+            continue;
+        }
+        e->src_size = (uint64_t)st.st_size;
+        e->src_mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        // 大小与 mtime 相同就不再读内容；否则比内容哈希，仍相同也可复用
+        const YixDirEnt *old = NULL;
+        for (uint32_t k = 0; k < job->old_nsegs; k++)
+            if (strcmp(seg_path(job->old + job->old_ents[k].off), path) == 0) { old = &job->old_ents[k]; break; }
+        if (old && old->src_size == e->src_size && old->src_mtime_ns == e->src_mtime_ns) {
+            e->src_hash = old->src_hash;
+        } else {
+            e->src_hash = qsm_hash64(m.data, m.size, 0);
+        }
+        if (old && old->src_hash == e->src_hash && old->src_size == e->src_size) {
+            buf_put(&job->segs[i], job->old + old->off, old->size);
+            atomic_fetch_add(&job->reused, 1);
+        } else {
+            build_segment(path, &m, &job->segs[i]);
+        }
+        e->size = job->segs[i].len;
+        qsm_unmap_file(&m);
+    }
+    return NULL;
+}
+
+static int validate(const QsmMap *m) {
+    if (m->size < sizeof(YixHeader)) return -1;
+    const YixHeader *h = (const YixHeader *)m->data;
+    if (h->magic != YIX_MAGIC || h->version != YIX_VERSION || h->file_size != m->size ||
+        h->dir_off + (uint64_t)h->nsegs * sizeof(YixDirEnt) > m->size) return -1;
+    return 0;
+}
+
+static int cmd_build(int argc, char **argv) {
+    const char *out = NULL;
+    int nthreads = qsm_default_threads(), argi = 0;
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "-o") == 0 && argi + 1 < argc) out = argv[++argi];
+        else if (strcmp(argv[argi], "-t") == 0 && argi + 1 < argc) nthreads = atoi(argv[++argi]);
+        else break;
+    }
+    if (!out || argi >= argc) {
+        fprintf(stderr, "用法: yi_corpus_index build [-t 线程] -o <index.yix> <目录|文件>...\n");
+        return 1;
+    }
+    if (nthreads < 1) nthreads = 1;
+    double t0 = now_sec();
+    BuildJob job;
+    memset(&job, 0, sizeof(job));
+    for (; argi < argc; argi++) {
+        char **list;
+        int n = qsm_list_jsonl(argv[argi], &list);
+        if (n < 0) { fprintf(stderr, "[INDEX] 无法读取: %s\n", argv[argi]); return 1; }
+        job.files = realloc(job.files, (job.nfiles + n) * sizeof(char *));
+        memcpy(job.files + job.nfiles, list, n * sizeof(char *));
+        job.nfiles += n;
+        free(list);
+    }
+    QsmMap old = { 0 };
+    if (qsm_map_file(out, &old) == 0 && validate(&old) == 0) {
+        const YixHeader *h = (const YixHeader *)old.data;
+        job.old = (const uint8_t *)old.data;
+        job.old_ents = (const YixDirEnt *)(old.data + h->dir_off);
+        job.old_nsegs = h->nsegs;
+    }
+    job.ents = calloc(job.nfiles ? job.nfiles : 1, sizeof(YixDirEnt));
+    job.segs = calloc(job.nfiles ? job.nfiles : 1, sizeof(Buf));
+    atomic_init(&job.next, 0);
+    atomic_init(&job.reused, 0);
+    atomic_init(&job.failed, 0);
+    pthread_t *th = malloc(nthreads * sizeof(pthread_t));
+    for (int t = 0; t < nthreads; t++) pthread_create(&th[t], NULL, build_thread, &job);
+    for (int t = 0; t < nthreads; t++) pthread_join(th[t], NULL);
+    free(th);
+    qsm_unmap_file(&old);
+    if (atomic_load(&job.failed)) return 1;
+
+    // 写到临时文件再改名，查询方不会读到半个索引
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", out);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) { fprintf(stderr, "[INDEX] 无法写: %s\n", tmp); return 1; }
+    YixHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = YIX_MAGIC;
+    h.version = YIX_VERSION;
+    h.nsegs = (uint32_t)job.nfiles;
+    uint64_t pos = sizeof(h);
+    for (int i = 0; i < job.nfiles; i++) {
+        job.ents[i].off = pos;
+        pos += job.ents[i].size;
+    }
+    h.dir_off = pos;
+    h.file_size = pos + (uint64_t)job.nfiles * sizeof(YixDirEnt);
+    fwrite(&h, sizeof(h), 1, f);
+    uint64_t ndocs = 0, ngrams = 0;
+    for (int i = 0; i < job.nfiles; i++) {
+        fwrite(job.segs[i].data, 1, job.segs[i].len, f);
+        const YixSegHdr *sh = (const YixSegHdr *)job.segs[i].data;
+        ndocs += sh->ndocs;
+        ngrams += sh->ngrams;
+        free(job.segs[i].data);
+    }
+    fwrite(job.ents, sizeof(YixDirEnt), job.nfiles, f);
+    if (fclose(f) != 0 || rename(tmp, out) != 0) { fprintf(stderr, "[INDEX] 无法写: %s\n", out); return 1; }
+    fprintf(stdout, "[INDEX] %d 个文件 (复用 %d, 重建 %d), %llu 条记录, %llu 个 gram, %.1f MB, %.2fs\n",
+            job.nfiles, atomic_load(&job.reused), job.nfiles - atomic_load(&job.reused),
+            (unsigned long long)ndocs, (unsigned long long)ngrams, h.file_size / 1048576.0, now_sec() - t0);
+    free(job.segs);
+    free(job.ents);
+    qsm_free_list(job.files, job.nfiles);
+    return 0;
+}
+
+// ==================== query ====================
+
+static const YixGram *find_gram(const uint8_t *seg, uint64_t key) {
+    const YixSegHdr *h = (const YixSegHdr *)seg;
+    const YixGram *g = (const YixGram *)(seg + h->grams_off);
+    uint32_t lo = 0, hi = h->ngrams;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (g[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < h->ngrams && g[lo].key == key ? &g[lo] : NULL;
+}
+
+static uint32_t decode_postings(const uint8_t *seg, const YixGram *g, uint32_t *out) {
+    const YixSegHdr *h = (const YixSegHdr *)seg;
+    const uint8_t *p = seg + h->post_off + g->post;
+    uint32_t doc = 0;
+    for (uint32_t i = 0; i < g->count; i++) {
+        uint32_t d;
+        p = get_varint(p, &d);
+        doc = i ? doc + d : d;
+        out[i] = doc;
+    }
+    return g->count;
+}
+
+// 有序数组求交，结果写回 a
+static uint32_t intersect(uint32_t *a, uint32_t na, const uint32_t *b, uint32_t nb) {
+    uint32_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) i++;
+        else if (a[i] > b[j]) j++;
+        else { a[k++] = a[i]; i++; j++; }
+    }
+    return k;
+}
+
+static int cmp_gram_count(const void *a, const void *b) {
+    const YixGram *x = *(const YixGram *const *)a, *y = *(const YixGram *const *)b;
+    return x->count < y->count ? -1 : x->count > y->count;
+}
+
+typedef struct {
+    const char *q;
+    size_t qlen;
+    char *buf;
+    size_t buf_cap;
+    const char *hit;                // 命中所在字符串（反转义后）
+    size_t hit_len, hit_at;
+} VerifyCtx;
+
+static int on_verify(void *ud, const char *key, size_t klen, const char *raw, size_t rlen, int depth) {
+    VerifyCtx *v = ud;
+    (void)depth;
+    if (key && klen == 4 && memcmp(key, "role", 4) == 0) return 0;
+    if (rlen > v->buf_cap) {
+        v->buf_cap = rlen * 2;
+        v->buf = realloc(v->buf, v->buf_cap);
+    }
+    size_t n = qsm_json_unescape(raw, rlen, v->buf);
+    const char *m = memmem(v->buf, n, v->q, v->qlen);
+    if (!m) return 0;
+    v->hit = v->buf;
+    v->hit_len = n;
+    v->hit_at = (size_t)(m - v->buf);
+    return 1;
+}
+
+// 命中附近的一段上下文（按码点截断，不切坏 UTF-8）
+static void print_context(const VerifyCtx *v) {
+    const char *s = v->hit, *end = v->hit + v->hit_len;
+    const char *lo = v->hit + v->hit_at, *hi = lo + v->qlen;
+    for (int k = 0; k < 20 && lo > s; k++) {
+        lo--;
+        while (lo > s && ((unsigned char)*lo & 0xC0) == 0x80) lo--;
+    }
+    for (int k = 0; k < 40 && hi < end; k++) {
+        uint32_t cp;
+        hi += qsm_utf8_next(hi, end, &cp);
+    }
+    for (const char *p = lo; p < hi; p++) fputc(*p == '\n' ? ' ' : *p, stdout);
+}
+
+static int cmd_query(int argc, char **argv) {
+    int max = 20, count_only = 0, argi = 0;
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "-n") == 0 && argi + 1 < argc) max = atoi(argv[++argi]);
+        else if (strcmp(argv[argi], "-c") == 0) count_only = 1;
+        else break;
+    }
+    if (argi + 2 != argc) {
+        fprintf(stderr, "用法: yi_corpus_index query [-n 20] [-c] <index.yix> <文本>\n");
+        return 1;
+    }
+    const char *q = argv[argi + 1];
+    size_t qlen = strlen(q);
+    uint32_t qcp[MAX_QUERY_CP];
+    int nq = 0;
+    for (const char *p = q, *end = q + qlen; p < end && nq < MAX_QUERY_CP;) p += qsm_utf8_next(p, end, &qcp[nq++]);
+    if (nq == 0) return 1;
+
+    double t0 = now_sec();
+    QsmMap m;
+    if (qsm_map_file(argv[argi], &m) != 0 || validate(&m) != 0) {
+        fprintf(stderr, "[INDEX] 不是有效的索引: %s\n", argv[argi]);
+        return 1;
+    }
+    const YixHeader *h = (const YixHeader *)m.data;
+    const YixDirEnt *ents = (const YixDirEnt *)(m.data + h->dir_off);
+    uint64_t total = 0, candidates = 0;
+    int shown = 0, stale = 0;
+    uint32_t *acc = NULL, *tmp = NULL;
+    size_t cap = 0;
+    VerifyCtx v;
+    memset(&v, 0, sizeof(v));
+    v.q = q;
+    v.qlen = qlen;
+    for (uint32_t s = 0; s < h->nsegs; s++) {
+        const uint8_t *seg = (const uint8_t *)m.data + ents[s].off;
+        const YixSegHdr *sh = (const YixSegHdr *)seg;
+        if (cap < sh->ndocs) {
+            cap = sh->ndocs;
+            acc = realloc(acc, cap * sizeof(uint32_t));
+            tmp = realloc(tmp, cap * sizeof(uint32_t));
+        }
+        // 候选：单字查一元表；否则按频次从低到高求二元 gram 交集
+        uint32_t nacc;
+        int exact = nq == 1;
+        if (nq == 1) {
+            const YixGram *g = find_gram(seg, qcp[0]);
+            if (!g) continue;
+            nacc = decode_postings(seg, g, acc);
+        } else {
+            const YixGram *gs[MAX_QUERY_CP];
+            int ng = 0, missing = 0;
+            for (int i = 0; i + 1 < nq; i++) {
+                gs[ng] = find_gram(seg, bigram_key(qcp[i], qcp[i + 1]));
+                if (!gs[ng]) { missing = 1; break; }
+                ng++;
+            }
+            if (missing) continue;
+            qsort(gs, ng, sizeof(gs[0]), cmp_gram_count);
+            nacc = decode_postings(seg, gs[0], acc);
+            for (int i = 1; i < ng && nacc > 0; i++) {
+                decode_postings(seg, gs[i], tmp);
+                nacc = intersect(acc, nacc, tmp, gs[i]->count);
+            }
+            exact = nq == 2;
+        }
+        if (nacc == 0) continue;
+        candidates += nacc;
+        const char *path = (const char *)seg + sh->path_off;
+        if (exact && count_only) { total += nacc; continue; }
+        QsmMap src;
+        struct stat st;
+        if (stat(path, &st) != 0 || (uint64_t)st.st_size != ents[s].src_size ||
+            (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec != ents[s].src_mtime_ns) stale++;
+        if (qsm_map_file(path, &src) != 0) continue;
+        const YixDoc *docs = (const YixDoc *)(seg + sh->docs_off);
+        for (uint32_t i = 0; i < nacc; i++) {
+            const YixDoc *d = &docs[acc[i]];
+            if (d->off + d->len > src.size) continue;
+            v.hit = NULL;
+            qsm_json_scan(src.data + d->off, src.data + d->off + d->len, on_verify, &v);
+            if (!v.hit) continue;
+            total++;
+            if (!count_only && shown < max) {
+                fprintf(stdout, "%s:%u: ", path, d->line);
+                print_context(&v);
+                fputc('\n', stdout);
+                shown++;
+            }
+        }
+        qsm_unmap_file(&src);
+    }
+    fprintf(stdout, "[INDEX] \"%s\": %llu 条记录命中 (候选 %llu), %.2f ms%s\n", q,
+            (unsigned long long)total, (unsigned long long)candidates, (now_sec() - t0) * 1e3,
+            stale ? "（部分源文件已改动，请重新 build）" : "");
+    free(acc);
+    free(tmp);
+    free(v.buf);
+    qsm_unmap_file(&m);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "build") == 0) return cmd_build(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "query") == 0) return cmd_query(argc - 2, argv + 2);
+    fprintf(stderr, "用法: %s build [-t 线程] -o <index.yix> <目录|文件>...\n", argv[0]);
+    fprintf(stderr, "      %s query [-n 20] [-c] <index.yix> <文本>\n", argv[0]);
+    fprintf(stderr, "\n语料全文倒排索引：码点一元 / 二元 gram，倒排表差分 varint 压缩，\n");
+    fprintf(stderr, "重建时只重新索引改动过的文件\n");
+    return 1;
+}
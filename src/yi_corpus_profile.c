@@ -0,0 +1,754 @@
+/*
+ * yi_corpus_profile.c — 语料单遍流式统计与质量画像
+ *
+ * 一次多线程扫描 data 目录下的 *.jsonl，按文件统计：
+ *   记录数、空记录、格式错误、记录格式（messages / input-output / text）、
+ *   角色与轮数分布、文字构成（彝文 PUA / 汉字 / 拉丁）、长度直方图与分位数。
+ * 全局去重数用 HyperLogLog 估计，长度分位数用 t-digest 估计；
+ * 两者的原始状态写在输出的 "sketches" 里，--merge 可以把多份分片结果
+ * 合并成一份（HLL 取寄存器最大值，t-digest 合并质心），不必重扫语料。
+ *
+ * 输出 JSON 中每个文件一行，--merge 按行读回。
+ *
+ * 用法: yi_corpus_profile [-t 线程] [-o stats.json] <目录|文件>...
+ *       yi_corpus_profile --merge [-o stats.json] <stats.json>...
+ */
+#define _GNU_SOURCE
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "qsm_jsonl.h"
+
+#define LEN_BUCKETS 14          // 0, 1, 2-3, 4-7, ..., >=4096（码点）
+#define TURN_BUCKETS 10         // 0..8 轮, >=9 轮
+#define HLL_P 14                // 全局 HLL：16384 个寄存器，标准误差约 0.8%
+#define HLL_FILE_P 12           // 单文件 HLL（不输出状态）
+#define TD_COMPRESSION 200.0
+#define TD_BUFFER 256
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ==================== HyperLogLog ====================
+
+typedef struct {
+    int p;
+    uint8_t *reg;
+} Hll;
+
+static void hll_init(Hll *h, int p) {
+    h->p = p;
+    h->reg = calloc((size_t)1 << p, 1);
+}
+
+static void hll_add(Hll *h, uint64_t x) {
+    uint32_t idx = (uint32_t)(x >> (64 - h->p));
+    uint64_t w = (x << h->p) | ((uint64_t)1 << (h->p - 1));
+    uint8_t rank = (uint8_t)(__builtin_clzll(w) + 1);
+    if (rank > h->reg[idx]) h->reg[idx] = rank;
+}
+
+static void hll_merge(Hll *dst, const Hll *src) {
+    for (size_t i = 0; i < (size_t)1 << dst->p; i++)
+        if (src->reg[i] > dst->reg[i]) dst->reg[i] = src->reg[i];
+}
+
+static double hll_estimate(const Hll *h) {
+    size_t m = (size_t)1 << h->p, zeros = 0;
+    double sum = 0;
+    for (size_t i = 0; i < m; i++) {
+        sum += ldexp(1.0, -h->reg[i]);
+        zeros += h->reg[i] == 0;
+    }
+    double est = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (est <= 2.5 * m && zeros) est = m * log((double)m / zeros);   // 小基数改用线性计数
+    return est;
+}
+
+// ==================== t-digest（合并式，k1 尺度函数） ====================
+
+typedef struct {
+    double mean, weight;
+} Centroid;
+
+typedef struct {
+    Centroid *c;
+    int n, cap;
+    Centroid *buf;
+    int nbuf;
+    double total;
+    double min, max;
+} TDigest;
+
+static double td_scale(double q) {
+    if (q < 0) q = 0;
+    if (q > 1) q = 1;
+    return TD_COMPRESSION / (2 * M_PI) * asin(2 * q - 1);
+}
+
+static int cmp_centroid(const void *a, const void *b) {
+    double x = ((const Centroid *)a)->mean, y = ((const Centroid *)b)->mean;
+    return x < y ? -1 : x > y;
+}
+
+static void td_compress(TDigest *d) {
+    if (d->nbuf == 0) return;
+    int n = d->n + d->nbuf;
+    Centroid *all = malloc(n * sizeof(Centroid));
+    memcpy(all, d->c, d->n * sizeof(Centroid));
+    memcpy(all + d->n, d->buf, d->nbuf * sizeof(Centroid));
+    qsort(all, n, sizeof(Centroid), cmp_centroid);
+    d->nbuf = 0;
+    d->n = 0;
+    double done = 0, k_lo = td_scale(0);
+    Centroid cur = all[0];
+    for (int i = 1; i < n; i++) {
+        double w = cur.weight + all[i].weight;
+        if (td_scale((done + w) / d->total) - k_lo <= 1) {
+            cur.mean += (all[i].mean - cur.mean) * all[i].weight / w;
+            cur.weight = w;
+            continue;
+        }
+        if (d->n == d->cap) d->c = realloc(d->c, (d->cap = d->cap ? d->cap * 2 : 64) * sizeof(Centroid));
+        d->c[d->n++] = cur;
+        done += cur.weight;
+        k_lo = td_scale(done / d->total);
+        cur = all[i];
+    }
+    if (d->n == d->cap) d->c = realloc(d->c, (d->cap = d->cap ? d->cap * 2 : 64) * sizeof(Centroid));
+    d->c[d->n++] = cur;
+    free(all);
+}
+
+static void td_add(TDigest *d, double x, double w) {
+    if (!d->buf) d->buf = malloc(TD_BUFFER * sizeof(Centroid));
+    if (d->total == 0 || x < d->min) d->min = x;
+    if (d->total == 0 || x > d->max) d->max = x;
+    d->buf[d->nbuf].mean = x;
+    d->buf[d->nbuf].weight = w;
+    d->nbuf++;
+    d->total += w;
+    if (d->nbuf == TD_BUFFER) td_compress(d);
+}
+
+static void td_merge(TDigest *dst, TDigest *src) {
+    td_compress(src);
+    double lo = src->min, hi = src->max;
+    for (int i = 0; i < src->n; i++) td_add(dst, src->c[i].mean, src->c[i].weight);
+    if (src->total > 0) {
+        if (lo < dst->min) dst->min = lo;
+        if (hi > dst->max) dst->max = hi;
+    }
+}
+
+static double td_quantile(TDigest *d, double q) {
+    td_compress(d);
+    if (d->n == 0) return 0;
+    if (d->n == 1) return d->c[0].mean;
+    double target = q * d->total, cum = 0;
+    for (int i = 0; i < d->n; i++) {
+        double center = cum + d->c[i].weight / 2;
+        if (target < center) {
+            if (i == 0) return d->min + (d->c[0].mean - d->min) * (center > 0 ? target / center : 0);
+            double pc = cum - d->c[i - 1].weight / 2;
+            return d->c[i - 1].mean + (d->c[i].mean - d->c[i - 1].mean) * (target - pc) / (center - pc);
+        }
+        cum += d->c[i].weight;
+    }
+    double last = d->total - d->c[d->n - 1].weight / 2;
+    double right = d->total - last;
+    return d->c[d->n - 1].mean + (d->max - d->c[d->n - 1].mean) * (right > 0 ? (target - last) / right : 0);
+}
+
+static void td_free(TDigest *d) {
+    free(d->c);
+    free(d->buf);
+}
+
+// ==================== 单文件统计 ====================
+
+enum { SCHEMA_MESSAGES, SCHEMA_INPUT_OUTPUT, SCHEMA_TEXT, SCHEMA_OTHER, SCHEMA_COUNT };
+enum { ROLE_SYSTEM, ROLE_USER, ROLE_ASSISTANT, ROLE_OTHER, ROLE_COUNT };
+
+static const char *SCRIPT_NAME[QSM_SCRIPT_COUNT] = { "yi", "han", "latin", "digit", "space", "punct", "other" };
+static const char *SCHEMA_NAME[SCHEMA_COUNT] = { "messages", "input_output", "text", "other" };
+static const char *ROLE_NAME[ROLE_COUNT] = { "system", "user", "assistant", "other" };
+
+typedef struct {
+    char *name;
+    uint64_t bytes;
+    uint64_t records;
+    uint64_t malformed;
+    uint64_t empty;
+    uint64_t yi_records;
+    uint64_t distinct;          // 单文件去重估计
+    uint64_t codepoints;
+    uint64_t script[QSM_SCRIPT_COUNT];
+    uint64_t schema[SCHEMA_COUNT];
+    uint64_t roles[ROLE_COUNT];
+    uint64_t turns[TURN_BUCKETS];
+    uint64_t len_hist[LEN_BUCKETS];
+    double len_p50, len_p90, len_p99, len_max;
+} FileStat;
+
+static void stat_add(FileStat *dst, const FileStat *src) {
+    dst->bytes += src->bytes;
+    dst->records += src->records;
+    dst->malformed += src->malformed;
+    dst->empty += src->empty;
+    dst->yi_records += src->yi_records;
+    dst->distinct += src->distinct;
+    dst->codepoints += src->codepoints;
+    for (int i = 0; i < QSM_SCRIPT_COUNT; i++) dst->script[i] += src->script[i];
+    for (int i = 0; i < SCHEMA_COUNT; i++) dst->schema[i] += src->schema[i];
+    for (int i = 0; i < ROLE_COUNT; i++) dst->roles[i] += src->roles[i];
+    for (int i = 0; i < TURN_BUCKETS; i++) dst->turns[i] += src->turns[i];
+    for (int i = 0; i < LEN_BUCKETS; i++) dst->len_hist[i] += src->len_hist[i];
+    if (src->len_max > dst->len_max) dst->len_max = src->len_max;
+}
+
+static int len_bucket(uint64_t len) {
+    int b = len ? 64 - __builtin_clzll(len) : 0;
+    return b < LEN_BUCKETS ? b : LEN_BUCKETS - 1;
+}
+
+// ==================== 阶段 1：并行扫描 ====================
+
+typedef struct {
+    FileStat st;
+    TDigest len;
+    Hll records;
+} FileAcc;
+
+typedef struct {
+    FileAcc *files;             // [nfiles]
+    Hll records, prompts, yi_chars;
+} ThreadAcc;
+
+typedef struct {
+    const QsmChunk *chunks;
+    int nchunks;
+    atomic_int next;
+    int nfiles;
+    ThreadAcc *acc;             // [nthreads]
+} ScanJob;
+
+typedef struct {
+    ThreadAcc *ta;
+    FileStat *st;
+    char *buf;
+    size_t buf_cap;
+    uint64_t len;               // 本记录正文码点数
+    uint64_t nonspace;
+    int yi, turns, last_role, have_prompt;
+    int seen_msg, seen_io, seen_text;
+} RecCtx;
+
+static int key_is(const char *key, size_t klen, const char *s) {
+    return klen == strlen(s) && memcmp(key, s, klen) == 0;
+}
+
+static int on_string(void *ud, const char *key, size_t klen, const char *raw, size_t rlen, int depth) {
+    RecCtx *c = ud;
+    if (!key) return 0;
+    if (key_is(key, klen, "role")) {
+        int r = ROLE_OTHER;
+        if (rlen == 6 && memcmp(raw, "system", 6) == 0) r = ROLE_SYSTEM;
+        else if (rlen == 4 && memcmp(raw, "user", 4) == 0) r = ROLE_USER;
+        else if (rlen == 9 && memcmp(raw, "assistant", 9) == 0) r = ROLE_ASSISTANT;
+        c->st->roles[r]++;
+        c->last_role = r;
+        c->turns++;
+        c->seen_msg = 1;
+        return 0;
+    }
+    int prompt = 0;
+    if (key_is(key, klen, "content")) {
+        if (depth > 1) c->seen_msg = 1;
+        prompt = c->last_role == ROLE_USER;
+    } else if (key_is(key, klen, "input") || key_is(key, klen, "instruction") || key_is(key, klen, "prompt")) {
+        c->seen_io = 1;
+        prompt = 1;
+    } else if (key_is(key, klen, "output") || key_is(key, klen, "response") || key_is(key, klen, "completion")) {
+        c->seen_io = 1;
+    } else if (key_is(key, klen, "text")) {
+        c->seen_text = 1;
+    } else {
+        return 0;               // lang / id / category 等元数据不计入正文
+    }
+    if (rlen > c->buf_cap) {
+        c->buf_cap = rlen * 2;
+        c->buf = realloc(c->buf, c->buf_cap);
+    }
+    size_t n = qsm_json_unescape(raw, rlen, c->buf);
+    if (prompt && !c->have_prompt) {
+        hll_add(&c->ta->prompts, qsm_hash64(c->buf, n, 0));
+        c->have_prompt = 1;
+    }
+    const char *p = c->buf, *end = c->buf + n;
+    while (p < end) {
+        uint32_t cp;
+        p += qsm_utf8_next(p, end, &cp);
+        QsmScript s = qsm_script_of(cp);
+        c->st->script[s]++;
+        c->len++;
+        if (s != QSM_SCRIPT_SPACE) c->nonspace++;
+        if (s == QSM_SCRIPT_YI) {
+            c->yi = 1;
+            hll_add(&c->ta->yi_chars, qsm_mix64(cp));
+        }
+    }
+    return 0;
+}
+
+static void *scan_thread(void *arg) {
+    void **a = arg;
+    ScanJob *job = a[0];
+    ThreadAcc *ta = a[1];
+    RecCtx c;
+    memset(&c, 0, sizeof(c));
+    c.ta = ta;
+    c.buf_cap = 1 << 16;
+    c.buf = malloc(c.buf_cap);
+    for (;;) {
+        int i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->nchunks) break;
+        const QsmChunk *ch = &job->chunks[i];
+        FileAcc *fa = &ta->files[ch->file];
+        if (!fa->records.reg) hll_init(&fa->records, HLL_FILE_P);
+        c.st = &fa->st;
+        for (const char *p = ch->lo; p < ch->hi;) {
+            const char *eol;
+            const char *nx = qsm_next_line(p, ch->hi, &eol);
+            if (!qsm_is_blank_line(p, eol)) {
+                c.len = c.nonspace = 0;
+                c.yi = c.turns = c.have_prompt = 0;
+                c.seen_msg = c.seen_io = c.seen_text = 0;
+                c.last_role = -1;
+                c.st->records++;
+                if (qsm_json_scan(p, eol, on_string, &c) < 0) c.st->malformed++;
+                uint64_t h = qsm_hash64(p, (size_t)(eol - p), 0);
+                hll_add(&fa->records, h);
+                hll_add(&ta->records, h);
+                c.st->codepoints += c.len;
+                c.st->len_hist[len_bucket(c.len)]++;
+                td_add(&fa->len, (double)c.len, 1);
+                if (c.nonspace == 0) c.st->empty++;
+                if (c.yi) c.st->yi_records++;
+                c.st->turns[c.turns < TURN_BUCKETS ? c.turns : TURN_BUCKETS - 1]++;
+                c.st->schema[c.seen_msg ? SCHEMA_MESSAGES : c.seen_io ? SCHEMA_INPUT_OUTPUT
+                             : c.seen_text ? SCHEMA_TEXT : SCHEMA_OTHER]++;
+            }
+            p = nx;
+        }
+    }
+    free(c.buf);
+    return NULL;
+}
+
+// ==================== 输出 ====================
+
+static const char B64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void put_base64(FILE *f, const uint8_t *p, size_t n) {
+    for (size_t i = 0; i < n; i += 3) {
+        uint32_t v = (uint32_t)p[i] << 16;
+        if (i + 1 < n) v |= (uint32_t)p[i + 1] << 8;
+        if (i + 2 < n) v |= p[i + 2];
+        fputc(B64[(v >> 18) & 63], f);
+        fputc(B64[(v >> 12) & 63], f);
+        fputc(i + 1 < n ? B64[(v >> 6) & 63] : '=', f);
+        fputc(i + 2 < n ? B64[v & 63] : '=', f);
+    }
+}
+
+static size_t get_base64(const char *s, uint8_t *out, size_t max) {
+    size_t n = 0;
+    uint32_t v = 0;
+    int bits = 0;
+    for (; *s && *s != '"'; s++) {
+        const char *q = strchr(B64, *s);
+        if (!q || *s == '=') continue;
+        v = (v << 6) | (uint32_t)(q - B64);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (n < max) out[n++] = (uint8_t)(v >> bits);
+        }
+    }
+    return n;
+}
+
+static void put_u64s(FILE *f, const uint64_t *v, int n) {
+    fputc('[', f);
+    for (int i = 0; i < n; i++) fprintf(f, "%s%llu", i ? ", " : "", (unsigned long long)v[i]);
+    fputc(']', f);
+}
+
+static double ratio(uint64_t a, uint64_t b) {
+    return b ? (double)a / b : 0;
+}
+
+static void write_stat(FILE *f, const char *name, const FileStat *s) {
+    char esc[6 * 1024 + 1];
+    size_t nlen = strlen(name);
+    if (nlen > 1024) nlen = 1024;
+    esc[qsm_json_escape(name, nlen, esc)] = '\0';
+    uint64_t letters = s->script[QSM_SCRIPT_YI] + s->script[QSM_SCRIPT_HAN] + s->script[QSM_SCRIPT_LATIN];
+    fprintf(f, "{\"file\": \"%s\", \"bytes\": %llu, \"records\": %llu, \"malformed\": %llu, \"empty\": %llu, "
+            "\"yi_records\": %llu, \"distinct_est\": %llu, \"codepoints\": %llu, ",
+            esc, (unsigned long long)s->bytes, (unsigned long long)s->records,
+            (unsigned long long)s->malformed, (unsigned long long)s->empty,
+            (unsigned long long)s->yi_records, (unsigned long long)s->distinct,
+            (unsigned long long)s->codepoints);
+    fprintf(f, "\"yi_ratio\": %.4f, \"han_ratio\": %.4f, \"latin_ratio\": %.4f, \"script\": {",
+            ratio(s->script[QSM_SCRIPT_YI], letters), ratio(s->script[QSM_SCRIPT_HAN], letters),
+            ratio(s->script[QSM_SCRIPT_LATIN], letters));
+    for (int i = 0; i < QSM_SCRIPT_COUNT; i++)
+        fprintf(f, "%s\"%s\": %llu", i ? ", " : "", SCRIPT_NAME[i], (unsigned long long)s->script[i]);
+    fprintf(f, "}, \"schema\": {");
+    for (int i = 0; i < SCHEMA_COUNT; i++)
+        fprintf(f, "%s\"%s\": %llu", i ? ", " : "", SCHEMA_NAME[i], (unsigned long long)s->schema[i]);
+    fprintf(f, "}, \"roles\": {");
+    for (int i = 0; i < ROLE_COUNT; i++)
+        fprintf(f, "%s\"%s\": %llu", i ? ", " : "", ROLE_NAME[i], (unsigned long long)s->roles[i]);
+    fprintf(f, "}, \"turns\": ");
+    put_u64s(f, s->turns, TURN_BUCKETS);
+    fprintf(f, ", \"len_p50\": %.1f, \"len_p90\": %.1f, \"len_p99\": %.1f, \"len_max\": %.0f, \"len_hist\": ",
+            s->len_p50, s->len_p90, s->len_p99, s->len_max);
+    put_u64s(f, s->len_hist, LEN_BUCKETS);
+    fputc('}', f);
+}
+
+typedef struct {
+    FileStat *files;
+    int nfiles;
+    Hll records, prompts, yi_chars;
+    TDigest len;
+} Profile;
+
+static void write_profile(FILE *f, Profile *pr, double secs) {
+    FileStat total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < pr->nfiles; i++) stat_add(&total, &pr->files[i]);
+    total.distinct = (uint64_t)(hll_estimate(&pr->records) + 0.5);
+    total.len_p50 = td_quantile(&pr->len, 0.5);
+    total.len_p90 = td_quantile(&pr->len, 0.9);
+    total.len_p99 = td_quantile(&pr->len, 0.99);
+    time_t now = time(NULL);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%d", localtime(&now));
+    fprintf(f, "{\n  \"generator\": \"yi_corpus_profile\",\n  \"generated_at\": \"%s\",\n", date);
+    fprintf(f, "  \"source_files\": %d,\n  \"elapsed_sec\": %.3f,\n", pr->nfiles, secs);
+    fprintf(f, "  \"distinct_records_est\": %.0f,\n  \"distinct_prompts_est\": %.0f,\n  \"yi_vocab_est\": %.0f,\n",
+            hll_estimate(&pr->records), hll_estimate(&pr->prompts), hll_estimate(&pr->yi_chars));
+    fprintf(f, "  \"len_hist_buckets\": \"0, 1, 2-3, 4-7, ..., >=4096 codepoints\",\n  \"total\": ");
+    write_stat(f, "*", &total);
+    fprintf(f, ",\n  \"files\": [\n");
+    for (int i = 0; i < pr->nfiles; i++) {
+        fprintf(f, "    ");
+        write_stat(f, pr->files[i].name, &pr->files[i]);
+        fprintf(f, "%s\n", i + 1 < pr->nfiles ? "," : "");
+    }
+    fprintf(f, "  ],\n  \"sketches\": {\n    \"hll_precision\": %d,\n", HLL_P);
+    const char *names[3] = { "hll_records", "hll_prompts", "hll_yi_chars" };
+    Hll *hs[3] = { &pr->records, &pr->prompts, &pr->yi_chars };
+    for (int k = 0; k < 3; k++) {
+        fprintf(f, "    \"%s\": \"", names[k]);
+        put_base64(f, hs[k]->reg, (size_t)1 << HLL_P);
+        fprintf(f, "\",\n");
+    }
+    td_compress(&pr->len);
+    fprintf(f, "    \"tdigest_length\": {\"min\": %.17g, \"max\": %.17g, \"centroids\": [",
+            pr->len.total ? pr->len.min : 0, pr->len.total ? pr->len.max : 0);
+    for (int i = 0; i < pr->len.n; i++)
+        fprintf(f, "%s[%.17g, %.17g]", i ? ", " : "", pr->len.c[i].mean, pr->len.c[i].weight);
+    fprintf(f, "]}\n  }\n}\n");
+}
+
+// ==================== --merge：读回分片结果 ====================
+
+static const char *find_key(const char *p, const char *key) {
+    char pat[64];
+    snprintf(pat, sizeof(pat), "\"%s\": ", key);
+    const char *q = strstr(p, pat);
+    return q ? q + strlen(pat) : NULL;
+}
+
+static uint64_t get_u64(const char *p, const char *key) {
+    const char *q = find_key(p, key);
+    return q ? strtoull(q, NULL, 10) : 0;
+}
+
+static double get_f64(const char *p, const char *key) {
+    const char *q = find_key(p, key);
+    return q ? strtod(q, NULL) : 0;
+}
+
+static void get_u64s(const char *p, const char *key, uint64_t *out, int n) {
+    const char *q = find_key(p, key);
+    if (!q || *q != '[') return;
+    q++;
+    for (int i = 0; i < n; i++) {
+        char *e;
+        out[i] = strtoull(q, &e, 10);
+        q = e;
+        while (*q == ',' || *q == ' ') q++;
+    }
+}
+
+static void get_obj(const char *p, const char *key, const char **names, uint64_t *out, int n) {
+    const char *q = find_key(p, key);
+    if (!q) return;
+    for (int i = 0; i < n; i++) out[i] = get_u64(q, names[i]);
+}
+
+static int parse_stat(const char *line, FileStat *s) {
+    const char *q = find_key(line, "file");
+    if (!q || *q != '"') return -1;
+    const char *e = q + 1;
+    while (*e && (*e != '"' || e[-1] == '\\')) e++;
+    memset(s, 0, sizeof(*s));
+    s->name = malloc((size_t)(e - q));
+    s->name[qsm_json_unescape(q + 1, (size_t)(e - q - 1), s->name)] = '\0';
+    s->bytes = get_u64(line, "bytes");
+    s->records = get_u64(line, "records");
+    s->malformed = get_u64(line, "malformed");
+    s->empty = get_u64(line, "empty");
+    s->yi_records = get_u64(line, "yi_records");
+    s->distinct = get_u64(line, "distinct_est");
+    s->codepoints = get_u64(line, "codepoints");
+    get_obj(line, "script", SCRIPT_NAME, s->script, QSM_SCRIPT_COUNT);
+    get_obj(line, "schema", SCHEMA_NAME, s->schema, SCHEMA_COUNT);
+    get_obj(line, "roles", ROLE_NAME, s->roles, ROLE_COUNT);
+    get_u64s(line, "turns", s->turns, TURN_BUCKETS);
+    get_u64s(line, "len_hist", s->len_hist, LEN_BUCKETS);
+    s->len_p50 = get_f64(line, "len_p50");
+    s->len_p90 = get_f64(line, "len_p90");
+    s->len_p99 = get_f64(line, "len_p99");
+    s->len_max = get_f64(line, "len_max");
+    return 0;
+}
+
+static int merge_file(Profile *pr, const char *path) {
+    QsmMap m;
+    if (qsm_map_file(path, &m) != 0) return -1;
+    char *text = malloc(m.size + 1);
+    memcpy(text, m.data, m.size);
+    text[m.size] = '\0';
+    qsm_unmap_file(&m);
+    if (!find_key(text, "sketches") || get_u64(text, "hll_precision") != HLL_P) {
+        free(text);
+        return -1;
+    }
+    // 草图段在 files 段之后，先定位再按行切 files 段
+    const char *sk = strstr(text, "\"sketches\"");
+    char *files = (char *)find_key(text, "files");
+    if (!sk || !files || sk < files) { free(text); return -1; }
+    for (char *line = strtok(files, "\n"); line; line = strtok(NULL, "\n")) {
+        if (strncmp(line, "  ]", 3) == 0) break;
+        FileStat s;
+        if (parse_stat(line, &s) != 0) continue;
+        pr->files = realloc(pr->files, (pr->nfiles + 1) * sizeof(FileStat));
+        pr->files[pr->nfiles++] = s;
+    }
+    const char *names[3] = { "hll_records", "hll_prompts", "hll_yi_chars" };
+    Hll *hs[3] = { &pr->records, &pr->prompts, &pr->yi_chars };
+    for (int k = 0; k < 3; k++) {
+        const char *q = find_key(sk, names[k]);
+        if (!q) continue;
+        Hll h;
+        hll_init(&h, HLL_P);
+        get_base64(q + 1, h.reg, (size_t)1 << HLL_P);
+        hll_merge(hs[k], &h);
+        free(h.reg);
+    }
+    const char *td = find_key(sk, "tdigest_length");
+    if (td) {
+        TDigest d;
+        memset(&d, 0, sizeof(d));
+        const char *q = strstr(td, "[[");
+        while (q && *q == '[') {
+            q += q[1] == '[' ? 2 : 1;
+            char *e;
+            double mean = strtod(q, &e);
+            double w = strtod(e + 1, &e);
+            if (w > 0) td_add(&d, mean, w);
+            q = e + 1;                          // 跳过 ']'
+            while (*q == ',' || *q == ' ') q++;
+        }
+        double lo = get_f64(td, "min"), hi = get_f64(td, "max");
+        if (d.total > 0) { d.min = lo; d.max = hi; }
+        td_merge(&pr->len, &d);
+        td_free(&d);
+    }
+    free(text);
+    return 0;
+}
+
+// ==================== 主函数 ====================
+
+static void usage(const char *prog) {
+    fprintf(stderr, "用法: %s [-t 线程] [-o stats.json] <目录|文件>...\n", prog);
+    fprintf(stderr, "      %s --merge [-o stats.json] <stats.json>...\n", prog);
+    fprintf(stderr, "\n语料单遍统计：记录数、空/错误记录、格式、角色轮数、文字构成、长度分位数\n");
+    fprintf(stderr, "  -t       扫描线程数（默认 CPU 核数）\n");
+    fprintf(stderr, "  -o       输出文件（默认标准输出）\n");
+    fprintf(stderr, "  --merge  合并多份分片统计（HLL / t-digest 草图合并）\n");
+}
+
+int main(int argc, char *argv[]) {
+    int nthreads = qsm_default_threads(), merge = 0;
+    const char *out_path = NULL;
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "-t") == 0 && argi + 1 < argc) nthreads = atoi(argv[++argi]);
+        else if (strcmp(argv[argi], "-o") == 0 && argi + 1 < argc) out_path = argv[++argi];
+        else if (strcmp(argv[argi], "--merge") == 0) merge = 1;
+        else { usage(argv[0]); return 1; }
+    }
+    if (argi >= argc) { usage(argv[0]); return 1; }
+    if (nthreads < 1) nthreads = 1;
+    double t0 = now_sec();
+    FILE *log = out_path ? stdout : stderr;
+
+    Profile pr;
+    memset(&pr, 0, sizeof(pr));
+    hll_init(&pr.records, HLL_P);
+    hll_init(&pr.prompts, HLL_P);
+    hll_init(&pr.yi_chars, HLL_P);
+
+    if (merge) {
+        for (; argi < argc; argi++) {
+            if (merge_file(&pr, argv[argi]) != 0) {
+                fprintf(stderr, "[PROFILE] 不是有效的统计文件: %s\n", argv[argi]);
+                return 1;
+            }
+        }
+    } else {
+        char **files = NULL;
+        int nfiles = 0;
+        for (; argi < argc; argi++) {
+            char **list;
+            int n = qsm_list_jsonl(argv[argi], &list);
+            if (n < 0) { fprintf(stderr, "[PROFILE] 无法读取: %s\n", argv[argi]); return 1; }
+            files = realloc(files, (nfiles + n) * sizeof(char *));
+            memcpy(files + nfiles, list, n * sizeof(char *));
+            nfiles += n;
+            free(list);
+        }
+        QsmMap *maps = calloc(nfiles ? nfiles : 1, sizeof(QsmMap));
+        size_t total = 0;
+        for (int i = 0; i < nfiles; i++) {
+            if (qsm_map_file(files[i], &maps[i]) != 0) {
+                fprintf(stderr, "[PROFILE] 无法映射: %s\n", files[i]);
+                return 1;
+            }
+            total += maps[i].size;
+        }
+        ScanJob job;
+        memset(&job, 0, sizeof(job));
+        QsmChunk *chunks;
+        job.nchunks = qsm_make_chunks(maps, nfiles, total / ((size_t)nthreads * 8) + 1, &chunks);
+        job.chunks = chunks;
+        job.nfiles = nfiles;
+        atomic_init(&job.next, 0);
+        job.acc = calloc(nthreads, sizeof(ThreadAcc));
+        pthread_t *th = malloc(nthreads * sizeof(pthread_t));
+        void **args = malloc(nthreads * 2 * sizeof(void *));
+        for (int t = 0; t < nthreads; t++) {
+            ThreadAcc *ta = &job.acc[t];
+            ta->files = calloc(nfiles ? nfiles : 1, sizeof(FileAcc));
+            hll_init(&ta->records, HLL_P);
+            hll_init(&ta->prompts, HLL_P);
+            hll_init(&ta->yi_chars, HLL_P);
+            args[2 * t] = &job;
+            args[2 * t + 1] = ta;
+            pthread_create(&th[t], NULL, scan_thread, &args[2 * t]);
+        }
+        for (int t = 0; t < nthreads; t++) pthread_join(th[t], NULL);
+
+        // 线程结果按文件合并
+        pr.nfiles = nfiles;
+        pr.files = calloc(nfiles ? nfiles : 1, sizeof(FileStat));
+        for (int i = 0; i < nfiles; i++) {
+            FileStat *fs = &pr.files[i];
+            TDigest len;
+            Hll recs;
+            memset(&len, 0, sizeof(len));
+            hll_init(&recs, HLL_FILE_P);
+            for (int t = 0; t < nthreads; t++) {
+                FileAcc *fa = &job.acc[t].files[i];
+                stat_add(fs, &fa->st);
+                if (fa->records.reg) hll_merge(&recs, &fa->records);
+                td_merge(&len, &fa->len);
+                td_merge(&pr.len, &fa->len);
+                td_free(&fa->len);
+                free(fa->records.reg);
+            }
+            fs->name = strdup(files[i]);
+            fs->bytes = maps[i].size;
+            fs->distinct = fs->records ? (uint64_t)(hll_estimate(&recs) + 0.5) : 0;
+            if (fs->distinct > fs->records) fs->distinct = fs->records;
+            fs->len_p50 = td_quantile(&len, 0.5);
+            fs->len_p90 = td_quantile(&len, 0.9);
+            fs->len_p99 = td_quantile(&len, 0.99);
+            fs->len_max = len.total ? len.max : 0;
+            td_free(&len);
+            free(recs.reg);
+        }
+        for (int t = 0; t < nthreads; t++) {
+            hll_merge(&pr.records, &job.acc[t].records);
+            hll_merge(&pr.prompts, &job.acc[t].prompts);
+            hll_merge(&pr.yi_chars, &job.acc[t].yi_chars);
+            free(job.acc[t].records.reg);
+            free(job.acc[t].prompts.reg);
+            free(job.acc[t].yi_chars.reg);
+            free(job.acc[t].files);
+        }
+        free(job.acc);
+        free(th);
+        free(args);
+        free(chunks);
+        for (int i = 0; i < nfiles; i++) qsm_unmap_file(&maps[i]);
+        free(maps);
+        qsm_free_list(files, nfiles);
+    }
+
+    FILE *f = out_path ? fopen(out_path, "w") : stdout;
+    if (!f) {
+        fprintf(stderr, "[PROFILE] 无法写输出: %s\n", out_path);
+        return 1;
+    }
+    double secs = now_sec() - t0;
+    write_profile(f, &pr, secs);
+    if (out_path) fclose(f);
+
+    uint64_t records = 0, bad = 0, empty = 0, yi = 0;
+    for (int i = 0; i < pr.nfiles; i++) {
+        records += pr.files[i].records;
+        bad += pr.files[i].malformed;
+        empty += pr.files[i].empty;
+        yi += pr.files[i].yi_records;
+    }
+    fprintf(log, "[PROFILE] %d 个文件, %llu 条记录 (空 %llu, 格式错误 %llu, 含彝文 %llu), "
+            "去重约 %.0f, 彝文字种约 %.0f, 长度 p50/p99 %.0f/%.0f, %.2fs\n",
+            pr.nfiles, (unsigned long long)records, (unsigned long long)empty, (unsigned long long)bad,
+            (unsigned long long)yi, hll_estimate(&pr.records), hll_estimate(&pr.yi_chars),
+            td_quantile(&pr.len, 0.5), td_quantile(&pr.len, 0.99), secs);
+    for (int i = 0; i < pr.nfiles; i++) free(pr.files[i].name);
+    free(pr.files);
+    free(pr.records.reg);
+    free(pr.prompts.reg);
+    free(pr.yi_chars.reg);
+    td_free(&pr.len);
+    return 0;
+}
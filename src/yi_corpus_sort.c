@@ -0,0 +1,452 @@
+/*
+ * yi_corpus_sort.c — 语料外排序 / 确定性洗牌与分层切分
+ *
+ * 代替按文件拼接生成合并训练集（yi_gemma_training_merged.jsonl 等）：
+ *   1. 顺串生成：输入按行对齐切块，每块由一个线程抽取键、排序后写成一个
+ *      临时顺串文件，块大小受 -M 内存预算约束；
+ *   2. k 路归并：最小堆逐条弹出，同一遍内完成 -u 去重和按
+ *      (来源文件, 语言) 分层的训练 / 验证切分。
+ *
+ * 洗牌键为 hash(整行, seed)，并列时依次比较文件序号与行偏移，
+ * 所以输出只取决于输入与 seed，与线程数、块大小无关。
+ * 相同内容的行哈希相同、必然相邻，-u 只需比较上一条。
+ *
+ * 用法: yi_corpus_sort [-s seed | -k 字段] [-M MB] [-t 线程] [-T 临时目录]
+ *                      [--val 比例] [-u] [-v] [-o 前缀] <目录|文件>...
+ * 输出 <前缀>.jsonl；给了 --val 时输出 <前缀>.train.jsonl 与 <前缀>.val.jsonl。
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "qsm_jsonl.h"
+
+#define OUT_BUF_SIZE (1 << 20)
+
+enum { LANG_YI, LANG_ZH, LANG_EN, LANG_OTHER, LANG_COUNT };
+static const char *LANG_NAME[LANG_COUNT] = { "yi", "zh", "en", "other" };
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ==================== 顺串记录 ====================
+//
+// 顺串文件为连续的 RunHdr + 键 + 行，按 8 字节对齐。
+
+typedef struct {
+    uint64_t hkey;          // 洗牌键，或排序模式下的并列键
+    uint64_t seq;           // 行在源文件中的字节偏移
+    uint32_t file;
+    uint32_t stratum;       // file * LANG_COUNT + 语言
+    uint32_t klen;
+    uint32_t len;
+} RunHdr;
+
+typedef struct {
+    RunHdr h;
+    const char *key;
+    const char *line;
+} Rec;
+
+static int g_by_key;        // -k 模式
+
+static int cmp_hdr(const RunHdr *a, const char *ak, const RunHdr *b, const char *bk) {
+    if (g_by_key) {
+        size_t n = a->klen < b->klen ? a->klen : b->klen;
+        int c = memcmp(ak, bk, n);
+        if (c) return c;
+        if (a->klen != b->klen) return a->klen < b->klen ? -1 : 1;
+    }
+    if (a->hkey != b->hkey) return a->hkey < b->hkey ? -1 : 1;
+    if (a->file != b->file) return a->file < b->file ? -1 : 1;
+    return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
+
+static int cmp_rec(const void *x, const void *y) {
+    const Rec *a = x, *b = y;
+    return cmp_hdr(&a->h, a->key, &b->h, b->key);
+}
+
+// ==================== 阶段 1：并行顺串生成 ====================
+
+typedef struct {
+    const QsmChunk *chunks;
+    int nchunks;
+    atomic_int next;
+    const QsmMap *maps;
+    const char *field;
+    size_t flen;
+    uint64_t seed;
+    const char *tmpdir;
+    atomic_ullong records;
+    atomic_ullong bad;
+    atomic_int failed;
+} RunJob;
+
+typedef struct {
+    const char *field;
+    size_t flen;
+    char *buf;              // 反转义缓冲
+    size_t buf_cap;
+    char *arena;            // 排序键
+    size_t arena_len, arena_cap;
+    uint32_t koff, klen;
+    int have_key;
+    uint32_t script[LANG_COUNT];
+} LineCtx;
+
+static void arena_put(LineCtx *c, const char *s, size_t n) {
+    if (c->arena_len + n > c->arena_cap) {
+        while (c->arena_len + n > c->arena_cap) c->arena_cap *= 2;
+        c->arena = realloc(c->arena, c->arena_cap);
+    }
+    memcpy(c->arena + c->arena_len, s, n);
+    c->arena_len += n;
+}
+
+static int on_string(void *ud, const char *key, size_t klen, const char *raw, size_t rlen, int depth) {
+    LineCtx *c = ud;
+    if (!key || (klen == 4 && memcmp(key, "role", 4) == 0)) return 0;
+    if (rlen > c->buf_cap) {
+        c->buf_cap = rlen * 2;
+        c->buf = realloc(c->buf, c->buf_cap);
+    }
+    size_t n = qsm_json_unescape(raw, rlen, c->buf);
+    if (c->field && !c->have_key && depth == 1 && klen == c->flen && memcmp(key, c->field, klen) == 0) {
+        c->koff = (uint32_t)c->arena_len;
+        c->klen = (uint32_t)n;
+        c->have_key = 1;
+        arena_put(c, c->buf, n);
+    }
+    const char *p = c->buf, *end = c->buf + n;
+    while (p < end) {
+        uint32_t cp;
+        p += qsm_utf8_next(p, end, &cp);
+        switch (qsm_script_of(cp)) {
+        case QSM_SCRIPT_YI:    c->script[LANG_YI]++; break;
+        case QSM_SCRIPT_HAN:   c->script[LANG_ZH]++; break;
+        case QSM_SCRIPT_LATIN: c->script[LANG_EN]++; break;
+        default: break;
+        }
+    }
+    return 0;
+}
+
+// 语言按出现即归类：含彝文即为 yi，否则含汉字为 zh，否则含拉丁字母为 en
+static int lang_of(const LineCtx *c) {
+    if (c->script[LANG_YI]) return LANG_YI;
+    if (c->script[LANG_ZH]) return LANG_ZH;
+    if (c->script[LANG_EN]) return LANG_EN;
+    return LANG_OTHER;
+}
+
+static void run_path(char *out, size_t cap, const char *tmpdir, int run) {
+    snprintf(out, cap, "%s/yi_sort_%d_%05d.run", tmpdir, (int)getpid(), run);
+}
+
+static int write_run(const char *path, Rec *recs, size_t n) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    static const char pad[8] = { 0 };
+    for (size_t i = 0; i < n; i++) {
+        fwrite(&recs[i].h, sizeof(RunHdr), 1, f);
+        fwrite(recs[i].key, 1, recs[i].h.klen, f);
+        fwrite(recs[i].line, 1, recs[i].h.len, f);
+        size_t body = recs[i].h.klen + recs[i].h.len;
+        fwrite(pad, 1, (8 - body % 8) % 8, f);
+    }
+    return fclose(f);
+}
+
+static void *run_thread(void *arg) {
+    RunJob *job = arg;
+    LineCtx c;
+    memset(&c, 0, sizeof(c));
+    c.field = job->field;
+    c.flen = job->flen;
+    c.buf_cap = 1 << 16;
+    c.buf = malloc(c.buf_cap);
+    c.arena_cap = 1 << 16;
+    c.arena = malloc(c.arena_cap);
+    size_t cap = 1 << 12;
+    Rec *recs = malloc(cap * sizeof(Rec));
+    unsigned long long nrec = 0, bad = 0;
+    for (;;) {
+        int i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->nchunks) break;
+        const QsmChunk *ch = &job->chunks[i];
+        const char *base = job->maps[ch->file].data;
+        size_t n = 0;
+        c.arena_len = 0;
+        for (const char *p = ch->lo; p < ch->hi;) {
+            const char *eol;
+            const char *nx = qsm_next_line(p, ch->hi, &eol);
+            if (!qsm_is_blank_line(p, eol)) {
+                memset(c.script, 0, sizeof(c.script));
+                c.have_key = 0;
+                c.klen = 0;
+                if (qsm_json_scan(p, eol, on_string, &c) < 0) bad++;
+                if (n == cap) recs = realloc(recs, (cap *= 2) * sizeof(Rec));
+                Rec *r = &recs[n++];
+                r->h.hkey = qsm_hash64(p, (size_t)(eol - p), job->seed);
+                r->h.seq = (uint64_t)(p - base);
+                r->h.file = (uint32_t)ch->file;
+                r->h.stratum = (uint32_t)ch->file * LANG_COUNT + lang_of(&c);
+                r->h.klen = c.klen;
+                r->h.len = (uint32_t)(eol - p);
+                r->key = (const char *)(uintptr_t)c.koff;   // 先存偏移，arena 可能搬家
+                r->line = p;
+            }
+            p = nx;
+        }
+        for (size_t k = 0; k < n; k++) recs[k].key = c.arena + (uintptr_t)recs[k].key;
+        qsort(recs, n, sizeof(Rec), cmp_rec);
+        char path[4096];
+        run_path(path, sizeof(path), job->tmpdir, i);
+        if (write_run(path, recs, n) != 0) {
+            fprintf(stderr, "[SORT] 无法写顺串: %s\n", path);
+            atomic_store(&job->failed, 1);
+        }
+        nrec += n;
+    }
+    free(recs);
+    free(c.buf);
+    free(c.arena);
+    atomic_fetch_add(&job->records, nrec);
+    atomic_fetch_add(&job->bad, bad);
+    return NULL;
+}
+
+// ==================== 阶段 2：k 路堆归并 ====================
+
+typedef struct {
+    QsmMap map;
+    const char *p, *end;
+    RunHdr h;
+    const char *key, *line;
+} Cursor;
+
+static int cursor_load(Cursor *c) {
+    if (c->p + sizeof(RunHdr) > c->end) return 0;
+    memcpy(&c->h, c->p, sizeof(RunHdr));
+    c->key = c->p + sizeof(RunHdr);
+    c->line = c->key + c->h.klen;
+    size_t body = c->h.klen + c->h.len;
+    c->p += sizeof(RunHdr) + body + (8 - body % 8) % 8;
+    return 1;
+}
+
+static int cursor_less(const Cursor *a, const Cursor *b) {
+    return cmp_hdr(&a->h, a->key, &b->h, b->key) < 0;
+}
+
+static void heap_down(Cursor **heap, int n, int i) {
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && cursor_less(heap[l], heap[m])) m = l;
+        if (r < n && cursor_less(heap[r], heap[m])) m = r;
+        if (m == i) return;
+        Cursor *t = heap[i]; heap[i] = heap[m]; heap[m] = t;
+        i = m;
+    }
+}
+
+typedef struct {
+    uint64_t total;
+    uint64_t val;
+} Stratum;
+
+static FILE *open_out(const char *prefix, const char *suffix, char **buf) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s%s", prefix, suffix);
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "[SORT] 无法写输出: %s\n", path);
+        return NULL;
+    }
+    *buf = malloc(OUT_BUF_SIZE);
+    setvbuf(f, *buf, _IOFBF, OUT_BUF_SIZE);
+    return f;
+}
+
+// ==================== 主函数 ====================
+
+static void usage(const char *prog) {
+    fprintf(stderr, "用法: %s [选项] <目录|文件>...\n", prog);
+    fprintf(stderr, "\n语料外排序 / 确定性洗牌，附带按 (来源文件, 语言) 分层的训练 / 验证切分\n");
+    fprintf(stderr, "  -s seed     按 hash(行, seed) 洗牌（默认 seed 1）\n");
+    fprintf(stderr, "  -k 字段     改为按顶层字符串字段排序（缺失视为空串）\n");
+    fprintf(stderr, "  -M MB       顺串生成内存预算（默认 256）\n");
+    fprintf(stderr, "  -t 线程     默认 CPU 核数\n");
+    fprintf(stderr, "  -T 目录     临时顺串目录（默认 /tmp）\n");
+    fprintf(stderr, "  --val 比例  每个分层抽出该比例作验证集\n");
+    fprintf(stderr, "  -u          去掉完全相同的行\n");
+    fprintf(stderr, "  -v          打印各分层计数\n");
+    fprintf(stderr, "  -o 前缀     输出前缀（默认 corpus）\n");
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t seed = 1;
+    const char *field = NULL, *tmpdir = "/tmp", *prefix = "corpus";
+    size_t budget_mb = 256;
+    int nthreads = qsm_default_threads(), dedup = 0, verbose = 0;
+    double val = 0;
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        const char *a = argv[argi];
+        int has = argi + 1 < argc;
+        if (strcmp(a, "-s") == 0 && has) seed = strtoull(argv[++argi], NULL, 10);
+        else if (strcmp(a, "-k") == 0 && has) field = argv[++argi];
+        else if (strcmp(a, "-M") == 0 && has) budget_mb = strtoull(argv[++argi], NULL, 10);
+        else if (strcmp(a, "-t") == 0 && has) nthreads = atoi(argv[++argi]);
+        else if (strcmp(a, "-T") == 0 && has) tmpdir = argv[++argi];
+        else if (strcmp(a, "-o") == 0 && has) prefix = argv[++argi];
+        else if (strcmp(a, "--val") == 0 && has) val = atof(argv[++argi]);
+        else if (strcmp(a, "-u") == 0) dedup = 1;
+        else if (strcmp(a, "-v") == 0) verbose = 1;
+        else { usage(argv[0]); return 1; }
+    }
+    if (argi >= argc || val < 0 || val >= 1) { usage(argv[0]); return 1; }
+    if (nthreads < 1) nthreads = 1;
+    if (budget_mb < 1) budget_mb = 1;
+    g_by_key = field != NULL;
+    double t0 = now_sec();
+
+    // 收集输入文件
+    char **files = NULL;
+    int nfiles = 0;
+    for (; argi < argc; argi++) {
+        char **list;
+        int n = qsm_list_jsonl(argv[argi], &list);
+        if (n < 0) { fprintf(stderr, "[SORT] 无法读取: %s\n", argv[argi]); return 1; }
+        files = realloc(files, (nfiles + n) * sizeof(char *));
+        memcpy(files + nfiles, list, n * sizeof(char *));
+        nfiles += n;
+        free(list);
+    }
+    QsmMap *maps = calloc(nfiles ? nfiles : 1, sizeof(QsmMap));
+    size_t total = 0;
+    for (int i = 0; i < nfiles; i++) {
+        if (qsm_map_file(files[i], &maps[i]) != 0) {
+            fprintf(stderr, "[SORT] 无法映射: %s\n", files[i]);
+            return 1;
+        }
+        total += maps[i].size;
+    }
+
+    // 阶段 1：每块一条顺串；预算按线程均分（记录数组与键约为行字节的一半以内）
+    RunJob job;
+    memset(&job, 0, sizeof(job));
+    size_t target = budget_mb * 1048576 / (size_t)nthreads;
+    if (target > total / (size_t)nthreads + 1) target = total / (size_t)nthreads + 1;
+    QsmChunk *chunks;
+    job.nchunks = qsm_make_chunks(maps, nfiles, target, &chunks);
+    job.chunks = chunks;
+    job.maps = maps;
+    job.field = field;
+    job.flen = field ? strlen(field) : 0;
+    job.seed = seed;
+    job.tmpdir = tmpdir;
+    atomic_init(&job.next, 0);
+    atomic_init(&job.records, 0);
+    atomic_init(&job.bad, 0);
+    atomic_init(&job.failed, 0);
+    pthread_t *th = malloc(nthreads * sizeof(pthread_t));
+    for (int t = 0; t < nthreads; t++) pthread_create(&th[t], NULL, run_thread, &job);
+    for (int t = 0; t < nthreads; t++) pthread_join(th[t], NULL);
+    free(th);
+    double t1 = now_sec();
+    fprintf(stdout, "[SORT] 顺串: %d 个文件, %.1f MB, %llu 条记录 (格式错误 %llu), %d 条顺串, %.2fs\n",
+            nfiles, total / 1048576.0, (unsigned long long)atomic_load(&job.records),
+            (unsigned long long)atomic_load(&job.bad), job.nchunks, t1 - t0);
+
+    // 阶段 2：归并、去重、分层切分
+    int nruns = job.nchunks, ok = !atomic_load(&job.failed);
+    Cursor *cur = calloc(nruns ? nruns : 1, sizeof(Cursor));
+    Cursor **heap = malloc((nruns ? nruns : 1) * sizeof(Cursor *));
+    int nheap = 0;
+    for (int r = 0; r < nruns && ok; r++) {
+        char path[4096];
+        run_path(path, sizeof(path), tmpdir, r);
+        if (qsm_map_file(path, &cur[r].map) != 0) {
+            fprintf(stderr, "[SORT] 无法映射顺串: %s\n", path);
+            ok = 0;
+            break;
+        }
+        cur[r].p = cur[r].map.data;
+        cur[r].end = cur[r].map.data + cur[r].map.size;
+        if (cursor_load(&cur[r])) heap[nheap++] = &cur[r];
+    }
+    for (int i = nheap / 2 - 1; i >= 0; i--) heap_down(heap, nheap, i);
+
+    char *train_buf = NULL, *val_buf = NULL;
+    FILE *ftrain = NULL, *fval = NULL;
+    if (ok) {
+        ftrain = open_out(prefix, val > 0 ? ".train.jsonl" : ".jsonl", &train_buf);
+        fval = val > 0 ? open_out(prefix, ".val.jsonl", &val_buf) : NULL;
+        if (!ftrain || (val > 0 && !fval)) ok = 0;
+    }
+    Stratum *strata = calloc((size_t)(nfiles ? nfiles : 1) * LANG_COUNT, sizeof(Stratum));
+    uint64_t ntrain = 0, nval = 0, ndup = 0;
+    const char *last = NULL;
+    uint32_t last_len = 0;
+    while (ok && nheap > 0) {
+        Cursor *c = heap[0];
+        if (dedup && last && last_len == c->h.len && memcmp(last, c->line, last_len) == 0) {
+            ndup++;
+        } else {
+            Stratum *s = &strata[c->h.stratum];
+            // 分层内按归并顺序等距抽取：第 n 条使 floor(n*val) 增加时进验证集
+            int to_val = fval && (uint64_t)((double)(s->total + 1) * val) > s->val;
+            s->total++;
+            FILE *f = to_val ? fval : ftrain;
+            fwrite(c->line, 1, c->h.len, f);
+            fputc('\n', f);
+            if (to_val) { s->val++; nval++; } else ntrain++;
+            last = c->line;
+            last_len = c->h.len;
+        }
+        if (cursor_load(c)) heap_down(heap, nheap, 0);
+        else { heap[0] = heap[--nheap]; heap_down(heap, nheap, 0); }
+    }
+    if (ftrain) fclose(ftrain);
+    if (fval) fclose(fval);
+    free(train_buf);
+    free(val_buf);
+    for (int r = 0; r < nruns; r++) {
+        char path[4096];
+        qsm_unmap_file(&cur[r].map);
+        run_path(path, sizeof(path), tmpdir, r);
+        unlink(path);
+    }
+    free(cur);
+    free(heap);
+
+    if (verbose) {
+        for (int i = 0; i < nfiles; i++)
+            for (int l = 0; l < LANG_COUNT; l++) {
+                Stratum *s = &strata[i * LANG_COUNT + l];
+                if (s->total)
+                    fprintf(stdout, "  %-5s %8llu 条, 验证 %6llu  %s\n", LANG_NAME[l],
+                            (unsigned long long)s->total, (unsigned long long)s->val, files[i]);
+            }
+    }
+    if (ok)
+        fprintf(stdout, "[SORT] 归并: 训练 %llu, 验证 %llu, 去重 %llu, %.2fs (总计 %.2fs)\n",
+                (unsigned long long)ntrain, (unsigned long long)nval, (unsigned long long)ndup,
+                now_sec() - t1, now_sec() - t0);
+    free(strata);
+    for (int i = 0; i < nfiles; i++) qsm_unmap_file(&maps[i]);
+    free(maps);
+    free(chunks);
+    qsm_free_list(files, nfiles);
+    return ok ? 0 : 1;
+}
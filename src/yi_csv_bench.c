@@ -0,0 +1,138 @@
+/*
+ * yi_csv_bench.c — 特征 CSV 加载器校验与测速
+ *
+ * 对每个文件：
+ *   - 用 qsm_csv 加载，逐字段与 strtod 的结果逐位比较；
+ *   - 列出各列的 min / mean / max 与快速路径命中率；
+ *   - 在内存里重复解析 -r 次测吞吐，并与 fgets + strtod 的朴素读法对比。
+ *
+ * 用法: yi_csv_bench [-r 2000] <csv>...
+ */
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "qsm_csv.h"
+#include "qsm_jsonl.h"
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// 朴素读法：逐行 fgets、逐字段 strtod，按行存。返回字段数，同时按列核对
+static long naive_check(const char *path, const QsmCsv *csv, long *mismatch) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[4096];
+    long fields = 0;
+    size_t row = 0;
+    int first = 1;
+    *mismatch = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '\n' || line[0] == '\r') continue;
+        if (first && strcmp(csv->names[0], "c0") != 0) { first = 0; continue; }
+        first = 0;
+        char *p = line;
+        for (size_t j = 0; j < csv->cols && row < csv->rows; j++) {
+            char *stop;
+            double v = strtod(p, &stop);
+            double got = qsm_csv_col(csv, j)[row];
+            if (memcmp(&v, &got, sizeof(v)) != 0 && !(isnan(v) && isnan(got))) (*mismatch)++;
+            fields++;
+            p = strchr(stop, ',');
+            if (!p) break;
+            p++;
+        }
+        row++;
+    }
+    fclose(f);
+    return fields;
+}
+
+static double naive_parse(const char *p, size_t n) {
+    double sum = 0;
+    const char *end = p + n;
+    char line[4096];
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        size_t len = (size_t)(eol - p) < sizeof(line) - 1 ? (size_t)(eol - p) : sizeof(line) - 1;
+        memcpy(line, p, len);
+        line[len] = '\0';
+        for (char *q = line; *q;) {
+            char *stop;
+            sum += strtod(q, &stop);
+            q = strchr(stop, ',');
+            if (!q) break;
+            q++;
+        }
+        p = eol + 1;
+    }
+    return sum;
+}
+
+int main(int argc, char *argv[]) {
+    int repeat = 2000, argi = 1;
+    if (argi + 1 < argc && strcmp(argv[argi], "-r") == 0) {
+        repeat = atoi(argv[argi + 1]);
+        argi += 2;
+    }
+    if (argi >= argc || repeat < 1) {
+        fprintf(stderr, "用法: %s [-r 2000] <csv>...\n", argv[0]);
+        fprintf(stderr, "\n特征 CSV 加载器校验与测速：逐字段对比 strtod，报告解析吞吐\n");
+        return 1;
+    }
+    int ok = 1;
+    volatile double sink = 0;
+    for (; argi < argc; argi++) {
+        const char *path = argv[argi];
+        QsmCsv csv;
+        if (qsm_csv_load(path, &csv) != 0) {
+            fprintf(stderr, "[CSV] 无法加载: %s\n", path);
+            ok = 0;
+            continue;
+        }
+        long mismatch;
+        long fields = naive_check(path, &csv, &mismatch);
+        fprintf(stdout, "[CSV] %s: %zu 行 x %zu 列, 快速路径 %.1f%%, 坏字段 %llu, 与 strtod 不一致 %ld/%ld\n",
+                path, csv.rows, csv.cols,
+                100.0 - 100.0 * (double)csv.slow / (double)(csv.rows * csv.cols),
+                (unsigned long long)csv.bad, mismatch, fields);
+        ok &= mismatch == 0 && fields == (long)(csv.rows * csv.cols);
+        for (size_t j = 0; j < csv.cols; j++) {
+            const double *c = qsm_csv_col(&csv, j);
+            double lo = INFINITY, hi = -INFINITY, sum = 0;
+            for (size_t i = 0; i < csv.rows; i++) {
+                if (c[i] < lo) lo = c[i];
+                if (c[i] > hi) hi = c[i];
+                sum += c[i];
+            }
+            fprintf(stdout, "      %-8s min %9.4f  mean %9.4f  max %9.4f\n", csv.names[j], lo, sum / (double)csv.rows, hi);
+        }
+        qsm_csv_free(&csv);
+
+        QsmMap m;
+        if (qsm_map_file(path, &m) != 0) continue;
+        double t0 = now_sec();
+        for (int r = 0; r < repeat; r++) {
+            QsmCsv t;
+            qsm_csv_parse(m.data, m.size, &t);
+            sink += t.data[0];
+            qsm_csv_free(&t);
+        }
+        double t1 = now_sec();
+        for (int r = 0; r < repeat; r++) sink += naive_parse(m.data, m.size);
+        double t2 = now_sec();
+        double mb = (double)m.size * repeat / 1048576.0;
+        fprintf(stdout, "[CSV] 解析 %.0f MB/s (fgets+strtod %.0f MB/s, %.1fx)\n",
+                mb / (t1 - t0), mb / (t2 - t1), (t2 - t1) / (t1 - t0));
+        qsm_unmap_file(&m);
+    }
+    (void)sink;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,300 @@
+/*
+ * yi_dict_index.c — .ydx 三语词典索引查询实现（mmap，零反序列化）
+ */
+#define _GNU_SOURCE
+#include "yi_dict_index.h"
+#include "qsm_jsonl.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct YiDict {
+    QsmMap map;
+    const YdxHeader *hdr;
+    const YdxEntry *entries;
+    const char *pool;
+};
+
+#define AT(d, off, type) ((const type *)((d)->map.data + (off)))
+
+// ==================== 打开 / 关闭 ====================
+
+// [off, off + n * size) 落在映射区内且按 align 对齐
+static int region_ok(const YiDict *d, uint64_t off, uint64_t n, uint64_t size, uint64_t align) {
+    return off % align == 0 && off >= sizeof(YdxHeader) && off <= d->map.size &&
+           n <= (d->map.size - off) / size;
+}
+
+// 打开时把文件头里的每个区段和区段内部的偏移都核对一遍，查询路径上就不必再做边界检查；
+// 截断或损坏的 .ydx 在这里被拒绝，不会在 mmap 上越界读
+static int validate(const YiDict *d) {
+    const YdxHeader *h = d->hdr;
+    if (!region_ok(d, h->pool_off, h->pool_size, 1, 1) || h->pool_size == 0 ||
+        d->map.data[h->pool_off + h->pool_size - 1] != '\0')
+        return -1;
+    if (!region_ok(d, h->entries_off, h->nentries, sizeof(YdxEntry), 4)) return -1;
+    const YdxEntry *ents = AT(d, h->entries_off, YdxEntry);
+    for (uint32_t i = 0; i < h->nentries; i++) {
+        if (ents[i].yi >= h->pool_size || ents[i].zh >= h->pool_size || ents[i].en >= h->pool_size) return -1;
+    }
+    for (int lang = 0; lang < YI_DICT_LANGS; lang++) {
+        const YdxSection *s = &h->sec[lang];
+        if (!s->nkeys) continue;
+        if (!region_ok(d, s->keys_off, s->nkeys, sizeof(YdxKey), 4) ||
+            !region_ok(d, s->post_off, s->npost, sizeof(uint32_t), 4) ||
+            !s->phf_nbuckets || !region_ok(d, s->phf_disp_off, s->phf_nbuckets, sizeof(uint32_t), 4) ||
+            !s->phf_nslots || !region_ok(d, s->phf_slots_off, s->phf_nslots, sizeof(uint32_t), 4) ||
+            !s->fst_nnodes || !region_ok(d, s->fst_nodes_off, s->fst_nnodes, sizeof(YdxNode), 4) ||
+            !region_ok(d, s->fst_trans_off, s->fst_ntrans, sizeof(YdxTrans), 4))
+            return -1;
+        const YdxKey *keys = AT(d, s->keys_off, YdxKey);
+        for (uint32_t i = 0; i < s->nkeys; i++) {
+            if ((uint64_t)keys[i].off + keys[i].len > h->pool_size ||
+                (uint64_t)keys[i].post + keys[i].npost > s->npost)
+                return -1;
+        }
+        const uint32_t *post = AT(d, s->post_off, uint32_t);
+        for (uint32_t i = 0; i < s->npost; i++) {
+            if (post[i] >= h->nentries) return -1;
+        }
+        const YdxNode *nodes = AT(d, s->fst_nodes_off, YdxNode);
+        const YdxTrans *tr = AT(d, s->fst_trans_off, YdxTrans);
+        for (uint32_t i = 0; i < s->fst_nnodes; i++) {
+            if ((uint64_t)nodes[i].trans + nodes[i].ntrans > s->fst_ntrans) return -1;
+        }
+        for (uint32_t i = 0; i < s->fst_ntrans; i++) {
+            if (tr[i].target >= s->fst_nnodes) return -1;
+        }
+    }
+    return 0;
+}
+
+YiDict *yi_dict_open(const char *path) {
+    YiDict *d = calloc(1, sizeof(YiDict));
+    if (qsm_map_file(path, &d->map) != 0 || d->map.size < sizeof(YdxHeader)) {
+        qsm_unmap_file(&d->map);
+        free(d);
+        return NULL;
+    }
+    d->hdr = (const YdxHeader *)d->map.data;
+    if (d->hdr->magic != YDX_MAGIC || d->hdr->version != YDX_VERSION ||
+        d->hdr->file_size != d->map.size || validate(d) != 0) {
+        yi_dict_close(d);
+        return NULL;
+    }
+    d->entries = AT(d, d->hdr->entries_off, YdxEntry);
+    d->pool = d->map.data + d->hdr->pool_off;
+    return d;
+}
+
+void yi_dict_close(YiDict *d) {
+    if (!d) return;
+    qsm_unmap_file(&d->map);
+    free(d);
+}
+
+int yi_dict_verify(const YiDict *d) {
+    uint64_t h = qsm_hash64(d->map.data + sizeof(YdxHeader), d->map.size - sizeof(YdxHeader), 0);
+    return h == d->hdr->checksum ? 0 : -1;
+}
+
+uint32_t yi_dict_size(const YiDict *d) {
+    return d->hdr->nentries;
+}
+
+uint32_t yi_dict_nkeys(const YiDict *d, YiDictLang lang) {
+    return d->hdr->sec[lang].nkeys;
+}
+
+int yi_dict_entry(const YiDict *d, uint32_t id, YiDictEntry *out) {
+    if (id >= d->hdr->nentries) return -1;
+    const YdxEntry *e = &d->entries[id];
+    out->id = id;
+    out->yi = d->pool + e->yi;
+    out->zh = d->pool + e->zh;
+    out->en = d->pool + e->en;
+    return 0;
+}
+
+int yi_dict_key(const YiDict *d, YiDictLang lang, uint32_t key, YiDictMatch *out) {
+    const YdxSection *s = &d->hdr->sec[lang];
+    if (key >= s->nkeys) return -1;
+    const YdxKey *k = AT(d, s->keys_off, YdxKey) + key;
+    out->key = key;
+    out->text = d->pool + k->off;
+    out->len = k->len;
+    out->dist = 0;
+    return 0;
+}
+
+// ==================== 精确查询（CHD 完美哈希） ====================
+
+int64_t yi_dict_find(const YiDict *d, YiDictLang lang, const char *key, size_t len) {
+    const YdxSection *s = &d->hdr->sec[lang];
+    if (!s->nkeys) return -1;
+    uint64_t h = qsm_hash64(key, len, s->phf_seed);
+    uint32_t disp = AT(d, s->phf_disp_off, uint32_t)[ydx_phf_bucket(h, s->phf_nbuckets)];
+    uint32_t ord = AT(d, s->phf_slots_off, uint32_t)[ydx_phf_slot(h, disp, s->phf_nslots)];
+    if (ord >= s->nkeys) return -1;
+    const YdxKey *k = AT(d, s->keys_off, YdxKey) + ord;
+    if (k->len != len || memcmp(d->pool + k->off, key, len) != 0) return -1;
+    return ord;
+}
+
+uint32_t yi_dict_postings(const YiDict *d, YiDictLang lang, uint32_t key, const uint32_t **ids) {
+    const YdxSection *s = &d->hdr->sec[lang];
+    if (key >= s->nkeys) { *ids = NULL; return 0; }
+    const YdxKey *k = AT(d, s->keys_off, YdxKey) + key;
+    *ids = AT(d, s->post_off, uint32_t) + k->post;
+    return k->npost;
+}
+
+int yi_dict_lookup(const YiDict *d, YiDictLang lang, const char *key, size_t len,
+                   uint32_t *ids, int max) {
+    int64_t ord = yi_dict_find(d, lang, key, len);
+    if (ord < 0) return 0;
+    const uint32_t *p;
+    uint32_t n = yi_dict_postings(d, lang, (uint32_t)ord, &p);
+    for (uint32_t i = 0; i < n && (int)i < max; i++) ids[i] = p[i];
+    return (int)n;
+}
+
+// ==================== 前缀查询（FST 序号区间） ====================
+
+// 在结点 n 的转移中二分查找字节 c，累加其左侧兄弟的计数
+static int fst_step(const YiDict *d, const YdxSection *s, uint32_t *node, uint32_t *ord, uint8_t c) {
+    const YdxNode *nodes = AT(d, s->fst_nodes_off, YdxNode);
+    const YdxTrans *tr = AT(d, s->fst_trans_off, YdxTrans);
+    const YdxNode *n = &nodes[*node];
+    uint32_t lo = n->trans, hi = n->trans + n->ntrans;
+    uint32_t acc = n->final;
+    // 转移数一般很少（<64），顺序累加比二分后再回扫更省
+    for (uint32_t i = lo; i < hi; i++) {
+        if (tr[i].byte == c) {
+            *ord += acc;
+            *node = tr[i].target;
+            return 0;
+        }
+        if (tr[i].byte > c) return -1;
+        acc += nodes[tr[i].target].count;
+    }
+    return -1;
+}
+
+uint32_t yi_dict_prefix(const YiDict *d, YiDictLang lang, const char *prefix, size_t len,
+                        uint32_t *first) {
+    const YdxSection *s = &d->hdr->sec[lang];
+    *first = 0;
+    if (!s->nkeys) return 0;
+    uint32_t node = 0, ord = 0;
+    for (size_t i = 0; i < len; i++)
+        if (fst_step(d, s, &node, &ord, (uint8_t)prefix[i]) != 0) return 0;
+    *first = ord;
+    return AT(d, s->fst_nodes_off, YdxNode)[node].count;
+}
+
+// ==================== 模糊查询（FST + Levenshtein） ====================
+
+#define FUZZY_MAX_Q 64
+#define FUZZY_MAX_DEPTH 256
+
+typedef struct {
+    const YiDict *d;
+    const YdxSection *s;
+    const YdxNode *nodes;
+    const YdxTrans *tr;
+    uint32_t q[FUZZY_MAX_Q];
+    int qlen;
+    int k;
+    int *rows;              // [FUZZY_MAX_DEPTH + 1][qlen + 1]
+    YiDictMatch *out;
+    int nout, max;
+} Fuzzy;
+
+static void fuzzy_emit(Fuzzy *f, uint32_t ord, int dist) {
+    if (f->nout < f->max) {
+        yi_dict_key(f->d, (YiDictLang)(f->s - f->d->hdr->sec), ord, &f->out[f->nout]);
+        f->out[f->nout].dist = dist;
+        f->nout++;
+        return;
+    }
+    // 已满：替换距离最大的一个
+    int worst = 0;
+    for (int i = 1; i < f->nout; i++) if (f->out[i].dist > f->out[worst].dist) worst = i;
+    if (f->out[worst].dist > dist) {
+        yi_dict_key(f->d, (YiDictLang)(f->s - f->d->hdr->sec), ord, &f->out[worst]);
+        f->out[worst].dist = dist;
+    }
+}
+
+// row 为当前已消费码点对应的 DP 行；pend/plen/need 为未凑满的 UTF-8 字节
+static void fuzzy_walk(Fuzzy *f, uint32_t node, uint32_t ord, int depth,
+                       uint32_t pend, int plen, int need) {
+    const YdxNode *n = &f->nodes[node];
+    int *row = f->rows + depth * (f->qlen + 1);
+    if (plen == 0 && n->final && row[f->qlen] <= f->k) fuzzy_emit(f, ord, row[f->qlen]);
+    if (depth >= FUZZY_MAX_DEPTH) return;
+    uint32_t acc = ord + n->final;
+    for (uint32_t i = n->trans; i < n->trans + n->ntrans; i++) {
+        uint8_t c = f->tr[i].byte;
+        uint32_t child = f->tr[i].target;
+        uint32_t child_ord = acc;
+        acc += f->nodes[child].count;
+        uint32_t cp = pend;
+        int pl = plen, nd = need;
+        if (pl == 0) {
+            if (c < 0x80) { cp = c; nd = 1; }
+            else if ((c & 0xE0) == 0xC0) { cp = c & 0x1F; nd = 2; }
+            else if ((c & 0xF0) == 0xE0) { cp = c & 0x0F; nd = 3; }
+            else { cp = c & 0x07; nd = 4; }
+        } else {
+            cp = (cp << 6) | (c & 0x3F);
+        }
+        pl++;
+        int *next = row + (f->qlen + 1);
+        if (pl < nd) {
+            // 码点未完整：DP 行原样下传
+            memcpy(next, row, (f->qlen + 1) * sizeof(int));
+            fuzzy_walk(f, child, child_ord, depth + 1, cp, pl, nd);
+            continue;
+        }
+        next[0] = row[0] + 1;
+        int best = next[0];
+        for (int j = 1; j <= f->qlen; j++) {
+            int v = row[j - 1] + (f->q[j - 1] != cp);
+            if (row[j] + 1 < v) v = row[j] + 1;
+            if (next[j - 1] + 1 < v) v = next[j - 1] + 1;
+            next[j] = v;
+            if (v < best) best = v;
+        }
+        if (best <= f->k) fuzzy_walk(f, child, child_ord, depth + 1, 0, 0, 0);
+    }
+}
+
+static int cmp_match(const void *a, const void *b) {
+    const YiDictMatch *x = a, *y = b;
+    if (x->dist != y->dist) return x->dist - y->dist;
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+int yi_dict_fuzzy(const YiDict *d, YiDictLang lang, const char *q, size_t len, int max_dist,
+                  YiDictMatch *out, int max) {
+    Fuzzy f;
+    memset(&f, 0, sizeof(f));
+    f.d = d;
+    f.s = &d->hdr->sec[lang];
+    if (!f.s->nkeys || max <= 0) return 0;
+    f.nodes = AT(d, f.s->fst_nodes_off, YdxNode);
+    f.tr = AT(d, f.s->fst_trans_off, YdxTrans);
+    const char *p = q, *end = q + len;
+    while (p < end && f.qlen < FUZZY_MAX_Q) p += qsm_utf8_next(p, end, &f.q[f.qlen++]);
+    f.k = max_dist;
+    f.out = out;
+    f.max = max;
+    f.rows = malloc((size_t)(FUZZY_MAX_DEPTH + 1) * (f.qlen + 1) * sizeof(int));
+    for (int j = 0; j <= f.qlen; j++) f.rows[j] = j;
+    fuzzy_walk(&f, 0, 0, 0, 0, 0, 0);
+    free(f.rows);
+    qsort(out, f.nout, sizeof(YiDictMatch), cmp_match);
+    return f.nout;
+}
@@ -0,0 +1,138 @@
+/*
+ * yi_dict_index.h — 彝/汉/英三语词典编译索引（.ydx）
+ *
+ * 由 yi_dict_tool build 把 CSV / JSON / yi_dict.js 各份对照表编译成一个
+ * 二进制文件；本接口直接在 mmap 上查询，不做任何反序列化：
+ *   - 精确查询：每种语言一张 CHD 完美哈希，O(1)
+ *   - 前缀查询：每种语言一个最小无环 FST（DAWG），键序号即输出，
+ *               前缀命中的键在排序键表中是一段连续区间
+ *   - 模糊查询：在 FST 上按码点做 Levenshtein 剪枝遍历
+ */
+#ifndef YI_DICT_INDEX_H
+#define YI_DICT_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ==================== 文件格式 ====================
+
+#define YDX_MAGIC   0x31584459u   // "YDX1"
+#define YDX_VERSION 1
+
+typedef enum {
+    YI_DICT_YI = 0,
+    YI_DICT_ZH = 1,
+    YI_DICT_EN = 2,
+    YI_DICT_LANGS = 3
+} YiDictLang;
+
+typedef struct {
+    uint32_t nkeys;
+    uint32_t keys_off;        // YdxKey[nkeys]，按字节序排序；下标即键序号
+    uint32_t post_off;        // uint32_t[npost] 词条 id
+    uint32_t npost;
+    uint32_t phf_nbuckets;
+    uint32_t phf_nslots;
+    uint32_t phf_disp_off;    // uint32_t[nbuckets] 位移
+    uint32_t phf_slots_off;   // uint32_t[nslots] 键序号，空槽为 UINT32_MAX
+    uint64_t phf_seed;
+    uint32_t fst_nnodes;
+    uint32_t fst_ntrans;
+    uint32_t fst_nodes_off;   // YdxNode[nnodes]，0 为根
+    uint32_t fst_trans_off;   // YdxTrans[ntrans]
+} YdxSection;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t file_size;
+    uint64_t checksum;        // 头部之后全部字节的 qsm_hash64
+    uint32_t nentries;
+    uint32_t entries_off;     // YdxEntry[nentries]
+    uint32_t pool_off;
+    uint32_t pool_size;
+    YdxSection sec[YI_DICT_LANGS];
+} YdxHeader;
+
+typedef struct {
+    uint32_t yi, zh, en;      // 字符串池偏移（以 NUL 结尾），0 表示缺省
+} YdxEntry;
+
+typedef struct {
+    uint32_t off, len;        // 键文本
+    uint32_t post, npost;     // 倒排区间
+} YdxKey;
+
+typedef struct {
+    uint32_t trans;           // 首条转移下标，转移按字节升序
+    uint16_t ntrans;
+    uint8_t final;
+    uint8_t pad;
+    uint32_t count;           // 从此结点可接受的键数（序号累加用）
+} YdxNode;
+
+typedef struct {
+    uint32_t target;
+    uint8_t byte;
+    uint8_t pad[3];
+} YdxTrans;
+
+// CHD 完美哈希：h 为 qsm_hash64(key, len, phf_seed)，构建与查询共用
+static inline uint32_t ydx_phf_bucket(uint64_t h, uint32_t nbuckets) {
+    return (uint32_t)(h % nbuckets);
+}
+
+static inline uint32_t ydx_phf_slot(uint64_t h, uint32_t disp, uint32_t nslots) {
+    uint64_t step = (h >> 17) | 1;
+    return (uint32_t)(((h >> 32) + (uint64_t)disp * step) % nslots);
+}
+
+// ==================== 查询接口 ====================
+
+typedef struct YiDict YiDict;
+
+typedef struct {
+    uint32_t id;
+    const char *yi;           // 缺省时为 ""
+    const char *zh;
+    const char *en;
+} YiDictEntry;
+
+typedef struct {
+    uint32_t key;             // 键序号
+    const char *text;
+    uint32_t len;
+    int dist;                 // 模糊查询的编辑距离（码点计），其余为 0
+} YiDictMatch;
+
+YiDict *yi_dict_open(const char *path);
+void yi_dict_close(YiDict *d);
+
+// 校验头部之后全部字节的校验和：0=一致
+int yi_dict_verify(const YiDict *d);
+
+uint32_t yi_dict_size(const YiDict *d);
+uint32_t yi_dict_nkeys(const YiDict *d, YiDictLang lang);
+int yi_dict_entry(const YiDict *d, uint32_t id, YiDictEntry *out);
+
+// 精确查询：返回命中键序号，未命中 -1
+int64_t yi_dict_find(const YiDict *d, YiDictLang lang, const char *key, size_t len);
+
+// 取键对应的词条 id 列表，返回个数
+uint32_t yi_dict_postings(const YiDict *d, YiDictLang lang, uint32_t key, const uint32_t **ids);
+
+// 精确查询的便捷形式：把词条 id 写入 ids（最多 max 个），返回总命中数
+int yi_dict_lookup(const YiDict *d, YiDictLang lang, const char *key, size_t len,
+                   uint32_t *ids, int max);
+
+// 前缀查询：命中键为 [*first, *first + 返回值) 的连续序号区间
+uint32_t yi_dict_prefix(const YiDict *d, YiDictLang lang, const char *prefix, size_t len,
+                        uint32_t *first);
+
+// 模糊查询：编辑距离不超过 max_dist，按距离、键序排序，返回写入个数
+int yi_dict_fuzzy(const YiDict *d, YiDictLang lang, const char *q, size_t len, int max_dist,
+                  YiDictMatch *out, int max);
+
+int yi_dict_key(const YiDict *d, YiDictLang lang, uint32_t key, YiDictMatch *out);
+
+#endif
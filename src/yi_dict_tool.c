@@ -0,0 +1,1055 @@
+/*
+ * yi_dict_tool.c — 三语词典索引构建与查询工具
+ *
+ *   yi_dict_tool build -o out.ydx <源文件>...
+ *       源文件按扩展名识别：
+ *         .csv   彝文三语对照表（序号,彝文,中文,英文）
+ *         .json  学习表数组 [{yi,zh,en}] 或 yi_mapping.json {cn_to_yi, yi_to_cn}
+ *         .js    web/data/yi_dict.js（CN_TO_YI / YI_TO_CN 对象字面量，值为 &#x..; 实体）
+ *       以彝文字符为词条主键合并各源；中文别名、拆分后的中英文义项都作为检索键。
+ *   yi_dict_tool web -o out.ybd <源文件>...
+ *       同样的源，输出前端用的紧凑二进制词典（字符串池 + 排序偏移数组）
+ *   yi_dict_tool lookup <ydx> yi|zh|en <键>
+ *   yi_dict_tool prefix <ydx> yi|zh|en <前缀> [上限]
+ *   yi_dict_tool fuzzy  <ydx> yi|zh|en <查询> [距离]
+ *   yi_dict_tool bench  <ydx>
+ *   yi_dict_tool verify <ydx>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "qsm_jsonl.h"
+#include "yi_dict_index.h"
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ==================== 构建期词条表 ====================
+
+typedef struct {
+    char *yi, *zh, *en;
+} BEntry;
+
+typedef struct {
+    int lang;
+    char *text;
+    uint32_t len;
+    uint32_t id;
+} BKey;
+
+static BEntry *g_entries;
+static uint32_t g_nentries, g_entries_cap;
+static uint32_t *g_yi_tab;          // 彝文 → 词条 id 的开放寻址表
+static uint32_t g_yi_tab_cap;
+static BKey *g_keys;
+static size_t g_nkeys, g_keys_cap;
+
+static void yi_tab_rehash(void) {
+    uint32_t ncap = g_yi_tab_cap ? g_yi_tab_cap * 2 : 8192;
+    uint32_t *nt = malloc(ncap * sizeof(uint32_t));
+    memset(nt, 0xFF, ncap * sizeof(uint32_t));
+    for (uint32_t i = 0; i < g_nentries; i++) {
+        uint32_t j = (uint32_t)qsm_hash64(g_entries[i].yi, strlen(g_entries[i].yi), 0) & (ncap - 1);
+        while (nt[j] != UINT32_MAX) j = (j + 1) & (ncap - 1);
+        nt[j] = i;
+    }
+    free(g_yi_tab);
+    g_yi_tab = nt;
+    g_yi_tab_cap = ncap;
+}
+
+// 取或建彝文词条
+static uint32_t entry_for(const char *yi) {
+    if ((g_nentries + 1) * 2 > g_yi_tab_cap) yi_tab_rehash();
+    size_t len = strlen(yi);
+    uint32_t j = (uint32_t)qsm_hash64(yi, len, 0) & (g_yi_tab_cap - 1);
+    while (g_yi_tab[j] != UINT32_MAX) {
+        if (strcmp(g_entries[g_yi_tab[j]].yi, yi) == 0) return g_yi_tab[j];
+        j = (j + 1) & (g_yi_tab_cap - 1);
+    }
+    if (g_nentries == g_entries_cap) {
+        g_entries_cap = g_entries_cap ? g_entries_cap * 2 : 4096;
+        g_entries = realloc(g_entries, g_entries_cap * sizeof(BEntry));
+    }
+    g_entries[g_nentries].yi = strdup(yi);
+    g_entries[g_nentries].zh = NULL;
+    g_entries[g_nentries].en = NULL;
+    g_yi_tab[j] = g_nentries;
+    return g_nentries++;
+}
+
+static void add_key(int lang, const char *text, size_t len, uint32_t id) {
+    if (len == 0) return;
+    if (g_nkeys == g_keys_cap) {
+        g_keys_cap = g_keys_cap ? g_keys_cap * 2 : 16384;
+        g_keys = realloc(g_keys, g_keys_cap * sizeof(BKey));
+    }
+    g_keys[g_nkeys].lang = lang;
+    g_keys[g_nkeys].text = strndup(text, len);
+    g_keys[g_nkeys].len = (uint32_t)len;
+    g_keys[g_nkeys].id = id;
+    g_nkeys++;
+}
+
+// 合并一条（yi, zh, en）：已有字段不覆盖，来源顺序即优先级
+static void merge_entry(const char *yi, const char *zh, const char *en) {
+    if (!yi || !*yi) return;
+    uint32_t id = entry_for(yi);
+    BEntry *e = &g_entries[id];
+    if (zh && *zh && !e->zh) e->zh = strdup(zh);
+    if (en && *en && !e->en) e->en = strdup(en);
+}
+
+// 中文别名：只加检索键，不改词条释义
+static void merge_alias(const char *zh, const char *yi) {
+    if (!zh || !*zh || !yi || !*yi) return;
+    uint32_t id = entry_for(yi);
+    if (!g_entries[id].zh) g_entries[id].zh = strdup(zh);
+    add_key(YI_DICT_ZH, zh, strlen(zh), id);
+}
+
+// ==================== 源文件解析 ====================
+
+// CSV：支持引号字段、"" 转义与 UTF-8 BOM
+static void csv_putc(char **out, size_t *n, size_t *cap, char c) {
+    if (*n + 1 >= *cap) *out = realloc(*out, *cap *= 2);
+    (*out)[(*n)++] = c;
+}
+
+// 解析一条记录；超过 maxf 的字段照样解析（引号内的逗号、换行）后丢弃，返回值总是下一条记录的起点
+static const char *csv_record(const char *p, const char *end, char **fields, int maxf, int *nf) {
+    *nf = 0;
+    while (p < end) {
+        size_t n = 0, cap = 256;
+        char *out = malloc(cap);
+        if (*p == '"') {
+            p++;
+            while (p < end) {
+                if (*p == '"') {
+                    if (p + 1 < end && p[1] == '"') { csv_putc(&out, &n, &cap, '"'); p += 2; continue; }
+                    p++;
+                    break;
+                }
+                csv_putc(&out, &n, &cap, *p++);
+            }
+        } else {
+            while (p < end && *p != ',' && *p != '\n' && *p != '\r') csv_putc(&out, &n, &cap, *p++);
+        }
+        out[n] = '\0';
+        if (*nf < maxf) fields[(*nf)++] = out;
+        else free(out);
+        if (p < end && *p == ',') { p++; continue; }
+        while (p < end && (*p == '\r' || *p == '\n')) p++;
+        break;
+    }
+    return p;
+}
+
+static int load_csv(const char *data, size_t size) {
+    const char *p = data, *end = data + size;
+    if (size >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) p += 3;
+    char *f[8];
+    int nf, rows = 0;
+    p = csv_record(p, end, f, 8, &nf);       // 表头
+    for (int i = 0; i < nf; i++) free(f[i]);
+    while (p < end) {
+        p = csv_record(p, end, f, 8, &nf);
+        if (nf >= 4) { merge_entry(f[1], f[2], f[3]); rows++; }
+        for (int i = 0; i < nf; i++) free(f[i]);
+    }
+    return rows;
+}
+
+// 从 p 处的 '{' 找到配对的 '}'（跳过字符串），返回其后一位
+static const char *match_brace(const char *p, const char *end) {
+    int depth = 0;
+    while (p < end) {
+        char c = *p++;
+        if (c == '"') {
+            while (p < end && *p != '"') p += (*p == '\\') ? 2 : 1;
+            p++;
+        } else if (c == '{') depth++;
+        else if (c == '}' && --depth == 0) return p;
+    }
+    return NULL;
+}
+
+typedef struct {
+    char *yi, *zh, *en;
+    int mode;               // 0=学习表对象，1=cn_to_yi，2=yi_to_cn
+    int rows;
+} JsonCtx;
+
+static char *unescape_dup(const char *raw, size_t rlen) {
+    char *s = malloc(rlen + 1);
+    s[qsm_json_unescape(raw, rlen, s)] = '\0';
+    return s;
+}
+
+static int on_json_str(void *ud, const char *key, size_t klen, const char *raw, size_t rlen, int depth) {
+    JsonCtx *c = ud;
+    if (c->mode == 0) {
+        if (depth != 1) return 0;
+        char **slot = NULL;
+        if (klen == 2 && memcmp(key, "yi", 2) == 0) slot = &c->yi;
+        else if (klen == 2 && memcmp(key, "zh", 2) == 0) slot = &c->zh;
+        else if (klen == 2 && memcmp(key, "en", 2) == 0) slot = &c->en;
+        if (slot && !*slot) *slot = unescape_dup(raw, rlen);
+        return 0;
+    }
+    char *k = unescape_dup(key, klen), *v = unescape_dup(raw, rlen);
+    if (c->mode == 1) merge_alias(k, v);
+    else merge_entry(k, v, NULL);
+    c->rows++;
+    free(k);
+    free(v);
+    return 0;
+}
+
+static int load_mapping_object(const char *data, const char *end, const char *name, int mode) {
+    char pat[64];
+    snprintf(pat, sizeof(pat), "\"%s\"", name);
+    const char *p = memmem(data, (size_t)(end - data), pat, strlen(pat));
+    if (!p) return 0;
+    p = memchr(p, '{', (size_t)(end - p));
+    if (!p) return 0;
+    const char *q = match_brace(p, end);
+    if (!q) return -1;
+    JsonCtx c = { NULL, NULL, NULL, mode, 0 };
+    return qsm_json_scan(p, q, on_json_str, &c) < 0 ? -1 : c.rows;
+}
+
+static int load_json(const char *data, size_t size) {
+    const char *p = data, *end = data + size;
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+    if (p < end && *p == '{') {
+        int a = load_mapping_object(p, end, "yi_to_cn", 2);
+        int b = load_mapping_object(p, end, "cn_to_yi", 1);
+        return (a < 0 || b < 0) ? -1 : a + b;
+    }
+    int rows = 0;
+    while ((p = memchr(p, '{', (size_t)(end - p))) != NULL) {
+        const char *q = match_brace(p, end);
+        if (!q) return -1;
+        JsonCtx c = { NULL, NULL, NULL, 0, 0 };
+        if (qsm_json_scan(p, q, on_json_str, &c) == 0) {
+            merge_entry(c.yi, c.zh, c.en);
+            rows++;
+        }
+        free(c.yi);
+        free(c.zh);
+        free(c.en);
+        p = q;
+    }
+    return rows;
+}
+
+// JS 单引号字符串，顺带解码 &#xHEX; / &#DEC; 实体
+static const char *js_string(const char *p, const char *end, char *out, size_t cap) {
+    size_t n = 0;
+    p++;
+    while (p < end && *p != '\'' && *p != '\n') {
+        if (*p == '\\' && p + 1 < end) { p++; if (n + 1 < cap) out[n++] = *p++; continue; }
+        if (*p == '&' && p + 2 < end && p[1] == '#') {
+            const char *q = p + 2;
+            int hex = (*q == 'x' || *q == 'X');
+            if (hex) q++;
+            uint32_t cp = (uint32_t)strtoul(q, (char **)&q, hex ? 16 : 10);
+            if (q < end && *q == ';' && cp && n + 4 < cap) {
+                n += qsm_utf8_put(cp, out + n);
+                p = q + 1;
+                continue;
+            }
+        }
+        if (n + 1 < cap) out[n++] = *p;
+        p++;
+    }
+    out[n] = '\0';
+    return p < end ? p + 1 : p;
+}
+
+static int load_js(const char *data, size_t size) {
+    const char *p = data, *end = data + size;
+    int mode = 0, rows = 0;
+    char k[1024], v[1024];
+    while (p < end) {
+        const char *eol;
+        const char *nx = qsm_next_line(p, end, &eol);
+        if (memmem(p, (size_t)(eol - p), "CN_TO_YI", 8)) mode = 1;
+        else if (memmem(p, (size_t)(eol - p), "YI_TO_CN", 8)) mode = 2;
+        else if (mode) {
+            const char *q = p;
+            while (q < eol && *q != '\'') q++;
+            if (q < eol) {
+                q = js_string(q, eol, k, sizeof(k));
+                while (q < eol && *q != '\'') q++;
+                if (q < eol) {
+                    js_string(q, eol, v, sizeof(v));
+                    if (mode == 1) merge_alias(k, v);
+                    else merge_entry(k, v, NULL);
+                    rows++;
+                }
+            }
+        }
+        p = nx;
+    }
+    return rows;
+}
+
+// ==================== 检索键生成 ====================
+
+// 去掉 "1、" "2." "3)" 之类的义项编号
+static const char *strip_numbering(const char *s, const char *end) {
+    const char *p = s;
+    while (p < end && *p >= '0' && *p <= '9') p++;
+    if (p == s) return s;
+    if (p < end && (*p == '.' || *p == ')')) p++;
+    else if (end - p >= 3 && memcmp(p, "、", 3) == 0) p += 3;
+    else return s;
+    while (p < end && *p == ' ') p++;
+    return p;
+}
+
+static int is_sep(const char *p, const char *end, int *w) {
+    *w = 1;
+    if (*p == ',' || *p == ';') return 1;
+    if (end - p >= 3 && (memcmp(p, "；", 3) == 0 || memcmp(p, "，", 3) == 0)) { *w = 3; return 1; }
+    return 0;
+}
+
+static void add_terms(int lang, const char *text, uint32_t id) {
+    size_t len = strlen(text);
+    char *t = strndup(text, len);
+    if (lang == YI_DICT_EN)
+        for (size_t i = 0; i < len; i++) if (t[i] >= 'A' && t[i] <= 'Z') t[i] += 32;
+    add_key(lang, t, len, id);
+    const char *p = t, *end = t + len, *start = t;
+    while (p <= end) {
+        int w = 1;
+        if (p == end || is_sep(p, end, &w)) {
+            const char *a = start, *b = p;
+            while (a < b && *a == ' ') a++;
+            while (b > a && b[-1] == ' ') b--;
+            a = strip_numbering(a, b);
+            if (b > a && (size_t)(b - a) != len) add_key(lang, a, (size_t)(b - a), id);
+            start = p + w;
+        }
+        p += w;
+    }
+    free(t);
+}
+
+static int cmp_bkey(const void *x, const void *y) {
+    const BKey *a = x, *b = y;
+    if (a->lang != b->lang) return a->lang - b->lang;
+    uint32_t n = a->len < b->len ? a->len : b->len;
+    int c = memcmp(a->text, b->text, n);
+    if (c) return c;
+    if (a->len != b->len) return a->len < b->len ? -1 : 1;
+    return a->id < b->id ? -1 : a->id > b->id;
+}
+
+// ==================== 输出缓冲 ====================
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+} Buf;
+
+static uint32_t buf_put(Buf *b, const void *p, size_t n) {
+    while (b->len % 8) b->data[b->len++] = 0;    // 各段 8 字节对齐
+    if (b->len + n + 8 > b->cap) {
+        while (b->len + n + 8 > b->cap) b->cap = b->cap ? b->cap * 2 : 1 << 20;
+        b->data = realloc(b->data, b->cap);
+    }
+    uint32_t off = (uint32_t)b->len;
+    if (n) memcpy(b->data + b->len, p, n);
+    b->len += n;
+    return off;
+}
+
+// 字符串池：相同字符串只存一份
+typedef struct {
+    Buf buf;
+    uint32_t *tab;
+    uint32_t cap, n;
+} Pool;
+
+static uint32_t pool_str(Pool *pl, const char *s, size_t len) {
+    if (!s || !len) return 0;
+    if ((pl->n + 1) * 2 > pl->cap) {
+        uint32_t ncap = pl->cap ? pl->cap * 2 : 1 << 14;
+        uint32_t *nt = calloc(ncap, sizeof(uint32_t));
+        for (uint32_t i = 0; i < pl->cap; i++) {
+            if (!pl->tab[i]) continue;
+            const char *t = pl->buf.data + pl->tab[i];
+            uint32_t j = (uint32_t)qsm_hash64(t, strlen(t), 0) & (ncap - 1);
+            while (nt[j]) j = (j + 1) & (ncap - 1);
+            nt[j] = pl->tab[i];
+        }
+        free(pl->tab);
+        pl->tab = nt;
+        pl->cap = ncap;
+    }
+    uint32_t j = (uint32_t)qsm_hash64(s, len, 0) & (pl->cap - 1);
+    while (pl->tab[j]) {
+        const char *t = pl->buf.data + pl->tab[j];
+        if (strncmp(t, s, len) == 0 && t[len] == '\0') return pl->tab[j];
+        j = (j + 1) & (pl->cap - 1);
+    }
+    if (pl->buf.len + len + 1 > pl->buf.cap) {
+        while (pl->buf.len + len + 1 > pl->buf.cap) pl->buf.cap = pl->buf.cap ? pl->buf.cap * 2 : 1 << 20;
+        pl->buf.data = realloc(pl->buf.data, pl->buf.cap);
+    }
+    uint32_t off = (uint32_t)pl->buf.len;
+    memcpy(pl->buf.data + off, s, len);
+    pl->buf.data[off + len] = '\0';
+    pl->buf.len += len + 1;
+    pl->tab[j] = off;
+    pl->n++;
+    return off;
+}
+
+// ==================== CHD 完美哈希 ====================
+
+static int build_phf(const BKey *keys, uint32_t n, YdxSection *s, uint32_t **disp_out, uint32_t **slots_out) {
+    uint32_t nb = n / 4 + 1, ns = n + n / 8 + 1;
+    uint64_t *h = malloc((n + 1) * sizeof(uint64_t));
+    uint32_t *bstart = malloc((nb + 1) * sizeof(uint32_t));
+    uint32_t *order = malloc((n + 1) * sizeof(uint32_t));
+    uint32_t *border = malloc(nb * sizeof(uint32_t));
+    uint32_t *disp = calloc(nb, sizeof(uint32_t));
+    uint32_t *slots = malloc(ns * sizeof(uint32_t));
+    uint32_t tmp[64];
+    for (uint64_t attempt = 0; attempt < 64; attempt++) {
+        uint64_t seed = qsm_mix64(attempt + 0x59445831);
+        memset(bstart, 0, (nb + 1) * sizeof(uint32_t));
+        for (uint32_t i = 0; i < n; i++) {
+            h[i] = qsm_hash64(keys[i].text, keys[i].len, seed);
+            bstart[ydx_phf_bucket(h[i], nb) + 1]++;
+        }
+        for (uint32_t b = 0; b < nb; b++) bstart[b + 1] += bstart[b];
+        uint32_t *fill = calloc(nb, sizeof(uint32_t));
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t b = ydx_phf_bucket(h[i], nb);
+            order[bstart[b] + fill[b]++] = i;
+        }
+        free(fill);
+        // 桶按大小降序处理（计数排序）
+        uint32_t maxsz = 0, k = 0;
+        for (uint32_t b = 0; b < nb; b++)
+            if (bstart[b + 1] - bstart[b] > maxsz) maxsz = bstart[b + 1] - bstart[b];
+        if (maxsz > 64) continue;
+        for (int sz = (int)maxsz; sz >= 1; sz--)
+            for (uint32_t b = 0; b < nb; b++)
+                if (bstart[b + 1] - bstart[b] == (uint32_t)sz) border[k++] = b;
+        memset(slots, 0xFF, ns * sizeof(uint32_t));
+        memset(disp, 0, nb * sizeof(uint32_t));
+        int ok = 1;
+        for (uint32_t bi = 0; bi < k && ok; bi++) {
+            uint32_t b = border[bi], lo = bstart[b], sz = bstart[b + 1] - lo;
+            uint32_t d;
+            for (d = 0; d < (1u << 20); d++) {
+                uint32_t j;
+                for (j = 0; j < sz; j++) {
+                    uint32_t sl = ydx_phf_slot(h[order[lo + j]], d, ns);
+                    if (slots[sl] != UINT32_MAX) break;
+                    uint32_t t;
+                    for (t = 0; t < j && tmp[t] != sl; t++) {}
+                    if (t < j) break;
+                    tmp[j] = sl;
+                }
+                if (j == sz) break;
+            }
+            if (d == (1u << 20)) { ok = 0; break; }
+            disp[b] = d;
+            for (uint32_t j = 0; j < sz; j++) slots[tmp[j]] = order[lo + j];
+        }
+        if (!ok) continue;
+        s->phf_nbuckets = nb;
+        s->phf_nslots = ns;
+        s->phf_seed = seed;
+        free(h); free(bstart); free(order); free(border);
+        *disp_out = disp;
+        *slots_out = slots;
+        return 0;
+    }
+    free(h); free(bstart); free(order); free(border); free(disp); free(slots);
+    return -1;
+}
+
+// ==================== 最小无环 FST（Daciuk 有序增量构建） ====================
+
+typedef struct {
+    uint8_t *bytes;
+    uint32_t *tgt;
+    uint16_t n, cap;
+    uint8_t final;
+    uint32_t newid;
+    uint32_t count;
+} FNode;
+
+typedef struct {
+    FNode *nodes;
+    uint32_t nnodes, cap;
+    uint32_t *reg;          // 已登记（已最小化）结点的哈希表
+    uint32_t reg_cap, reg_n;
+} Fst;
+
+static uint32_t fst_new(Fst *f) {
+    if (f->nnodes == f->cap) {
+        f->cap = f->cap ? f->cap * 2 : 4096;
+        f->nodes = realloc(f->nodes, f->cap * sizeof(FNode));
+    }
+    memset(&f->nodes[f->nnodes], 0, sizeof(FNode));
+    f->nodes[f->nnodes].newid = UINT32_MAX;
+    return f->nnodes++;
+}
+
+static void fst_add_trans(Fst *f, uint32_t from, uint8_t c, uint32_t to) {
+    FNode *n = &f->nodes[from];
+    if (n->n == n->cap) {
+        n->cap = n->cap ? n->cap * 2 : 2;
+        n->bytes = realloc(n->bytes, n->cap);
+        n->tgt = realloc(n->tgt, n->cap * sizeof(uint32_t));
+    }
+    n->bytes[n->n] = c;
+    n->tgt[n->n] = to;
+    n->n++;
+}
+
+static uint64_t fst_sig(const FNode *n) {
+    uint64_t h = n->final + 0x9E37;
+    for (int i = 0; i < n->n; i++) h = qsm_mix64(h ^ ((uint64_t)n->bytes[i] << 32 | n->tgt[i]));
+    return h;
+}
+
+static int fst_equal(const FNode *a, const FNode *b) {
+    return a->final == b->final && a->n == b->n &&
+           memcmp(a->bytes, b->bytes, a->n) == 0 &&
+           memcmp(a->tgt, b->tgt, a->n * sizeof(uint32_t)) == 0;
+}
+
+// 返回等价的已登记结点；无则登记自身
+static uint32_t fst_register(Fst *f, uint32_t id) {
+    if ((f->reg_n + 1) * 2 > f->reg_cap) {
+        uint32_t ncap = f->reg_cap ? f->reg_cap * 2 : 1 << 14;
+        uint32_t *nt = malloc(ncap * sizeof(uint32_t));
+        memset(nt, 0xFF, ncap * sizeof(uint32_t));
+        for (uint32_t i = 0; i < f->reg_cap; i++) {
+            if (f->reg[i] == UINT32_MAX) continue;
+            uint32_t j = (uint32_t)fst_sig(&f->nodes[f->reg[i]]) & (ncap - 1);
+            while (nt[j] != UINT32_MAX) j = (j + 1) & (ncap - 1);
+            nt[j] = f->reg[i];
+        }
+        free(f->reg);
+        f->reg = nt;
+        f->reg_cap = ncap;
+    }
+    uint32_t j = (uint32_t)fst_sig(&f->nodes[id]) & (f->reg_cap - 1);
+    while (f->reg[j] != UINT32_MAX) {
+        if (fst_equal(&f->nodes[f->reg[j]], &f->nodes[id])) return f->reg[j];
+        j = (j + 1) & (f->reg_cap - 1);
+    }
+    f->reg[j] = id;
+    f->reg_n++;
+    return id;
+}
+
+static void fst_minimize(Fst *f, uint32_t *path, int from, int down_to) {
+    for (int d = from; d > down_to; d--) {
+        uint32_t child = path[d], parent = path[d - 1];
+        uint32_t r = fst_register(f, child);
+        if (r != child) {
+            FNode *p = &f->nodes[parent];
+            p->tgt[p->n - 1] = r;
+            free(f->nodes[child].bytes);
+            free(f->nodes[child].tgt);
+            f->nodes[child].bytes = NULL;
+            f->nodes[child].tgt = NULL;
+            f->nodes[child].n = 0;
+        }
+    }
+}
+
+// 输入键必须已排序去重
+static void fst_build(Fst *f, const BKey *keys, uint32_t n) {
+    uint32_t maxlen = 1;
+    for (uint32_t i = 0; i < n; i++) if (keys[i].len > maxlen) maxlen = keys[i].len;
+    uint32_t *path = malloc((maxlen + 1) * sizeof(uint32_t));
+    path[0] = fst_new(f);
+    int prevlen = 0;
+    const char *prev = "";
+    for (uint32_t i = 0; i < n; i++) {
+        const char *w = keys[i].text;
+        int len = (int)keys[i].len, cp = 0;
+        while (cp < len && cp < prevlen && w[cp] == prev[cp]) cp++;
+        fst_minimize(f, path, prevlen, cp);
+        for (int d = cp; d < len; d++) {
+            uint32_t nn = fst_new(f);
+            fst_add_trans(f, path[d], (uint8_t)w[d], nn);
+            path[d + 1] = nn;
+        }
+        f->nodes[path[len]].final = 1;
+        prev = w;
+        prevlen = len;
+    }
+    fst_minimize(f, path, prevlen, 0);
+    free(path);
+}
+
+// 先序编号（根为 0）并后序计算可接受键数
+static uint32_t fst_number(Fst *f, uint32_t id, uint32_t *next) {
+    FNode *n = &f->nodes[id];
+    if (n->newid != UINT32_MAX) return n->count;
+    n->newid = (*next)++;
+    uint32_t c = n->final;
+    for (int i = 0; i < n->n; i++) c += fst_number(f, f->nodes[id].tgt[i], next);
+    f->nodes[id].count = c;
+    return c;
+}
+
+static void fst_emit(Fst *f, Buf *out, YdxSection *s) {
+    uint32_t live = 0;
+    fst_number(f, 0, &live);
+    YdxNode *nodes = calloc(live, sizeof(YdxNode));
+    uint32_t ntrans = 0;
+    for (uint32_t i = 0; i < f->nnodes; i++) if (f->nodes[i].newid != UINT32_MAX) ntrans += f->nodes[i].n;
+    YdxTrans *tr = calloc(ntrans ? ntrans : 1, sizeof(YdxTrans));
+    // 按新编号顺序排布转移
+    uint32_t *byid = malloc(live * sizeof(uint32_t));
+    for (uint32_t i = 0; i < f->nnodes; i++) if (f->nodes[i].newid != UINT32_MAX) byid[f->nodes[i].newid] = i;
+    uint32_t t = 0;
+    for (uint32_t k = 0; k < live; k++) {
+        FNode *n = &f->nodes[byid[k]];
+        nodes[k].trans = t;
+        nodes[k].ntrans = n->n;
+        nodes[k].final = n->final;
+        nodes[k].count = n->count;
+        for (int i = 0; i < n->n; i++) {
+            tr[t].target = f->nodes[n->tgt[i]].newid;
+            tr[t].byte = n->bytes[i];
+            t++;
+        }
+    }
+    s->fst_nnodes = live;
+    s->fst_ntrans = ntrans;
+    s->fst_nodes_off = buf_put(out, nodes, live * sizeof(YdxNode));
+    s->fst_trans_off = buf_put(out, tr, ntrans * sizeof(YdxTrans));
+    free(nodes);
+    free(tr);
+    free(byid);
+    for (uint32_t i = 0; i < f->nnodes; i++) { free(f->nodes[i].bytes); free(f->nodes[i].tgt); }
+    free(f->nodes);
+    free(f->reg);
+}
+
+// ==================== 读源文件并生成检索键（build / web 共用） ====================
+
+static int load_sources(int argc, char **argv) {
+    for (int i = 0; i < argc; i++) {
+        QsmMap m;
+        if (qsm_map_file(argv[i], &m) != 0) {
+            fprintf(stderr, "[DICT] 无法读取: %s\n", argv[i]);
+            return -1;
+        }
+        size_t pl = strlen(argv[i]);
+        int rows;
+        if (pl > 4 && strcmp(argv[i] + pl - 4, ".csv") == 0) rows = load_csv(m.data, m.size);
+        else if (pl > 3 && strcmp(argv[i] + pl - 3, ".js") == 0) rows = load_js(m.data, m.size);
+        else rows = load_json(m.data, m.size);
+        qsm_unmap_file(&m);
+        if (rows < 0) {
+            fprintf(stderr, "[DICT] 格式错误: %s\n", argv[i]);
+            return -1;
+        }
+        fprintf(stdout, "[DICT] 读取 %s: %d 条\n", argv[i], rows);
+    }
+    for (uint32_t id = 0; id < g_nentries; id++) {
+        BEntry *e = &g_entries[id];
+        add_key(YI_DICT_YI, e->yi, strlen(e->yi), id);
+        if (e->zh) add_terms(YI_DICT_ZH, e->zh, id);
+        if (e->en) add_terms(YI_DICT_EN, e->en, id);
+    }
+    qsort(g_keys, g_nkeys, sizeof(BKey), cmp_bkey);
+    return 0;
+}
+
+// -o <out> <源文件>...：返回源文件起始下标，失败 -1
+static int parse_out_arg(int argc, char **argv, const char **out) {
+    if (argc >= 3 && strcmp(argv[0], "-o") == 0) {
+        *out = argv[1];
+        return 2;
+    }
+    return -1;
+}
+
+// ==================== build 子命令 ====================
+
+static int cmd_build(int argc, char **argv) {
+    const char *out = NULL;
+    int i = parse_out_arg(argc, argv, &out);
+    if (i < 0) {
+        fprintf(stderr, "用法: yi_dict_tool build -o out.ydx <源文件>...\n");
+        return 1;
+    }
+    double t0 = now_sec();
+    if (load_sources(argc - i, argv + i) != 0) return 1;
+
+    Buf body = { 0 };
+    Pool pool = { 0 };
+    pool.buf.data = malloc(1 << 20);
+    pool.buf.cap = 1 << 20;
+    pool.buf.data[0] = '\0';
+    pool.buf.len = 1;
+
+    YdxHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = YDX_MAGIC;
+    hdr.version = YDX_VERSION;
+    hdr.nentries = g_nentries;
+    YdxEntry *ents = malloc((g_nentries + 1) * sizeof(YdxEntry));
+    for (uint32_t id = 0; id < g_nentries; id++) {
+        BEntry *e = &g_entries[id];
+        ents[id].yi = pool_str(&pool, e->yi, strlen(e->yi));
+        ents[id].zh = e->zh ? pool_str(&pool, e->zh, strlen(e->zh)) : 0;
+        ents[id].en = e->en ? pool_str(&pool, e->en, strlen(e->en)) : 0;
+    }
+    buf_put(&body, &hdr, sizeof(hdr));
+    hdr.entries_off = buf_put(&body, ents, g_nentries * sizeof(YdxEntry));
+    free(ents);
+
+    size_t k = 0;
+    for (int lang = 0; lang < YI_DICT_LANGS; lang++) {
+        YdxSection *s = &hdr.sec[lang];
+        // 去重：同一语言同一键文本合并为一个键，倒排去重
+        BKey *uk = malloc((g_nkeys + 1) * sizeof(BKey));
+        YdxKey *yk = malloc((g_nkeys + 1) * sizeof(YdxKey));
+        uint32_t *post = malloc((g_nkeys + 1) * sizeof(uint32_t));
+        uint32_t nk = 0, np = 0;
+        for (; k < g_nkeys && g_keys[k].lang == lang; k++) {
+            BKey *b = &g_keys[k];
+            if (nk && uk[nk - 1].len == b->len && memcmp(uk[nk - 1].text, b->text, b->len) == 0) {
+                if (post[np - 1] != b->id) { post[np++] = b->id; yk[nk - 1].npost++; }
+                continue;
+            }
+            uk[nk] = *b;
+            yk[nk].off = pool_str(&pool, b->text, b->len);
+            yk[nk].len = b->len;
+            yk[nk].post = np;
+            yk[nk].npost = 1;
+            post[np++] = b->id;
+            nk++;
+        }
+        s->nkeys = nk;
+        s->npost = np;
+        s->keys_off = buf_put(&body, yk, nk * sizeof(YdxKey));
+        s->post_off = buf_put(&body, post, np * sizeof(uint32_t));
+        uint32_t *disp, *slots;
+        if (build_phf(uk, nk, s, &disp, &slots) != 0) {
+            fprintf(stderr, "[DICT] 完美哈希构建失败\n");
+            return 1;
+        }
+        s->phf_disp_off = buf_put(&body, disp, s->phf_nbuckets * sizeof(uint32_t));
+        s->phf_slots_off = buf_put(&body, slots, s->phf_nslots * sizeof(uint32_t));
+        free(disp);
+        free(slots);
+        Fst f = { 0 };
+        fst_build(&f, uk, nk);
+        fst_emit(&f, &body, s);
+        free(uk);
+        free(yk);
+        free(post);
+    }
+    hdr.pool_off = buf_put(&body, pool.buf.data, pool.buf.len);
+    hdr.pool_size = (uint32_t)pool.buf.len;
+    buf_put(&body, NULL, 0);
+    hdr.file_size = body.len;
+    hdr.checksum = qsm_hash64(body.data + sizeof(hdr), body.len - sizeof(hdr), 0);
+    memcpy(body.data, &hdr, sizeof(hdr));
+
+    FILE *fo = fopen(out, "wb");
+    if (!fo) {
+        fprintf(stderr, "[DICT] 无法创建输出文件: %s\n", out);
+        return 1;
+    }
+    fwrite(body.data, 1, body.len, fo);
+    fclose(fo);
+    fprintf(stdout, "[DICT] 词条 %u, 键 彝/中/英 = %u/%u/%u, FST 结点 %u/%u/%u\n", g_nentries,
+            hdr.sec[0].nkeys, hdr.sec[1].nkeys, hdr.sec[2].nkeys,
+            hdr.sec[0].fst_nnodes, hdr.sec[1].fst_nnodes, hdr.sec[2].fst_nnodes);
+    fprintf(stdout, "[DICT] 输出: %s (%zu 字节), %.2fs\n", out, body.len, now_sec() - t0);
+    return 0;
+}
+
+// ==================== web 子命令：前端二进制词典（.ybd） ====================
+//
+// 供 web/assets/js/yi-dict-binary.js 以单个 ArrayBuffer + DataView 读取，
+// 页面启动时不解析任何 JS/JSON。全部小端：
+//   YbdHeader
+//   YbdTable[ntables]
+//   每表 (1 + ncols) 个偏移数组，各 n+1 个 uint32（相对字符串池）：
+//     第 0 个为键，按 UTF-8 字节序排序；第 c 个为第 c 列值。
+//     字符串 i 即 pool[off[i], off[i+1])，无需分隔符与长度字段。
+//   字符串池
+
+#define YBD_MAGIC   0x31444259u   // "YBD1"
+#define YBD_VERSION 1
+
+// 英文检索表体积大且前端暂无消费方，英文只作为彝文词条的一列随表下发
+enum { YBD_ZH_YI = 0, YBD_YI_ENTRY = 1, YBD_TABLES = 2 };
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ntables;
+    uint32_t pool_off;
+    uint32_t pool_size;
+    uint32_t nentries;
+} YbdHeader;
+
+typedef struct {
+    uint32_t id;
+    uint32_t n;
+    uint32_t ncols;
+    uint32_t offs_off;
+} YbdTable;
+
+typedef struct {
+    const char *s[3];         // 键 + 至多两列
+} YbdRow;
+
+static int cmp_ybd_row(const void *x, const void *y) {
+    return strcmp(((const YbdRow *)x)->s[0], ((const YbdRow *)y)->s[0]);
+}
+
+// 把一张表的各列依次写入字符串池，偏移数组写入 offs
+static void ybd_table(Buf *pool, const YbdRow *rows, uint32_t n, uint32_t ncols, uint32_t *offs) {
+    for (uint32_t c = 0; c <= ncols; c++) {
+        uint32_t *o = offs + (size_t)c * (n + 1);
+        for (uint32_t i = 0; i < n; i++) {
+            const char *t = rows[i].s[c] ? rows[i].s[c] : "";
+            size_t len = strlen(t);
+            o[i] = (uint32_t)pool->len;
+            if (pool->len + len > pool->cap) {
+                while (pool->len + len > pool->cap) pool->cap = pool->cap ? pool->cap * 2 : 1 << 20;
+                pool->data = realloc(pool->data, pool->cap);
+            }
+            memcpy(pool->data + pool->len, t, len);
+            pool->len += len;
+        }
+        o[n] = (uint32_t)pool->len;
+    }
+}
+
+// 同一中文检索键取首个词条（来源顺序即优先级），值为彝文
+static uint32_t ybd_key_rows(int lang, YbdRow *rows) {
+    uint32_t n = 0;
+    for (size_t k = 0; k < g_nkeys; k++) {
+        const BKey *b = &g_keys[k];
+        if (b->lang != lang) continue;
+        if (n && strcmp(rows[n - 1].s[0], b->text) == 0) continue;
+        rows[n].s[0] = b->text;
+        rows[n].s[1] = g_entries[b->id].yi;
+        rows[n].s[2] = NULL;
+        n++;
+    }
+    return n;
+}
+
+static int cmd_web(int argc, char **argv) {
+    const char *out = NULL;
+    int i = parse_out_arg(argc, argv, &out);
+    if (i < 0) {
+        fprintf(stderr, "用法: yi_dict_tool web -o out.ybd <源文件>...\n");
+        return 1;
+    }
+    if (load_sources(argc - i, argv + i) != 0) return 1;
+
+    YbdRow *rows = malloc((g_nkeys + g_nentries + 1) * sizeof(YbdRow));
+    uint32_t n[YBD_TABLES], ncols[YBD_TABLES] = { 1, 2 };
+    uint32_t *offs[YBD_TABLES];
+    Buf pool = { 0 };
+    for (int t = 0; t < YBD_TABLES; t++) {
+        if (t == YBD_YI_ENTRY) {
+            n[t] = g_nentries;
+            for (uint32_t id = 0; id < g_nentries; id++) {
+                rows[id].s[0] = g_entries[id].yi;
+                rows[id].s[1] = g_entries[id].zh;
+                rows[id].s[2] = g_entries[id].en;
+            }
+            qsort(rows, n[t], sizeof(YbdRow), cmp_ybd_row);
+        } else {
+            n[t] = ybd_key_rows(YI_DICT_ZH, rows);
+        }
+        offs[t] = malloc((size_t)(ncols[t] + 1) * (n[t] + 1) * sizeof(uint32_t));
+        ybd_table(&pool, rows, n[t], ncols[t], offs[t]);
+    }
+    free(rows);
+
+    Buf body = { 0 };
+    YbdHeader hdr = { YBD_MAGIC, YBD_VERSION, YBD_TABLES, 0, (uint32_t)pool.len, g_nentries };
+    YbdTable tabs[YBD_TABLES];
+    buf_put(&body, &hdr, sizeof(hdr));
+    uint32_t tabs_off = buf_put(&body, tabs, sizeof(tabs));
+    for (int t = 0; t < YBD_TABLES; t++) {
+        tabs[t].id = (uint32_t)t;
+        tabs[t].n = n[t];
+        tabs[t].ncols = ncols[t];
+        tabs[t].offs_off = buf_put(&body, offs[t], (size_t)(ncols[t] + 1) * (n[t] + 1) * sizeof(uint32_t));
+        free(offs[t]);
+    }
+    hdr.pool_off = buf_put(&body, pool.data, pool.len);
+    memcpy(body.data, &hdr, sizeof(hdr));
+    memcpy(body.data + tabs_off, tabs, sizeof(tabs));
+    free(pool.data);
+
+    FILE *fo = fopen(out, "wb");
+    if (!fo) {
+        fprintf(stderr, "[DICT] 无法创建输出文件: %s\n", out);
+        return 1;
+    }
+    fwrite(body.data, 1, body.len, fo);
+    fclose(fo);
+    fprintf(stdout, "[DICT] 前端词典: 中→彝 %u, 彝→中/英 %u\n", n[YBD_ZH_YI], n[YBD_YI_ENTRY]);
+    fprintf(stdout, "[DICT] 输出: %s (%zu 字节)\n", out, body.len);
+    free(body.data);
+    return 0;
+}
+
+// ==================== 查询子命令 ====================
+
+static int parse_lang(const char *s) {
+    if (strcmp(s, "yi") == 0) return YI_DICT_YI;
+    if (strcmp(s, "zh") == 0) return YI_DICT_ZH;
+    if (strcmp(s, "en") == 0) return YI_DICT_EN;
+    return -1;
+}
+
+static void print_entry(const YiDict *d, uint32_t id) {
+    YiDictEntry e;
+    if (yi_dict_entry(d, id, &e) == 0) fprintf(stdout, "  #%u\t%s\t%s\t%s\n", id, e.yi, e.zh, e.en);
+}
+
+static void print_key(const YiDict *d, YiDictLang lang, const YiDictMatch *m) {
+    const uint32_t *ids;
+    uint32_t n = yi_dict_postings(d, lang, m->key, &ids);
+    fprintf(stdout, "%.*s", (int)m->len, m->text);
+    if (m->dist) fprintf(stdout, "  (距离 %d)", m->dist);
+    fprintf(stdout, "\n");
+    for (uint32_t i = 0; i < n && i < 8; i++) print_entry(d, ids[i]);
+}
+
+static int cmd_bench(const YiDict *d) {
+    // 用索引自身的键做查询负载：精确命中、前缀与模糊各测一轮
+    for (int lang = 0; lang < YI_DICT_LANGS; lang++) {
+        uint32_t nk = yi_dict_nkeys(d, (YiDictLang)lang);
+        if (!nk) continue;
+        int rounds = 200000 / (int)nk + 1;
+        uint64_t hits = 0;
+        double t0 = now_sec();
+        for (int r = 0; r < rounds; r++) {
+            for (uint32_t k = 0; k < nk; k++) {
+                YiDictMatch m;
+                yi_dict_key(d, (YiDictLang)lang, k, &m);
+                hits += yi_dict_find(d, (YiDictLang)lang, m.text, m.len) == (int64_t)k;
+            }
+        }
+        double t1 = now_sec();
+        uint64_t total = (uint64_t)rounds * nk;
+        uint32_t first;
+        uint64_t pref = 0;
+        for (uint32_t k = 0; k < nk; k++) {
+            YiDictMatch m;
+            yi_dict_key(d, (YiDictLang)lang, k, &m);
+            pref += yi_dict_prefix(d, (YiDictLang)lang, m.text, m.len < 3 ? m.len : 3, &first);
+        }
+        double t2 = now_sec();
+        YiDictMatch out[16];
+        uint32_t nf = nk < 200 ? nk : 200;
+        for (uint32_t k = 0; k < nf; k++) {
+            YiDictMatch m;
+            yi_dict_key(d, (YiDictLang)lang, k * (nk / nf), &m);
+            yi_dict_fuzzy(d, (YiDictLang)lang, m.text, m.len, 1, out, 16);
+        }
+        double t3 = now_sec();
+        fprintf(stdout, "[DICT] %s: %u 键, 精确 %.3f us/次 (命中 %llu/%llu), 前缀 %.3f us/次, 模糊(k=1) %.1f us/次\n",
+                lang == 0 ? "yi" : lang == 1 ? "zh" : "en", nk,
+                (t1 - t0) * 1e6 / total, (unsigned long long)hits, (unsigned long long)total,
+                (t2 - t1) * 1e6 / nk, (t3 - t2) * 1e6 / nf);
+        (void)pref;
+    }
+    return 0;
+}
+
+static void usage(void) {
+    fprintf(stderr, "用法:\n");
+    fprintf(stderr, "  yi_dict_tool build -o out.ydx <源文件(.csv/.json/.js)>...\n");
+    fprintf(stderr, "  yi_dict_tool web   -o out.ybd <源文件(.csv/.json/.js)>...\n");
+    fprintf(stderr, "  yi_dict_tool lookup <ydx> yi|zh|en <键>\n");
+    fprintf(stderr, "  yi_dict_tool prefix <ydx> yi|zh|en <前缀> [上限]\n");
+    fprintf(stderr, "  yi_dict_tool fuzzy  <ydx> yi|zh|en <查询> [距离]\n");
+    fprintf(stderr, "  yi_dict_tool bench  <ydx>\n");
+    fprintf(stderr, "  yi_dict_tool verify <ydx>\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) { usage(); return 1; }
+    const char *cmd = argv[1];
+    if (strcmp(cmd, "build") == 0) return cmd_build(argc - 2, argv + 2);
+    if (strcmp(cmd, "web") == 0) return cmd_web(argc - 2, argv + 2);
+
+    YiDict *d = yi_dict_open(argv[2]);
+    if (!d) {
+        fprintf(stderr, "[DICT] 无法打开索引: %s\n", argv[2]);
+        return 1;
+    }
+    int ret = 0;
+    if (strcmp(cmd, "verify") == 0) {
+        ret = yi_dict_verify(d) == 0 ? 0 : 1;
+        fprintf(stdout, "[DICT] 校验: %s (%u 条词条)\n", ret ? "FAIL" : "OK", yi_dict_size(d));
+    } else if (strcmp(cmd, "bench") == 0) {
+        ret = cmd_bench(d);
+    } else if (argc >= 5 && parse_lang(argv[3]) >= 0) {
+        YiDictLang lang = (YiDictLang)parse_lang(argv[3]);
+        const char *q = argv[4];
+        if (strcmp(cmd, "lookup") == 0) {
+            int64_t k = yi_dict_find(d, lang, q, strlen(q));
+            if (k < 0) { fprintf(stdout, "[DICT] 未找到: %s\n", q); ret = 1; }
+            else {
+                YiDictMatch m;
+                yi_dict_key(d, lang, (uint32_t)k, &m);
+                print_key(d, lang, &m);
+            }
+        } else if (strcmp(cmd, "prefix") == 0) {
+            uint32_t limit = argc >= 6 ? (uint32_t)atoi(argv[5]) : 20, first;
+            uint32_t n = yi_dict_prefix(d, lang, q, strlen(q), &first);
+            fprintf(stdout, "[DICT] 前缀 \"%s\": %u 个键\n", q, n);
+            for (uint32_t i = 0; i < n && i < limit; i++) {
+                YiDictMatch m;
+                yi_dict_key(d, lang, first + i, &m);
+                print_key(d, lang, &m);
+            }
+        } else if (strcmp(cmd, "fuzzy") == 0) {
+            int dist = argc >= 6 ? atoi(argv[5]) : 1;
+            YiDictMatch out[20];
+            int n = yi_dict_fuzzy(d, lang, q, strlen(q), dist, out, 20);
+            fprintf(stdout, "[DICT] 模糊 \"%s\" (距离<=%d): %d 个键\n", q, dist, n);
+            for (int i = 0; i < n; i++) print_key(d, lang, &out[i]);
+        } else {
+            usage();
+            ret = 1;
+        }
+    } else {
+        usage();
+        ret = 1;
+    }
+    yi_dict_close(d);
+    return ret;
+}
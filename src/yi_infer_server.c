@@ -0,0 +1,909 @@
+/*
+ * yi_infer_server.c — 本机批处理推理服务
+ *
+ * 给 web/apps/assistant、quantum-assistant 提供模型回答。只监听 127.0.0.1，
+ * 只服务 Host 为本机名的请求；跨域请求只认回环地址上的页面与 -O 给出的来源：
+ *   GET  /api/v21/health                 状态与已加载模型
+ *   POST /api/v21/chat      {message, model?}            → {response, model, confidence, ...}
+ *   POST /api/v21/translate {text, direction?, model?}   （/translate 同）→ {translated, ...}
+ *   POST /api/v21/run       {circuit, model?}            → 各基态概率与测量比特的 P(1)
+ *   GET  /api/v21/stats                  p50 / p99 延迟、吞吐、批大小、线路缓存命中
+ *
+ * - 模型：启动时 mmap 载入 .qck 检查点（src/qsm_ckpt.h），回答直接查 states 表：
+ *   对输入做最长匹配（彝文字 → 中文释义，中文词 → 彝文字）；
+ * - 线路缓存：检查点里的 BYTECODE 段启动时预解码；-q 目录下的 .qbc 首次用到时解码，
+ *   之后常驻内存（文件 mtime 变了才重读）；
+ * - 微批：连接线程把请求放进队列，批处理线程等到凑满 -B 个、最早一个请求已等了 -W 微秒，
+ *   或 -W/8 内没有新请求进来，就整批处理；同一批里相同的请求只算一次；
+ * - 自测：--selftest N 在同一进程里起服务、用 -c 个长连接客户端打 N 个请求，再打印统计，
+ *   完全离线。
+ *
+ * 用法: yi_infer_server [-p 8000] -m 名字=model.qck... [-q 线路目录] [-B 32] [-W 2000]
+ *                       [-O 来源]... [--selftest N [-c 16]]
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "qsm_ckpt.h"
+#include "qsm_jsonl.h"
+#include "qvm_exec.h"
+
+#define MAX_MODELS 8
+#define MAX_MATCH_CP 16
+#define MAX_QUBITS 16
+#define MAX_BODY (1 << 20)
+#define LAT_RING 8192
+#define TOP_STATES 8
+#define MAX_ORIGINS 8
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ==================== 输出缓冲 ====================
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+} Str;
+
+static void str_put(Str *s, const char *p, size_t n) {
+    if (s->len + n + 1 > s->cap) {
+        s->cap = s->cap ? s->cap : 256;
+        while (s->len + n + 1 > s->cap) s->cap *= 2;
+        s->data = realloc(s->data, s->cap);
+    }
+    memcpy(s->data + s->len, p, n);
+    s->len += n;
+    s->data[s->len] = '\0';
+}
+
+static void str_printf(Str *s, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void str_printf(Str *s, const char *fmt, ...) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n > 0) str_put(s, buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+static void str_json(Str *s, const char *p, size_t n) {
+    char *tmp = malloc(6 * n + 1);
+    size_t m = qsm_json_escape(p, n, tmp);
+    str_put(s, "\"", 1);
+    str_put(s, tmp, m);
+    str_put(s, "\"", 1);
+    free(tmp);
+}
+
+// ==================== 线路 ====================
+
+typedef struct {
+    char name[128];
+    char path[512];             // 来自 -q 目录时记下路径，用于检查 mtime
+    int64_t mtime_ns;
+    QvmCircuit qc;
+} Circuit;
+
+// 态矢量模拟，报告概率最大的几个基态与各经典寄存器为 1 的概率
+static void simulate(const Circuit *c, Str *out) {
+    QvmState st;
+    if (qvm_state_init(&st, c->qc.nqubits) != 0) {
+        str_printf(out, "\"error\":\"内存不足\"");
+        return;
+    }
+    qvm_run(&st, &c->qc);
+    size_t top[TOP_STATES];
+    int ntop = qvm_top(&st, top, TOP_STATES), nq = st.nqubits;
+    str_printf(out, "\"qubits\":%d,\"gates\":%d,\"probs\":{", nq, c->qc.ngates);
+    for (int t = 0; t < ntop; t++) {
+        char bits[QVM_MAX_QUBITS + 1];  // q0 在最右
+        for (int q = 0; q < nq; q++) bits[nq - 1 - q] = (top[t] >> q) & 1 ? '1' : '0';
+        bits[nq] = '\0';
+        str_printf(out, "%s\"%s\":%.6f", t ? "," : "", bits, qvm_prob(&st, top[t]));
+    }
+    str_put(out, "},\"measured\":{", 14);
+    int label[QVM_MAX_REGS], qs[QVM_MAX_REGS], nm = 0;
+    if (c->qc.regs) nm = qvm_outputs(&c->qc, label, qs);
+    for (int b = 0; b < nm; b++)
+        str_printf(out, "%s\"%d\":%.6f", b ? "," : "", label[b], qvm_prob_one(&st, qs[b]));
+    str_put(out, "}", 1);
+    qvm_state_free(&st);
+}
+
+// ==================== 模型 ====================
+
+typedef struct {
+    char name[64];
+    QsmCkpt *ck;
+    const QsmCkptEntry *keys, *targets, *conf;
+    const char *meta_name;
+    size_t meta_name_len;
+} Model;
+
+typedef struct {
+    Model models[MAX_MODELS];
+    int nmodels;
+    Circuit *circuits;          // 只由批处理线程访问
+    int ncircuits, circ_cap;
+    const char *circuit_dir;
+    int max_batch;
+    double max_wait;
+    const char *origins[MAX_ORIGINS];   // -O 额外允许的跨域来源
+    int norigins;
+    // 队列
+    pthread_mutex_t mu;
+    pthread_cond_t nonempty, done;
+    struct Job *head, *tail;
+    int depth;
+    double last_arrival;
+    atomic_int stop;
+    // 指标
+    double started;
+    uint64_t requests, batches, max_batch_seen, dedup, errors;
+    double lat[LAT_RING], lat_at[LAT_RING];
+    uint64_t lat_n;
+    atomic_ullong cache_hits, cache_misses;
+} Server;
+
+static Server g_srv;
+
+static Model *find_model(const char *name, size_t len) {
+    if (g_srv.nmodels == 0) return NULL;
+    if (!name || len == 0) return &g_srv.models[0];
+    for (int i = 0; i < g_srv.nmodels; i++)
+        if (strlen(g_srv.models[i].name) == len && memcmp(g_srv.models[i].name, name, len) == 0) return &g_srv.models[i];
+    return NULL;
+}
+
+static Circuit *add_circuit(void) {
+    if (g_srv.ncircuits == g_srv.circ_cap) {
+        g_srv.circ_cap = g_srv.circ_cap ? g_srv.circ_cap * 2 : 16;
+        g_srv.circuits = realloc(g_srv.circuits, g_srv.circ_cap * sizeof(Circuit));
+    }
+    Circuit *c = &g_srv.circuits[g_srv.ncircuits++];
+    memset(c, 0, sizeof(*c));
+    return c;
+}
+
+static int load_model(const char *arg) {
+    const char *eq = strchr(arg, '=');
+    if (!eq || eq == arg || (size_t)(eq - arg) >= sizeof(g_srv.models[0].name) || g_srv.nmodels == MAX_MODELS) return -1;
+    Model *m = &g_srv.models[g_srv.nmodels];
+    memset(m, 0, sizeof(*m));
+    memcpy(m->name, arg, (size_t)(eq - arg));
+    const char *err;
+    m->ck = qsm_ckpt_open(eq + 1, QSM_CKPT_VERIFY, &err);
+    if (!m->ck) {
+        fprintf(stderr, "[INFER] %s: %s\n", eq + 1, err);
+        return -1;
+    }
+    m->keys = qsm_ckpt_find(m->ck, QSM_CKPT_VOCAB, "states.key");
+    m->targets = qsm_ckpt_find(m->ck, QSM_CKPT_VOCAB, "states.target");
+    m->conf = qsm_ckpt_find(m->ck, QSM_CKPT_TENSOR, "states.confidence");
+    if (!m->keys || !m->targets || !m->conf) {
+        fprintf(stderr, "[INFER] %s: 缺少 states 表\n", eq + 1);
+        qsm_ckpt_close(m->ck);
+        return -1;
+    }
+    m->meta_name = qsm_ckpt_meta(m->ck, "name", &m->meta_name_len);
+    // 检查点里的线路启动时就预解码
+    for (uint32_t i = 0; i < qsm_ckpt_count(m->ck); i++) {
+        const QsmCkptEntry *e = qsm_ckpt_entry(m->ck, i);
+        if (e->kind != QSM_CKPT_BYTECODE) continue;
+        Circuit *c = add_circuit();
+        snprintf(c->name, sizeof(c->name), "%s/%s", m->name, e->name);
+        if (qvm_decode(qsm_ckpt_data(m->ck, e), e->size, MAX_QUBITS, &c->qc) != 0) g_srv.ncircuits--;
+    }
+    g_srv.nmodels++;
+    return 0;
+}
+
+// 最长匹配：彝文字输出中文释义（" | " 之前），中文词输出彝文字
+static void answer(const Model *m, const char *text, size_t len, int want_yi, Str *out, double *conf, double *coverage) {
+    const QsmCkpt *ck = m->ck;
+    const float *cf = qsm_ckpt_data(ck, m->conf);
+    size_t ncp = 0, matched_cp = 0, nmatch = 0;
+    double csum = 0;
+    const char *end = text + len;
+    const char *pos[MAX_MATCH_CP + 1];
+    for (const char *p = text; p < end;) {
+        // 向后最多取 MAX_MATCH_CP 个码点
+        int k = 0;
+        const char *q = p;
+        pos[0] = p;
+        while (k < MAX_MATCH_CP && q < end) {
+            uint32_t cp;
+            q += qsm_utf8_next(q, end, &cp);
+            pos[++k] = q;
+        }
+        int hit = 0;
+        for (int l = k; l >= 1 && !hit; l--) {
+            int64_t id = qsm_ckpt_vocab_find(ck, m->keys, p, (size_t)(pos[l] - p));
+            if (id < 0) continue;
+            size_t tl;
+            const char *t = qsm_ckpt_vocab_get(ck, m->targets, (uint32_t)id, &tl);
+            uint32_t first;
+            qsm_utf8_next(t, t + tl, &first);
+            int target_yi = qsm_is_yi_pua(first);
+            if (want_yi >= 0 && target_yi != want_yi) continue;
+            const char *bar = target_yi ? NULL : memmem(t, tl, " | ", 3);
+            if (out->len && !target_yi) str_put(out, " ", 1);
+            str_put(out, t, bar ? (size_t)(bar - t) : tl);
+            csum += cf[id];
+            nmatch++;
+            matched_cp += (size_t)l;
+            ncp += (size_t)l;
+            p = pos[l];
+            hit = 1;
+        }
+        if (!hit) {
+            str_put(out, p, (size_t)(pos[1] - p));
+            ncp++;
+            p = pos[1];
+        }
+    }
+    *conf = nmatch ? csum / (double)nmatch : 0;
+    *coverage = ncp ? (double)matched_cp / (double)ncp : 0;
+}
+
+// ==================== 请求与批处理 ====================
+
+enum { JOB_CHAT, JOB_TRANSLATE, JOB_RUN };
+
+typedef struct Job {
+    int kind;
+    Model *model;
+    char *text;
+    size_t len;
+    int want_yi;                // -1 自动，0 要中文，1 要彝文
+    uint64_t key;               // 同批去重
+    double arrived;
+    Str out;
+    int status;
+    int done;
+    struct Job *next;
+} Job;
+
+static Circuit *find_circuit(const char *name, size_t len) {
+    char nm[128];
+    if (len == 0 || len >= sizeof(nm)) return NULL;
+    memcpy(nm, name, len);
+    nm[len] = '\0';
+    for (int i = 0; i < g_srv.ncircuits; i++) {
+        Circuit *c = &g_srv.circuits[i];
+        if (strcmp(c->name, nm) != 0) continue;
+        if (!c->path[0]) { atomic_fetch_add(&g_srv.cache_hits, 1); return c; }
+        struct stat st;
+        if (stat(c->path, &st) == 0 &&
+            (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec == c->mtime_ns) {
+            atomic_fetch_add(&g_srv.cache_hits, 1);
+            return c;
+        }
+        // 文件改过：丢掉旧的解码结果重读
+        qvm_circuit_free(&c->qc);
+        g_srv.circuits[i] = g_srv.circuits[--g_srv.ncircuits];
+        break;
+    }
+    if (!g_srv.circuit_dir || strchr(nm, '/') || nm[0] == '.') return NULL;
+    atomic_fetch_add(&g_srv.cache_misses, 1);
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s.qbc", g_srv.circuit_dir, nm);
+    QsmMap map;
+    struct stat st;
+    if (stat(path, &st) != 0 || qsm_map_file(path, &map) != 0) return NULL;
+    Circuit *c = add_circuit();
+    snprintf(c->name, sizeof(c->name), "%s", nm);
+    snprintf(c->path, sizeof(c->path), "%s", path);
+    c->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    int r = qvm_decode((const uint8_t *)map.data, map.size, MAX_QUBITS, &c->qc);
+    qsm_unmap_file(&map);
+    if (r != 0) {
+        g_srv.ncircuits--;
+        return NULL;
+    }
+    return c;
+}
+
+static void run_job(Job *j) {
+    Str *o = &j->out;
+    j->status = 200;
+    if (j->kind == JOB_RUN) {
+        Circuit *c = find_circuit(j->text, j->len);
+        if (!c) {
+            j->status = 404;
+            str_put(o, "{\"error\":\"线路不存在或无法解码\"}", strlen("{\"error\":\"线路不存在或无法解码\"}"));
+            return;
+        }
+        str_put(o, "{\"circuit\":", 11);
+        str_json(o, c->name, strlen(c->name));
+        str_put(o, ",", 1);
+        simulate(c, o);
+        str_put(o, "}", 1);
+        return;
+    }
+    Str ans = { 0 };
+    double conf, coverage;
+    answer(j->model, j->text, j->len, j->want_yi, &ans, &conf, &coverage);
+    str_put(o, j->kind == JOB_CHAT ? "{\"response\":" : "{\"translated\":", j->kind == JOB_CHAT ? 12 : 14);
+    str_json(o, ans.data ? ans.data : "", ans.len);
+    str_put(o, ",\"model\":", 9);
+    if (j->model->meta_name) str_json(o, j->model->meta_name, j->model->meta_name_len);
+    else str_json(o, j->model->name, strlen(j->model->name));
+    str_printf(o, ",\"confidence\":%.4f,\"coverage\":%.4f}", conf, coverage);
+    free(ans.data);
+}
+
+static uint64_t job_key(const Job *j) {
+    uint64_t h = qsm_hash64(j->text, j->len, (uint64_t)j->kind * 131 + (uint64_t)(j->want_yi + 1));
+    return qsm_mix64(h ^ (uint64_t)(uintptr_t)j->model);
+}
+
+static void *batch_thread(void *arg) {
+    (void)arg;
+    Job **batch = malloc(g_srv.max_batch * sizeof(Job *));
+    pthread_mutex_lock(&g_srv.mu);
+    for (;;) {
+        while (!g_srv.head && !atomic_load(&g_srv.stop)) pthread_cond_wait(&g_srv.nonempty, &g_srv.mu);
+        if (!g_srv.head) break;
+        // 延迟上限：从队首请求到达起最多再等 max_wait；
+        // 若已有 max_wait/8 没有新请求进来，说明这一波已到齐，不必等满
+        double deadline = g_srv.head->arrived + g_srv.max_wait;
+        while (g_srv.depth < g_srv.max_batch && !atomic_load(&g_srv.stop)) {
+            double idle = g_srv.last_arrival + g_srv.max_wait / 8;
+            double left = (idle < deadline ? idle : deadline) - now_sec();
+            if (left <= 0) break;
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            long ns = ts.tv_nsec + (long)(left * 1e9);
+            ts.tv_sec += ns / 1000000000L;
+            ts.tv_nsec = ns % 1000000000L;
+            pthread_cond_timedwait(&g_srv.nonempty, &g_srv.mu, &ts);
+        }
+        int n = 0;
+        while (g_srv.head && n < g_srv.max_batch) {
+            batch[n++] = g_srv.head;
+            g_srv.head = g_srv.head->next;
+            g_srv.depth--;
+        }
+        if (!g_srv.head) g_srv.tail = NULL;
+        pthread_mutex_unlock(&g_srv.mu);
+
+        uint64_t dedup = 0;
+        for (int i = 0; i < n; i++) {
+            Job *j = batch[i];
+            j->key = job_key(j);
+            int k = 0;
+            for (; k < i; k++)
+                if (batch[k]->key == j->key && batch[k]->len == j->len && memcmp(batch[k]->text, j->text, j->len) == 0) break;
+            if (k < i) {
+                j->status = batch[k]->status;
+                str_put(&j->out, batch[k]->out.data, batch[k]->out.len);
+                dedup++;
+            } else {
+                run_job(j);
+            }
+        }
+
+        pthread_mutex_lock(&g_srv.mu);
+        double t = now_sec();
+        for (int i = 0; i < n; i++) {
+            Job *j = batch[i];
+            g_srv.lat[g_srv.lat_n % LAT_RING] = t - j->arrived;
+            g_srv.lat_at[g_srv.lat_n % LAT_RING] = t;
+            g_srv.lat_n++;
+            if (j->status != 200) g_srv.errors++;
+            j->done = 1;
+        }
+        g_srv.requests += (uint64_t)n;
+        g_srv.batches++;
+        g_srv.dedup += dedup;
+        if ((uint64_t)n > g_srv.max_batch_seen) g_srv.max_batch_seen = (uint64_t)n;
+        pthread_cond_broadcast(&g_srv.done);
+    }
+    pthread_mutex_unlock(&g_srv.mu);
+    free(batch);
+    return NULL;
+}
+
+static void submit_and_wait(Job *j) {
+    j->arrived = now_sec();
+    pthread_mutex_lock(&g_srv.mu);
+    if (g_srv.tail) g_srv.tail->next = j;
+    else g_srv.head = j;
+    g_srv.tail = j;
+    g_srv.depth++;
+    g_srv.last_arrival = j->arrived;
+    if (g_srv.depth == 1 || g_srv.depth >= g_srv.max_batch) pthread_cond_signal(&g_srv.nonempty);
+    while (!j->done) pthread_cond_wait(&g_srv.done, &g_srv.mu);
+    pthread_mutex_unlock(&g_srv.mu);
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void stats_json(Str *o) {
+    pthread_mutex_lock(&g_srv.mu);
+    size_t n = g_srv.lat_n < LAT_RING ? (size_t)g_srv.lat_n : LAT_RING;
+    double *v = malloc((n ? n : 1) * sizeof(double));
+    double t = now_sec();
+    size_t recent = 0;
+    for (size_t i = 0; i < n; i++) {
+        v[i] = g_srv.lat[i];
+        recent += t - g_srv.lat_at[i] <= 10.0;
+    }
+    uint64_t requests = g_srv.requests, batches = g_srv.batches, maxb = g_srv.max_batch_seen;
+    uint64_t dedup = g_srv.dedup, errors = g_srv.errors;
+    int depth = g_srv.depth, ncirc = g_srv.ncircuits;
+    pthread_mutex_unlock(&g_srv.mu);
+    qsort(v, n, sizeof(double), cmp_double);
+    double up = t - g_srv.started;
+    double p50 = n ? v[n / 2] : 0, p99 = n ? v[(size_t)((double)(n - 1) * 0.99)] : 0, mx = n ? v[n - 1] : 0;
+    str_printf(o, "{\"uptime_s\":%.1f,\"requests\":%llu,\"errors\":%llu,\"batches\":%llu,"
+               "\"avg_batch\":%.2f,\"max_batch\":%llu,\"dedup\":%llu,\"queue_depth\":%d,",
+               up, (unsigned long long)requests, (unsigned long long)errors, (unsigned long long)batches,
+               batches ? (double)requests / (double)batches : 0, (unsigned long long)maxb,
+               (unsigned long long)dedup, depth);
+    str_printf(o, "\"latency_ms\":{\"p50\":%.3f,\"p99\":%.3f,\"max\":%.3f,\"window\":%zu},",
+               p50 * 1e3, p99 * 1e3, mx * 1e3, n);
+    str_printf(o, "\"throughput_rps\":{\"total\":%.1f,\"last_10s\":%.1f},",
+               up > 0 ? (double)requests / up : 0, (double)recent / (up < 10 ? (up > 0 ? up : 1) : 10));
+    str_printf(o, "\"circuit_cache\":{\"entries\":%d,\"hits\":%llu,\"misses\":%llu}}", ncirc,
+               (unsigned long long)atomic_load(&g_srv.cache_hits), (unsigned long long)atomic_load(&g_srv.cache_misses));
+    free(v);
+}
+
+// ==================== HTTP ====================
+
+typedef struct {
+    const char *message, *text, *direction, *model, *circuit;
+    size_t message_len, text_len, direction_len, model_len, circuit_len;
+    char *buf;                  // 反转义后的字符串都放在这里
+    size_t used, cap;
+} Body;
+
+static int on_field(void *ud, const char *key, size_t klen, const char *raw, size_t rlen, int depth) {
+    Body *b = ud;
+    if (depth != 1 || !key) return 0;
+    const char **dst = NULL;
+    size_t *dlen = NULL;
+    if (klen == 7 && memcmp(key, "message", 7) == 0) { dst = &b->message; dlen = &b->message_len; }
+    else if (klen == 4 && memcmp(key, "text", 4) == 0) { dst = &b->text; dlen = &b->text_len; }
+    else if (klen == 9 && memcmp(key, "direction", 9) == 0) { dst = &b->direction; dlen = &b->direction_len; }
+    else if (klen == 5 && memcmp(key, "model", 5) == 0) { dst = &b->model; dlen = &b->model_len; }
+    else if (klen == 7 && memcmp(key, "circuit", 7) == 0) { dst = &b->circuit; dlen = &b->circuit_len; }
+    if (!dst || b->used + rlen + 1 > b->cap) return 0;
+    char *s = b->buf + b->used;
+    *dlen = qsm_json_unescape(raw, rlen, s);
+    s[*dlen] = '\0';
+    *dst = s;
+    b->used += *dlen + 1;
+    return 0;
+}
+
+static int send_all(int fd, const char *p, size_t n) {
+    while (n) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0) {
+            if (w < 0 && errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+typedef struct {
+    int fd;
+    int keep;
+    char origin[256];           // 通过检查的 Origin，回显给浏览器；没带 Origin 时为空
+} Conn;
+
+// Host 或 Origin 里的 host[:port] 是否是本机回环地址
+static int is_loopback_host(const char *h, size_t n) {
+    size_t l = n;
+    if (n && h[0] == '[') {
+        const char *e = memchr(h, ']', n);
+        l = e ? (size_t)(e - h) + 1 : n;
+    } else {
+        const char *e = memchr(h, ':', n);
+        if (e) l = (size_t)(e - h);
+    }
+    if (l < n && h[l] != ':') return 0;
+    return (l == 9 && strncasecmp(h, "localhost", 9) == 0) || (l == 9 && memcmp(h, "127.0.0.1", 9) == 0) ||
+           (l == 5 && memcmp(h, "[::1]", 5) == 0);
+}
+
+static int origin_allowed(const char *o, size_t n) {
+    for (int i = 0; i < g_srv.norigins; i++)
+        if (strlen(g_srv.origins[i]) == n && memcmp(g_srv.origins[i], o, n) == 0) return 1;
+    if (n > 7 && memcmp(o, "http://", 7) == 0) return is_loopback_host(o + 7, n - 7);
+    if (n > 8 && memcmp(o, "https://", 8) == 0) return is_loopback_host(o + 8, n - 8);
+    return 0;
+}
+
+static int respond(Conn *c, int status, const char *body, size_t n) {
+    const char *reason = status == 200 ? "OK" : status == 204 ? "No Content" : status == 400 ? "Bad Request"
+                       : status == 403 ? "Forbidden" : status == 404 ? "Not Found"
+                       : status == 413 ? "Payload Too Large" : "Error";
+    char cors[512] = "", hdr[1024];
+    if (c->origin[0])
+        snprintf(cors, sizeof(cors), "Access-Control-Allow-Origin: %s\r\nVary: Origin\r\n"
+                 "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\nAccess-Control-Allow-Headers: Content-Type\r\n",
+                 c->origin);
+    int h = snprintf(hdr, sizeof(hdr),
+                     "HTTP/1.1 %d %s\r\nContent-Type: application/json; charset=utf-8\r\nContent-Length: %zu\r\n"
+                     "%sConnection: %s\r\n\r\n", status, reason, n, cors, c->keep ? "keep-alive" : "close");
+    if (send_all(c->fd, hdr, (size_t)h) != 0) return -1;
+    return n ? send_all(c->fd, body, n) : 0;
+}
+
+static int error_json(Conn *c, int status, const char *msg) {
+    Str o = { 0 };
+    str_put(&o, "{\"error\":", 9);
+    str_json(&o, msg, strlen(msg));
+    str_put(&o, "}", 1);
+    int r = respond(c, status, o.data, o.len);
+    free(o.data);
+    return r;
+}
+
+static int handle(Conn *c, const char *method, const char *path, const char *body, size_t blen) {
+    if (strcmp(method, "OPTIONS") == 0) return respond(c, 204, NULL, 0);
+    Str o = { 0 };
+    int r;
+    if (strcmp(method, "GET") == 0 && strcmp(path, "/api/v21/health") == 0) {
+        str_printf(&o, "{\"status\":\"ok\",\"architecture\":\"QEntL 原生批处理推理\",\"on_qvm\":false,\"models\":[");
+        for (int i = 0; i < g_srv.nmodels; i++) {
+            if (i) str_put(&o, ",", 1);
+            str_json(&o, g_srv.models[i].name, strlen(g_srv.models[i].name));
+        }
+        str_put(&o, "]}", 2);
+        r = respond(c, 200, o.data, o.len);
+        free(o.data);
+        return r;
+    }
+    if (strcmp(method, "GET") == 0 && strcmp(path, "/api/v21/stats") == 0) {
+        stats_json(&o);
+        r = respond(c, 200, o.data, o.len);
+        free(o.data);
+        return r;
+    }
+    if (strcmp(method, "POST") != 0) return error_json(c, 404, "未知接口");
+    int kind;
+    if (strcmp(path, "/api/v21/chat") == 0) kind = JOB_CHAT;
+    else if (strcmp(path, "/api/v21/translate") == 0 || strcmp(path, "/translate") == 0) kind = JOB_TRANSLATE;
+    else if (strcmp(path, "/api/v21/run") == 0) kind = JOB_RUN;
+    else return error_json(c, 404, "未知接口");
+
+    Body b;
+    memset(&b, 0, sizeof(b));
+    b.cap = blen + 16;
+    b.buf = malloc(b.cap);
+    if (qsm_json_scan(body, body + blen, on_field, &b) < 0) {
+        free(b.buf);
+        return error_json(c, 400, "请求体不是有效 JSON");
+    }
+    Job j;
+    memset(&j, 0, sizeof(j));
+    j.kind = kind;
+    j.want_yi = -1;
+    j.model = find_model(b.model, b.model_len);
+    if (kind == JOB_CHAT) { j.text = (char *)b.message; j.len = b.message_len; }
+    else if (kind == JOB_TRANSLATE) {
+        j.text = (char *)b.text;
+        j.len = b.text_len;
+        if (b.direction && strcmp(b.direction, "zh2yi") == 0) j.want_yi = 1;
+        else if (b.direction && strcmp(b.direction, "yi2zh") == 0) j.want_yi = 0;
+    } else { j.text = (char *)b.circuit; j.len = b.circuit_len; }
+    const char *bad = !j.text ? "缺少输入字段" : kind != JOB_RUN && !j.model ? "模型不存在" : NULL;
+    if (bad) {
+        free(b.buf);
+        return error_json(c, 400, bad);
+    }
+    submit_and_wait(&j);
+    r = respond(c, j.status, j.out.data, j.out.len);
+    free(j.out.data);
+    free(b.buf);
+    return r;
+}
+
+static void *conn_thread(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    size_t cap = 64 * 1024, have = 0;
+    char *buf = malloc(cap + 1);
+    for (;;) {
+        // 读到头部结束
+        char *hend = NULL;
+        while (!(hend = have ? memmem(buf, have, "\r\n\r\n", 4) : NULL)) {
+            if (have == cap) goto out;
+            ssize_t r = recv(fd, buf + have, cap - have, 0);
+            if (r <= 0) goto out;
+            have += (size_t)r;
+        }
+        *hend = '\0';
+        char method[16], path[256];
+        if (sscanf(buf, "%15s %255s", method, path) != 2) break;
+        size_t clen = 0;
+        Conn c = { .fd = fd, .keep = strstr(buf, "HTTP/1.1") != NULL };
+        const char *deny = NULL;
+        for (char *line = strstr(buf, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+            if (strncasecmp(line + 2, "Content-Length:", 15) == 0) clen = strtoul(line + 17, NULL, 10);
+            else if (strncasecmp(line + 2, "Connection:", 11) == 0) {
+                const char *v = line + 13;
+                while (*v == ' ') v++;
+                if (strncasecmp(v, "close", 5) == 0) c.keep = 0;
+                else if (strncasecmp(v, "keep-alive", 10) == 0) c.keep = 1;
+            } else if (strncasecmp(line + 2, "Host:", 5) == 0) {
+                // 其他域名解析到 127.0.0.1（DNS 重绑定）时 Host 是那个域名
+                const char *v = line + 7;
+                while (*v == ' ') v++;
+                size_t n = strcspn(v, "\r ");
+                if (!is_loopback_host(v, n)) deny = "Host 不是本机";
+            } else if (strncasecmp(line + 2, "Origin:", 7) == 0) {
+                const char *v = line + 9;
+                while (*v == ' ') v++;
+                size_t n = strcspn(v, "\r ");
+                if (origin_allowed(v, n) && n < sizeof(c.origin)) snprintf(c.origin, sizeof(c.origin), "%.*s", (int)n, v);
+                else deny = "来源不在允许列表";
+            }
+        }
+        if (deny) {
+            c.origin[0] = '\0';
+            c.keep = 0;
+            error_json(&c, 403, deny);
+            break;
+        }
+        char *q = strchr(path, '?');
+        if (q) *q = '\0';
+        size_t hlen = (size_t)(hend - buf) + 4;
+        if (clen > MAX_BODY) {
+            c.keep = 0;
+            error_json(&c, 413, "请求体过大");
+            break;
+        }
+        if (hlen + clen > cap) {
+            cap = hlen + clen;
+            buf = realloc(buf, cap + 1);
+        }
+        while (have < hlen + clen) {
+            ssize_t r = recv(fd, buf + have, cap - have, 0);
+            if (r <= 0) goto out;
+            have += (size_t)r;
+        }
+        if (handle(&c, method, path, buf + hlen, clen) != 0 || !c.keep) break;
+        memmove(buf, buf + hlen + clen, have - hlen - clen);
+        have -= hlen + clen;
+    }
+out:
+    close(fd);
+    free(buf);
+    return NULL;
+}
+
+static void *accept_thread(void *arg) {
+    int lfd = (int)(intptr_t)arg;
+    for (;;) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        pthread_t th;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        pthread_attr_setstacksize(&attr, 256 * 1024);
+        if (pthread_create(&th, &attr, conn_thread, (void *)(intptr_t)fd) != 0) close(fd);
+        pthread_attr_destroy(&attr);
+    }
+    return NULL;
+}
+
+// ==================== 自测客户端 ====================
+
+typedef struct {
+    int port;
+    int n;
+    int id;
+    int failures;
+    double *lat;
+    char (*circuits)[128];      // 开始前拷一份线路名，批处理线程会改缓存
+    int ncircuits;
+} Client;
+
+static int http_call(int fd, const char *method, const char *path, const char *body, char *resp, size_t cap) {
+    char req[2048];
+    int n = snprintf(req, sizeof(req), "%s %s HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Type: application/json\r\n"
+                     "Content-Length: %zu\r\n\r\n%s", method, path, body ? strlen(body) : 0, body ? body : "");
+    if (send_all(fd, req, (size_t)n) != 0) return -1;
+    size_t have = 0;
+    char *hend;
+    while (!(hend = have ? memmem(resp, have, "\r\n\r\n", 4) : NULL)) {
+        ssize_t r = recv(fd, resp + have, cap - 1 - have, 0);
+        if (r <= 0) return -1;
+        have += (size_t)r;
+    }
+    resp[have] = '\0';
+    const char *cl = strcasestr(resp, "Content-Length:");
+    size_t need = (size_t)(hend - resp) + 4 + (cl ? strtoul(cl + 15, NULL, 10) : 0);
+    while (have < need && have < cap - 1) {
+        ssize_t r = recv(fd, resp + have, cap - 1 - have, 0);
+        if (r <= 0) return -1;
+        have += (size_t)r;
+    }
+    resp[have] = '\0';
+    return atoi(resp + 9);
+}
+
+static int connect_local(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&a, sizeof(a)) != 0) { close(fd); return -1; }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static void *client_thread(void *arg) {
+    Client *c = arg;
+    int fd = connect_local(c->port);
+    if (fd < 0) { c->failures = c->n; return NULL; }
+    const Model *m = &g_srv.models[0];
+    uint32_t nkeys = qsm_ckpt_vocab_size(m->ck, m->keys);
+    char *resp = malloc(1 << 16);
+    uint64_t rng = qsm_mix64((uint64_t)c->id + 1);
+    for (int i = 0; i < c->n; i++) {
+        char body[1024], esc[900];
+        const char *path;
+        rng = qsm_mix64(rng);
+        if (c->ncircuits && i % 8 == 7) {
+            const char *name = c->circuits[rng % (uint64_t)c->ncircuits];
+            size_t e = qsm_json_escape(name, strlen(name), esc);
+            snprintf(body, sizeof(body), "{\"circuit\":\"%.*s\"}", (int)e, esc);
+            path = "/api/v21/run";
+        } else {
+            // 从模型自己的 states 表里挑 1~3 个词拼成问题，保证能命中
+            size_t e = 0;
+            int words = 1 + (int)(rng % 3);
+            for (int w = 0; w < words; w++) {
+                size_t len;
+                const char *k = qsm_ckpt_vocab_get(m->ck, m->keys, (uint32_t)(qsm_mix64(rng + (uint64_t)w) % nkeys), &len);
+                if (e + 6 * len < sizeof(esc)) e += qsm_json_escape(k, len, esc + e);
+            }
+            snprintf(body, sizeof(body), "{\"message\":\"%.*s\"}", (int)e, esc);
+            path = "/api/v21/chat";
+        }
+        double t0 = now_sec();
+        int st = http_call(fd, "POST", path, body, resp, 1 << 16);
+        c->lat[i] = now_sec() - t0;
+        if (st != 200) c->failures++;
+        if (st < 0) break;
+    }
+    free(resp);
+    close(fd);
+    return NULL;
+}
+
+static int selftest(int port, int total, int nclients) {
+    if (nclients < 1) nclients = 1;
+    Client *cs = calloc(nclients, sizeof(Client));
+    pthread_t *th = malloc(nclients * sizeof(pthread_t));
+    int ncirc = g_srv.ncircuits;
+    char (*names)[128] = malloc((ncirc ? ncirc : 1) * sizeof(*names));
+    for (int i = 0; i < ncirc; i++) memcpy(names[i], g_srv.circuits[i].name, sizeof(names[i]));
+    double t0 = now_sec();
+    for (int i = 0; i < nclients; i++) {
+        cs[i].port = port;
+        cs[i].id = i;
+        cs[i].n = total / nclients + (i < total % nclients);
+        cs[i].lat = calloc(cs[i].n ? cs[i].n : 1, sizeof(double));
+        cs[i].circuits = names;
+        cs[i].ncircuits = ncirc;
+        pthread_create(&th[i], NULL, client_thread, &cs[i]);
+    }
+    int failures = 0, n = 0;
+    double *all = malloc((total ? total : 1) * sizeof(double));
+    for (int i = 0; i < nclients; i++) {
+        pthread_join(th[i], NULL);
+        failures += cs[i].failures;
+        memcpy(all + n, cs[i].lat, cs[i].n * sizeof(double));
+        n += cs[i].n;
+        free(cs[i].lat);
+    }
+    double el = now_sec() - t0;
+    qsort(all, n, sizeof(double), cmp_double);
+    fprintf(stdout, "[INFER] 自测: %d 个请求, %d 个连接, 失败 %d, %.2fs (%.0f 请求/秒), 客户端 p50 %.3f ms, p99 %.3f ms\n",
+            n, nclients, failures, el, n / el, n ? all[n / 2] * 1e3 : 0, n ? all[(size_t)((n - 1) * 0.99)] * 1e3 : 0);
+    int fd = connect_local(port);
+    char *resp = malloc(1 << 16);
+    if (fd >= 0 && http_call(fd, "GET", "/api/v21/stats", NULL, resp, 1 << 16) == 200)
+        fprintf(stdout, "[INFER] 服务端: %s\n", strstr(resp, "\r\n\r\n") + 4);
+    if (fd >= 0) close(fd);
+    free(resp);
+    free(all);
+    free(names);
+    free(cs);
+    free(th);
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    int port = 8000, selftest_n = 0, clients = 16;
+    g_srv.max_batch = 32;
+    g_srv.max_wait = 2000e-6;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (i + 1 >= argc) goto usage;
+        if (strcmp(a, "-p") == 0) port = atoi(argv[++i]);
+        else if (strcmp(a, "-m") == 0) { if (load_model(argv[++i]) != 0) return 1; }
+        else if (strcmp(a, "-q") == 0) g_srv.circuit_dir = argv[++i];
+        else if (strcmp(a, "-B") == 0) g_srv.max_batch = atoi(argv[++i]);
+        else if (strcmp(a, "-W") == 0) g_srv.max_wait = atof(argv[++i]) * 1e-6;
+        else if (strcmp(a, "--selftest") == 0) selftest_n = atoi(argv[++i]);
+        else if (strcmp(a, "-c") == 0) clients = atoi(argv[++i]);
+        else if (strcmp(a, "-O") == 0 && g_srv.norigins < MAX_ORIGINS) g_srv.origins[g_srv.norigins++] = argv[++i];
+        else goto usage;
+    }
+    if (g_srv.nmodels == 0 || g_srv.max_batch < 1) goto usage;
+
+    signal(SIGPIPE, SIG_IGN);
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)(selftest_n ? 0 : port)) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, 128) != 0 ||
+        getsockname(lfd, (struct sockaddr *)&addr, &alen) != 0) {
+        fprintf(stderr, "[INFER] 无法监听 127.0.0.1:%d: %s\n", port, strerror(errno));
+        return 1;
+    }
+    port = ntohs(addr.sin_port);
+
+    pthread_mutex_init(&g_srv.mu, NULL);
+    pthread_cond_init(&g_srv.nonempty, NULL);
+    pthread_cond_init(&g_srv.done, NULL);
+    atomic_init(&g_srv.stop, 0);
+    g_srv.started = now_sec();
+    pthread_t bt, at;
+    pthread_create(&bt, NULL, batch_thread, NULL);
+    pthread_create(&at, NULL, accept_thread, (void *)(intptr_t)lfd);
+    fprintf(stdout, "[INFER] 监听 127.0.0.1:%d, %d 个模型, %d 条预解码线路, 微批 %d / %.1f ms\n",
+            port, g_srv.nmodels, g_srv.ncircuits, g_srv.max_batch, g_srv.max_wait * 1e3);
+    fflush(stdout);
+    if (selftest_n > 0) return selftest(port, selftest_n, clients);
+    pthread_join(at, NULL);
+    return 0;
+
+usage:
+    fprintf(stderr, "用法: %s [-p 8000] -m 名字=model.qck... [-q 线路目录] [-B 32] [-W 2000] [-O 来源]... [--selftest N [-c 16]]\n", argv[0]);
+    fprintf(stderr, "\n本机批处理推理服务：载入 .qck 检查点，按 -B 个请求或 -W 微秒的延迟上限组成微批，\n");
+    fprintf(stderr, "/api/v21/stats 报告 p50 / p99 延迟与吞吐；--selftest 离线自测\n");
+    fprintf(stderr, "浏览器跨域只放行本机回环地址上的页面，-O 来源 可再加（可重复）\n");
+    return 1;
+}
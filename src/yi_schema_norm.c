@@ -0,0 +1,427 @@
+/*
+ * yi_schema_norm.c — 语料记录格式统一
+ *
+ * 语料里混着几种记录格式：
+ *   {"messages": [{"role": ..., "content": ...}, ...]}        主力格式
+ *   {"input": ..., "output": ...}（另有 instruction / lang / zh / note 等字段）
+ *   {"original": ..., "translated": ...}
+ *   {"text": ...}
+ * 这里把每条记录都改写成 messages 格式，其余顶层字符串字段收进 "meta"，
+ * 训练端只需认一种格式：
+ *   {"messages": [{"role": "user", "content": ...}, {"role": "assistant", "content": ...}], "meta": {...}}
+ *
+ * 字符串值直接从 mmap 中的原始切片拷贝，不反转义；只有含非规范转义
+ * （如 \uXXXX、\/）的字符串才反转义后按 qsm_json_escape 重新转义。
+ * 输入按行对齐切块并行处理，各块结果按原顺序边完成边写出，输出与线程数无关；
+ * 内存里只挂着有限个块的结果，不随语料大小增长。
+ *
+ * 用法: yi_schema_norm [-t 线程] [--no-meta] -o <输出目录|输出.jsonl> <目录|文件>...
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "qsm_jsonl.h"
+
+#define MAX_MSGS 64
+#define MAX_META 16
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ==================== 输出缓冲 ====================
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+} OutBuf;
+
+static char *ob_reserve(OutBuf *b, size_t n) {
+    if (b->len + n > b->cap) {
+        b->cap = b->cap ? b->cap : 1 << 16;
+        while (b->len + n > b->cap) b->cap *= 2;
+        b->data = realloc(b->data, b->cap);
+    }
+    return b->data + b->len;
+}
+
+static void ob_put(OutBuf *b, const char *s, size_t n) {
+    memcpy(ob_reserve(b, n), s, n);
+    b->len += n;
+}
+
+#define OB_LIT(b, s) ob_put((b), (s), sizeof(s) - 1)
+
+// ==================== 记录改写 ====================
+
+typedef struct {
+    const char *p;
+    size_t n;
+} Span;
+
+enum { REC_MESSAGES, REC_PAIR, REC_TEXT, REC_DROPPED, REC_COUNT };
+static const char *REC_NAME[REC_COUNT] = { "messages", "input/output", "text", "未识别" };
+
+typedef struct {
+    Span role[MAX_MSGS], content[MAX_MSGS];
+    int nmsg;
+    Span pend_role, pend_content;
+    Span instruction, user, assistant, text;
+    Span meta_key[MAX_META], meta_val[MAX_META];
+    int nmeta;
+    int keep_meta;
+    OutBuf *out;
+    unsigned long long reescaped;
+    char *tmp;
+    size_t tmp_cap;
+} RecCtx;
+
+static int key_is(const char *key, size_t klen, const char *s) {
+    return klen == strlen(s) && memcmp(key, s, klen) == 0;
+}
+
+static int key_in(const char *key, size_t klen, const char *const *set) {
+    for (; *set; set++) if (key_is(key, klen, *set)) return 1;
+    return 0;
+}
+
+static const char *const USER_KEYS[] = { "input", "prompt", "question", "original", NULL };
+static const char *const ASSISTANT_KEYS[] = { "output", "response", "completion", "answer", "translated", NULL };
+
+static int on_string(void *ud, const char *key, size_t klen, const char *raw, size_t rlen, int depth) {
+    RecCtx *c = ud;
+    if (!key) return 0;
+    Span v = { raw, rlen };
+    if (depth >= 2) {
+        // messages 数组里的对象：role 与 content 先后顺序不定，凑齐一对即成一条
+        if (key_is(key, klen, "role")) c->pend_role = v;
+        else if (key_is(key, klen, "content")) c->pend_content = v;
+        else return 0;
+        if (c->pend_role.p && c->pend_content.p && c->nmsg < MAX_MSGS) {
+            c->role[c->nmsg] = c->pend_role;
+            c->content[c->nmsg] = c->pend_content;
+            c->nmsg++;
+            c->pend_role.p = c->pend_content.p = NULL;
+        }
+        return 0;
+    }
+    if (key_is(key, klen, "instruction")) c->instruction = v;
+    else if (key_in(key, klen, USER_KEYS)) { if (!c->user.p) c->user = v; }
+    else if (key_in(key, klen, ASSISTANT_KEYS)) { if (!c->assistant.p) c->assistant = v; }
+    else if (key_is(key, klen, "text")) c->text = v;
+    else if (c->nmeta < MAX_META) {
+        c->meta_key[c->nmeta].p = key;
+        c->meta_key[c->nmeta].n = klen;
+        c->meta_val[c->nmeta++] = v;
+    }
+    return 0;
+}
+
+// 原始切片里的转义是否已是 qsm_json_escape 的写法（\" \\ \n \t \r 与控制字符 \u00XX）
+static int is_canonical(const char *s, size_t n) {
+    const char *p = memchr(s, '\\', n), *end = s + n;
+    while (p) {
+        if (p + 1 >= end) return 0;
+        char e = p[1];
+        if (e == 'u') {
+            if (p + 6 > end || p[2] != '0' || p[3] != '0' || p[4] > '1') return 0;
+            if (p[4] == '0' && (p[5] == '9' || p[5] == 'a' || p[5] == 'd')) return 0;   // 应写 \t \n \r
+            p += 6;
+        } else if (e == '"' || e == '\\' || e == 'n' || e == 't' || e == 'r') {
+            p += 2;
+        } else {
+            return 0;
+        }
+        p = p < end ? memchr(p, '\\', (size_t)(end - p)) : NULL;
+    }
+    return 1;
+}
+
+static void put_str_body(RecCtx *c, Span s) {
+    if (is_canonical(s.p, s.n)) {
+        ob_put(c->out, s.p, s.n);
+        return;
+    }
+    if (s.n > c->tmp_cap) {
+        c->tmp_cap = s.n * 2;
+        c->tmp = realloc(c->tmp, c->tmp_cap);
+    }
+    size_t n = qsm_json_unescape(s.p, s.n, c->tmp);
+    char *o = ob_reserve(c->out, n * 6);
+    c->out->len += qsm_json_escape(c->tmp, n, o);
+    c->reescaped++;
+}
+
+static void put_message(RecCtx *c, int first, const char *role, Span role_raw, Span a, Span b) {
+    if (!first) OB_LIT(c->out, ", ");
+    OB_LIT(c->out, "{\"role\": \"");
+    if (role) ob_put(c->out, role, strlen(role));
+    else put_str_body(c, role_raw);
+    OB_LIT(c->out, "\", \"content\": \"");
+    put_str_body(c, a);
+    if (b.p) {
+        OB_LIT(c->out, "\\n");
+        put_str_body(c, b);
+    }
+    OB_LIT(c->out, "\"}");
+}
+
+static int emit_record(RecCtx *c) {
+    Span none = { NULL, 0 };
+    int kind;
+    size_t mark = c->out->len;
+    OB_LIT(c->out, "{\"messages\": [");
+    if (c->nmsg > 0) {
+        kind = REC_MESSAGES;
+        for (int i = 0; i < c->nmsg; i++) put_message(c, i == 0, NULL, c->role[i], c->content[i], none);
+    } else if (c->user.p || c->assistant.p || c->instruction.p) {
+        kind = REC_PAIR;
+        // instruction 与 input 同时存在时拼成一条 user 消息
+        Span u = c->instruction.p ? c->instruction : c->user;
+        Span u2 = c->instruction.p && c->user.p ? c->user : none;
+        int first = 1;
+        if (u.p) { put_message(c, 1, "user", none, u, u2); first = 0; }
+        if (c->assistant.p) put_message(c, first, "assistant", none, c->assistant, none);
+    } else if (c->text.p) {
+        kind = REC_TEXT;
+        put_message(c, 1, "assistant", none, c->text, none);
+    } else {
+        c->out->len = mark;
+        return REC_DROPPED;
+    }
+    OB_LIT(c->out, "]");
+    if (c->keep_meta && c->nmeta > 0) {
+        OB_LIT(c->out, ", \"meta\": {");
+        for (int i = 0; i < c->nmeta; i++) {
+            if (i) OB_LIT(c->out, ", ");
+            OB_LIT(c->out, "\"");
+            put_str_body(c, c->meta_key[i]);
+            OB_LIT(c->out, "\": \"");
+            put_str_body(c, c->meta_val[i]);
+            OB_LIT(c->out, "\"");
+        }
+        OB_LIT(c->out, "}");
+    }
+    OB_LIT(c->out, "}\n");
+    return kind;
+}
+
+// ==================== 并行改写 ====================
+//
+// 工作线程按块号顺序领块，主线程按同样的顺序等块完成、写出、释放。领先已写出的块
+// 超过 window 个时工作线程停下来等，内存里挂着的结果最多 window 块（块长有上限），
+// 与语料总量无关。
+
+#define CHUNK_MAX (8 << 20)
+
+typedef struct {
+    const QsmChunk *chunks;
+    int nchunks;
+    int next, written, window, stop;
+    char *done;                 // [nchunks]
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+    OutBuf *outs;               // [nchunks]
+    int keep_meta;
+    atomic_ullong kinds[REC_COUNT];
+    atomic_ullong malformed;
+    atomic_ullong reescaped;
+} NormJob;
+
+static void *norm_thread(void *arg) {
+    NormJob *job = arg;
+    RecCtx c;
+    memset(&c, 0, sizeof(c));
+    c.keep_meta = job->keep_meta;
+    unsigned long long kinds[REC_COUNT] = { 0 }, bad = 0;
+    for (;;) {
+        pthread_mutex_lock(&job->mu);
+        while (!job->stop && job->next < job->nchunks && job->next >= job->written + job->window)
+            pthread_cond_wait(&job->cv, &job->mu);
+        int i = !job->stop && job->next < job->nchunks ? job->next++ : -1;
+        pthread_mutex_unlock(&job->mu);
+        if (i < 0) break;
+        const QsmChunk *ch = &job->chunks[i];
+        c.out = &job->outs[i];
+        ob_reserve(c.out, (size_t)(ch->hi - ch->lo) + 1024);
+        for (const char *p = ch->lo; p < ch->hi;) {
+            const char *eol;
+            const char *nx = qsm_next_line(p, ch->hi, &eol);
+            if (!qsm_is_blank_line(p, eol)) {
+                memset(&c, 0, offsetof(RecCtx, keep_meta));
+                if (qsm_json_scan(p, eol, on_string, &c) < 0) {
+                    bad++;
+                    kinds[REC_DROPPED]++;
+                } else {
+                    kinds[emit_record(&c)]++;
+                }
+            }
+            p = nx;
+        }
+        pthread_mutex_lock(&job->mu);
+        job->done[i] = 1;
+        pthread_cond_broadcast(&job->cv);
+        pthread_mutex_unlock(&job->mu);
+    }
+    free(c.tmp);
+    for (int k = 0; k < REC_COUNT; k++) atomic_fetch_add(&job->kinds[k], kinds[k]);
+    atomic_fetch_add(&job->malformed, bad);
+    atomic_fetch_add(&job->reescaped, c.reescaped);
+    return NULL;
+}
+
+// 输出目录模式下按输入的相对路径建文件（子目录里同名的文件不会互相覆盖）
+static FILE *open_output(const char *dir, const char *rel) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", dir, rel);
+    for (char *p = path + strlen(dir) + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(path, 0755);
+        *p = '/';
+    }
+    FILE *f = fopen(path, "wb");
+    if (!f) fprintf(stderr, "[NORM] 无法写输出: %s\n", path);
+    return f;
+}
+
+// ==================== 主函数 ====================
+
+static int ends_with(const char *s, const char *suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "用法: %s [-t 线程] [--no-meta] -o <输出目录|输出.jsonl> <目录|文件>...\n", prog);
+    fprintf(stderr, "\n把 messages / input-output / original-translated / text 记录统一改写为 messages 格式\n");
+    fprintf(stderr, "  -o         以 .jsonl 结尾时所有输入按顺序写入该文件，否则为输出目录（同名文件）\n");
+    fprintf(stderr, "  -t         线程数（默认 CPU 核数）\n");
+    fprintf(stderr, "  --no-meta  丢弃其余顶层字段，不输出 \"meta\"\n");
+}
+
+int main(int argc, char *argv[]) {
+    int nthreads = qsm_default_threads(), keep_meta = 1;
+    const char *out_path = NULL;
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "-t") == 0 && argi + 1 < argc) nthreads = atoi(argv[++argi]);
+        else if (strcmp(argv[argi], "-o") == 0 && argi + 1 < argc) out_path = argv[++argi];
+        else if (strcmp(argv[argi], "--no-meta") == 0) keep_meta = 0;
+        else { usage(argv[0]); return 1; }
+    }
+    if (argi >= argc || !out_path) { usage(argv[0]); return 1; }
+    if (nthreads < 1) nthreads = 1;
+    double t0 = now_sec();
+
+    char **files = NULL;
+    int nfiles = 0;
+    size_t *rel = NULL;         // files[i] + rel[i] 为相对输入参数的路径（输出目录模式用）
+    for (; argi < argc; argi++) {
+        char **list;
+        int n = qsm_list_jsonl(argv[argi], &list);
+        if (n < 0) { fprintf(stderr, "[NORM] 无法读取: %s\n", argv[argi]); return 1; }
+        files = realloc(files, (nfiles + n) * sizeof(char *));
+        rel = realloc(rel, (nfiles + n) * sizeof(size_t));
+        memcpy(files + nfiles, list, n * sizeof(char *));
+        struct stat st;
+        int is_dir = stat(argv[argi], &st) == 0 && S_ISDIR(st.st_mode);
+        for (int i = 0; i < n; i++) {
+            const char *base = strrchr(list[i], '/');
+            rel[nfiles + i] = is_dir ? strlen(argv[argi]) + 1 : base ? (size_t)(base + 1 - list[i]) : 0;
+        }
+        nfiles += n;
+        free(list);
+    }
+    QsmMap *maps = calloc(nfiles ? nfiles : 1, sizeof(QsmMap));
+    size_t total = 0;
+    for (int i = 0; i < nfiles; i++) {
+        if (qsm_map_file(files[i], &maps[i]) != 0) {
+            fprintf(stderr, "[NORM] 无法映射: %s\n", files[i]);
+            return 1;
+        }
+        total += maps[i].size;
+    }
+
+    NormJob job;
+    memset(&job, 0, sizeof(job));
+    QsmChunk *chunks;
+    size_t target = total / ((size_t)nthreads * 8) + 1;
+    job.nchunks = qsm_make_chunks(maps, nfiles, target < CHUNK_MAX ? target : CHUNK_MAX, &chunks);
+    job.chunks = chunks;
+    job.outs = calloc(job.nchunks ? job.nchunks : 1, sizeof(OutBuf));
+    job.done = calloc(job.nchunks ? job.nchunks : 1, 1);
+    job.window = nthreads * 2;
+    job.keep_meta = keep_meta;
+    pthread_mutex_init(&job.mu, NULL);
+    pthread_cond_init(&job.cv, NULL);
+    pthread_t *th = malloc(nthreads * sizeof(pthread_t));
+    for (int t = 0; t < nthreads; t++) pthread_create(&th[t], NULL, norm_thread, &job);
+
+    // 按块顺序边等边写：同一文件的块在 chunks 中相邻，没有块的空文件也要建出空输出
+    int single = ends_with(out_path, ".jsonl");
+    if (!single) mkdir(out_path, 0755);
+    FILE *f = single ? fopen(out_path, "wb") : NULL;
+    if (single && !f) fprintf(stderr, "[NORM] 无法写输出: %s\n", out_path);
+    int ok = !single || f;
+    size_t written = 0;
+    for (int k = 0, cur = -1; ok && k <= job.nchunks; k++) {
+        int file = k < job.nchunks ? job.chunks[k].file : nfiles;
+        while (!single && ok && cur < file) {
+            if (f) fclose(f);
+            f = NULL;
+            if (++cur < nfiles && !(f = open_output(out_path, files[cur] + rel[cur]))) ok = 0;
+        }
+        if (!ok || k == job.nchunks) break;
+        pthread_mutex_lock(&job.mu);
+        while (!job.done[k]) pthread_cond_wait(&job.cv, &job.mu);
+        pthread_mutex_unlock(&job.mu);
+        if (fwrite(job.outs[k].data, 1, job.outs[k].len, f) != job.outs[k].len) {
+            fprintf(stderr, "[NORM] 写输出失败\n");
+            ok = 0;
+        }
+        written += job.outs[k].len;
+        free(job.outs[k].data);
+        job.outs[k].data = NULL;
+        pthread_mutex_lock(&job.mu);
+        job.written = k + 1;
+        pthread_cond_broadcast(&job.cv);
+        pthread_mutex_unlock(&job.mu);
+    }
+    if (f && fclose(f) != 0) ok = 0;
+    pthread_mutex_lock(&job.mu);
+    job.stop = 1;                       // 出错提前结束时放走还在等窗口的线程
+    pthread_cond_broadcast(&job.cv);
+    pthread_mutex_unlock(&job.mu);
+    for (int t = 0; t < nthreads; t++) pthread_join(th[t], NULL);
+    free(th);
+    for (int k = 0; k < job.nchunks; k++) free(job.outs[k].data);
+    free(job.outs);
+    free(job.done);
+    pthread_mutex_destroy(&job.mu);
+    pthread_cond_destroy(&job.cv);
+
+    double secs = now_sec() - t0;
+    fprintf(stdout, "[NORM] %d 个文件, %.1f MB → %.1f MB:", nfiles, total / 1048576.0, written / 1048576.0);
+    for (int k = 0; k < REC_COUNT; k++)
+        fprintf(stdout, " %s %llu%s", REC_NAME[k], (unsigned long long)atomic_load(&job.kinds[k]),
+                k + 1 < REC_COUNT ? "," : "");
+    fprintf(stdout, " (格式错误 %llu), 重新转义 %llu 个字符串, %.2fs\n",
+            (unsigned long long)atomic_load(&job.malformed),
+            (unsigned long long)atomic_load(&job.reescaped), secs);
+
+    for (int i = 0; i < nfiles; i++) qsm_unmap_file(&maps[i]);
+    free(maps);
+    free(chunks);
+    qsm_free_list(files, nfiles);
+    free(rel);
+    return ok ? 0 : 1;
+}
@@ -114,6 +114,121 @@ const QentlRuntime = {
         }
     },
     
+    // 原生QVM作业服务（bin/qvm_job_server）
+    // 服务在本机运行时，线路交给原生态矢量执行器；不可用时调用方回退到 QVMSimulator
+    qvm: {
+        endpoint: 'http://127.0.0.1:8100',
+        available: null,    // null=尚未探测
+        info: null,
+
+        async probe(force = false) {
+            if (this.available !== null && !force) return this.available;
+            try {
+                const ctrl = new AbortController();
+                const timer = setTimeout(() => ctrl.abort(), 500);
+                const resp = await fetch(this.endpoint + '/api/qvm/health', { signal: ctrl.signal });
+                clearTimeout(timer);
+                this.info = resp.ok ? await resp.json() : null;
+                this.available = !!(this.info && this.info.status === 'ok');
+            } catch (e) {
+                this.available = false;
+            }
+            return this.available;
+        },
+
+        // 把 Web 端 QBC 文本（INIT q0 / H q0 / CNOT q0 q1 / MEASURE q0）转成 QEntL 量子指令；
+        // 助记符不分大小写；INIT 后跟纯数字时是比特数（同 .qentl 的 init N），跟 qN 时是单个比特。
+        // 含原生执行器不支持的指令（GROVER、RANDOM 等）时返回 null
+        fromQBCText(text) {
+            const out = [];
+            let maxQ = -1;
+            const q = s => {
+                const m = /^q?(\d+)$/i.exec(s || '');
+                if (!m) throw new Error('bad qubit');
+                const n = parseInt(m[1], 10);
+                if (n > maxQ) maxQ = n;
+                return n;
+            };
+            try {
+                for (const raw of text.split('\n')) {
+                    const line = raw.replace(/(#|\/\/).*$/, '').trim();
+                    if (!line) continue;
+                    const [word, ...args] = line.split(/\s+/);
+                    const op = word.toUpperCase();
+                    switch (op) {
+                        case 'INIT':
+                            if (/^\d+$/.test(args[0])) maxQ = Math.max(maxQ, parseInt(args[0], 10) - 1);
+                            else q(args[0]);
+                            break;
+                        case 'H': case 'X': case 'Y': case 'Z': case 'S': case 'T':
+                            out.push(`${op} ${q(args[0])}`);
+                            break;
+                        case 'NOT':
+                            out.push(`X ${q(args[0])}`);
+                            break;
+                        case 'CNOT': case 'SWAP':
+                            out.push(`${op} ${q(args[0])} ${q(args[1])}`);
+                            break;
+                        case 'MEASURE': {
+                            const a = q(args[0]);
+                            out.push(`MEASURE ${a} ${args[1] !== undefined ? q(args[1]) : a}`);
+                            break;
+                        }
+                        case 'PRINT':
+                            out.push(`PRINT ${parseInt(args[0], 10) || 0}`);
+                            break;
+                        case 'STOP': case 'EXIT':
+                            out.push(op);
+                            break;
+                        default:
+                            return null;
+                    }
+                }
+            } catch (e) {
+                return null;
+            }
+            if (maxQ < 0) return null;
+            return `init ${maxQ + 1}\n` + out.join('\n') + '\n';
+        },
+
+        // 提交作业并逐行读取 NDJSON 事件（queued / compiled / result / error），
+        // onEvent 每收到一个事件调用一次；返回 result 事件，出错时抛异常
+        async run(job, onEvent = () => {}) {
+            const resp = await fetch(this.endpoint + '/api/qvm/jobs', {
+                method: 'POST',
+                headers: { 'Content-Type': 'application/json' },
+                body: JSON.stringify(job)
+            });
+            if (!resp.ok) {
+                const err = await resp.json().catch(() => ({}));
+                throw new Error(err.error || `HTTP ${resp.status}`);
+            }
+            const reader = resp.body.getReader();
+            const decoder = new TextDecoder();
+            let buf = '', result = null;
+            const handle = line => {
+                if (!line.trim()) return;
+                const ev = JSON.parse(line);
+                onEvent(ev);
+                if (ev.event === 'error') throw new Error(ev.error);
+                if (ev.event === 'result') result = ev;
+            };
+            for (;;) {
+                const { done, value } = await reader.read();
+                if (done) break;
+                buf += decoder.decode(value, { stream: true });
+                let nl;
+                while ((nl = buf.indexOf('\n')) >= 0) {
+                    handle(buf.slice(0, nl));
+                    buf = buf.slice(nl + 1);
+                }
+            }
+            handle(buf);
+            if (!result) throw new Error('作业未返回结果');
+            return result;
+        }
+    },
+
     // 四大模型接口
     models: {
         QSM: {
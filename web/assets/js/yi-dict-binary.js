@@ -0,0 +1,129 @@
+/**
+ * QSM 彝文二进制词典加载器
+ * 读取 yi_dict_tool web 生成的 web/data/yi_dict.ybd：
+ * 一次 fetch 得到 ArrayBuffer，DataView 直接读偏移表，
+ * 启动时不解析 JS/JSON，只有查询命中的字符串才解码。
+ *
+ * 布局（小端）：
+ *   头部  magic "YBD1", version, ntables, pool_off, pool_size, nentries
+ *   表    id, n, ncols, offs_off
+ *   每表 (1 + ncols) 个 uint32[n+1] 偏移数组（相对字符串池），
+ *   第 0 个为按 UTF-8 字节序排序的键，字符串 i = pool[off[i], off[i+1])
+ */
+
+class YiBinaryDict {
+    static get MAGIC() { return 0x31444259; }
+    static get TABLE_ZH_YI() { return 0; }
+    static get TABLE_YI_ENTRY() { return 1; }
+
+    constructor(buffer) {
+        const view = new DataView(buffer);
+        if (view.getUint32(0, true) !== YiBinaryDict.MAGIC) {
+            throw new Error('yi_dict.ybd: magic 不匹配');
+        }
+        this.buffer = buffer;
+        this.view = view;
+        this.version = view.getUint32(4, true);
+        const ntables = view.getUint32(8, true);
+        const poolOff = view.getUint32(12, true);
+        const poolSize = view.getUint32(16, true);
+        this.nentries = view.getUint32(20, true);
+        this.pool = new Uint8Array(buffer, poolOff, poolSize);
+        this.tables = [];
+        for (let t = 0; t < ntables; t++) {
+            const base = 24 + t * 16;
+            this.tables[view.getUint32(base, true)] = {
+                n: view.getUint32(base + 4, true),
+                ncols: view.getUint32(base + 8, true),
+                offs: view.getUint32(base + 12, true)
+            };
+        }
+        this.encoder = new TextEncoder();
+        this.decoder = new TextDecoder('utf-8');
+    }
+
+    static async load(url = '/data/yi_dict.ybd') {
+        const resp = await fetch(url);
+        if (!resp.ok) throw new Error(`yi_dict.ybd: HTTP ${resp.status}`);
+        return new YiBinaryDict(await resp.arrayBuffer());
+    }
+
+    // 第 col 列第 i 个字符串的 [起, 止)
+    _span(table, col, i) {
+        const at = table.offs + (col * (table.n + 1) + i) * 4;
+        return [this.view.getUint32(at, true), this.view.getUint32(at + 4, true)];
+    }
+
+    _string(table, col, i) {
+        const [lo, hi] = this._span(table, col, i);
+        return this.decoder.decode(this.pool.subarray(lo, hi));
+    }
+
+    _compare(table, i, key) {
+        const [lo, hi] = this._span(table, 0, i);
+        const pool = this.pool;
+        const n = Math.min(hi - lo, key.length);
+        for (let k = 0; k < n; k++) {
+            const d = pool[lo + k] - key[k];
+            if (d !== 0) return d;
+        }
+        return (hi - lo) - key.length;
+    }
+
+    // 二分查找键，返回行号或 -1
+    find(tableId, text) {
+        const table = this.tables[tableId];
+        if (!table) return -1;
+        const key = this.encoder.encode(text);
+        let lo = 0, hi = table.n - 1;
+        while (lo <= hi) {
+            const mid = (lo + hi) >>> 1;
+            const c = this._compare(table, mid, key);
+            if (c === 0) return mid;
+            if (c < 0) lo = mid + 1; else hi = mid - 1;
+        }
+        return -1;
+    }
+
+    get(tableId, text, col = 1) {
+        const i = this.find(tableId, text);
+        return i < 0 ? null : this._string(this.tables[tableId], col, i);
+    }
+
+    zhToYi(zh) { return this.get(YiBinaryDict.TABLE_ZH_YI, zh); }
+    yiToZh(yi) { return this.get(YiBinaryDict.TABLE_YI_ENTRY, yi, 1); }
+    yiToEn(yi) { return this.get(YiBinaryDict.TABLE_YI_ENTRY, yi, 2); }
+
+    // 逐字翻译：优先最长匹配的中文词，未收录的字原样保留
+    translateZh(text, maxLen = 8) {
+        let out = '';
+        const chars = Array.from(text);
+        for (let i = 0; i < chars.length;) {
+            let hit = null, len = Math.min(maxLen, chars.length - i);
+            for (; len > 0; len--) {
+                hit = this.zhToYi(chars.slice(i, i + len).join(''));
+                if (hit !== null) break;
+            }
+            if (hit === null) { out += chars[i]; i++; }
+            else { out += hit; i += len; }
+        }
+        return out;
+    }
+
+    // 兼容旧代码：按需展开成 CN_TO_YI / YI_TO_CN 风格的普通对象
+    toObject(tableId, col = 1) {
+        const table = this.tables[tableId];
+        const obj = {};
+        for (let i = 0; i < table.n; i++) obj[this._string(table, 0, i)] = this._string(table, col, i);
+        return obj;
+    }
+
+    get size() { return this.nentries; }
+}
+
+if (typeof window !== 'undefined') {
+    window.YiBinaryDict = YiBinaryDict;
+}
+if (typeof module !== 'undefined') {
+    module.exports = YiBinaryDict;
+}